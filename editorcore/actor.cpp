@@ -24,6 +24,14 @@ Actor::Actor(const Actor& other)
 }
 
 
+shared_ptr<Actor> Actor::CreateSnapshot(const shared_ptr<ActorType>& type) const
+{
+	shared_ptr<Actor> result = make_shared<Actor>(*this);
+	result->m_type = type;
+	return result;
+}
+
+
 void Actor::Move(size_t x, size_t y, size_t width, size_t height)
 {
 	m_x = x;
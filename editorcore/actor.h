@@ -12,6 +12,9 @@ public:
 	Actor(const std::shared_ptr<ActorType>& type, size_t x, size_t y, size_t width = 1, size_t height = 1);
 	Actor(const Actor& other);
 
+	// Copy for saving in the background that refers to a snapshot of the actor type
+	std::shared_ptr<Actor> CreateSnapshot(const std::shared_ptr<ActorType>& type) const;
+
 	std::shared_ptr<ActorType> GetType() const { return m_type; }
 
 	size_t GetX() const { return m_x; }
@@ -66,6 +66,14 @@ ActorType::ActorType(const ActorType& other)
 }
 
 
+shared_ptr<ActorType> ActorType::CreateSnapshot() const
+{
+	shared_ptr<ActorType> result = make_shared<ActorType>();
+	*result = *this;
+	return result;
+}
+
+
 void ActorType::AddField(const ActorField& field)
 {
 	m_fields.push_back(field);
@@ -63,6 +63,9 @@ public:
 	ActorType();
 	ActorType(const ActorType& other);
 
+	// Copy with the same id for saving in the background
+	std::shared_ptr<ActorType> CreateSnapshot() const;
+
 	const std::string& GetName() const { return m_name; }
 	void SetName(const std::string& name) { m_name = name; }
 
@@ -22,6 +22,7 @@ AddTileSetDialog::AddTileSetDialog(QWidget* parent, shared_ptr<Project> project)
 	types.append("Normal tile set");
 	types.append("Simplified single width smart tile set");
 	types.append("Simplified double width smart tile set");
+	types.append("Blob (47 tile) smart tile set");
 	m_type->setEditable(false);
 	m_type->addItems(types);
 	m_type->setCurrentIndex(0);
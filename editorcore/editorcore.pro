@@ -14,9 +14,13 @@ SOURCES += \
 	theme.cpp \
 	palette.cpp \
 	tile.cpp \
+	tilecache.cpp \
 	tileset.cpp \
+	smarttile.cpp \
 	map.cpp \
 	maplayer.cpp \
+	undodelta.cpp \
+	undohistory.cpp \
 	project.cpp \
 	projectview.cpp \
 	projectitemwidget.cpp \
@@ -39,6 +43,7 @@ SOURCES += \
 	mapeditorwidget.cpp \
 	renderer.cpp \
 	mapfloatinglayer.cpp \
+	maptilesmimedata.cpp \
 	maplayerwidget.cpp \
 	maplayeritemwidget.cpp \
 	maptilewidget.cpp \
@@ -84,9 +89,13 @@ HEADERS += \
 	theme.h \
 	palette.h \
 	tile.h \
+	tilecache.h \
 	tileset.h \
+	smarttile.h \
 	map.h \
 	maplayer.h \
+	undodelta.h \
+	undohistory.h \
 	project.h \
 	projectview.h \
 	projectitemwidget.h \
@@ -109,6 +118,7 @@ HEADERS += \
 	mapeditorwidget.h \
 	renderer.h \
 	mapfloatinglayer.h \
+	maptilesmimedata.h \
 	maplayerwidget.h \
 	maplayeritemwidget.h \
 	maptilewidget.h \
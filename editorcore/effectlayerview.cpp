@@ -111,7 +111,40 @@ EffectLayerView::EffectLayerView(MainWindow* parent, shared_ptr<Project> project
 void EffectLayerView::UpdateView()
 {
 	m_editor->UpdateView();
+	UpdateWidgets();
+}
+
+
+void EffectLayerView::UpdateTileSetContents(shared_ptr<TileSet> tileSet)
+{
+	m_editor->UpdateTileSetContents(tileSet);
+	UpdateWidgets();
+}
+
+
+void EffectLayerView::UpdateTileSetTiles(shared_ptr<TileSet> tileSet, const set<size_t>& tiles, uint16_t frame)
+{
+	// Only the changed tiles are decoded again, the tile selection widgets are kept
+	m_editor->UpdateTileSetContents(tileSet);
+	m_tiles->UpdateTileSetTiles(tileSet, tiles, frame);
+}
+
 
+void EffectLayerView::UpdatePaletteContents(shared_ptr<Palette> palette)
+{
+	m_editor->UpdatePaletteContents(palette);
+	UpdateWidgets();
+}
+
+
+bool EffectLayerView::DependsOnTileSet(shared_ptr<TileSet> tileSet)
+{
+	return m_layer->UsesTileSet(tileSet) || m_tiles->ShowsTileSet(tileSet);
+}
+
+
+void EffectLayerView::UpdateWidgets()
+{
 	auto sinceLastUpdate = chrono::steady_clock::now() - m_lastUpdate;
 	double t = chrono::duration_cast<chrono::milliseconds>(sinceLastUpdate).count();
 	if (m_firstUpdate || (t > 250))
@@ -39,11 +39,17 @@ class EffectLayerView: public EditorView
 	std::chrono::steady_clock::time_point m_lastUpdate;
 	bool m_firstUpdate;
 
+	void UpdateWidgets();
+
 public:
 	EffectLayerView(MainWindow* parent, std::shared_ptr<Project> project,
 		std::shared_ptr<MapLayer> layer);
 
 	void UpdateView();
+	void UpdateTileSetContents(std::shared_ptr<TileSet> tileSet);
+	void UpdateTileSetTiles(std::shared_ptr<TileSet> tileSet, const std::set<size_t>& tiles, uint16_t frame);
+	void UpdatePaletteContents(std::shared_ptr<Palette> palette);
+	bool DependsOnTileSet(std::shared_ptr<TileSet> tileSet);
 	void UpdateToolState();
 
 	std::shared_ptr<MapLayer> GetEffectLayer() const { return m_layer; }
@@ -10,33 +10,29 @@
 #include <QMenu>
 #include <QMenuBar>
 #include <QFileDialog>
+#include <QFile>
 #include <QSettings>
 #include <QMessageBox>
 #include <QStatusBar>
 #include <QCoreApplication>
 #include <QPlainTextEdit>
 #include <QFont>
+#include <QDir>
+#include <QSaveFile>
+#include <QRunnable>
 #include <stdio.h>
 
 using namespace std;
 
 
-UndoAction::UndoAction(const function<void()>& undoAction, const function<void()>& redoAction):
-	m_undo(undoAction), m_redo(redoAction)
+class AutosaveTask: public QRunnable
 {
-}
-
+	function<void()> m_func;
 
-void UndoAction::Undo()
-{
-	m_undo();
-}
-
-
-void UndoAction::Redo()
-{
-	m_redo();
-}
+public:
+	AutosaveTask(const function<void()>& func): m_func(func) {}
+	virtual void run() override { m_func(); }
+};
 
 
 MainWindow::MainWindow(const QString& title, const QString& basePath, const QString& assetPath, QWidget* parent):
@@ -44,6 +40,22 @@ MainWindow::MainWindow(const QString& title, const QString& basePath, const QStr
 {
 	m_basePath = basePath;
 
+	QSettings settings;
+	m_undoHistory.SetMemoryBudget((size_t)settings.value("undoMemoryBudget",
+		(qulonglong)DEFAULT_UNDO_MEMORY_BUDGET).toULongLong());
+
+	m_autosavePool.setMaxThreadCount(1);
+	m_discardAutosave = false;
+	m_autosaveTimer = new QTimer(this);
+	m_autosaveTimer->setInterval(settings.value("autosaveInterval", DEFAULT_AUTOSAVE_INTERVAL).toInt() * 1000);
+	connect(m_autosaveTimer, &QTimer::timeout, this, &MainWindow::OnAutosaveTimer);
+	m_autosaveTimer->start();
+
+	m_changeTimer = new QTimer(this);
+	m_changeTimer->setInterval(0);
+	m_changeTimer->setSingleShot(true);
+	connect(m_changeTimer, &QTimer::timeout, this, &MainWindow::OnChangeTimer);
+
 	resize(QSize(1024, 640));
 	setWindowTitle(title);
 
@@ -71,6 +83,14 @@ MainWindow::MainWindow(const QString& title, const QString& basePath, const QStr
 	connect(m_saveAction, &QAction::triggered, this, &MainWindow::OnSave);
 	fileMenu->addAction(m_saveAction);
 
+	fileMenu->addSeparator();
+
+	// Packed maps are smaller and faster to load, but can't be read by versions before the format was added
+	m_packedMapsAction = new QAction("Save Maps in Packed Format");
+	m_packedMapsAction->setCheckable(true);
+	connect(m_packedMapsAction, &QAction::triggered, this, &MainWindow::OnPackedMaps);
+	fileMenu->addAction(m_packedMapsAction);
+
 	QMenu* editMenu = new QMenu("Edit");
 
 	m_undoAction = new QAction("Undo");
@@ -83,6 +103,10 @@ MainWindow::MainWindow(const QString& title, const QString& basePath, const QStr
 	connect(m_redoAction, &QAction::triggered, this, &MainWindow::OnRedo);
 	editMenu->addAction(m_redoAction);
 
+	m_undoMemoryAction = new QAction("Undo History Memory Usage...");
+	connect(m_undoMemoryAction, &QAction::triggered, this, &MainWindow::OnUndoMemoryUsage);
+	editMenu->addAction(m_undoMemoryAction);
+
 	editMenu->addSeparator();
 
 	m_cutAction = new QAction("Cut");
@@ -142,6 +166,7 @@ MainWindow::MainWindow(const QString& title, const QString& basePath, const QStr
 
 MainWindow::~MainWindow()
 {
+	WaitForAutosave();
 }
 
 
@@ -203,14 +228,8 @@ void MainWindow::UpdatePaletteContents(shared_ptr<Palette> palette)
 		i->second->UpdateView();
 	}
 
-	for (auto& i : m_openTileSets)
-		i.second->UpdateView();
-	for (auto& i : m_openSprites)
-		i.second->UpdateView();
-	for (auto& i : m_openEffectLayers)
-		i.second->UpdateView();
-	for (auto& i : m_openMaps)
-		i.second->UpdateView();
+	m_changedPalettes.insert(palette);
+	QueueChangeNotification();
 }
 
 
@@ -272,10 +291,27 @@ void MainWindow::UpdateTileSetContents(shared_ptr<TileSet> tileSet)
 		i->second->UpdateView();
 	}
 
+	m_changedTileSets.insert(tileSet);
+	QueueChangeNotification();
+}
+
+
+void MainWindow::UpdateTileSetTiles(shared_ptr<TileSet> tileSet, const set<size_t>& tiles, uint16_t frame)
+{
+	auto i = m_openTileSets.find(tileSet);
+	if (i != m_openTileSets.end())
+		i->second->UpdateTiles(tiles, frame);
+
 	for (auto& i : m_openEffectLayers)
-		i.second->UpdateView();
+	{
+		if (i.second->DependsOnTileSet(tileSet))
+			i.second->UpdateTileSetTiles(tileSet, tiles, frame);
+	}
 	for (auto& i : m_openMaps)
-		i.second->UpdateView();
+	{
+		if (i.second->DependsOnTileSet(tileSet))
+			i.second->UpdateTileSetTiles(tileSet, tiles, frame);
+	}
 }
 
 
@@ -475,10 +511,8 @@ void MainWindow::UpdateSpriteContents(shared_ptr<Sprite> sprite)
 		i->second->UpdateView();
 	}
 
-	for (auto& i : m_openMaps)
-		i.second->UpdateView();
-	for (auto& i : m_openActorTypes)
-		i.second->UpdateView();
+	m_changedSprites.insert(sprite);
+	QueueChangeNotification();
 }
 
 
@@ -557,12 +591,32 @@ ActorTypeView* MainWindow::GetActorTypeView(std::shared_ptr<ActorType> actorType
 
 void MainWindow::AddUndoAction(const function<void()>& undoAction, const function<void()>& redoAction)
 {
-	m_redoStack = stack<shared_ptr<UndoAction>>();
-	m_undoStack.push(make_shared<UndoAction>(undoAction, redoAction));
+	AddUndoAction("", DEFAULT_UNDO_ACTION_SIZE, undoAction, redoAction);
+}
+
+
+void MainWindow::AddUndoAction(const string& asset, size_t memoryUsage,
+	const function<void()>& undoAction, const function<void()>& redoAction)
+{
+	m_undoHistory.Add(make_shared<UndoAction>(undoAction, redoAction, asset, memoryUsage));
 	m_modified = true;
 }
 
 
+void MainWindow::ClearUndoHistory()
+{
+	m_undoHistory.Clear();
+}
+
+
+void MainWindow::SetUndoMemoryBudget(size_t bytes)
+{
+	m_undoHistory.SetMemoryBudget(bytes);
+	QSettings settings;
+	settings.setValue("undoMemoryBudget", (qulonglong)bytes);
+}
+
+
 bool MainWindow::PromptToSaveIfRequired()
 {
 	if (m_modified)
@@ -575,6 +629,10 @@ bool MainWindow::PromptToSaveIfRequired()
 			if (!AttemptSave())
 				return false;
 		}
+		else if (result == QMessageBox::Discard)
+		{
+			DiscardAutosave();
+		}
 		else if (result == QMessageBox::Cancel)
 		{
 			return false;
@@ -592,22 +650,32 @@ void MainWindow::CloseProject()
 	m_openTileSets.clear();
 	m_openEffectLayers.clear();
 	m_openMaps.clear();
+
+	m_changeTimer->stop();
+	m_changedPalettes.clear();
+	m_changedTileSets.clear();
+	m_changedSprites.clear();
 }
 
 
 void MainWindow::NewProject(const QString& path)
 {
+	WaitForAutosave();
 	CloseProject();
 
 	m_project = make_shared<Project>();
 	m_projectPath = path;
 	m_modified = false;
+	ClearUndoHistory();
 	m_projectView->SetProject(m_project);
+	m_packedMapsAction->setChecked(m_project->GetMapTileFormat() == MAP_LAYER_TILE_FORMAT_PACKED);
 }
 
 
 bool MainWindow::OpenProject(const QString& path)
 {
+	WaitForAutosave();
+
 	shared_ptr<Project> project = Project::Open(path);
 	if (!project)
 	{
@@ -615,10 +683,56 @@ bool MainWindow::OpenProject(const QString& path)
 		return false;
 	}
 
+	// An autosave is only left behind if the project was not saved afterwards, for example after a crash
+	bool recovered = false;
+	QString autosavePath = GetAutosavePath(path);
+	if (IsAutosaveOfProject(autosavePath, path))
+	{
+		QMessageBox::StandardButton result = QMessageBox::question(this, "Recover Changes",
+			"The project has unsaved changes from a previous session. Do you want to recover these changes?",
+			QMessageBox::Yes | QMessageBox::No, QMessageBox::Yes);
+		if (result == QMessageBox::Yes)
+		{
+			// Load every asset now, the autosave directory is removed once the project is saved or discarded
+			shared_ptr<Project> autosave = Project::Open(autosavePath);
+			if (autosave && autosave->LoadAllAssets())
+			{
+				project = autosave;
+				recovered = true;
+			}
+			else if (autosave)
+			{
+				QMessageBox::critical(this, "Error", "Unsaved changes could not be recovered:\n" +
+					autosave->GetLoadErrors().join("\n"));
+			}
+			else
+			{
+				QMessageBox::critical(this, "Error", "Unsaved changes could not be recovered.");
+			}
+		}
+		else
+		{
+			QDir(autosavePath).removeRecursively();
+		}
+	}
+
 	m_project = project;
 	m_projectPath = path;
-	m_modified = false;
+	m_modified = recovered;
+	ClearUndoHistory();
 	m_projectView->SetProject(m_project);
+	m_packedMapsAction->setChecked(m_project->GetMapTileFormat() == MAP_LAYER_TILE_FORMAT_PACKED);
+
+	double total = 0;
+	QString stages;
+	for (auto& i : project->GetOpenTimings())
+	{
+		total += i.second;
+		if (stages.size() != 0)
+			stages += ", ";
+		stages += QString::fromStdString(i.first) + QString::asprintf(" %.0f ms", i.second);
+	}
+	statusBar()->showMessage(QString::asprintf("Project opened in %.0f ms (", total) + stages + ")", 10000);
 	return true;
 }
 
@@ -635,6 +749,7 @@ bool MainWindow::SaveProject(const QString& path)
 
 	m_projectPath = path;
 	m_modified = false;
+	DiscardAutosave();
 	return true;
 }
 
@@ -678,27 +793,283 @@ void MainWindow::OnSave()
 }
 
 
+void MainWindow::OnPackedMaps(bool packed)
+{
+	if (!m_project->SetMapTileFormat(packed ? MAP_LAYER_TILE_FORMAT_PACKED : MAP_LAYER_TILE_FORMAT_ROWS))
+	{
+		QMessageBox::critical(this, "Error", "Some maps could not be loaded and will keep their current format:\n" +
+			m_project->GetLoadErrors().join("\n"));
+	}
+	m_modified = true;
+}
+
+
+void MainWindow::QueueChangeNotification()
+{
+	if (!m_changeTimer->isActive())
+		m_changeTimer->start();
+}
+
+
+void MainWindow::OnChangeTimer()
+{
+	set<shared_ptr<Palette>> palettes;
+	set<shared_ptr<TileSet>> tileSets;
+	set<shared_ptr<Sprite>> sprites;
+	palettes.swap(m_changedPalettes);
+	tileSets.swap(m_changedTileSets);
+	sprites.swap(m_changedSprites);
+
+	// Tile set and sprite editors list every palette, but only need a full update when they use one
+	// of the changed palettes
+	set<TileSetView*> tileSetViews, tileSetPaletteLists;
+	set<SpriteView*> spriteViews, spritePaletteLists;
+	set<MapView*> mapViews;
+	for (auto& palette : palettes)
+	{
+		// Runs on every edit, so tile sets that have not been loaded are not read from disk here
+		vector<shared_ptr<TileSet>> paletteTileSets = m_project->GetLoadedTileSetsUsingPalette(palette);
+		vector<shared_ptr<Sprite>> paletteSprites = m_project->GetSpritesUsingPalette(palette);
+
+		for (auto& i : m_openTileSets)
+		{
+			if (i.first->UsesPalette(palette))
+				tileSetViews.insert(i.second);
+			else
+				tileSetPaletteLists.insert(i.second);
+		}
+		for (auto& i : m_openSprites)
+		{
+			if (i.first->UsesPalette(palette))
+				spriteViews.insert(i.second);
+			else
+				spritePaletteLists.insert(i.second);
+		}
+
+		for (auto& i : m_openEffectLayers)
+		{
+			for (auto& j : paletteTileSets)
+			{
+				if (i.second->DependsOnTileSet(j))
+				{
+					i.second->UpdatePaletteContents(palette);
+					break;
+				}
+			}
+		}
+		for (auto& i : m_openMaps)
+		{
+			bool dependent = false;
+			for (auto& j : paletteTileSets)
+			{
+				if (i.second->DependsOnTileSet(j))
+				{
+					dependent = true;
+					break;
+				}
+			}
+			for (auto& j : paletteSprites)
+			{
+				if (dependent)
+					break;
+				dependent = i.second->DependsOnSprite(j);
+			}
+			if (dependent)
+				i.second->UpdatePaletteContents(palette);
+		}
+	}
+
+	for (auto i : tileSetViews)
+		i->UpdateView();
+	for (auto i : tileSetPaletteLists)
+	{
+		if (tileSetViews.count(i) == 0)
+			i->UpdatePaletteList();
+	}
+	for (auto i : spriteViews)
+		i->UpdateView();
+	for (auto i : spritePaletteLists)
+	{
+		if (spriteViews.count(i) == 0)
+			i->UpdatePaletteList();
+	}
+
+	for (auto& tileSet : tileSets)
+	{
+		for (auto& i : m_openEffectLayers)
+		{
+			if (i.second->DependsOnTileSet(tileSet))
+				i.second->UpdateTileSetContents(tileSet);
+		}
+		for (auto& i : m_openMaps)
+		{
+			if (i.second->DependsOnTileSet(tileSet))
+				i.second->UpdateTileSetContents(tileSet);
+		}
+	}
+
+	// Actor type editors list every sprite, maps only draw the sprites of their actors
+	if (sprites.size() != 0)
+	{
+		for (auto& i : m_openActorTypes)
+			i.second->UpdateView();
+	}
+	for (auto& sprite : sprites)
+	{
+		for (auto& i : m_openMaps)
+		{
+			if (i.second->DependsOnSprite(sprite))
+				mapViews.insert(i.second);
+		}
+	}
+	for (auto i : mapViews)
+		i->UpdateView();
+}
+
+
 void MainWindow::OnUndo()
 {
-	if (m_undoStack.empty())
+	if (!m_undoHistory.Undo())
 		return;
-	shared_ptr<UndoAction> action = m_undoStack.top();
-	m_undoStack.pop();
-	m_redoStack.push(action);
-	action->Undo();
 	m_modified = true;
+	Q_ASSERT(m_project->CheckUsageCounts());
 }
 
 
 void MainWindow::OnRedo()
 {
-	if (m_redoStack.empty())
+	if (!m_undoHistory.Redo())
 		return;
-	shared_ptr<UndoAction> action = m_redoStack.top();
-	m_redoStack.pop();
-	m_undoStack.push(action);
-	action->Redo();
 	m_modified = true;
+	Q_ASSERT(m_project->CheckUsageCounts());
+}
+
+
+QString MainWindow::GetAutosavePath(const QString& path)
+{
+	// Kept inside the project, so that projects in the same directory do not share it
+	return QDir(path).absoluteFilePath(AUTOSAVE_DIRECTORY);
+}
+
+
+bool MainWindow::WriteAutosaveSource(const QString& autosavePath, const QString& projectPath)
+{
+	QSaveFile file(QDir(autosavePath).absoluteFilePath(AUTOSAVE_SOURCE_FILE));
+	if (!file.open(QIODevice::WriteOnly))
+		return false;
+	QByteArray data = QDir(projectPath).absolutePath().toUtf8();
+	if (file.write(data) != (qint64)data.size())
+	{
+		file.cancelWriting();
+		return false;
+	}
+	return file.commit();
+}
+
+
+bool MainWindow::IsAutosaveOfProject(const QString& autosavePath, const QString& projectPath)
+{
+	// A project copied along with its autosave directory must not offer changes made to the original
+	if (!QFile::exists(QDir(autosavePath).absoluteFilePath("manifest.json")))
+		return false;
+	QFile file(QDir(autosavePath).absoluteFilePath(AUTOSAVE_SOURCE_FILE));
+	if (!file.open(QIODevice::ReadOnly))
+		return false;
+	return QString::fromUtf8(file.readAll()) == QDir(projectPath).absolutePath();
+}
+
+
+void MainWindow::WaitForAutosave()
+{
+	m_autosavePool.waitForDone();
+	if (m_discardAutosave)
+	{
+		QDir(m_autosavePath).removeRecursively();
+		m_discardAutosave = false;
+	}
+}
+
+
+void MainWindow::DiscardAutosave()
+{
+	// An autosave still being written removes the directory once it completes
+	if (m_autosaveSnapshot)
+		m_discardAutosave = true;
+	else
+		QDir(GetAutosavePath(m_projectPath)).removeRecursively();
+}
+
+
+void MainWindow::OnAutosaveTimer()
+{
+	if ((!m_modified) || m_autosaveSnapshot)
+		return;
+
+	// Taking the snapshot only copies references to tile data, serializing and writing it happens on a
+	// worker thread so that editing is not interrupted
+	m_autosaveProject = m_project;
+	m_autosaveSnapshot = m_project->CreateSnapshot();
+	m_autosavePath = GetAutosavePath(m_projectPath);
+	m_discardAutosave = false;
+
+	shared_ptr<Project> snapshot = m_autosaveSnapshot;
+	QString path = m_autosavePath;
+	QString projectPath = m_projectPath;
+	m_autosavePool.start(new AutosaveTask([=]() {
+		bool result = snapshot->Save(path) && WriteAutosaveSource(path, projectPath);
+		QMetaObject::invokeMethod(this, "OnAutosaveFinished", Qt::QueuedConnection, Q_ARG(bool, result));
+	}));
+}
+
+
+void MainWindow::OnAutosaveFinished(bool result)
+{
+	if (m_autosaveProject == m_project)
+	{
+		m_project->FinishAutosave(m_autosaveSnapshot, result);
+		if (!result)
+			statusBar()->showMessage("Autosave to " + m_autosavePath + " failed", 10000);
+	}
+
+	if (m_discardAutosave)
+	{
+		QDir(m_autosavePath).removeRecursively();
+		m_discardAutosave = false;
+	}
+
+	m_autosaveProject.reset();
+	m_autosaveSnapshot.reset();
+}
+
+
+void MainWindow::OnUndoMemoryUsage()
+{
+	// History is kept by asset id, names are looked up now so that renamed assets are reported once. Actions on
+	// deleted assets and actions not attributed to an asset are reported together.
+	QString text;
+	size_t deleted = 0, other = 0;
+	for (auto& i : m_undoHistory.GetMemoryUsageByAsset())
+	{
+		if (i.first.size() == 0)
+		{
+			other += i.second;
+			continue;
+		}
+		QString name = m_project->GetAssetDescription(i.first);
+		if (name.size() == 0)
+		{
+			deleted += i.second;
+			continue;
+		}
+		text += name + ": " + QString::number((i.second + 1023) / 1024) + " KB\n";
+	}
+	if (deleted != 0)
+		text += "Deleted assets: " + QString::number((deleted + 1023) / 1024) + " KB\n";
+	if (other != 0)
+		text += "Other: " + QString::number((other + 1023) / 1024) + " KB\n";
+	text += "\nTotal: " + QString::number((m_undoHistory.GetMemoryUsage() + 1023) / 1024) + " KB of " +
+		QString::number(m_undoHistory.GetMemoryBudget() / (1024 * 1024)) + " MB";
+	QMessageBox::information(this, "Undo History Memory Usage", text);
 }
 
 
@@ -883,7 +1254,7 @@ void MainWindow::OnImportNES()
 		shared_ptr<TileSet> tileSet = dialog.GetResult();
 		UpdateTileSetContents(tileSet);
 		OpenTileSet(tileSet);
-		AddUndoAction(
+		AddUndoAction(tileSet->GetId(), tileSet->GetMemoryUsage(),
 			[=]() { // Undo
 				UpdateTileSetContents(tileSet);
 				CloseTileSet(tileSet);
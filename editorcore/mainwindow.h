@@ -5,20 +5,21 @@
 #include <QKeyEvent>
 #include <QTabWidget>
 #include <QProcess>
+#include <QThreadPool>
 #include <functional>
-#include <stack>
+#include <deque>
+#include <map>
+#include <set>
 #include "project.h"
 #include "projectview.h"
+#include "undohistory.h"
 
-class UndoAction
-{
-	std::function<void()> m_undo, m_redo;
+// Default time in seconds between autosaves of a modified project
+#define DEFAULT_AUTOSAVE_INTERVAL 60
 
-public:
-	UndoAction(const std::function<void()>& undoAction, const std::function<void()>& redoAction);
-	void Undo();
-	void Redo();
-};
+// Directory inside the project that autosaves are written to, and the file in it naming the project
+#define AUTOSAVE_DIRECTORY ".autosave"
+#define AUTOSAVE_SOURCE_FILE "source"
 
 class PaletteView;
 class TileSetView;
@@ -35,9 +36,11 @@ class MainWindow: public QMainWindow
 	QAction* m_openAction;
 	QAction* m_saveAction;
 	QAction* m_saveAsAction;
+	QAction* m_packedMapsAction;
 
 	QAction* m_undoAction;
 	QAction* m_redoAction;
+	QAction* m_undoMemoryAction;
 	QAction* m_cutAction;
 	QAction* m_copyAction;
 	QAction* m_pasteAction;
@@ -56,7 +59,14 @@ class MainWindow: public QMainWindow
 	QString m_projectPath;
 	bool m_modified;
 
-	std::stack<std::shared_ptr<UndoAction>> m_undoStack, m_redoStack;
+	UndoHistory m_undoHistory;
+
+	// Autosaves are written from a snapshot of the project on a worker thread, one at a time
+	QTimer* m_autosaveTimer;
+	QThreadPool m_autosavePool;
+	std::shared_ptr<Project> m_autosaveProject, m_autosaveSnapshot;
+	QString m_autosavePath;
+	bool m_discardAutosave;
 
 	std::map<std::shared_ptr<Palette>, PaletteView*> m_openPalettes;
 	std::map<std::shared_ptr<TileSet>, TileSetView*> m_openTileSets;
@@ -65,6 +75,13 @@ class MainWindow: public QMainWindow
 	std::map<std::shared_ptr<Sprite>, SpriteView*> m_openSprites;
 	std::map<std::shared_ptr<ActorType>, ActorTypeView*> m_openActorTypes;
 
+	// Changes are collected during an event loop turn and then propagated once, only to the views
+	// that depend on the changed assets
+	QTimer* m_changeTimer;
+	std::set<std::shared_ptr<Palette>> m_changedPalettes;
+	std::set<std::shared_ptr<TileSet>> m_changedTileSets;
+	std::set<std::shared_ptr<Sprite>> m_changedSprites;
+
 	QString m_basePath;
 	QProcess* m_buildProcess = nullptr;
 	QProcess* m_runProcess = nullptr;
@@ -75,6 +92,12 @@ class MainWindow: public QMainWindow
 	bool PromptToSaveIfRequired();
 	bool SaveProject(const QString& path);
 	bool AttemptSave();
+	static QString GetAutosavePath(const QString& path);
+	static bool WriteAutosaveSource(const QString& autosavePath, const QString& projectPath);
+	static bool IsAutosaveOfProject(const QString& autosavePath, const QString& projectPath);
+	void WaitForAutosave();
+	void DiscardAutosave();
+	void QueueChangeNotification();
 
 public:
 	MainWindow(const QString& title, const QString& basePath, const QString& assetPath, QWidget* parent = nullptr);
@@ -89,6 +112,7 @@ public:
 	void CloseTileSet(std::shared_ptr<TileSet> tileSet);
 	void UpdateTileSetName(std::shared_ptr<TileSet> tileSet);
 	void UpdateTileSetContents(std::shared_ptr<TileSet> tileSet);
+	void UpdateTileSetTiles(std::shared_ptr<TileSet> tileSet, const std::set<size_t>& tiles, uint16_t frame);
 	TileSetView* GetTileSetView(std::shared_ptr<TileSet> tileSet);
 
 	void OpenEffectLayer(std::shared_ptr<MapLayer> layer);
@@ -116,6 +140,13 @@ public:
 	ActorTypeView* GetActorTypeView(std::shared_ptr<ActorType> actorType);
 
 	void AddUndoAction(const std::function<void()>& undoAction, const std::function<void()>& redoAction);
+	void AddUndoAction(const std::string& asset, size_t memoryUsage,
+		const std::function<void()>& undoAction, const std::function<void()>& redoAction);
+	void ClearUndoHistory();
+
+	size_t GetUndoMemoryBudget() const { return m_undoHistory.GetMemoryBudget(); }
+	void SetUndoMemoryBudget(size_t bytes);
+	size_t GetUndoMemoryUsage() const { return m_undoHistory.GetMemoryUsage(); }
 
 protected:
 	virtual void closeEvent(QCloseEvent* event) override;
@@ -124,8 +155,13 @@ protected slots:
 	void OnNew();
 	void OnOpen();
 	void OnSave();
+	void OnPackedMaps(bool packed);
+	void OnAutosaveTimer();
+	void OnAutosaveFinished(bool result);
+	void OnChangeTimer();
 	void OnUndo();
 	void OnRedo();
+	void OnUndoMemoryUsage();
 	void OnCut();
 	void OnCopy();
 	void OnPaste();
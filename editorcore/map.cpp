@@ -46,6 +46,34 @@ Map::Map(const Map& other)
 }
 
 
+shared_ptr<Map> Map::CreateSnapshot(const map<shared_ptr<ActorType>, shared_ptr<ActorType>>& actorTypes) const
+{
+	shared_ptr<Map> result = make_shared<Map>();
+	result->m_id = m_id;
+	result->m_name = m_name;
+	result->m_backgroundColor = m_backgroundColor;
+	for (auto& i : m_layers)
+	{
+		shared_ptr<MapLayer> layer = i->IsEffectLayer() ? i : i->CreateSnapshot();
+		result->m_layers.push_back(layer);
+		if (i == m_mainLayer)
+			result->m_mainLayer = layer;
+	}
+	if (!result->m_mainLayer)
+		result->m_mainLayer = m_mainLayer->CreateSnapshot();
+
+	for (auto& i : m_actors)
+	{
+		auto type = actorTypes.find(i->GetType());
+		if (type != actorTypes.end())
+			result->m_actors.push_back(i->CreateSnapshot(type->second));
+		else
+			result->m_actors.push_back(i->CreateSnapshot(i->GetType()));
+	}
+	return result;
+}
+
+
 void Map::SetMainLayerSize(size_t width, size_t height)
 {
 	m_mainLayer->SetSize(width, height);
@@ -68,17 +96,25 @@ void Map::SetMainLayerSize(size_t width, size_t height)
 
 void Map::InsertLayer(size_t i, shared_ptr<MapLayer> layer)
 {
+	// Effect layers can be added to a map more than once
+	bool inserted = !UsesEffectLayer(layer);
 	if (i < m_layers.size())
 		m_layers.insert(m_layers.begin() + i, layer);
 	else
 		m_layers.push_back(layer);
+	if (inserted && m_layerCallback)
+		m_layerCallback(layer, true);
 }
 
 
 void Map::DeleteLayer(size_t i)
 {
-	if (i < m_layers.size())
-		m_layers.erase(m_layers.begin() + i);
+	if (i >= m_layers.size())
+		return;
+	shared_ptr<MapLayer> layer = m_layers[i];
+	m_layers.erase(m_layers.begin() + i);
+	if (!UsesEffectLayer(layer) && m_layerCallback)
+		m_layerCallback(layer, false);
 }
 
 
@@ -144,7 +180,41 @@ bool Map::UsesEffectLayer(shared_ptr<MapLayer> layer)
 }
 
 
-Json::Value Map::Serialize()
+set<string> Map::GetDependencies() const
+{
+	set<string> result;
+	for (auto& i : m_layers)
+	{
+		if (i->IsEffectLayer())
+		{
+			result.insert(i->GetId());
+			continue;
+		}
+		for (auto& j : i->GetReferencedTileSets())
+			result.insert(j->GetId());
+	}
+	for (auto& i : m_actors)
+	{
+		if (i->GetType())
+			result.insert(i->GetType()->GetId());
+	}
+	return result;
+}
+
+
+size_t Map::GetMemoryUsage() const
+{
+	size_t result = sizeof(Map) + (m_actors.size() * sizeof(Actor));
+	for (auto& i : m_layers)
+	{
+		if (!i->IsEffectLayer())
+			result += i->GetMemoryUsage();
+	}
+	return result;
+}
+
+
+Json::Value Map::Serialize(uint32_t tileFormat)
 {
 	Json::Value map(Json::objectValue);
 	map["name"] = m_name;
@@ -165,7 +235,7 @@ Json::Value Map::Serialize()
 		else
 		{
 			Json::Value layer(Json::objectValue);
-			layer["normal"] = j->Serialize();
+			layer["normal"] = j->Serialize(tileFormat);
 			layers.append(layer);
 		}
 		if (j == m_mainLayer)
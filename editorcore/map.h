@@ -2,28 +2,42 @@
 
 #include <string>
 #include <vector>
+#include <set>
+#include <map>
 #include <memory>
+#include <functional>
 #include "tileset.h"
 #include "maplayer.h"
 #include "json/json.h"
 
 class Project;
 class Actor;
+class ActorType;
 
 class Map
 {
+public:
+	typedef std::function<void(const std::shared_ptr<MapLayer>& layer, bool inserted)> LayerCallback;
+
+private:
 	std::string m_name;
 	std::vector<std::shared_ptr<MapLayer>> m_layers;
 	std::shared_ptr<MapLayer> m_mainLayer;
 	uint16_t m_backgroundColor;
 	std::vector<std::shared_ptr<Actor>> m_actors;
 	std::string m_id;
+	LayerCallback m_layerCallback;
 
 public:
 	Map();
 	Map(size_t width, size_t height, size_t tileWidth, size_t tileHeight, size_t tileDepth);
 	Map(const Map& other);
 
+	// Copy with the same id for saving in the background. Layers share their tile grid with the original,
+	// effect layers are not copied as only their id is saved. Actors refer to the given actor type snapshots.
+	std::shared_ptr<Map> CreateSnapshot(
+		const std::map<std::shared_ptr<ActorType>, std::shared_ptr<ActorType>>& actorTypes) const;
+
 	const std::string& GetName() const { return m_name; }
 	void SetName(const std::string& name) { m_name = name; }
 
@@ -36,6 +50,8 @@ public:
 	void InsertLayer(size_t i, std::shared_ptr<MapLayer> layer);
 	void DeleteLayer(size_t i);
 	void SwapLayers(size_t i, size_t j);
+	// Called when a layer is added to the map or its last instance is removed, copies do not keep the callback
+	void SetLayerCallback(const LayerCallback& callback) { m_layerCallback = callback; }
 
 	uint16_t GetBackgroundColor() const { return m_backgroundColor; }
 	void SetBackgroundColor(uint16_t color) { m_backgroundColor = color; }
@@ -48,7 +64,12 @@ public:
 	bool UsesTileSet(std::shared_ptr<TileSet> tileSet);
 	bool UsesEffectLayer(std::shared_ptr<MapLayer> layer);
 
+	// Ids of the tile sets, effect layers and actor types that the map refers to
+	std::set<std::string> GetDependencies() const;
+	// Memory held by the map's own layers and actors, effect layers belong to the project
+	size_t GetMemoryUsage() const;
+
 	const std::string& GetId() const { return m_id; }
-	Json::Value Serialize();
+	Json::Value Serialize(uint32_t tileFormat);
 	static std::shared_ptr<Map> Deserialize(std::shared_ptr<Project> project, const Json::Value& data);
 };
@@ -5,6 +5,9 @@
 #include <QScrollBar>
 #include <QGuiApplication>
 #include <QClipboard>
+#include <QMimeData>
+#include <QSettings>
+#include <QThread>
 #include <set>
 #include <queue>
 #include <math.h>
@@ -14,6 +17,8 @@
 #include "theme.h"
 #include "mainwindow.h"
 #include "mapactorwidget.h"
+#include "undodelta.h"
+#include "maptilesmimedata.h"
 
 using namespace std;
 
@@ -45,6 +50,29 @@ MapEditorWidget::MapEditorWidget(QWidget* parent, MainWindow* mainWindow, shared
 
 
 void MapEditorWidget::UpdateView()
+{
+	RefreshView();
+
+	// Tile set and palette contents are not tracked by the renderer, so recompose everything
+	m_renderer->Invalidate();
+}
+
+
+void MapEditorWidget::UpdateTileSetContents(shared_ptr<TileSet> tileSet)
+{
+	RefreshView();
+	m_renderer->InvalidateTileSet(tileSet);
+}
+
+
+void MapEditorWidget::UpdatePaletteContents(shared_ptr<Palette> palette)
+{
+	RefreshView();
+	m_renderer->InvalidatePalette(palette);
+}
+
+
+void MapEditorWidget::RefreshView()
 {
 	if (m_tool == ActorTool)
 	{
@@ -82,10 +110,19 @@ void MapEditorWidget::UpdateView()
 		m_image = new QImage(m_renderWidth, m_renderHeight, QImage::Format_RGB555);
 	}
 
-	m_renderer = make_shared<Renderer>(m_map, (uint16_t)m_renderWidth, (uint16_t)m_renderHeight);
+	if ((!m_renderer) || (m_renderer->GetWidth() != m_renderWidth) || (m_renderer->GetHeight() != m_renderHeight))
+	{
+		m_renderer = make_shared<Renderer>(m_map, (uint16_t)m_renderWidth, (uint16_t)m_renderHeight);
+		QSettings settings;
+		// Layer caching is off unless the "layerCache" setting is true, it trades memory for faster redraws
+		m_renderer->SetLayerCacheEnabled(settings.value("layerCache", false).toBool());
+		// Large updates are split into horizontal bands rendered on all cores, "renderBands" overrides the count
+		int bands = settings.value("renderBands", QThread::idealThreadCount()).toInt();
+		m_renderer->SetBandCount((bands > 1) ? (size_t)bands : 1);
+		m_renderer->SetAnimating(m_animate);
+	}
 	m_renderer->SetActiveLayer(m_layer);
-	if (m_floatingLayer)
-		m_renderer->SetFloatingLayer(m_floatingLayer);
+	m_renderer->SetFloatingLayer(m_floatingLayer);
 	if (m_effectLayerEditor)
 	{
 		m_renderer->SetBackgroundColor(Palette::FromRGB(6, 6, 6));
@@ -183,7 +220,10 @@ void MapEditorWidget::SetAnimationEnabled(bool enabled)
 		return;
 	m_animate = enabled;
 	if (m_renderer)
+	{
 		m_renderer->ResetAnimation();
+		m_renderer->SetAnimating(m_animate);
+	}
 	if (m_animate)
 		m_animTimer->start();
 	else
@@ -219,6 +259,7 @@ void MapEditorWidget::paintEvent(QPaintEvent*)
 	int scrollX = horizontalScrollBar()->value();
 	int scrollY = verticalScrollBar()->value();
 	m_renderer->SetScroll((int16_t)scrollX, (int16_t)scrollY);
+	m_renderer->SetFloatingLayer(m_floatingLayer);
 
 	if (m_animate)
 		m_renderer->TickAnimation();
@@ -234,8 +275,7 @@ void MapEditorWidget::paintEvent(QPaintEvent*)
 				uint16_t* dest = (uint16_t*)m_image->scanLine(y);
 				const uint16_t* allLayersSrc = m_renderer->GetPixelDataForRow(y);
 				const uint16_t* curLayerSrc = m_renderer->GetSingleLayerPixelDataForRow(y);
-				for (int x = 0; x < m_renderWidth; x++)
-					dest[x] = Palette::BlendColor(allLayersSrc[x], curLayerSrc[x], 5);
+				Palette::BlendColors(dest, allLayersSrc, curLayerSrc, 5, m_renderWidth);
 			}
 		}
 		else
@@ -372,7 +412,7 @@ void MapEditorWidget::SetTileForMouseEvent(QMouseEvent* event)
 	if (SetTile(tileX, tileY, m_mouseDownTileSet, m_mouseDownTileIndex))
 	{
 		m_layer->UpdateRegionForSmartTiles(tileX, tileY, 1, 1);
-		UpdateView();
+		RefreshView();
 	}
 }
 
@@ -390,6 +430,7 @@ void MapEditorWidget::ApplyLayer(shared_ptr<MapFloatingLayer> layer)
 	if (!layer)
 		return;
 
+	vector<pair<size_t, size_t>> changedTiles;
 	for (int y = 0; y < layer->GetHeight(); y++)
 	{
 		int absY = layer->GetY() + y;
@@ -406,12 +447,13 @@ void MapEditorWidget::ApplyLayer(shared_ptr<MapFloatingLayer> layer)
 			if (!tile.valid)
 				continue;
 
-			SetTile(absX, absY, tile.tileSet, tile.index);
+			if (SetTile(absX, absY, tile.tileSet, tile.index))
+				changedTiles.push_back(pair<size_t, size_t>(absX, absY));
 		}
 	}
 
-	m_layer->UpdateRegionForSmartTiles(layer->GetX(), layer->GetY(), layer->GetWidth(), layer->GetHeight());
-	UpdateView();
+	m_layer->UpdateSmartTilesAround(changedTiles);
+	RefreshView();
 }
 
 
@@ -495,7 +537,7 @@ void MapEditorWidget::BeginMoveSelectionLayer()
 {
 	ApplyLayer(m_underSelection);
 	m_floatingLayer = make_shared<MapFloatingLayer>(*m_selectionContents);
-	UpdateView();
+	RefreshView();
 }
 
 
@@ -515,7 +557,7 @@ void MapEditorWidget::MoveSelectionLayer(QMouseEvent* event)
 		return;
 
 	m_floatingLayer->Move(m_floatingLayer->GetX() + deltaX, m_floatingLayer->GetY() + deltaY);
-	UpdateView();
+	RefreshView();
 }
 
 
@@ -564,7 +606,7 @@ void MapEditorWidget::UpdateRectangleLayer(QMouseEvent* event)
 		m_floatingLayer->SetTile(x, height - 1, m_mouseDownTileSet, m_mouseDownTileIndex);
 	}
 
-	UpdateView();
+	RefreshView();
 }
 
 
@@ -586,7 +628,7 @@ void MapEditorWidget::UpdateFilledRectangleLayer(QMouseEvent* event)
 		for (int x = 0; x < width; x++)
 			m_floatingLayer->SetTile(x, y, m_mouseDownTileSet, m_mouseDownTileIndex);
 
-	UpdateView();
+	RefreshView();
 }
 
 
@@ -709,7 +751,7 @@ void MapEditorWidget::UpdateLineLayer(QMouseEvent* event)
 	}
 
 	m_floatingLayer->SetTile(curX - leftX, curY - topY, m_mouseDownTileSet, m_mouseDownTileIndex);
-	UpdateView();
+	RefreshView();
 }
 
 
@@ -728,6 +770,7 @@ void MapEditorWidget::Fill(QMouseEvent* event)
 	if ((target.tileSet == replacement.tileSet) && (target.index == replacement.index))
 		return;
 
+	vector<pair<size_t, size_t>> filledTiles;
 	queue<pair<int, int>> workQueue;
 	workQueue.push(pair<int, int>(curX, curY));
 	while (!workQueue.empty())
@@ -758,7 +801,8 @@ void MapEditorWidget::Fill(QMouseEvent* event)
 
 		for (int fill = start; fill <= end; fill++)
 		{
-			SetTile(fill, y, m_mouseDownTileSet, m_mouseDownTileIndex);
+			if (SetTile(fill, y, m_mouseDownTileSet, m_mouseDownTileIndex))
+				filledTiles.push_back(pair<size_t, size_t>(fill, y));
 
 			MapFloatingLayerTile up = GetTile(fill, y - 1);
 			if (up.valid && (up.tileSet == target.tileSet) && (up.index == target.index))
@@ -770,8 +814,8 @@ void MapEditorWidget::Fill(QMouseEvent* event)
 		}
 	}
 
-	m_layer->UpdateRegionForSmartTiles(0, 0, m_layer->GetWidth(), m_layer->GetHeight());
-	UpdateView();
+	m_layer->UpdateSmartTilesAround(filledTiles);
+	RefreshView();
 }
 
 
@@ -812,7 +856,7 @@ void MapEditorWidget::mousePressEvent(QMouseEvent* event)
 			m_underSelection.reset();
 			m_moveSelection = false;
 			m_waitForSelection = 6;
-			UpdateView();
+			RefreshView();
 		}
 		break;
 
@@ -857,7 +901,7 @@ void MapEditorWidget::mousePressEvent(QMouseEvent* event)
 		m_moveSelection = false;
 		m_waitForSelection = 0;
 		UpdateSelectionLayer(event);
-		UpdateView();
+		RefreshView();
 		break;
 
 	default:
@@ -883,21 +927,44 @@ void MapEditorWidget::CommitPendingActions()
 			selectActions.erase(selectActions.begin() + 1, selectActions.end());
 		}
 
+		// Store the tile changes as compact per layer deltas for the undo history
+		std::map<shared_ptr<MapLayer>, shared_ptr<MapLayerDelta>> layerDeltas;
+		for (auto& i : editActions)
+		{
+			shared_ptr<MapLayerDelta>& delta = layerDeltas[i.layer];
+			if (!delta)
+				delta = make_shared<MapLayerDelta>(i.layer);
+			delta->AddChange(i.x, i.y, TileReference(i.oldTileSet, (uint16_t)i.oldTileIndex),
+				TileReference(i.newTileSet, (uint16_t)i.newTileIndex));
+		}
+
+		vector<shared_ptr<MapLayerDelta>> deltas;
+		size_t memoryUsage = 0;
+		for (auto& i : layerDeltas)
+		{
+			i.second->Finish();
+			if (i.second->IsEmpty())
+				continue;
+			memoryUsage += i.second->GetMemoryUsage();
+			deltas.push_back(i.second);
+		}
+		for (auto& i : selectActions)
+		{
+			for (auto& j : {i.oldSelectionContents, i.oldUnderSelection, i.newSelectionContents, i.newUnderSelection})
+			{
+				if (j)
+					memoryUsage += j->GetWidth() * j->GetHeight() * sizeof(MapFloatingLayerTile);
+			}
+		}
+
 		shared_ptr<MapLayer> layer = m_layer;
 		shared_ptr<Map> map = m_map;
 		MainWindow* mainWindow = m_mainWindow;
 		bool effectLayerEditor = m_effectLayerEditor;
-		m_mainWindow->AddUndoAction(
+		m_mainWindow->AddUndoAction(effectLayerEditor ? layer->GetId() : map->GetId(), memoryUsage,
 			[=]() { // Undo
-				for (size_t i = 0; i < editActions.size(); i++)
-				{
-					EditAction action = editActions[editActions.size() - (i + 1)];
-					TileReference ref;
-					ref.tileSet = action.oldTileSet;
-					ref.index = action.oldTileIndex;
-					action.layer->SetTileAt(action.x, action.y, ref);
-					action.layer->UpdateRegionForSmartTiles(action.x, action.y, 1, 1);
-				}
+				for (auto& i : deltas)
+					i->Undo();
 				for (auto& i : selectActions)
 				{
 					MapEditorWidget* editor;
@@ -942,15 +1009,8 @@ void MapEditorWidget::CommitPendingActions()
 					mainWindow->UpdateMapContents(map);
 			},
 			[=]() { // Redo
-				for (size_t i = 0; i < editActions.size(); i++)
-				{
-					EditAction action = editActions[i];
-					TileReference ref;
-					ref.tileSet = action.newTileSet;
-					ref.index = action.newTileIndex;
-					action.layer->SetTileAt(action.x, action.y, ref);
-					action.layer->UpdateRegionForSmartTiles(action.x, action.y, 1, 1);
-				}
+				for (auto& i : deltas)
+					i->Redo();
 				for (auto& i : selectActions)
 				{
 					MapEditorWidget* editor;
@@ -1023,7 +1083,7 @@ void MapEditorWidget::mouseReleaseEvent(QMouseEvent* event)
 		else
 		{
 			UpdateSelectionLayer(event);
-			UpdateView();
+			RefreshView();
 		}
 		break;
 
@@ -1053,7 +1113,7 @@ void MapEditorWidget::mouseReleaseEvent(QMouseEvent* event)
 
 	case ActorTool:
 		UpdateSelectionLayer(event);
-		UpdateView();
+		RefreshView();
 		break;
 
 	default:
@@ -1207,171 +1267,76 @@ bool MapEditorWidget::Copy()
 	if (!m_selectionContents)
 		return false;
 
-	Json::Value data(Json::objectValue);
-
-	Json::Value tiles(Json::objectValue);
-	tiles["width"] = m_selectionContents->GetWidth();
-	tiles["height"] = m_selectionContents->GetHeight();
-
-	map<shared_ptr<TileSet>, int> tileSetIndex;
-	Json::Value tileSets(Json::arrayValue);
-	int curTileSetIndex = 1;
-	for (int y = 0; y < m_selectionContents->GetHeight(); y++)
-	{
-		for (int x = 0; x < m_selectionContents->GetWidth(); x++)
-		{
-			MapFloatingLayerTile tile = m_selectionContents->GetTile(x, y);
-			if (!tile.valid)
-				continue;
-			auto i = tileSetIndex.find(tile.tileSet);
-			if (i == tileSetIndex.end())
-			{
-				tileSetIndex[tile.tileSet] = curTileSetIndex++;
-				if (tile.tileSet)
-					tileSets.append(tile.tileSet->GetId());
-				else
-					tileSets.append("");
-			}
-		}
-	}
-	tiles["tile_sets"] = tileSets;
-
-	string tileIndexData, tileSetData;
-	for (int y = 0; y < m_selectionContents->GetHeight(); y++)
-	{
-		for (int x = 0; x < m_selectionContents->GetWidth(); x++)
-		{
-			MapFloatingLayerTile tile = m_selectionContents->GetTile(x, y);
-			if (!tile.valid)
-			{
-				tileIndexData += "0000";
-				tileSetData += "00";
-				continue;
-			}
-
-			char dataStr[32];
-			sprintf(dataStr, "%.4x", (uint8_t)tile.index);
-			tileIndexData += dataStr;
-			sprintf(dataStr, "%.2x", (uint8_t)tileSetIndex[tile.tileSet]);
-			tileSetData += dataStr;
-		}
-	}
-	tiles["tile_index_data"] = tileIndexData;
-	tiles["tile_set_data"] = tileSetData;
-
-	data["tiles"] = tiles;
-
-	Json::Value image(Json::objectValue);
-	image["width"] = (uint32_t)(m_selectionContents->GetWidth() * m_layer->GetTileWidth());
-	image["height"] = (uint32_t)(m_selectionContents->GetHeight() * m_layer->GetTileHeight());
-
-	map<shared_ptr<Palette>, int> paletteIndex;
-	Json::Value palettes(Json::arrayValue);
-	int curPaletteIndex = 1;
-	for (int y = 0; y < m_selectionContents->GetHeight(); y++)
-	{
-		for (int x = 0; x < m_selectionContents->GetWidth(); x++)
-		{
-			MapFloatingLayerTile tile = m_selectionContents->GetTile(x, y);
-			if (!tile.valid)
-				continue;
-			if (!tile.tileSet)
-				continue;
-
-			shared_ptr<Tile> tileObj = tile.tileSet->GetTile(tile.index);
-			if (!tileObj)
-				continue;
-
-			auto i = paletteIndex.find(tileObj->GetPalette());
-			if (i == paletteIndex.end())
-			{
-				paletteIndex[tileObj->GetPalette()] = curPaletteIndex++;
-				if (tileObj->GetPalette())
-					palettes.append(tileObj->GetPalette()->GetId());
-				else
-					palettes.append("");
-			}
-		}
-	}
-	image["palettes"] = palettes;
+	QClipboard* clipboard = QGuiApplication::clipboard();
+	clipboard->setMimeData(new MapTilesMimeData(make_shared<MapFloatingLayer>(*m_selectionContents)));
+	return true;
+}
 
-	string imageData, imagePalette;
-	for (int y = 0; y < (int)(m_selectionContents->GetHeight() * m_layer->GetTileWidth()); y++)
-	{
-		for (int x = 0; x < (int)(m_selectionContents->GetWidth() * m_layer->GetTileHeight()); x++)
-		{
-			MapFloatingLayerTile tile = m_selectionContents->GetTile(x / m_layer->GetTileWidth(),
-				y / m_layer->GetTileHeight());
-			if ((!tile.valid) || (!tile.tileSet))
-			{
-				imageData += "00";
-				imagePalette += "00";
-				continue;
-			}
 
-			shared_ptr<Tile> tileObj = tile.tileSet->GetTile(tile.index);
-			if ((!tileObj) || (tileObj->GetWidth() != m_layer->GetTileWidth()) ||
-				(tileObj->GetHeight() != m_layer->GetTileHeight()))
-			{
-				imageData += "00";
-				imagePalette += "00";
-				continue;
-			}
+bool MapEditorWidget::Paste()
+{
+	if (m_tool == ActorTool)
+		return false;
 
-			int pixelX = x % m_layer->GetTileWidth();
-			int pixelY = y % m_layer->GetTileHeight();
-			uint8_t colorIndex;
-			if (tileObj->GetDepth() == 4)
-			{
-				size_t offset = (pixelY * tileObj->GetPitch()) + (pixelX / 2);
-				colorIndex = (tileObj->GetData()[offset] >> ((x & 1) << 2)) & 0xf;
-			}
-			else
-			{
-				size_t offset = (pixelY * tileObj->GetPitch()) + pixelX;
-				colorIndex = tileObj->GetData()[offset];
-			}
+	// Selections copied by older versions only have the JSON text
+	QClipboard* clipboard = QGuiApplication::clipboard();
+	const QMimeData* mimeData = clipboard->mimeData();
+	if (!mimeData)
+		return false;
+	shared_ptr<MapFloatingLayer> selectionContents;
+	if (mimeData->hasFormat(MAP_TILES_MIME_TYPE))
+		selectionContents = MapTilesMimeData::Decode(mimeData->data(MAP_TILES_MIME_TYPE), m_project, m_layer);
+	else
+		selectionContents = ParseClipboardText(mimeData->text());
+	if (!selectionContents)
+		return false;
 
-			if ((colorIndex == 0) || (!tileObj->GetPalette()))
-			{
-				imageData += "00";
-				imagePalette += "00";
-				continue;
-			}
+	int width = selectionContents->GetWidth();
+	int height = selectionContents->GetHeight();
+
+	int centerX = (viewport()->rect().center().x() + (horizontalScrollBar()->value() * m_zoom)) /
+		(m_zoom * m_layer->GetTileWidth());
+	int centerY = (viewport()->rect().center().y() + (verticalScrollBar()->value() * m_zoom)) /
+		(m_zoom * m_layer->GetTileHeight());
+
+	int posX = centerX - (width / 2);
+	int posY = centerY - (height / 2);
+	if ((posX + width) > (int)m_layer->GetWidth())
+		posX = (int)m_layer->GetWidth() - width;
+	if ((posY + height) > (int)m_layer->GetHeight())
+		posY = (int)m_layer->GetHeight() - height;
+	if (posX < 0)
+		posX = 0;
+	if (posY < 0)
+		posY = 0;
+	selectionContents->Move(posX, posY);
 
-			char dataStr[32];
-			sprintf(dataStr, "%.2x", (uint8_t)(colorIndex + tileObj->GetPaletteOffset()));
-			imageData += dataStr;
-			sprintf(dataStr, "%.2x", (uint8_t)paletteIndex[tileObj->GetPalette()]);
-			imagePalette += dataStr;
-		}
-	}
-	image["pixel_data"] = imageData;
-	image["palette_data"] = imagePalette;
+	SelectAction action;
+	action.oldSelectionContents = m_selectionContents;
+	action.oldUnderSelection = m_underSelection;
 
-	data["image"] = image;
+	m_selectionContents = selectionContents;
+	m_underSelection = make_shared<MapFloatingLayer>(m_layer, posX, posY, width, height);
 
-	Json::StyledWriter writer;
-	string contents = writer.write(data);
+	action.newSelectionContents = selectionContents;
+	action.newUnderSelection = m_underSelection;
+	m_pendingSelections.push_back(action);
 
-	QClipboard* clipboard = QGuiApplication::clipboard();
-	clipboard->setText(QString::fromStdString(contents));
+	m_tool = SelectTool;
+	m_showHover = false;
+	CaptureLayer(m_underSelection);
+	ApplyLayer(m_selectionContents);
+	CommitPendingActions();
 	return true;
 }
 
 
-bool MapEditorWidget::Paste()
+shared_ptr<MapFloatingLayer> MapEditorWidget::ParseClipboardText(const QString& text)
 {
-	if (m_tool == ActorTool)
-		return false;
-
-	QClipboard* clipboard = QGuiApplication::clipboard();
-	QString text = clipboard->text();
-
 	Json::Reader reader;
 	Json::Value jsonData;
 	if (!reader.parse(text.toStdString(), jsonData, false))
-		return false;
+		return shared_ptr<MapFloatingLayer>();
 
 	try
 	{
@@ -1390,40 +1355,23 @@ bool MapEditorWidget::Paste()
 				tileSets.push_back(m_project->GetTileSetById(id));
 		}
 
+		if ((width <= 0) || (height <= 0) || (width >= 0x8000) || (height >= 0x8000))
+			return shared_ptr<MapFloatingLayer>();
 		string tileIndexData = tiles["tile_index_data"].asString();
 		string tileSetData = tiles["tile_set_data"].asString();
 		if (tileIndexData.size() != (size_t)(width * height * 4))
-			return false;
+			return shared_ptr<MapFloatingLayer>();
 		if (tileSetData.size() != (size_t)(width * height * 2))
-			return false;
-		if ((width <= 0) || (height <= 0) || (width >= 0x8000) || (height >= 0x8000))
-			return false;
+			return shared_ptr<MapFloatingLayer>();
 
-		int centerX = (viewport()->rect().center().x() + (horizontalScrollBar()->value() * m_zoom)) /
-			(m_zoom * m_layer->GetTileWidth());
-		int centerY = (viewport()->rect().center().y() + (verticalScrollBar()->value() * m_zoom)) /
-			(m_zoom * m_layer->GetTileHeight());
-
-		int posX = centerX - (width / 2);
-		int posY = centerY - (height / 2);
-		if ((posX + width) > (int)m_layer->GetWidth())
-			posX = (int)m_layer->GetWidth() - width;
-		if ((posY + height) > (int)m_layer->GetHeight())
-			posY = (int)m_layer->GetHeight() - height;
-		if (posX < 0)
-			posX = 0;
-		if (posY < 0)
-			posY = 0;
-
-		shared_ptr<MapFloatingLayer> selectionContents = make_shared<MapFloatingLayer>(m_layer,
-			posX, posY, width, height);
+		shared_ptr<MapFloatingLayer> result = make_shared<MapFloatingLayer>(m_layer, 0, 0, width, height);
 		for (int y = 0; y < height; y++)
 		{
 			for (int x = 0; x < width; x++)
 			{
 				uint8_t tileSetIndex = (uint8_t)strtoul(
 					tileSetData.substr((y * width * 2) + (x * 2), 2).c_str(), nullptr, 16);
-				uint8_t tileIndex = (uint8_t)strtoul(
+				uint16_t tileIndex = (uint16_t)strtoul(
 					tileIndexData.substr((y * width * 4) + (x * 4), 4).c_str(), nullptr, 16);
 
 				if ((size_t)tileSetIndex >= tileSets.size())
@@ -1439,31 +1387,14 @@ bool MapEditorWidget::Paste()
 					tileIndex = 0;
 				}
 
-				selectionContents->SetTile(x, y, tileSet, tileIndex);
+				result->SetTile(x, y, tileSet, tileIndex);
 			}
 		}
-
-		SelectAction action;
-		action.oldSelectionContents = m_selectionContents;
-		action.oldUnderSelection = m_underSelection;
-
-		m_selectionContents = selectionContents;
-		m_underSelection = make_shared<MapFloatingLayer>(m_layer, posX, posY, width, height);
-
-		action.newSelectionContents = selectionContents;
-		action.newUnderSelection = m_underSelection;
-		m_pendingSelections.push_back(action);
-
-		m_tool = SelectTool;
-		m_showHover = false;
-		CaptureLayer(m_underSelection);
-		ApplyLayer(m_selectionContents);
-		CommitPendingActions();
-		return true;
+		return result;
 	}
 	catch (exception&)
 	{
-		return false;
+		return shared_ptr<MapFloatingLayer>();
 	}
 }
 
@@ -89,14 +89,18 @@ class MapEditorWidget: public QAbstractScrollArea
 	void UpdateCircleLayer(QMouseEvent* event);
 	void UpdateLineLayer(QMouseEvent* event);
 	void Fill(QMouseEvent* event);
+	std::shared_ptr<MapFloatingLayer> ParseClipboardText(const QString& text);
 
 	void CommitPendingActions();
+	void RefreshView();
 
 public:
 	MapEditorWidget(QWidget* parent, MainWindow* mainWindow, std::shared_ptr<Project> project,
 		std::shared_ptr<Map> map, bool effectLayer);
 
 	void UpdateView();
+	void UpdateTileSetContents(std::shared_ptr<TileSet> tileSet);
+	void UpdatePaletteContents(std::shared_ptr<Palette> palette);
 
 	std::shared_ptr<MapLayer> GetActiveLayer() const;
 	void SetActiveLayer(std::shared_ptr<MapLayer> layer);
@@ -12,20 +12,14 @@ MapFieldEditorWidget::MapFieldEditorWidget(const shared_ptr<Project>& project,
 	QVBoxLayout* layout = new QVBoxLayout();
 	layout->setContentsMargins(0, 0, 0, 0);
 
-	for (auto& i : project->GetMaps())
-		m_maps.push_back(i.second);
-	sort(m_maps.begin(), m_maps.end(), [&](const shared_ptr<Map>& a, const shared_ptr<Map>& b) {
-		return a->GetName() < b->GetName();
-	});
-	m_maps.insert(m_maps.begin(), shared_ptr<Map>());
-
+	// Maps are listed by id so that choosing a map does not require loading all of them
 	QStringList choices;
-	for (auto& i : m_maps)
+	m_mapIds.push_back("");
+	choices.append("<None>");
+	for (auto& i : project->GetMapIdsByName())
 	{
-		if (i)
-			choices.append(QString::fromStdString(i->GetName()));
-		else
-			choices.append("<None>");
+		m_mapIds.push_back(i.second);
+		choices.append(QString::fromStdString(i.first));
 	}
 
 	m_combo = new QComboBox();
@@ -35,10 +29,10 @@ MapFieldEditorWidget::MapFieldEditorWidget(const shared_ptr<Project>& project,
 	{
 		if (!value->GetValue().isNull())
 		{
-			shared_ptr<Map> map = project->GetMapById(value->GetValue().asString());
-			for (size_t i = 0; i < m_maps.size(); i++)
+			string id = value->GetValue().asString();
+			for (size_t i = 1; i < m_mapIds.size(); i++)
 			{
-				if (m_maps[i] == map)
+				if (m_mapIds[i] == id)
 					m_combo->setCurrentIndex(i);
 			}
 		}
@@ -57,13 +51,9 @@ MapFieldEditorWidget::MapFieldEditorWidget(const shared_ptr<Project>& project,
 
 void MapFieldEditorWidget::OnValueChanged(int value)
 {
-	if ((value < 0) || (value >= (int)m_maps.size()))
+	if ((value < 0) || (value >= (int)m_mapIds.size()))
 		return;
-	shared_ptr<Map> map = m_maps[value];
-	if (map)
-		m_value->SetValue(map->GetId());
-	else
-		m_value->SetValue("");
+	m_value->SetValue(m_mapIds[value]);
 }
 
 
@@ -8,7 +8,7 @@
 class MapFieldEditorWidget: public QWidget
 {
 	std::shared_ptr<ActorFieldValue> m_value;
-	std::vector<std::shared_ptr<Map>> m_maps;
+	std::vector<std::string> m_mapIds;
 	QComboBox* m_combo;
 
 public:
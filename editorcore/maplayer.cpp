@@ -1,29 +1,17 @@
 #include <QUuid>
+#include <QByteArray>
+#include <algorithm>
 #include <set>
 #include <map>
 #include <memory>
+#include <cstring>
 #include "maplayer.h"
 #include "project.h"
+#include "smarttile.h"
 
 using namespace std;
 
 
-bool MapLayer::SmartTileContext::Empty(int x, int y)
-{
-	if ((x < -2) || (x > 2) || (y < -2) || (y > 2))
-		return false;
-	return !tile[x + 2][y + 2];
-}
-
-
-bool MapLayer::SmartTileContext::Filled(int x, int y)
-{
-	if ((x < -2) || (x > 2) || (y < -2) || (y > 2))
-		return false;
-	return tile[x + 2][y + 2];
-}
-
-
 MapLayer::MapLayer(size_t width, size_t height, size_t tileWidth, size_t tileHeight, size_t tileDepth,
 	bool effectLayer)
 {
@@ -34,7 +22,12 @@ MapLayer::MapLayer(size_t width, size_t height, size_t tileWidth, size_t tileHei
 	m_tileWidth = tileWidth;
 	m_tileHeight = tileHeight;
 	m_tileDepth = tileDepth;
-	m_tiles.resize(m_width * m_height);
+	m_chunksWide = (m_width + MAP_LAYER_CHUNK_SIZE - 1) >> MAP_LAYER_CHUNK_SHIFT;
+	m_chunksHigh = (m_height + MAP_LAYER_CHUNK_SIZE - 1) >> MAP_LAYER_CHUNK_SHIFT;
+	m_chunks.resize(m_chunksWide * m_chunksHigh);
+	m_tileSets.emplace_back();
+	m_tileSetCellCounts.push_back(0);
+	m_changeCount = 0;
 
 	m_effectLayer = effectLayer;
 	m_blendMode = BlendMode_Normal;
@@ -53,7 +46,18 @@ MapLayer::MapLayer(const MapLayer& other)
 	m_tileWidth = other.m_tileWidth;
 	m_tileHeight = other.m_tileHeight;
 	m_tileDepth = other.m_tileDepth;
-	m_tiles = other.m_tiles;
+	m_chunksWide = other.m_chunksWide;
+	m_chunksHigh = other.m_chunksHigh;
+	for (auto& i : other.m_chunks)
+	{
+		if (i)
+			m_chunks.push_back(make_shared<Chunk>(*i));
+		else
+			m_chunks.emplace_back();
+	}
+	m_tileSets = other.m_tileSets;
+	m_tileSetCellCounts = other.m_tileSetCellCounts;
+	m_changeCount = 0;
 	m_effectLayer = other.m_effectLayer;
 	m_blendMode = other.m_blendMode;
 	m_alpha = other.m_alpha;
@@ -64,35 +68,227 @@ MapLayer::MapLayer(const MapLayer& other)
 }
 
 
+shared_ptr<MapLayer> MapLayer::CreateSnapshot() const
+{
+	// Chunks are shared with the snapshot, whichever layer modifies a chunk first makes its own copy
+	shared_ptr<MapLayer> result = make_shared<MapLayer>(0, 0, m_tileWidth, m_tileHeight, m_tileDepth, m_effectLayer);
+	*result = *this;
+	result->m_changedTiles.clear();
+	result->m_tileSetUsageCallback = nullptr;
+	return result;
+}
+
+
+MapLayer::Chunk* MapLayer::GetWritableChunk(shared_ptr<Chunk>& chunk)
+{
+	if (chunk.use_count() > 1)
+		chunk = make_shared<Chunk>(*chunk);
+	return chunk.get();
+}
+
+
 void MapLayer::SetSize(size_t width, size_t height)
 {
-	vector<TileReference> newTiles;
-	newTiles.resize(width * height);
+	size_t chunksWide = (width + MAP_LAYER_CHUNK_SIZE - 1) >> MAP_LAYER_CHUNK_SHIFT;
+	size_t chunksHigh = (height + MAP_LAYER_CHUNK_SIZE - 1) >> MAP_LAYER_CHUNK_SHIFT;
+	vector<shared_ptr<Chunk>> newChunks;
+	newChunks.resize(chunksWide * chunksHigh);
+
+	// Chunks keep their position, only the ones on the new edge need to have tiles cleared
+	for (size_t chunkY = 0; chunkY < m_chunksHigh; chunkY++)
+	{
+		for (size_t chunkX = 0; chunkX < m_chunksWide; chunkX++)
+		{
+			shared_ptr<Chunk>& chunk = m_chunks[(chunkY * m_chunksWide) + chunkX];
+			if (!chunk)
+				continue;
+
+			// Chunks that are entirely outside the new size are dropped without being modified
+			if ((chunkX >= chunksWide) || (chunkY >= chunksHigh))
+			{
+				for (auto& i : chunk->cells)
+				{
+					if (i.tileSet)
+						RemoveTileSetCell(i.tileSet);
+				}
+				continue;
+			}
 
-	size_t copyWidth = width;
-	size_t copyHeight = height;
-	if (m_width < copyWidth)
-		copyWidth = m_width;
-	if (m_height < copyHeight)
-		copyHeight = m_height;
+			size_t left = chunkX << MAP_LAYER_CHUNK_SHIFT;
+			size_t top = chunkY << MAP_LAYER_CHUNK_SHIFT;
+			if (((left + MAP_LAYER_CHUNK_SIZE) > width) || ((top + MAP_LAYER_CHUNK_SIZE) > height))
+				GetWritableChunk(chunk);
+			for (size_t y = 0; y < MAP_LAYER_CHUNK_SIZE; y++)
+			{
+				for (size_t x = 0; x < MAP_LAYER_CHUNK_SIZE; x++)
+				{
+					if (((left + x) < width) && ((top + y) < height))
+						continue;
+					MapLayerCell& cell = chunk->cells[(y << MAP_LAYER_CHUNK_SHIFT) + x];
+					if (cell.tileSet)
+					{
+						chunk->tileCount--;
+						RemoveTileSetCell(cell.tileSet);
+					}
+					cell.tileSet = 0;
+					cell.index = 0;
+				}
+			}
 
-	for (size_t y = 0; y < copyHeight; y++)
-		for (size_t x = 0; x < copyWidth; x++)
-			newTiles[(y * width) + x] = m_tiles[(y * m_width) + x];
+			if (chunk->tileCount != 0)
+				newChunks[(chunkY * chunksWide) + chunkX] = chunk;
+		}
+	}
 
-	m_tiles = newTiles;
+	m_chunks = newChunks;
+	m_chunksWide = chunksWide;
+	m_chunksHigh = chunksHigh;
 	m_width = width;
 	m_height = height;
+	CompactTileSets();
+
+	// Every tile may have moved, forget the change history so that views redraw everything
+	m_changeCount++;
+	m_changedTiles.clear();
+}
+
+
+MapLayerCell MapLayer::GetCell(size_t x, size_t y) const
+{
+	const shared_ptr<Chunk>& chunk = m_chunks[((y >> MAP_LAYER_CHUNK_SHIFT) * m_chunksWide) +
+		(x >> MAP_LAYER_CHUNK_SHIFT)];
+	if (!chunk)
+		return MapLayerCell{0, 0};
+	return chunk->cells[((y & (MAP_LAYER_CHUNK_SIZE - 1)) << MAP_LAYER_CHUNK_SHIFT) + (x & (MAP_LAYER_CHUNK_SIZE - 1))];
+}
+
+
+void MapLayer::SetCell(size_t x, size_t y, const MapLayerCell& cell)
+{
+	shared_ptr<Chunk>& chunk = m_chunks[((y >> MAP_LAYER_CHUNK_SHIFT) * m_chunksWide) +
+		(x >> MAP_LAYER_CHUNK_SHIFT)];
+	if (!chunk)
+	{
+		if (!cell.tileSet)
+			return;
+		chunk = make_shared<Chunk>();
+		memset(chunk->cells, 0, sizeof(chunk->cells));
+		chunk->tileCount = 0;
+	}
+	else
+	{
+		GetWritableChunk(chunk);
+	}
+
+	MapLayerCell& dest = chunk->cells[((y & (MAP_LAYER_CHUNK_SIZE - 1)) << MAP_LAYER_CHUNK_SHIFT) +
+		(x & (MAP_LAYER_CHUNK_SIZE - 1))];
+	if (dest.tileSet && !cell.tileSet)
+		chunk->tileCount--;
+	else if (!dest.tileSet && cell.tileSet)
+		chunk->tileCount++;
+	// Count the new tile first so that replacing a tile with one from the same set does not report a change
+	if (cell.tileSet)
+		AddTileSetCell(cell.tileSet);
+	if (dest.tileSet)
+		RemoveTileSetCell(dest.tileSet);
+	dest = cell;
+
+	// Chunks are freed as soon as they are empty so that cleared areas cost nothing
+	if (chunk->tileCount == 0)
+		chunk.reset();
 }
 
 
-TileReference MapLayer::GetTileAt(size_t x, size_t y)
+const MapLayerCell* MapLayer::GetTileChunk(size_t chunkX, size_t chunkY) const
+{
+	if ((chunkX >= m_chunksWide) || (chunkY >= m_chunksHigh))
+		return nullptr;
+	const shared_ptr<Chunk>& chunk = m_chunks[(chunkY * m_chunksWide) + chunkX];
+	if (!chunk)
+		return nullptr;
+	return chunk->cells;
+}
+
+
+uint16_t MapLayer::GetTileSetSlot(const shared_ptr<TileSet>& tileSet)
+{
+	if (!tileSet)
+		return 0;
+	for (size_t i = 1; i < m_tileSets.size(); i++)
+	{
+		if (m_tileSets[i] == tileSet)
+			return (uint16_t)i;
+	}
+
+	// Slots are never freed while editing, reclaim the ones that are no longer used if the table is full
+	if (m_tileSets.size() > 0xffff)
+		CompactTileSets();
+	m_tileSets.push_back(tileSet);
+	m_tileSetCellCounts.push_back(0);
+	return (uint16_t)(m_tileSets.size() - 1);
+}
+
+
+void MapLayer::AddTileSetCell(uint16_t slot)
+{
+	if ((m_tileSetCellCounts[slot]++ == 0) && m_tileSetUsageCallback)
+		m_tileSetUsageCallback(m_tileSets[slot], true);
+}
+
+
+void MapLayer::RemoveTileSetCell(uint16_t slot)
+{
+	if ((--m_tileSetCellCounts[slot] == 0) && m_tileSetUsageCallback)
+		m_tileSetUsageCallback(m_tileSets[slot], false);
+}
+
+
+void MapLayer::CompactTileSets()
+{
+	vector<uint16_t> newSlots;
+	newSlots.resize(m_tileSets.size(), 0);
+	vector<shared_ptr<TileSet>> newTileSets;
+	vector<size_t> newCounts;
+	newTileSets.emplace_back();
+	newCounts.push_back(0);
+	bool remapped = false;
+	for (size_t i = 1; i < m_tileSets.size(); i++)
+	{
+		if (m_tileSetCellCounts[i] == 0)
+			continue;
+		newSlots[i] = (uint16_t)newTileSets.size();
+		if (newSlots[i] != i)
+			remapped = true;
+		newTileSets.push_back(m_tileSets[i]);
+		newCounts.push_back(m_tileSetCellCounts[i]);
+	}
+
+	// Only touch the chunks if a slot in use moved, so chunks shared with a snapshot are not copied needlessly
+	if (remapped)
+	{
+		for (auto& chunk : m_chunks)
+		{
+			if (!chunk)
+				continue;
+			for (auto& i : GetWritableChunk(chunk)->cells)
+				i.tileSet = newSlots[i.tileSet];
+		}
+	}
+	m_tileSets = newTileSets;
+	m_tileSetCellCounts = newCounts;
+}
+
+
+TileReference MapLayer::GetTileAt(size_t x, size_t y) const
 {
 	if (x >= m_width)
 		return TileReference();
 	if (y >= m_height)
 		return TileReference();
-	return m_tiles[(y * m_width) + x];
+	MapLayerCell cell = GetCell(x, y);
+	if (!cell.tileSet)
+		return TileReference();
+	return TileReference(m_tileSets[cell.tileSet], cell.index);
 }
 
 
@@ -102,207 +298,95 @@ void MapLayer::SetTileAt(size_t x, size_t y, const TileReference& tile)
 		return;
 	if (y >= m_height)
 		return;
-	m_tiles[(y * m_width) + x] = tile;
+	MapLayerCell cell;
+	cell.tileSet = GetTileSetSlot(tile.tileSet);
+	cell.index = cell.tileSet ? tile.index : 0;
+	SetCell(x, y, cell);
+
+	m_changeCount++;
+	m_changedTiles.push_back(pair<size_t, size_t>(x, y));
+	if (m_changedTiles.size() > MAP_LAYER_CHANGE_HISTORY)
+		m_changedTiles.pop_front();
 }
 
 
-void MapLayer::UpdateSmartTile(size_t x, size_t y)
+bool MapLayer::GetChangedTilesSince(uint64_t changeCount, vector<pair<size_t, size_t>>& tiles) const
 {
-	if (x >= m_width)
-		return;
-	if (y >= m_height)
-		return;
+	if (changeCount > m_changeCount)
+		return false;
+	uint64_t count = m_changeCount - changeCount;
+	if (count > (uint64_t)m_changedTiles.size())
+		return false;
+	tiles.insert(tiles.end(), m_changedTiles.end() - (size_t)count, m_changedTiles.end());
+	return true;
+}
+
+
+void MapLayer::GetSmartTileCompatibility(const shared_ptr<TileSet>& tileSet, vector<bool>& compatible)
+{
+	// Compatibility is resolved once per tile set slot instead of once per neighbour
+	compatible.resize(m_tileSets.size());
+	compatible[0] = false;
+	for (size_t i = 1; i < m_tileSets.size(); i++)
+		compatible[i] = tileSet->IsCompatibleForSmartTiles(m_tileSets[i]);
+}
 
-	TileReference ref = GetTileAt(x, y);
-	if (!ref.tileSet)
-		return;
-	if (!ref.tileSet->IsSmartTileSet())
-		return;
 
-	switch (ref.tileSet->GetSmartTileSetType())
+uint32_t MapLayer::GetSmartTileNeighbours(size_t x, size_t y, int radius, const vector<bool>& compatible) const
+{
+	// Tiles outside of the map always connect so that smart tiles continue past the edges
+	uint32_t neighbours = 0;
+	for (int j = -radius; j <= radius; j++)
 	{
-	case SimplifiedSingleWidthSmartTileSet:
-		UpdateSimplifiedSingleWidthSmartTileSet(x, y, ref.tileSet);
-		break;
-	case SimplifiedDoubleWidthSmartTileSet:
-		UpdateSimplifiedDoubleWidthSmartTileSet(x, y, ref.tileSet);
-		break;
-	default:
-		break;
+		for (int i = -radius; i <= radius; i++)
+		{
+			if ((i == 0) && (j == 0))
+				continue;
+			size_t neighbourX = x + i;
+			size_t neighbourY = y + j;
+			if ((neighbourX >= m_width) || (neighbourY >= m_height) ||
+				compatible[GetCell(neighbourX, neighbourY).tileSet])
+				neighbours |= SmartTileNeighbour(i, j);
+		}
 	}
+	return neighbours;
 }
 
 
-bool MapLayer::IsCompatibleForSmartTiles(size_t x, size_t y, const shared_ptr<TileSet>& tileSet)
+void MapLayer::UpdateSmartTile(size_t x, size_t y, shared_ptr<TileSet>& compatibleTileSet,
+	vector<bool>& compatible)
 {
 	if (x >= m_width)
-		return true;
+		return;
 	if (y >= m_height)
-		return true;
-	TileReference ref = GetTileAt(x, y);
-	if (!ref.tileSet)
-		return false;
-	return tileSet->IsCompatibleForSmartTiles(ref.tileSet);
-}
-
+		return;
 
-MapLayer::SmartTileContext MapLayer::GetContextForSmartTile(size_t x, size_t y, const std::shared_ptr<TileSet>& tileSet)
-{
-	SmartTileContext result;
-	for (int j = -2; j <= 2; j++)
-		for (int i = -2; i <= 2; i++)
-			result.tile[i + 2][j + 2] = IsCompatibleForSmartTiles(x + i, y + j, tileSet);
-	return result;
-}
+	MapLayerCell cell = GetCell(x, y);
+	const shared_ptr<TileSet>& tileSet = m_tileSets[cell.tileSet];
+	if (!tileSet)
+		return;
+	if (!tileSet->IsSmartTileSet())
+		return;
 
+	if (tileSet != compatibleTileSet)
+	{
+		GetSmartTileCompatibility(tileSet, compatible);
+		compatibleTileSet = tileSet;
+	}
 
-void MapLayer::UpdateSimplifiedSingleWidthSmartTileSet(size_t x, size_t y, const shared_ptr<TileSet>& tileSet)
-{
-	SmartTileContext c = GetContextForSmartTile(x, y, tileSet);
-
-#define TILE_INDEX(x, y) (((y) * 5) + (x))
-	if (c.Filled(-1, 0) && c.Filled(1, 0) && c.Filled(0, -1) && c.Empty(0, 1))
-		SetTileAt(x, y, TileReference(tileSet, TILE_INDEX(1, 2)));
-	else if (c.Filled(-1, 0) && c.Filled(1, 0) && c.Empty(0, -1) && c.Filled(0, 1))
-		SetTileAt(x, y, TileReference(tileSet, TILE_INDEX(1, 0)));
-	else if (c.Filled(-1, 0) && c.Empty(1, 0) && c.Filled(0, -1) && c.Filled(0, 1))
-		SetTileAt(x, y, TileReference(tileSet, TILE_INDEX(2, 1)));
-	else if (c.Empty(-1, 0) && c.Filled(1, 0) && c.Filled(0, -1) && c.Filled(0, 1))
-		SetTileAt(x, y, TileReference(tileSet, TILE_INDEX(0, 1)));
-	else if (c.Filled(-1, 0) && c.Empty(1, 0) && c.Filled(0, -1) && c.Empty(0, 1))
-		SetTileAt(x, y, TileReference(tileSet, TILE_INDEX(2, 2)));
-	else if (c.Filled(-1, 0) && c.Empty(1, 0) && c.Empty(0, -1) && c.Filled(0, 1))
-		SetTileAt(x, y, TileReference(tileSet, TILE_INDEX(2, 0)));
-	else if (c.Empty(-1, 0) && c.Filled(1, 0) && c.Filled(0, -1) && c.Empty(0, 1))
-		SetTileAt(x, y, TileReference(tileSet, TILE_INDEX(0, 2)));
-	else if (c.Empty(-1, 0) && c.Filled(1, 0) && c.Empty(0, -1) && c.Filled(0, 1))
-		SetTileAt(x, y, TileReference(tileSet, TILE_INDEX(0, 0)));
-	else if (c.Empty(-1, -1))
-		SetTileAt(x, y, TileReference(tileSet, TILE_INDEX(3, 0)));
-	else if (c.Empty(1, -1))
-		SetTileAt(x, y, TileReference(tileSet, TILE_INDEX(4, 0)));
-	else if (c.Empty(-1, 1))
-		SetTileAt(x, y, TileReference(tileSet, TILE_INDEX(3, 1)));
-	else if (c.Empty(1, 1))
-		SetTileAt(x, y, TileReference(tileSet, TILE_INDEX(4, 1)));
-	else
-		SetTileAt(x, y, TileReference(tileSet, TILE_INDEX(1, 1)));
-#undef TILE_INDEX
+	SmartTileSetType type = tileSet->GetSmartTileSetType();
+	uint32_t neighbours = GetSmartTileNeighbours(x, y, SmartTile::GetNeighbourRadius(type), compatible);
+	uint16_t index = SmartTile::ResolveTile(type, neighbours);
+	if (index != cell.index)
+		SetTileAt(x, y, TileReference(tileSet, index));
 }
 
 
-void MapLayer::UpdateSimplifiedDoubleWidthSmartTileSet(size_t x, size_t y, const shared_ptr<TileSet>& tileSet)
+void MapLayer::UpdateSmartTile(size_t x, size_t y)
 {
-	SmartTileContext c = GetContextForSmartTile(x, y, tileSet);
-
-#define TILE_INDEX(x, y) (((y) * 9) + (x))
-	// Outer upper left corner
-	if (c.Filled(1, 0) && c.Filled(1, 1) && c.Filled(1, 2) && c.Filled(2, 1) && c.Empty(2, 2))
-		SetTileAt(x, y, TileReference(tileSet, TILE_INDEX(0, 0)));
-	else if (c.Filled(0, 1) && c.Filled(0, 2) && c.Filled(1, 0) && c.Filled(1, 1) && c.Empty(1, 2))
-		SetTileAt(x, y, TileReference(tileSet, TILE_INDEX(1, 0)));
-	else if (c.Filled(1, 0) && c.Filled(1, 1) && c.Filled(2, 0) && c.Empty(2, 1))
-		SetTileAt(x, y, TileReference(tileSet, TILE_INDEX(0, 1)));
-	else if (c.Filled(0, 1) && c.Filled(1, 0) && c.Empty(1, 1))
-		SetTileAt(x, y, TileReference(tileSet, TILE_INDEX(1, 1)));
-
-	// Top
-	else if (c.Filled(0, 1) && c.Filled(-2, 0) && c.Filled(-1, 0) && c.Filled(1, 0) && c.Filled(2, 0) && c.Empty(0, 2))
-		SetTileAt(x, y, TileReference(tileSet, TILE_INDEX(2, 0)));
-	else if (c.Filled(-2, 0) && c.Filled(-1, 0) && c.Filled(1, 0) && c.Filled(2, 0) && c.Empty(0, 1))
-		SetTileAt(x, y, TileReference(tileSet, TILE_INDEX(2, 1)));
-
-	// Outer upper right corner
-	else if (c.Filled(0, 1) && c.Filled(0, 2) && c.Filled(-1, 0) && c.Filled(-1, 1) && c.Empty(-1, 2))
-		SetTileAt(x, y, TileReference(tileSet, TILE_INDEX(3, 0)));
-	else if (c.Filled(-1, 0) && c.Filled(-1, 1) && c.Filled(-1, 2) && c.Filled(-2, 1) && c.Empty(-2, 2))
-		SetTileAt(x, y, TileReference(tileSet, TILE_INDEX(4, 0)));
-	else if (c.Filled(0, 1) && c.Filled(-1, 0) && c.Empty(-1, 1))
-		SetTileAt(x, y, TileReference(tileSet, TILE_INDEX(3, 1)));
-	else if (c.Filled(-1, 0) && c.Filled(-1, 1) && c.Filled(-2, 0) && c.Empty(-2, 1))
-		SetTileAt(x, y, TileReference(tileSet, TILE_INDEX(4, 1)));
-
-	// Left
-	else if (c.Filled(1, 0) && c.Filled(0, -2) && c.Filled(0, -1) && c.Filled(0, 1) && c.Filled(0, 2) && c.Empty(2, 0))
-		SetTileAt(x, y, TileReference(tileSet, TILE_INDEX(0, 2)));
-	else if (c.Filled(0, -2) && c.Filled(0, -1) && c.Filled(0, 1) && c.Filled(0, 2) && c.Empty(1, 0))
-		SetTileAt(x, y, TileReference(tileSet, TILE_INDEX(1, 2)));
-
-	// Right
-	else if (c.Filled(0, -2) && c.Filled(0, -1) && c.Filled(0, 1) && c.Filled(0, 2) && c.Empty(-1, 0))
-		SetTileAt(x, y, TileReference(tileSet, TILE_INDEX(3, 2)));
-	else if (c.Filled(-1, 0) && c.Filled(0, -2) && c.Filled(0, -1) && c.Filled(0, 1) && c.Filled(0, 2) && c.Empty(-2, 0))
-		SetTileAt(x, y, TileReference(tileSet, TILE_INDEX(4, 2)));
-
-	// Outer bottom left corner
-	else if (c.Filled(1, 0) && c.Filled(1, -1) && c.Filled(2, 0) && c.Empty(2, -1))
-		SetTileAt(x, y, TileReference(tileSet, TILE_INDEX(0, 3)));
-	else if (c.Filled(0, -1) && c.Filled(1, 0) && c.Empty(1, -1))
-		SetTileAt(x, y, TileReference(tileSet, TILE_INDEX(1, 3)));
-	else if (c.Filled(1, 0) && c.Filled(1, -1) && c.Filled(1, -2) && c.Filled(2, -1) && c.Empty(2, -2))
-		SetTileAt(x, y, TileReference(tileSet, TILE_INDEX(0, 4)));
-	else if (c.Filled(0, -1) && c.Filled(0, -2) && c.Filled(1, 0) && c.Filled(1, -1) && c.Empty(1, -2))
-		SetTileAt(x, y, TileReference(tileSet, TILE_INDEX(1, 4)));
-
-	// Bottom
-	else if (c.Filled(-2, 0) && c.Filled(-1, 0) && c.Filled(1, 0) && c.Filled(2, 0) && c.Empty(0, -1))
-		SetTileAt(x, y, TileReference(tileSet, TILE_INDEX(2, 3)));
-	else if (c.Filled(0, -1) && c.Filled(-2, 0) && c.Filled(-1, 0) && c.Filled(1, 0) && c.Filled(2, 0) && c.Empty(0, -2))
-		SetTileAt(x, y, TileReference(tileSet, TILE_INDEX(2, 4)));
-
-	// Outer bottom right corner
-	else if (c.Filled(0, -1) && c.Filled(-1, 0) && c.Empty(-1, -1))
-		SetTileAt(x, y, TileReference(tileSet, TILE_INDEX(3, 3)));
-	else if (c.Filled(-1, 0) && c.Filled(-1, -1) && c.Filled(-2, 0) && c.Empty(-2, -1))
-		SetTileAt(x, y, TileReference(tileSet, TILE_INDEX(4, 3)));
-	else if (c.Filled(0, -1) && c.Filled(0, -2) && c.Filled(-1, 0) && c.Filled(-1, -1) && c.Empty(-1, -2))
-		SetTileAt(x, y, TileReference(tileSet, TILE_INDEX(3, 4)));
-	else if (c.Filled(-1, 0) && c.Filled(-1, -1) && c.Filled(-1, -2) && c.Filled(-2, -1) && c.Empty(-2, -2))
-		SetTileAt(x, y, TileReference(tileSet, TILE_INDEX(4, 4)));
-
-	// Inner upper left corner
-	else if (c.Filled(1, 0) && c.Filled(1, 1) && c.Filled(0, 1) && c.Empty(2, 0) && c.Empty(0, 2))
-		SetTileAt(x, y, TileReference(tileSet, TILE_INDEX(5, 0)));
-	else if (c.Filled(-1, 0) && c.Filled(-1, 1) && c.Filled(0, 1) && c.Empty(1, 0) && c.Empty(0, 2))
-		SetTileAt(x, y, TileReference(tileSet, TILE_INDEX(6, 0)));
-	else if (c.Filled(0, -1) && c.Filled(1, -1) && c.Filled(1, 0) && c.Empty(2, 0) && c.Empty(0, 1))
-		SetTileAt(x, y, TileReference(tileSet, TILE_INDEX(5, 1)));
-	else if (c.Filled(-1, -1) && c.Filled(-1, 0) && c.Filled(0, -1) && c.Empty(1, 0) && c.Empty(0, 1))
-		SetTileAt(x, y, TileReference(tileSet, TILE_INDEX(6, 1)));
-
-	// Inner upper right corner
-	else if (c.Filled(1, 0) && c.Filled(1, 1) && c.Filled(0, 1) && c.Empty(-1, 0) && c.Empty(0, 2))
-		SetTileAt(x, y, TileReference(tileSet, TILE_INDEX(7, 0)));
-	else if (c.Filled(-1, 0) && c.Filled(-1, 1) && c.Filled(0, 1) && c.Empty(-2, 0) && c.Empty(0, 2))
-		SetTileAt(x, y, TileReference(tileSet, TILE_INDEX(8, 0)));
-	else if (c.Filled(1, -1) && c.Filled(1, 0) && c.Filled(0, -1) && c.Empty(-1, 0) && c.Empty(0, 1))
-		SetTileAt(x, y, TileReference(tileSet, TILE_INDEX(7, 1)));
-	else if (c.Filled(0, -1) && c.Filled(-1, -1) && c.Filled(-1, 0) && c.Empty(-2, 0) && c.Empty(0, 1))
-		SetTileAt(x, y, TileReference(tileSet, TILE_INDEX(8, 1)));
-
-	// Inner bottom left corner
-	else if (c.Filled(0, 1) && c.Filled(1, 1) && c.Filled(1, 0) && c.Empty(2, 0) && c.Empty(0, -1))
-		SetTileAt(x, y, TileReference(tileSet, TILE_INDEX(5, 2)));
-	else if (c.Filled(-1, 1) && c.Filled(-1, 0) && c.Filled(0, 1) && c.Empty(1, 0) && c.Empty(0, -1))
-		SetTileAt(x, y, TileReference(tileSet, TILE_INDEX(6, 2)));
-	else if (c.Filled(1, 0) && c.Filled(1, -1) && c.Filled(0, -1) && c.Empty(2, 0) && c.Empty(0, -2))
-		SetTileAt(x, y, TileReference(tileSet, TILE_INDEX(5, 3)));
-	else if (c.Filled(-1, 0) && c.Filled(-1, -1) && c.Filled(0, -1) && c.Empty(1, 0) && c.Empty(0, -2))
-		SetTileAt(x, y, TileReference(tileSet, TILE_INDEX(6, 3)));
-
-	// Inner bottom right corner
-	else if (c.Filled(1, 1) && c.Filled(1, 0) && c.Filled(0, 1) && c.Empty(-1, 0) && c.Empty(0, -1))
-		SetTileAt(x, y, TileReference(tileSet, TILE_INDEX(7, 2)));
-	else if (c.Filled(0, 1) && c.Filled(-1, 1) && c.Filled(-1, 0) && c.Empty(-2, 0) && c.Empty(0, -1))
-		SetTileAt(x, y, TileReference(tileSet, TILE_INDEX(8, 2)));
-	else if (c.Filled(1, 0) && c.Filled(1, -1) && c.Filled(0, -1) && c.Empty(-1, 0) && c.Empty(0, -2))
-		SetTileAt(x, y, TileReference(tileSet, TILE_INDEX(7, 3)));
-	else if (c.Filled(-1, 0) && c.Filled(-1, -1) && c.Filled(0, -1) && c.Empty(-2, 0) && c.Empty(0, -2))
-		SetTileAt(x, y, TileReference(tileSet, TILE_INDEX(8, 3)));
-
-	else
-		SetTileAt(x, y, TileReference(tileSet, TILE_INDEX(2, 2)));
-#undef TILE_INDEX
+	shared_ptr<TileSet> compatibleTileSet;
+	vector<bool> compatible;
+	UpdateSmartTile(x, y, compatibleTileSet, compatible);
 }
 
 
@@ -348,24 +432,115 @@ void MapLayer::UpdateRegionForSmartTiles(int x, int y, int w, int h)
 	if (h <= 0)
 		return;
 
+	shared_ptr<TileSet> compatibleTileSet;
+	vector<bool> compatible;
 	for (int j = 0; j < h; j++)
 		for (int i = 0; i < w; i++)
-			UpdateSmartTile((size_t)(x + i), (size_t)(y + j));
+			UpdateSmartTile((size_t)(x + i), (size_t)(y + j), compatibleTileSet, compatible);
+}
+
+
+void MapLayer::UpdateSmartTilesAround(const vector<pair<size_t, size_t>>& tiles)
+{
+	// Smart tiles only depend on which tile sets are around them, not on the tile indices, so the order in
+	// which the affected tiles are resolved does not matter
+	vector<size_t> affected;
+	affected.reserve(tiles.size() * 25);
+	for (auto& i : tiles)
+	{
+		for (int dy = -2; dy <= 2; dy++)
+		{
+			for (int dx = -2; dx <= 2; dx++)
+			{
+				size_t x = i.first + dx;
+				size_t y = i.second + dy;
+				if ((x < m_width) && (y < m_height))
+					affected.push_back((y * m_width) + x);
+			}
+		}
+	}
+	sort(affected.begin(), affected.end());
+	affected.erase(unique(affected.begin(), affected.end()), affected.end());
+
+	shared_ptr<TileSet> compatibleTileSet;
+	vector<bool> compatible;
+	for (auto i : affected)
+		UpdateSmartTile(i % m_width, i / m_width, compatibleTileSet, compatible);
 }
 
 
 bool MapLayer::UsesTileSet(std::shared_ptr<TileSet> tileSet)
 {
-	for (auto& i : m_tiles)
+	if (!tileSet)
+		return false;
+	for (size_t slot = 1; slot < m_tileSets.size(); slot++)
 	{
-		if (i.tileSet == tileSet)
-			return true;
+		if (m_tileSets[slot] == tileSet)
+			return m_tileSetCellCounts[slot] != 0;
 	}
 	return false;
 }
 
 
-Json::Value MapLayer::Serialize()
+bool MapLayer::CheckTileSetUsage() const
+{
+	if (m_tileSetCellCounts.size() != m_tileSets.size())
+		return false;
+	vector<size_t> counts;
+	counts.resize(m_tileSets.size(), 0);
+	for (auto& chunk : m_chunks)
+	{
+		if (!chunk)
+			continue;
+		for (auto& i : chunk->cells)
+		{
+			if (i.tileSet >= counts.size())
+				return false;
+			if (i.tileSet)
+				counts[i.tileSet]++;
+		}
+	}
+	return counts == m_tileSetCellCounts;
+}
+
+
+vector<shared_ptr<TileSet>> MapLayer::GetReferencedTileSets() const
+{
+	vector<shared_ptr<TileSet>> result;
+	for (size_t slot = 1; slot < m_tileSets.size(); slot++)
+	{
+		if (m_tileSets[slot])
+			result.push_back(m_tileSets[slot]);
+	}
+	return result;
+}
+
+
+vector<shared_ptr<TileSet>> MapLayer::GetUsedTileSets() const
+{
+	vector<shared_ptr<TileSet>> result;
+	for (size_t slot = 1; slot < m_tileSets.size(); slot++)
+	{
+		if (m_tileSets[slot] && (m_tileSetCellCounts[slot] != 0))
+			result.push_back(m_tileSets[slot]);
+	}
+	return result;
+}
+
+
+size_t MapLayer::GetMemoryUsage() const
+{
+	size_t result = sizeof(MapLayer) + (m_chunks.size() * sizeof(shared_ptr<Chunk>));
+	for (auto& i : m_chunks)
+	{
+		if (i)
+			result += sizeof(Chunk);
+	}
+	return result;
+}
+
+
+Json::Value MapLayer::Serialize(uint32_t tileFormat)
 {
 	Json::Value map(Json::objectValue);
 	map["name"] = m_name;
@@ -376,15 +551,12 @@ Json::Value MapLayer::Serialize()
 	map["tile_height"] = (uint64_t)m_tileHeight;
 	map["tile_depth"] = (uint64_t)m_tileDepth;
 
-	set<shared_ptr<TileSet>> usedTileSets;
-	for (auto& i : m_tiles)
+	vector<shared_ptr<TileSet>> sortedUsedTileSets;
+	for (size_t i = 1; i < m_tileSets.size(); i++)
 	{
-		if (i.tileSet)
-			usedTileSets.insert(i.tileSet);
+		if (m_tileSetCellCounts[i] != 0)
+			sortedUsedTileSets.push_back(m_tileSets[i]);
 	}
-	vector<shared_ptr<TileSet>> sortedUsedTileSets;
-	for (auto& i : usedTileSets)
-		sortedUsedTileSets.push_back(i);
 	sort(sortedUsedTileSets.begin(), sortedUsedTileSets.end(),
 		[&](const shared_ptr<TileSet>& a, const shared_ptr<TileSet>& b) {
 			return a->GetId() < b->GetId();
@@ -400,26 +572,82 @@ Json::Value MapLayer::Serialize()
 	}
 	map["tile_sets"] = tileSets;
 
-	Json::Value tiles(Json::arrayValue);
-	for (size_t y = 0; y < m_height; y++)
+	if (tileFormat == MAP_LAYER_TILE_FORMAT_ROWS)
 	{
-		Json::Value row(Json::arrayValue);
-		for (size_t x = 0; x < m_width; x++)
+		Json::Value tiles(Json::arrayValue);
+		for (size_t y = 0; y < m_height; y++)
 		{
-			Json::Value tile(Json::arrayValue);
-			TileReference ref = GetTileAt(x, y);
-			if (ref.tileSet)
+			Json::Value row(Json::arrayValue);
+			for (size_t x = 0; x < m_width; x++)
 			{
-				tile.append(tileSetIds[ref.tileSet]);
-				tile.append(ref.index);
+				Json::Value tile(Json::arrayValue);
+				MapLayerCell cell = GetCell(x, y);
+				if (cell.tileSet)
+				{
+					tile.append(tileSetIds[m_tileSets[cell.tileSet]]);
+					tile.append(cell.index);
+				}
+				row.append(tile);
 			}
-			row.append(tile);
+			Json::FastWriter writer;
+			string rowStr = writer.write(row);
+			tiles.append(rowStr);
 		}
-		Json::FastWriter writer;
-		string rowStr = writer.write(row);
-		tiles.append(rowStr);
+		map["tiles"] = tiles;
+	}
+	else
+	{
+		vector<uint16_t> slotNumbers;
+		slotNumbers.resize(m_tileSets.size(), 0);
+		for (size_t i = 1; i < m_tileSets.size(); i++)
+		{
+			if (m_tileSetCellCounts[i] != 0)
+				slotNumbers[i] = (uint16_t)(tileSetIds[m_tileSets[i]] + 1);
+		}
+
+		// Each run is a 16-bit count, a 16-bit tile set number (zero for no tile) and a 16-bit tile index,
+		// all little endian. Runs never cross the end of a row.
+		string packed;
+		for (size_t y = 0; y < m_height; y++)
+		{
+			const shared_ptr<Chunk>* chunkRow = &m_chunks[(y >> MAP_LAYER_CHUNK_SHIFT) * m_chunksWide];
+			size_t x = 0;
+			while (x < m_width)
+			{
+				MapLayerCell cell = GetCell(x, y);
+				size_t count = 1;
+				while (((x + count) < m_width) && (count < 0xffff))
+				{
+					// Runs of empty tiles step over chunks that are not allocated in one go
+					size_t nextX = x + count;
+					if ((!cell.tileSet) && (!chunkRow[nextX >> MAP_LAYER_CHUNK_SHIFT]))
+					{
+						size_t chunkEnd = ((nextX >> MAP_LAYER_CHUNK_SHIFT) + 1) << MAP_LAYER_CHUNK_SHIFT;
+						count = min(min(chunkEnd, m_width) - x, (size_t)0xffff);
+						continue;
+					}
+
+					MapLayerCell next = GetCell(nextX, y);
+					if ((next.tileSet != cell.tileSet) || (next.index != cell.index))
+						break;
+					count++;
+				}
+
+				uint16_t run[3];
+				run[0] = (uint16_t)count;
+				run[1] = slotNumbers[cell.tileSet];
+				run[2] = cell.index;
+				for (size_t i = 0; i < 3; i++)
+				{
+					packed += (char)(run[i] & 0xff);
+					packed += (char)(run[i] >> 8);
+				}
+				x += count;
+			}
+		}
+		map["tile_format"] = MAP_LAYER_TILE_FORMAT_PACKED;
+		map["tiles"] = QByteArray(packed.c_str(), (int)packed.size()).toBase64().toStdString();
 	}
-	map["tiles"] = tiles;
 
 	map["effect"] = m_effectLayer;
 	map["blend"] = (uint32_t)m_blendMode;
@@ -456,32 +684,90 @@ shared_ptr<MapLayer> MapLayer::Deserialize(shared_ptr<Project> project, const Js
 	for (auto& i : data["tile_sets"])
 		tileSets.push_back(project->GetTileSetById(i.asString()));
 
-	size_t y = 0;
-	for (auto& rowStr : data["tiles"])
+	uint32_t tileFormat = MAP_LAYER_TILE_FORMAT_ROWS;
+	if (data.isMember("tile_format"))
+		tileFormat = data["tile_format"].asUInt();
+
+	if (tileFormat == MAP_LAYER_TILE_FORMAT_ROWS)
 	{
-		if (y >= height)
-			return shared_ptr<MapLayer>();
+		size_t y = 0;
+		for (auto& rowStr : data["tiles"])
+		{
+			if (y >= height)
+				return shared_ptr<MapLayer>();
+
+			Json::Reader reader;
+			Json::Value row;
+			if (!reader.parse(rowStr.asString(), row, false))
+				return shared_ptr<MapLayer>();
+
+			size_t x = 0;
+			for (auto& col : row)
+			{
+				TileReference ref;
+				if ((col.size() == 2) && (col[0].asUInt64() < tileSets.size()))
+				{
+					ref.tileSet = tileSets[(size_t)col[0].asUInt64()];
+					ref.index = (uint16_t)col[1].asUInt();
+				}
+				result->SetTileAt(x, y, ref);
+				x++;
+			}
 
-		Json::Reader reader;
-		Json::Value row;
-		if (!reader.parse(rowStr.asString(), row, false))
+			y++;
+		}
+	}
+	else if (tileFormat == MAP_LAYER_TILE_FORMAT_PACKED)
+	{
+		string tilesStr = data["tiles"].asString();
+		QByteArray packed = QByteArray::fromBase64(QByteArray(tilesStr.c_str(), (int)tilesStr.size()));
+		const uint8_t* runs = (const uint8_t*)packed.constData();
+		size_t runCount = (size_t)packed.size() / 6;
+		if (((size_t)packed.size() % 6) != 0)
 			return shared_ptr<MapLayer>();
 
+		vector<uint16_t> slots;
+		for (auto& i : tileSets)
+			slots.push_back(result->GetTileSetSlot(i));
+
+		// Runs are written straight into the tile grid, every row must be covered exactly
+		size_t offset = 0;
 		size_t x = 0;
-		for (auto& col : row)
+		for (size_t i = 0; i < runCount; i++)
 		{
-			TileReference ref;
-			if ((col.size() == 2) && (col[0].asUInt64() < tileSets.size()))
+			uint16_t count = (uint16_t)(runs[0] | (runs[1] << 8));
+			uint16_t tileSet = (uint16_t)(runs[2] | (runs[3] << 8));
+			uint16_t index = (uint16_t)(runs[4] | (runs[5] << 8));
+			runs += 6;
+
+			if ((count == 0) || ((x + count) > width) || ((offset + count) > (width * height)) ||
+				(tileSet > tileSets.size()))
+				return shared_ptr<MapLayer>();
+
+			MapLayerCell cell;
+			cell.tileSet = (tileSet != 0) ? slots[tileSet - 1] : 0;
+			cell.index = cell.tileSet ? index : 0;
+			if (cell.tileSet)
 			{
-				ref.tileSet = tileSets[(size_t)col[0].asUInt64()];
-				ref.index = (uint16_t)col[1].asUInt();
+				for (size_t j = 0; j < count; j++)
+					result->SetCell(x + j, offset / width, cell);
 			}
-			result->SetTileAt(x, y, ref);
-			x++;
+			offset += count;
+
+			x += count;
+			if (x == width)
+				x = 0;
 		}
 
-		y++;
+		if (offset != (width * height))
+			return shared_ptr<MapLayer>();
+	}
+	else
+	{
+		return shared_ptr<MapLayer>();
 	}
 
+	// Nothing can be watching a layer that was just loaded
+	result->m_changedTiles.clear();
 	return result;
 }
@@ -2,7 +2,9 @@
 
 #include <string>
 #include <vector>
+#include <deque>
 #include <memory>
+#include <functional>
 #include "tileset.h"
 #include "json/json.h"
 
@@ -15,8 +17,29 @@ struct TileReference
 	TileReference(std::shared_ptr<TileSet> s, uint16_t i): tileSet(s), index(i) {}
 };
 
+// Tile as stored in a layer's grid. The tile set is a slot in the layer's tile set table, slot zero is
+// always empty and is used for cells without a tile. The layer counts the cells using each slot.
+struct MapLayerCell
+{
+	uint16_t tileSet;
+	uint16_t index;
+};
+
 class Project;
 
+// Layers are stored as square chunks of tiles, chunks that do not contain any tiles are not allocated
+#define MAP_LAYER_CHUNK_SHIFT 5
+#define MAP_LAYER_CHUNK_SIZE (1 << MAP_LAYER_CHUNK_SHIFT)
+
+// Number of recent tile changes remembered by a layer for incremental rendering
+#define MAP_LAYER_CHANGE_HISTORY 4096
+
+// Formats for the tile grid of a serialized layer. Rows stores each row as a JSON string of
+// [tile set, index] pairs and is readable by every version. Packed stores base64 encoded runs of
+// identical tiles within each row, tagged with a "tile_format" field.
+#define MAP_LAYER_TILE_FORMAT_ROWS 1
+#define MAP_LAYER_TILE_FORMAT_PACKED 2
+
 enum BlendMode
 {
 	BlendMode_Normal,
@@ -27,18 +50,25 @@ enum BlendMode
 
 class MapLayer
 {
-	struct SmartTileContext
+public:
+	typedef std::function<void(const std::shared_ptr<TileSet>& tileSet, bool used)> TileSetUsageCallback;
+
+private:
+	struct Chunk
 	{
-		bool tile[5][5];
-		bool Empty(int x, int y);
-		bool Filled(int x, int y);
+		MapLayerCell cells[MAP_LAYER_CHUNK_SIZE * MAP_LAYER_CHUNK_SIZE];
+		size_t tileCount;
 	};
 
 	std::string m_name;
 	std::string m_id;
 	size_t m_width, m_height;
 	size_t m_tileWidth, m_tileHeight, m_tileDepth;
-	std::vector<TileReference> m_tiles;
+	size_t m_chunksWide, m_chunksHigh;
+	std::vector<std::shared_ptr<Chunk>> m_chunks;
+	std::vector<std::shared_ptr<TileSet>> m_tileSets;
+	std::vector<size_t> m_tileSetCellCounts;
+	TileSetUsageCallback m_tileSetUsageCallback;
 
 	bool m_effectLayer;
 	BlendMode m_blendMode;
@@ -46,16 +76,29 @@ class MapLayer
 	int16_t m_parallaxFactorX, m_parallaxFactorY;
 	int16_t m_autoScrollX, m_autoScrollY;
 
-	bool IsCompatibleForSmartTiles(size_t x, size_t y, const std::shared_ptr<TileSet>& tileSet);
-	SmartTileContext GetContextForSmartTile(size_t x, size_t y, const std::shared_ptr<TileSet>& tileSet);
-	void UpdateSimplifiedSingleWidthSmartTileSet(size_t x, size_t y, const std::shared_ptr<TileSet>& tileSet);
-	void UpdateSimplifiedDoubleWidthSmartTileSet(size_t x, size_t y, const std::shared_ptr<TileSet>& tileSet);
+	uint64_t m_changeCount;
+	std::deque<std::pair<size_t, size_t>> m_changedTiles;
+
+	Chunk* GetWritableChunk(std::shared_ptr<Chunk>& chunk);
+	MapLayerCell GetCell(size_t x, size_t y) const;
+	void SetCell(size_t x, size_t y, const MapLayerCell& cell);
+	uint16_t GetTileSetSlot(const std::shared_ptr<TileSet>& tileSet);
+	void AddTileSetCell(uint16_t slot);
+	void RemoveTileSetCell(uint16_t slot);
+	void CompactTileSets();
+	void GetSmartTileCompatibility(const std::shared_ptr<TileSet>& tileSet, std::vector<bool>& compatible);
+	uint32_t GetSmartTileNeighbours(size_t x, size_t y, int radius, const std::vector<bool>& compatible) const;
+	void UpdateSmartTile(size_t x, size_t y, std::shared_ptr<TileSet>& compatibleTileSet,
+		std::vector<bool>& compatible);
 
 public:
 	MapLayer(size_t width, size_t height, size_t tileWidth, size_t tileHeight, size_t tileDepth,
 		bool effectLayer = false);
 	MapLayer(const MapLayer& other);
 
+	// Copy with the same id that shares the tile grid until either layer is modified, for saving in the background
+	std::shared_ptr<MapLayer> CreateSnapshot() const;
+
 	const std::string& GetName() const { return m_name; }
 	void SetName(const std::string& name) { m_name = name; }
 
@@ -67,9 +110,21 @@ public:
 	size_t GetTileHeight() const { return m_tileHeight; }
 	size_t GetTileDepth() const { return m_tileDepth; }
 
-	TileReference GetTileAt(size_t x, size_t y);
+	TileReference GetTileAt(size_t x, size_t y) const;
 	void SetTileAt(size_t x, size_t y, const TileReference& tile);
 
+	// Direct access to the tile grid for code that walks many tiles. Chunks are MAP_LAYER_CHUNK_SIZE cells
+	// square and stored by row, chunks without any tiles are null. Only valid until the layer is modified.
+	size_t GetWidthInChunks() const { return m_chunksWide; }
+	size_t GetHeightInChunks() const { return m_chunksHigh; }
+	const MapLayerCell* GetTileChunk(size_t chunkX, size_t chunkY) const;
+	const std::shared_ptr<TileSet>& GetTileSetForCell(const MapLayerCell& cell) const { return m_tileSets[cell.tileSet]; }
+
+	// Each tile change increments the change count. The positions of the most recent changes are kept so
+	// that views can update only what changed, if they fell too far behind they must redraw everything.
+	uint64_t GetChangeCount() const { return m_changeCount; }
+	bool GetChangedTilesSince(uint64_t changeCount, std::vector<std::pair<size_t, size_t>>& tiles) const;
+
 	bool IsEffectLayer() const { return m_effectLayer; }
 	void SetIsEffectLayer(bool effectLayer) { m_effectLayer = effectLayer; }
 	BlendMode GetBlendMode() const { return m_blendMode; }
@@ -88,9 +143,24 @@ public:
 	void UpdateSmartTile(size_t x, size_t y);
 	void UpdateRegionForSmartTiles(int x, int y, int w, int h);
 
+	// Updates smart tiles after a batch of tile changes. Every tile near a changed tile is resolved exactly once,
+	// no matter how many of the changes it is near.
+	void UpdateSmartTilesAround(const std::vector<std::pair<size_t, size_t>>& tiles);
+
 	bool UsesTileSet(std::shared_ptr<TileSet> tileSet);
+	// Verifies the number of cells counted for each tile set slot against the tile grid, for debugging
+	bool CheckTileSetUsage() const;
+	// Tile sets in the layer's tile set table, which can include sets that are no longer placed on the layer
+	std::vector<std::shared_ptr<TileSet>> GetReferencedTileSets() const;
+	// Tile sets with at least one tile placed on the layer
+	std::vector<std::shared_ptr<TileSet>> GetUsedTileSets() const;
+	// Called when the first tile from a tile set is placed on the layer or the last one is removed. Copies
+	// and snapshots of the layer do not keep the callback.
+	void SetTileSetUsageCallback(const TileSetUsageCallback& callback) { m_tileSetUsageCallback = callback; }
+	// Memory held by the tile grid, empty chunks take no memory
+	size_t GetMemoryUsage() const;
 
 	const std::string& GetId() const { return m_id; }
-	Json::Value Serialize();
+	Json::Value Serialize(uint32_t tileFormat);
 	static std::shared_ptr<MapLayer> Deserialize(std::shared_ptr<Project> project, const Json::Value& data);
 };
@@ -67,7 +67,7 @@ void MapLayerWidget::MoveLayerUp(shared_ptr<MapLayer> layer)
 
 			shared_ptr<Map> map = m_map;
 			MainWindow* mainWindow = m_mainWindow;
-			m_mainWindow->AddUndoAction(
+			m_mainWindow->AddUndoAction(map->GetId(), DEFAULT_UNDO_ACTION_SIZE,
 				[=]() { // Undo
 					map->SwapLayers(i, i + 1);
 					mainWindow->UpdateMapContents(map);
@@ -96,7 +96,7 @@ void MapLayerWidget::MoveLayerDown(shared_ptr<MapLayer> layer)
 
 			shared_ptr<Map> map = m_map;
 			MainWindow* mainWindow = m_mainWindow;
-			m_mainWindow->AddUndoAction(
+			m_mainWindow->AddUndoAction(map->GetId(), DEFAULT_UNDO_ACTION_SIZE,
 				[=]() { // Undo
 					map->SwapLayers(i - 1, i);
 					mainWindow->UpdateMapContents(map);
@@ -138,7 +138,7 @@ void MapLayerWidget::EditLayer(shared_ptr<MapLayer> layer)
 
 	shared_ptr<Map> map = m_map;
 	MainWindow* mainWindow = m_mainWindow;
-	m_mainWindow->AddUndoAction(
+	m_mainWindow->AddUndoAction(map->GetId(), DEFAULT_UNDO_ACTION_SIZE,
 		[=]() { // Undo
 			layer->SetName(oldName);
 			layer->SetBlendMode(oldBlendMode);
@@ -175,9 +175,12 @@ void MapLayerWidget::RemoveLayer(shared_ptr<MapLayer> layer)
 				m_editor->SetActiveLayer(m_map->GetMainLayer());
 			m_mainWindow->UpdateMapContents(m_map);
 
+			// Effect layers are owned by the project and are not freed with the map
+			size_t memoryUsage = layer->IsEffectLayer() ? DEFAULT_UNDO_ACTION_SIZE : layer->GetMemoryUsage();
+
 			shared_ptr<Map> map = m_map;
 			MainWindow* mainWindow = m_mainWindow;
-			m_mainWindow->AddUndoAction(
+			m_mainWindow->AddUndoAction(map->GetId(), memoryUsage,
 				[=]() { // Undo
 					map->InsertLayer(i, layer);
 					mainWindow->UpdateMapContents(map);
@@ -272,7 +275,7 @@ void MapLayerWidget::OnAddLayer()
 
 		shared_ptr<Map> map = m_map;
 		MainWindow* mainWindow = m_mainWindow;
-		m_mainWindow->AddUndoAction(
+		m_mainWindow->AddUndoAction(map->GetId(), layer->GetMemoryUsage(),
 			[=]() { // Undo
 				map->DeleteLayer(index);
 				mainWindow->UpdateMapContents(map);
@@ -320,7 +323,7 @@ void MapLayerWidget::OnAddEffectLayer()
 
 	shared_ptr<Map> map = m_map;
 	MainWindow* mainWindow = m_mainWindow;
-	m_mainWindow->AddUndoAction(
+	m_mainWindow->AddUndoAction(map->GetId(), DEFAULT_UNDO_ACTION_SIZE,
 		[=]() { // Undo
 			map->DeleteLayer(index);
 			mainWindow->UpdateMapContents(map);
@@ -0,0 +1,338 @@
+#include <QStringList>
+#include <algorithm>
+#include "maptilesmimedata.h"
+
+using namespace std;
+
+
+static void AppendHex(string& str, uint32_t value, int digits)
+{
+	static const char* hexDigits = "0123456789abcdef";
+	for (int i = digits - 1; i >= 0; i--)
+		str += hexDigits[(value >> (i * 4)) & 0xf];
+}
+
+
+static void AppendWord(QByteArray& data, uint16_t value)
+{
+	data.append((char)(value & 0xff));
+	data.append((char)(value >> 8));
+}
+
+
+MapTilesMimeData::MapTilesMimeData(const shared_ptr<MapFloatingLayer>& contents):
+	m_contents(contents), m_textValid(false)
+{
+	m_tiles = Encode(contents);
+
+	int width = contents->GetWidth();
+	int height = contents->GetHeight();
+	m_tileWidth = (int)contents->GetMapLayer()->GetTileWidth();
+	m_tileHeight = (int)contents->GetMapLayer()->GetTileHeight();
+
+	// Snapshots share pixel data with the tiles until they are edited, each tile is only captured once
+	map<pair<shared_ptr<TileSet>, uint16_t>, shared_ptr<Tile>> snapshots;
+	m_cellTiles.resize((size_t)width * (size_t)height);
+	for (int y = 0; y < height; y++)
+	{
+		for (int x = 0; x < width; x++)
+		{
+			MapFloatingLayerTile tile = contents->GetTile(x, y);
+			if ((!tile.valid) || (!tile.tileSet))
+				continue;
+
+			pair<shared_ptr<TileSet>, uint16_t> key(tile.tileSet, tile.index);
+			auto i = snapshots.find(key);
+			if (i == snapshots.end())
+			{
+				shared_ptr<Tile> tileObj = tile.tileSet->GetTile(tile.index);
+				i = snapshots.insert(make_pair(key, tileObj ? tileObj->CreateSnapshot() : shared_ptr<Tile>())).first;
+			}
+			m_cellTiles[(y * width) + x] = i->second;
+		}
+	}
+}
+
+
+QStringList MapTilesMimeData::formats() const
+{
+	return QStringList() << MAP_TILES_MIME_TYPE << "text/plain";
+}
+
+
+QVariant MapTilesMimeData::retrieveData(const QString& mimeType, QVariant::Type type) const
+{
+	if (mimeType == MAP_TILES_MIME_TYPE)
+		return m_tiles;
+	if (mimeType == "text/plain")
+	{
+		if (!m_textValid)
+		{
+			m_text = GenerateText();
+			m_textValid = true;
+		}
+		if (type == QVariant::String)
+			return QString::fromUtf8(m_text);
+		return m_text;
+	}
+	return QMimeData::retrieveData(mimeType, type);
+}
+
+
+QByteArray MapTilesMimeData::Encode(const shared_ptr<MapFloatingLayer>& contents)
+{
+	int width = contents->GetWidth();
+	int height = contents->GetHeight();
+
+	// Tile sets are numbered in order of first use. Neighbouring cells usually share a tile set, so the
+	// table is only searched when it changes.
+	vector<shared_ptr<TileSet>> tileSets;
+	vector<uint16_t> cells;
+	cells.reserve((size_t)width * (size_t)height * 2);
+	shared_ptr<TileSet> lastTileSet;
+	uint16_t lastNumber = 0;
+	for (int y = 0; y < height; y++)
+	{
+		for (int x = 0; x < width; x++)
+		{
+			MapFloatingLayerTile tile = contents->GetTile(x, y);
+			if ((!tile.valid) || (!tile.tileSet))
+			{
+				cells.push_back(0);
+				cells.push_back(0);
+				continue;
+			}
+
+			if (tile.tileSet != lastTileSet)
+			{
+				auto i = find(tileSets.begin(), tileSets.end(), tile.tileSet);
+				lastNumber = (uint16_t)((i - tileSets.begin()) + 1);
+				if (i == tileSets.end())
+					tileSets.push_back(tile.tileSet);
+				lastTileSet = tile.tileSet;
+			}
+			cells.push_back(lastNumber);
+			cells.push_back(tile.index);
+		}
+	}
+
+	QByteArray result;
+	AppendWord(result, (uint16_t)width);
+	AppendWord(result, (uint16_t)height);
+	AppendWord(result, (uint16_t)tileSets.size());
+	for (auto& i : tileSets)
+	{
+		const string& id = i->GetId();
+		AppendWord(result, (uint16_t)id.size());
+		result.append(id.c_str(), (int)id.size());
+	}
+
+	size_t offset = (size_t)result.size();
+	result.resize((int)(offset + (cells.size() * 2)));
+	uint8_t* out = (uint8_t*)result.data() + offset;
+	for (auto i : cells)
+	{
+		*(out++) = (uint8_t)(i & 0xff);
+		*(out++) = (uint8_t)(i >> 8);
+	}
+	return result;
+}
+
+
+shared_ptr<MapFloatingLayer> MapTilesMimeData::Decode(const QByteArray& data, shared_ptr<Project> project,
+	shared_ptr<MapLayer> layer)
+{
+	const uint8_t* ptr = (const uint8_t*)data.constData();
+	size_t remaining = (size_t)data.size();
+	auto readWord = [&](uint16_t& value) {
+		if (remaining < 2)
+			return false;
+		value = (uint16_t)(ptr[0] | (ptr[1] << 8));
+		ptr += 2;
+		remaining -= 2;
+		return true;
+	};
+
+	uint16_t width, height, tileSetCount;
+	if ((!readWord(width)) || (!readWord(height)) || (!readWord(tileSetCount)))
+		return shared_ptr<MapFloatingLayer>();
+	if ((width == 0) || (height == 0) || (width >= 0x8000) || (height >= 0x8000))
+		return shared_ptr<MapFloatingLayer>();
+
+	vector<shared_ptr<TileSet>> tileSets;
+	tileSets.push_back(shared_ptr<TileSet>());
+	for (uint16_t i = 0; i < tileSetCount; i++)
+	{
+		uint16_t length;
+		if ((!readWord(length)) || (remaining < (size_t)length))
+			return shared_ptr<MapFloatingLayer>();
+		tileSets.push_back(project->GetTileSetById(string((const char*)ptr, length)));
+		ptr += length;
+		remaining -= length;
+	}
+
+	if (remaining != ((size_t)width * (size_t)height * 4))
+		return shared_ptr<MapFloatingLayer>();
+
+	shared_ptr<MapFloatingLayer> result = make_shared<MapFloatingLayer>(layer, 0, 0, width, height);
+	for (int y = 0; y < (int)height; y++)
+	{
+		for (int x = 0; x < (int)width; x++)
+		{
+			uint16_t tileSetNumber = (uint16_t)(ptr[0] | (ptr[1] << 8));
+			uint16_t tileIndex = (uint16_t)(ptr[2] | (ptr[3] << 8));
+			ptr += 4;
+
+			if ((size_t)tileSetNumber >= tileSets.size())
+				tileSetNumber = 0;
+			shared_ptr<TileSet> tileSet = tileSets[tileSetNumber];
+			if ((!tileSet) || ((size_t)tileIndex >= tileSet->GetTileCount()))
+			{
+				tileSet.reset();
+				tileIndex = 0;
+			}
+
+			result->SetTile(x, y, tileSet, tileIndex);
+		}
+	}
+	return result;
+}
+
+
+QByteArray MapTilesMimeData::GenerateText() const
+{
+	int width = m_contents->GetWidth();
+	int height = m_contents->GetHeight();
+	int tileWidth = m_tileWidth;
+	int tileHeight = m_tileHeight;
+
+	Json::Value data(Json::objectValue);
+
+	Json::Value tiles(Json::objectValue);
+	tiles["width"] = width;
+	tiles["height"] = height;
+
+	map<shared_ptr<TileSet>, int> tileSetIndex;
+	Json::Value tileSets(Json::arrayValue);
+	int curTileSetIndex = 1;
+	for (int y = 0; y < height; y++)
+	{
+		for (int x = 0; x < width; x++)
+		{
+			MapFloatingLayerTile tile = m_contents->GetTile(x, y);
+			if (!tile.valid)
+				continue;
+			auto i = tileSetIndex.find(tile.tileSet);
+			if (i == tileSetIndex.end())
+			{
+				tileSetIndex[tile.tileSet] = curTileSetIndex++;
+				if (tile.tileSet)
+					tileSets.append(tile.tileSet->GetId());
+				else
+					tileSets.append("");
+			}
+		}
+	}
+	tiles["tile_sets"] = tileSets;
+
+	string tileIndexData, tileSetData;
+	tileIndexData.reserve((size_t)width * (size_t)height * 4);
+	tileSetData.reserve((size_t)width * (size_t)height * 2);
+	for (int y = 0; y < height; y++)
+	{
+		for (int x = 0; x < width; x++)
+		{
+			MapFloatingLayerTile tile = m_contents->GetTile(x, y);
+			if (!tile.valid)
+			{
+				tileIndexData += "0000";
+				tileSetData += "00";
+				continue;
+			}
+
+			AppendHex(tileIndexData, tile.index, 4);
+			AppendHex(tileSetData, (uint8_t)tileSetIndex[tile.tileSet], 2);
+		}
+	}
+	tiles["tile_index_data"] = tileIndexData;
+	tiles["tile_set_data"] = tileSetData;
+
+	data["tiles"] = tiles;
+
+	Json::Value image(Json::objectValue);
+	image["width"] = (uint32_t)(width * tileWidth);
+	image["height"] = (uint32_t)(height * tileHeight);
+
+	// Tiles of a different size than the layer's are left out of the image, pixels are written a row at a time
+	vector<shared_ptr<Tile>> cellTiles;
+	cellTiles.resize((size_t)width * (size_t)height);
+	map<shared_ptr<Palette>, int> paletteIndex;
+	Json::Value palettes(Json::arrayValue);
+	int curPaletteIndex = 1;
+	for (int y = 0; y < height; y++)
+	{
+		for (int x = 0; x < width; x++)
+		{
+			const shared_ptr<Tile>& tileObj = m_cellTiles[(y * width) + x];
+			if (!tileObj)
+				continue;
+			if (((int)tileObj->GetWidth() == tileWidth) && ((int)tileObj->GetHeight() == tileHeight))
+				cellTiles[(y * width) + x] = tileObj;
+
+			auto i = paletteIndex.find(tileObj->GetPalette());
+			if (i == paletteIndex.end())
+			{
+				paletteIndex[tileObj->GetPalette()] = curPaletteIndex++;
+				if (tileObj->GetPalette())
+					palettes.append(tileObj->GetPalette()->GetId());
+				else
+					palettes.append("");
+			}
+		}
+	}
+	image["palettes"] = palettes;
+
+	string imageData, imagePalette;
+	imageData.reserve((size_t)width * (size_t)tileWidth * (size_t)height * (size_t)tileHeight * 2);
+	imagePalette.reserve(imageData.capacity());
+	for (int y = 0; y < (height * tileHeight); y++)
+	{
+		for (int x = 0; x < (width * tileWidth); x++)
+		{
+			const shared_ptr<Tile>& tileObj = cellTiles[((y / tileHeight) * width) + (x / tileWidth)];
+			if (!tileObj)
+			{
+				imageData += "00";
+				imagePalette += "00";
+				continue;
+			}
+
+			int pixelX = x % tileWidth;
+			int pixelY = y % tileHeight;
+			const uint8_t* tileData = static_cast<const Tile&>(*tileObj).GetData();
+			uint8_t colorIndex;
+			if (tileObj->GetDepth() == 4)
+				colorIndex = (tileData[(pixelY * tileObj->GetPitch()) + (pixelX / 2)] >> ((pixelX & 1) << 2)) & 0xf;
+			else
+				colorIndex = tileData[(pixelY * tileObj->GetPitch()) + pixelX];
+
+			if ((colorIndex == 0) || (!tileObj->GetPalette()))
+			{
+				imageData += "00";
+				imagePalette += "00";
+				continue;
+			}
+
+			AppendHex(imageData, (uint8_t)(colorIndex + tileObj->GetPaletteOffset()), 2);
+			AppendHex(imagePalette, (uint8_t)paletteIndex[tileObj->GetPalette()], 2);
+		}
+	}
+	image["pixel_data"] = imageData;
+	image["palette_data"] = imagePalette;
+
+	data["image"] = image;
+
+	Json::StyledWriter writer;
+	string contents = writer.write(data);
+	return QByteArray(contents.c_str(), (int)contents.size());
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <QMimeData>
+#include "project.h"
+#include "mapfloatinglayer.h"
+
+// Binary clipboard format for tile selections. All values are 16-bit little endian: the width and height,
+// the number of tile sets, then for each tile set the length of its id in bytes followed by the id. The
+// cells follow in row order as a tile set number (zero for no tile) and a tile index.
+#define MAP_TILES_MIME_TYPE "application/x-shuriken16-tiles"
+
+// Clipboard contents for a copied map selection. The binary format is encoded when copying, the JSON text
+// used by the tile set and sprite editors and by older versions is only generated if it is requested.
+// Snapshots of the tiles are taken when copying, so the text has the pixels and palettes of that time.
+class MapTilesMimeData: public QMimeData
+{
+	std::shared_ptr<MapFloatingLayer> m_contents;
+	std::vector<std::shared_ptr<Tile>> m_cellTiles;
+	int m_tileWidth, m_tileHeight;
+	QByteArray m_tiles;
+	mutable QByteArray m_text;
+	mutable bool m_textValid;
+
+	QByteArray GenerateText() const;
+
+public:
+	MapTilesMimeData(const std::shared_ptr<MapFloatingLayer>& contents);
+
+	virtual QStringList formats() const override;
+
+	static QByteArray Encode(const std::shared_ptr<MapFloatingLayer>& contents);
+	// Returns a floating layer at the top left of the map layer, or null if the data is not valid
+	static std::shared_ptr<MapFloatingLayer> Decode(const QByteArray& data, std::shared_ptr<Project> project,
+		std::shared_ptr<MapLayer> layer);
+
+protected:
+	virtual QVariant retrieveData(const QString& mimeType, QVariant::Type type) const override;
+};
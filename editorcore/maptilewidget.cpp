@@ -43,6 +43,7 @@ void MapTileWidget::AddTileSetWidgets(shared_ptr<TileSet> tileSet, int& row)
 	TileSelectWidget* widget = new TileSelectWidget(this, m_editor, m_mainWindow, m_project, tileSet);
 	m_entryLayout->addWidget(widget, row, 0);
 	m_entries.push_back(widget);
+	m_tileSetWidgets.push_back(widget);
 	row++;
 }
 
@@ -55,6 +56,7 @@ void MapTileWidget::UpdateView()
 		i->deleteLater();
 	}
 	m_entries.clear();
+	m_tileSetWidgets.clear();
 
 	int row = 0;
 
@@ -126,3 +128,29 @@ void MapTileWidget::UpdateView()
 			AddTileSetWidgets(i, row);
 	}
 }
+
+
+void MapTileWidget::UpdateTileSetTiles(shared_ptr<TileSet> tileSet, const set<size_t>& tiles, uint16_t frame)
+{
+	// Tile selection only shows the first frame
+	if (frame != 0)
+		return;
+	for (auto i : m_tileSetWidgets)
+	{
+		if (i->GetTileSet() == tileSet)
+			i->UpdateTiles(tiles);
+	}
+}
+
+
+bool MapTileWidget::ShowsTileSet(shared_ptr<TileSet> tileSet)
+{
+	for (auto i : m_tileSetWidgets)
+	{
+		if (i->GetTileSet() == tileSet)
+			return true;
+	}
+	return (tileSet->GetWidth() == m_editor->GetActiveLayer()->GetTileWidth()) &&
+		(tileSet->GetHeight() == m_editor->GetActiveLayer()->GetTileHeight()) &&
+		(tileSet->GetDepth() == m_editor->GetActiveLayer()->GetTileDepth());
+}
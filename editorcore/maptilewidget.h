@@ -2,12 +2,14 @@
 
 #include <QWidget>
 #include <QGridLayout>
+#include <set>
 #include "project.h"
 #include "map.h"
 #include "tileset.h"
 
 class MainWindow;
 class MapEditorWidget;
+class TileSelectWidget;
 
 class MapTileWidget: public QWidget
 {
@@ -20,6 +22,7 @@ class MapTileWidget: public QWidget
 
 	QGridLayout* m_entryLayout;
 	std::vector<QWidget*> m_entries;
+	std::vector<TileSelectWidget*> m_tileSetWidgets;
 
 	void AddTileSetWidgets(std::shared_ptr<TileSet> tileSet, int& row);
 
@@ -28,4 +31,7 @@ public:
 		std::shared_ptr<Project> project, std::shared_ptr<Map> map);
 
 	void UpdateView();
+	void UpdateTileSetTiles(std::shared_ptr<TileSet> tileSet, const std::set<size_t>& tiles, uint16_t frame);
+	// True if the tile set is shown for selection, or would be shown once the view is updated
+	bool ShowsTileSet(std::shared_ptr<TileSet> tileSet);
 };
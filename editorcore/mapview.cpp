@@ -137,7 +137,51 @@ void MapView::UpdateToolState()
 void MapView::UpdateView()
 {
 	m_editor->UpdateView();
+	UpdateWidgets();
+}
+
+
+void MapView::UpdateTileSetContents(shared_ptr<TileSet> tileSet)
+{
+	m_editor->UpdateTileSetContents(tileSet);
+	UpdateWidgets();
+}
+
+
+void MapView::UpdateTileSetTiles(shared_ptr<TileSet> tileSet, const set<size_t>& tiles, uint16_t frame)
+{
+	// Only the changed tiles are decoded again, the tile selection widgets are kept
+	m_editor->UpdateTileSetContents(tileSet);
+	m_tiles->UpdateTileSetTiles(tileSet, tiles, frame);
+}
+
+
+void MapView::UpdatePaletteContents(shared_ptr<Palette> palette)
+{
+	m_editor->UpdatePaletteContents(palette);
+	UpdateWidgets();
+}
 
+
+bool MapView::DependsOnTileSet(shared_ptr<TileSet> tileSet)
+{
+	return m_map->UsesTileSet(tileSet) || m_tiles->ShowsTileSet(tileSet);
+}
+
+
+bool MapView::DependsOnSprite(shared_ptr<Sprite> sprite)
+{
+	for (auto& i : m_map->GetActors())
+	{
+		if (i->GetType() && (i->GetType()->GetEditorSprite() == sprite))
+			return true;
+	}
+	return false;
+}
+
+
+void MapView::UpdateWidgets()
+{
 	auto sinceLastUpdate = chrono::steady_clock::now() - m_lastUpdate;
 	double t = chrono::duration_cast<chrono::milliseconds>(sinceLastUpdate).count();
 	if (m_firstUpdate || (t > 250))
@@ -41,10 +41,17 @@ class MapView: public EditorView
 	std::chrono::steady_clock::time_point m_lastUpdate;
 	bool m_firstUpdate;
 
+	void UpdateWidgets();
+
 public:
 	MapView(MainWindow* parent, std::shared_ptr<Project> project, std::shared_ptr<Map> map);
 
 	void UpdateView();
+	void UpdateTileSetContents(std::shared_ptr<TileSet> tileSet);
+	void UpdateTileSetTiles(std::shared_ptr<TileSet> tileSet, const std::set<size_t>& tiles, uint16_t frame);
+	void UpdatePaletteContents(std::shared_ptr<Palette> palette);
+	bool DependsOnTileSet(std::shared_ptr<TileSet> tileSet);
+	bool DependsOnSprite(std::shared_ptr<Sprite> sprite);
 	void UpdateToolState();
 
 	std::shared_ptr<Map> GetMap() const { return m_map; }
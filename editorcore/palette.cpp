@@ -2,11 +2,24 @@
 #include "palette.h"
 #include "project.h"
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define PALETTE_SSE2
+#include <emmintrin.h>
+#endif
+#ifdef __AVX2__
+#define PALETTE_AVX2
+#include <immintrin.h>
+#endif
+
 using namespace std;
 
 
+atomic<uint64_t> Palette::m_nextGeneration(1);
+
+
 Palette::Palette()
 {
+	m_generation = m_nextGeneration++;
 	m_id = QUuid::createUuid().toString().toStdString();
 	m_entries.resize(16);
 }
@@ -14,12 +27,21 @@ Palette::Palette()
 
 Palette::Palette(const Palette& other)
 {
+	m_generation = m_nextGeneration++;
 	m_id = QUuid::createUuid().toString().toStdString();
 	m_name = other.m_name;
 	m_entries = other.m_entries;
 }
 
 
+shared_ptr<Palette> Palette::CreateSnapshot() const
+{
+	shared_ptr<Palette> result = make_shared<Palette>();
+	*result = *this;
+	return result;
+}
+
+
 uint16_t Palette::GetEntry(size_t i)
 {
 	if (i >= m_entries.size())
@@ -33,12 +55,20 @@ void Palette::SetEntry(size_t i, uint16_t value)
 	if (i >= m_entries.size())
 		return;
 	m_entries[i] = value;
+	m_generation = m_nextGeneration++;
 }
 
 
 void Palette::SetEntryCount(size_t count)
 {
 	m_entries.resize(count);
+	m_generation = m_nextGeneration++;
+}
+
+
+size_t Palette::GetMemoryUsage() const
+{
+	return sizeof(Palette) + m_entries.size() * sizeof(uint16_t);
 }
 
 
@@ -146,3 +176,174 @@ uint16_t Palette::BlendColor(uint16_t a, uint16_t b, uint8_t alpha)
 		((b & 0x1f) * (16 - alpha))) >> 4;
 	return red | green | blue;
 }
+
+
+// Batch versions of the color operations. Each channel is unpacked into its own 16-bit lane, where the
+// clamping done by the scalar versions reduces to a saturating add, a saturating subtract, or a minimum
+// against the largest 5-bit value. This gives results identical to the scalar functions above.
+#ifdef PALETTE_SSE2
+struct PaletteSSE2Vector
+{
+	typedef __m128i Type;
+	static const size_t Width = 8;
+
+	static Type Load(const uint16_t* p) { return _mm_loadu_si128((const __m128i*)p); }
+	static void Store(uint16_t* p, Type v) { _mm_storeu_si128((__m128i*)p, v); }
+	static Type Set(uint16_t x) { return _mm_set1_epi16((short)x); }
+	static Type And(Type a, Type b) { return _mm_and_si128(a, b); }
+	static Type Or(Type a, Type b) { return _mm_or_si128(a, b); }
+	static Type Add(Type a, Type b) { return _mm_add_epi16(a, b); }
+	static Type SubSaturate(Type a, Type b) { return _mm_subs_epu16(a, b); }
+	static Type Mul(Type a, Type b) { return _mm_mullo_epi16(a, b); }
+	static Type Min(Type a, Type b) { return _mm_min_epi16(a, b); }
+	static Type ShiftLeft(Type a, int n) { return _mm_sll_epi16(a, _mm_cvtsi32_si128(n)); }
+	static Type ShiftRight(Type a, int n) { return _mm_srl_epi16(a, _mm_cvtsi32_si128(n)); }
+};
+#endif
+
+#ifdef PALETTE_AVX2
+struct PaletteAVX2Vector
+{
+	typedef __m256i Type;
+	static const size_t Width = 16;
+
+	static Type Load(const uint16_t* p) { return _mm256_loadu_si256((const __m256i*)p); }
+	static void Store(uint16_t* p, Type v) { _mm256_storeu_si256((__m256i*)p, v); }
+	static Type Set(uint16_t x) { return _mm256_set1_epi16((short)x); }
+	static Type And(Type a, Type b) { return _mm256_and_si256(a, b); }
+	static Type Or(Type a, Type b) { return _mm256_or_si256(a, b); }
+	static Type Add(Type a, Type b) { return _mm256_add_epi16(a, b); }
+	static Type SubSaturate(Type a, Type b) { return _mm256_subs_epu16(a, b); }
+	static Type Mul(Type a, Type b) { return _mm256_mullo_epi16(a, b); }
+	static Type Min(Type a, Type b) { return _mm256_min_epi16(a, b); }
+	static Type ShiftLeft(Type a, int n) { return _mm256_sll_epi16(a, _mm_cvtsi32_si128(n)); }
+	static Type ShiftRight(Type a, int n) { return _mm256_srl_epi16(a, _mm_cvtsi32_si128(n)); }
+};
+#endif
+
+template <class V>
+static inline typename V::Type GetChannel(typename V::Type color, int shift)
+{
+	return V::And(V::ShiftRight(color, shift), V::Set(0x1f));
+}
+
+
+template <class V>
+static inline typename V::Type CombineChannels(typename V::Type red, typename V::Type green, typename V::Type blue)
+{
+	return V::Or(V::Or(V::ShiftLeft(red, 10), V::ShiftLeft(green, 5)), blue);
+}
+
+
+template <class V>
+struct AddColorVectorOp
+{
+	static typename V::Type Apply(typename V::Type a, typename V::Type b, uint8_t)
+	{
+		typename V::Type max = V::Set(0x1f);
+		return CombineChannels<V>(V::Min(V::Add(GetChannel<V>(a, 10), GetChannel<V>(b, 10)), max),
+			V::Min(V::Add(GetChannel<V>(a, 5), GetChannel<V>(b, 5)), max),
+			V::Min(V::Add(GetChannel<V>(a, 0), GetChannel<V>(b, 0)), max));
+	}
+};
+
+
+template <class V>
+struct SubColorVectorOp
+{
+	static typename V::Type Apply(typename V::Type a, typename V::Type b, uint8_t)
+	{
+		return CombineChannels<V>(V::SubSaturate(GetChannel<V>(a, 10), GetChannel<V>(b, 10)),
+			V::SubSaturate(GetChannel<V>(a, 5), GetChannel<V>(b, 5)),
+			V::SubSaturate(GetChannel<V>(a, 0), GetChannel<V>(b, 0)));
+	}
+};
+
+
+template <class V>
+struct MultiplyColorVectorOp
+{
+	static typename V::Type Apply(typename V::Type a, typename V::Type b, uint8_t)
+	{
+		typename V::Type max = V::Set(0x1f);
+		return CombineChannels<V>(
+			V::Min(V::ShiftRight(V::Mul(GetChannel<V>(a, 10), GetChannel<V>(b, 10)), 4), max),
+			V::Min(V::ShiftRight(V::Mul(GetChannel<V>(a, 5), GetChannel<V>(b, 5)), 4), max),
+			V::Min(V::ShiftRight(V::Mul(GetChannel<V>(a, 0), GetChannel<V>(b, 0)), 4), max));
+	}
+};
+
+
+template <class V>
+struct BlendColorVectorOp
+{
+	static typename V::Type Apply(typename V::Type a, typename V::Type b, uint8_t alpha)
+	{
+		alpha &= 15;
+		typename V::Type alphaA = V::Set(alpha);
+		typename V::Type alphaB = V::Set(16 - alpha);
+		return CombineChannels<V>(
+			V::ShiftRight(V::Add(V::Mul(GetChannel<V>(a, 10), alphaA), V::Mul(GetChannel<V>(b, 10), alphaB)), 4),
+			V::ShiftRight(V::Add(V::Mul(GetChannel<V>(a, 5), alphaA), V::Mul(GetChannel<V>(b, 5), alphaB)), 4),
+			V::ShiftRight(V::Add(V::Mul(GetChannel<V>(a, 0), alphaA), V::Mul(GetChannel<V>(b, 0), alphaB)), 4));
+	}
+};
+
+
+template <class V, template <class> class Op>
+static size_t ApplyColorsVector(uint16_t* result, const uint16_t* a, const uint16_t* b, uint8_t alpha,
+	size_t count)
+{
+	size_t i = 0;
+	for (; (i + V::Width) <= count; i += V::Width)
+		V::Store(&result[i], Op<V>::Apply(V::Load(&a[i]), V::Load(&b[i]), alpha));
+	return i;
+}
+
+
+template <template <class> class Op>
+static size_t ApplyColors(uint16_t* result, const uint16_t* a, const uint16_t* b, uint8_t alpha, size_t count)
+{
+	// Returns the number of pixels processed, the remainder is handled by the scalar version
+	size_t i = 0;
+#ifdef PALETTE_AVX2
+	i += ApplyColorsVector<PaletteAVX2Vector, Op>(result, a, b, alpha, count);
+#endif
+#ifdef PALETTE_SSE2
+	i += ApplyColorsVector<PaletteSSE2Vector, Op>(&result[i], &a[i], &b[i], alpha, count - i);
+#endif
+	(void)result;
+	(void)a;
+	(void)b;
+	(void)alpha;
+	(void)count;
+	return i;
+}
+
+
+void Palette::AddColors(uint16_t* result, const uint16_t* a, const uint16_t* b, size_t count)
+{
+	for (size_t i = ApplyColors<AddColorVectorOp>(result, a, b, 0, count); i < count; i++)
+		result[i] = AddColor(a[i], b[i]);
+}
+
+
+void Palette::SubColors(uint16_t* result, const uint16_t* a, const uint16_t* b, size_t count)
+{
+	for (size_t i = ApplyColors<SubColorVectorOp>(result, a, b, 0, count); i < count; i++)
+		result[i] = SubColor(a[i], b[i]);
+}
+
+
+void Palette::MultiplyColors(uint16_t* result, const uint16_t* a, const uint16_t* b, size_t count)
+{
+	for (size_t i = ApplyColors<MultiplyColorVectorOp>(result, a, b, 0, count); i < count; i++)
+		result[i] = MultiplyColor(a[i], b[i]);
+}
+
+
+void Palette::BlendColors(uint16_t* result, const uint16_t* a, const uint16_t* b, uint8_t alpha, size_t count)
+{
+	for (size_t i = ApplyColors<BlendColorVectorOp>(result, a, b, alpha, count); i < count; i++)
+		result[i] = BlendColor(a[i], b[i], alpha);
+}
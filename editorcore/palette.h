@@ -3,6 +3,7 @@
 #include <string>
 #include <vector>
 #include <memory>
+#include <atomic>
 #include <inttypes.h>
 #include "json/json.h"
 
@@ -14,10 +15,16 @@ class Palette
 	std::vector<uint16_t> m_entries;
 	std::string m_id;
 
+	uint64_t m_generation;
+	static std::atomic<uint64_t> m_nextGeneration;
+
 public:
 	Palette();
 	Palette(const Palette& other);
 
+	// Copy with the same id for saving in the background
+	std::shared_ptr<Palette> CreateSnapshot() const;
+
 	const std::string& GetName() const { return m_name; }
 	void SetName(const std::string& name) { m_name = name; }
 
@@ -26,6 +33,10 @@ public:
 	uint16_t GetEntry(size_t i);
 	void SetEntry(size_t i, uint16_t value);
 	void SetEntryCount(size_t count);
+	size_t GetMemoryUsage() const;
+
+	// Generation changes whenever an entry is modified
+	uint64_t GetGeneration() const { return m_generation; }
 
 	const std::string& GetId() const { return m_id; }
 	Json::Value Serialize();
@@ -39,4 +50,10 @@ public:
 	static uint16_t SubColor(uint16_t a, uint16_t b);
 	static uint16_t MultiplyColor(uint16_t a, uint16_t b);
 	static uint16_t BlendColor(uint16_t a, uint16_t b, uint8_t alpha);
+
+	// Apply the color operations above to whole rows of pixels, result may be the same as a or b
+	static void AddColors(uint16_t* result, const uint16_t* a, const uint16_t* b, size_t count);
+	static void SubColors(uint16_t* result, const uint16_t* a, const uint16_t* b, size_t count);
+	static void MultiplyColors(uint16_t* result, const uint16_t* a, const uint16_t* b, size_t count);
+	static void BlendColors(uint16_t* result, const uint16_t* a, const uint16_t* b, uint8_t alpha, size_t count);
 };
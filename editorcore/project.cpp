@@ -1,5 +1,14 @@
 #include <QMessageBox>
 #include <QDir>
+#include <QFile>
+#include <QSaveFile>
+#include <QCryptographicHash>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QSemaphore>
+#include <QElapsedTimer>
+#include <functional>
+#include <algorithm>
 #include <cassert>
 #include <set>
 #include "project.h"
@@ -8,6 +17,89 @@
 using namespace std;
 
 
+class ProjectFileTask: public QRunnable
+{
+	function<void()> m_func;
+	shared_ptr<QSemaphore> m_done;
+
+public:
+	ProjectFileTask(const function<void()>& func, const shared_ptr<QSemaphore>& done): m_func(func), m_done(done) {}
+
+	virtual void run() override
+	{
+		m_func();
+		m_done->release();
+	}
+};
+
+
+// Reads and parses the files listed in a project manifest on the thread pool. Assets are deserialized in
+// dependency order, so each asset type only waits for its own files while later ones are still loading.
+class ProjectFileLoader
+{
+public:
+	struct File
+	{
+		QString name;
+		Json::Value data;
+		QByteArray hash;
+		bool valid = false;
+	};
+
+	typedef function<bool(const QString& name, Json::Value& data, QByteArray* hash)> ReadFunction;
+
+private:
+	struct Group
+	{
+		vector<shared_ptr<File>> files;
+		shared_ptr<QSemaphore> done;
+	};
+
+	map<string, Group> m_groups;
+	QElapsedTimer m_timer;
+	vector<pair<string, double>> m_timings;
+
+public:
+	ProjectFileLoader(const Json::Value& manifest, const vector<string>& keys, const ReadFunction& read)
+	{
+		m_timer.start();
+
+		// Tasks only reference shared state, so they can finish safely if loading is abandoned
+		for (auto& key : keys)
+		{
+			Group& group = m_groups[key];
+			group.done = make_shared<QSemaphore>();
+			for (auto& i : manifest[key])
+			{
+				shared_ptr<File> file = make_shared<File>();
+				file->name = QString::fromStdString(i.asString());
+				group.files.push_back(file);
+				QThreadPool::globalInstance()->start(new ProjectFileTask([=]() {
+					file->valid = read(file->name, file->data, &file->hash);
+				}, group.done));
+			}
+		}
+	}
+
+	const vector<shared_ptr<File>>& WaitForFiles(const string& key)
+	{
+		Group& group = m_groups[key];
+		if (group.done)
+			group.done->acquire((int)group.files.size());
+		group.done.reset();
+		return group.files;
+	}
+
+	void EndStage(const string& name)
+	{
+		m_timings.push_back(pair<string, double>(name, (double)m_timer.nsecsElapsed() / 1000000.0));
+		m_timer.restart();
+	}
+
+	const vector<pair<string, double>>& GetTimings() const { return m_timings; }
+};
+
+
 Project::Project()
 {
 	shared_ptr<Palette> palette = make_shared<Palette>();
@@ -31,6 +123,152 @@ Project::Project()
 	palette->SetEntry(15, Palette::FromRGB32(0xE0E0E0));
 	m_palettes[palette->GetName()] = palette;
 	m_palettesById[palette->GetId()] = palette;
+
+	m_mapTileFormat = MAP_LAYER_TILE_FORMAT_PACKED;
+}
+
+
+Project::~Project()
+{
+	// Assets can outlive the project in the undo history, they must not report to it once it is gone
+	for (auto& i : m_tileSets)
+		i.second->SetPaletteUsageCallback(nullptr);
+	for (auto& i : m_effectLayers)
+		i.second->SetTileSetUsageCallback(nullptr);
+	for (auto& i : m_maps)
+	{
+		i.second->SetLayerCallback(nullptr);
+		for (auto& j : i.second->GetLayers())
+		{
+			if (!j->IsEffectLayer())
+				j->SetTileSetUsageCallback(nullptr);
+		}
+	}
+}
+
+
+template <class K, class V>
+static void AddToIndex(map<K, set<V>>& index, const K& key, const V& value)
+{
+	if (key)
+		index[key].insert(value);
+}
+
+
+template <class K, class V>
+static void RemoveFromIndex(map<K, set<V>>& index, const K& key, const V& value)
+{
+	auto i = index.find(key);
+	if (i == index.end())
+		return;
+	i->second.erase(value);
+	if (i->second.empty())
+		index.erase(i);
+}
+
+
+// The index is ordered by pointer, results are sorted by name so that lists shown to the user are stable
+template <class T>
+static vector<shared_ptr<T>> SortByName(const set<shared_ptr<T>>& assets)
+{
+	vector<shared_ptr<T>> result(assets.begin(), assets.end());
+	sort(result.begin(), result.end(), [](const shared_ptr<T>& a, const shared_ptr<T>& b) {
+		return a->GetName() < b->GetName();
+	});
+	return result;
+}
+
+
+void Project::AttachTileSet(const shared_ptr<TileSet>& tileSet)
+{
+	// Tile sets own the callback, so it must not keep them alive
+	weak_ptr<TileSet> weakTileSet = tileSet;
+	tileSet->SetPaletteUsageCallback([this, weakTileSet](const shared_ptr<Palette>& palette, bool used) {
+		shared_ptr<TileSet> tileSet = weakTileSet.lock();
+		if (!tileSet)
+			return;
+		if (used)
+			AddToIndex(m_tileSetsByPalette, palette, tileSet);
+		else
+			RemoveFromIndex(m_tileSetsByPalette, palette, tileSet);
+	});
+	for (auto& i : tileSet->GetUsedPalettes())
+		AddToIndex(m_tileSetsByPalette, i, tileSet);
+}
+
+
+void Project::DetachTileSet(const shared_ptr<TileSet>& tileSet)
+{
+	tileSet->SetPaletteUsageCallback(nullptr);
+	for (auto& i : tileSet->GetUsedPalettes())
+		RemoveFromIndex(m_tileSetsByPalette, i, tileSet);
+}
+
+
+void Project::AttachLayer(const shared_ptr<MapLayer>& layer)
+{
+	weak_ptr<MapLayer> weakLayer = layer;
+	layer->SetTileSetUsageCallback([this, weakLayer](const shared_ptr<TileSet>& tileSet, bool used) {
+		shared_ptr<MapLayer> layer = weakLayer.lock();
+		if (!layer)
+			return;
+		if (used)
+			AddToIndex(m_layersByTileSet, tileSet, layer);
+		else
+			RemoveFromIndex(m_layersByTileSet, tileSet, layer);
+	});
+	for (auto& i : layer->GetUsedTileSets())
+		AddToIndex(m_layersByTileSet, i, layer);
+}
+
+
+void Project::DetachLayer(const shared_ptr<MapLayer>& layer)
+{
+	layer->SetTileSetUsageCallback(nullptr);
+	for (auto& i : layer->GetUsedTileSets())
+		RemoveFromIndex(m_layersByTileSet, i, layer);
+}
+
+
+void Project::AttachMap(const shared_ptr<Map>& map)
+{
+	weak_ptr<Map> weakMap = map;
+	map->SetLayerCallback([this, weakMap](const shared_ptr<MapLayer>& layer, bool inserted) {
+		shared_ptr<Map> map = weakMap.lock();
+		if (!map)
+			return;
+		if (inserted)
+			AddLayerToMap(map, layer);
+		else
+			RemoveLayerFromMap(map, layer);
+	});
+	for (auto& i : map->GetLayers())
+		AddLayerToMap(map, i);
+}
+
+
+void Project::DetachMap(const shared_ptr<Map>& map)
+{
+	map->SetLayerCallback(nullptr);
+	for (auto& i : map->GetLayers())
+		RemoveLayerFromMap(map, i);
+}
+
+
+void Project::AddLayerToMap(const shared_ptr<Map>& map, const shared_ptr<MapLayer>& layer)
+{
+	// Effect layers are indexed by the project whether or not a map uses them
+	AddToIndex(m_mapsByLayer, layer, map);
+	if (!layer->IsEffectLayer())
+		AttachLayer(layer);
+}
+
+
+void Project::RemoveLayerFromMap(const shared_ptr<Map>& map, const shared_ptr<MapLayer>& layer)
+{
+	RemoveFromIndex(m_mapsByLayer, layer, map);
+	if (!layer->IsEffectLayer())
+		DetachLayer(layer);
 }
 
 
@@ -77,24 +315,123 @@ void Project::DeletePalette(std::shared_ptr<Palette> palette)
 }
 
 
+const map<string, shared_ptr<TileSet>>& Project::GetTileSets()
+{
+	LoadAllTileSets();
+	return m_tileSets;
+}
+
+
+map<string, string> Project::GetTileSetIdsByName() const
+{
+	map<string, string> result;
+	for (auto& i : m_tileSets)
+		result[i.first] = i.second->GetId();
+	for (auto& i : m_unloadedTileSets)
+		result[i.second.name] = i.first;
+	return result;
+}
+
+
+shared_ptr<TileSet> Project::LoadTileSet(const string& id)
+{
+	auto i = m_unloadedTileSets.find(id);
+	if (i == m_unloadedTileSets.end())
+		return shared_ptr<TileSet>();
+
+	Json::Value data;
+	QByteArray hash;
+	if (!ReadProjectFile(m_assetPath, i->second.fileName, data, &hash))
+	{
+		i->second.error = QString("Unable to read tile set '") + i->second.fileName + QString("'.");
+		return shared_ptr<TileSet>();
+	}
+
+	shared_ptr<TileSet> tileSet = TileSet::Deserialize(shared_from_this(), data);
+	if (!tileSet)
+	{
+		i->second.error = QString("Tile set '") + QString::fromStdString(i->second.name) +
+			QString("' could not be read from project file.");
+		return shared_ptr<TileSet>();
+	}
+
+	m_savedFiles[QDir(m_assetPath).absoluteFilePath(i->second.fileName)] = hash;
+	m_unloadedTileSets.erase(i);
+	m_tileSets[tileSet->GetName()] = tileSet;
+	m_tileSetsById[tileSet->GetId()] = tileSet;
+	AttachTileSet(tileSet);
+
+	// Associated tile sets may refer back to this one, so it is resolved once it can be found
+	tileSet->ResolveInitialAssociatedTileSets(shared_from_this());
+	return tileSet;
+}
+
+
+void Project::LoadAllTileSets()
+{
+	vector<string> ids;
+	for (auto& i : m_unloadedTileSets)
+		ids.push_back(i.first);
+	for (auto& i : ids)
+		LoadTileSet(i);
+}
+
+
+void Project::LoadTileSetsDependingOn(const set<string>& ids)
+{
+	vector<string> tileSetIds;
+	for (auto& i : m_unloadedTileSets)
+	{
+		for (auto& j : i.second.dependencies)
+		{
+			if (ids.count(j) != 0)
+			{
+				tileSetIds.push_back(i.first);
+				break;
+			}
+		}
+	}
+	for (auto& i : tileSetIds)
+		LoadTileSet(i);
+}
+
+
+bool Project::IsTileSetNameUsed(const string& name) const
+{
+	if (m_tileSets.find(name) != m_tileSets.end())
+		return true;
+	for (auto& i : m_unloadedTileSets)
+	{
+		if (i.second.name == name)
+			return true;
+	}
+	return false;
+}
+
+
 shared_ptr<TileSet> Project::GetTileSetByName(const string& name)
 {
 	auto i = m_tileSets.find(name);
-	if (i == m_tileSets.end())
-		return shared_ptr<TileSet>();
-	return i->second;
+	if (i != m_tileSets.end())
+		return i->second;
+	for (auto& j : m_unloadedTileSets)
+	{
+		if (j.second.name == name)
+			return LoadTileSet(j.first);
+	}
+	return shared_ptr<TileSet>();
 }
 
 
 bool Project::AddTileSet(shared_ptr<TileSet> tileSet)
 {
 	string name = tileSet->GetName();
-	auto i = m_tileSets.find(name);
-	if (i != m_tileSets.end())
+	if (IsTileSetNameUsed(name))
 		return false;
 	assert(m_tileSetsById.find(tileSet->GetId()) == m_tileSetsById.end());
 	m_tileSets[name] = tileSet;
 	m_tileSetsById[tileSet->GetId()] = tileSet;
+	AttachTileSet(tileSet);
 	return true;
 }
 
@@ -103,8 +440,7 @@ bool Project::RenameTileSet(shared_ptr<TileSet> tileSet, const string& name)
 {
 	if (name == tileSet->GetName())
 		return true;
-	auto i = m_tileSets.find(name);
-	if (i != m_tileSets.end())
+	if (IsTileSetNameUsed(name))
 		return false;
 	m_tileSets.erase(tileSet->GetName());
 	tileSet->SetName(name);
@@ -117,6 +453,7 @@ void Project::DeleteTileSet(shared_ptr<TileSet> tileSet)
 {
 	m_tileSets.erase(tileSet->GetName());
 	m_tileSetsById.erase(tileSet->GetId());
+	DetachTileSet(tileSet);
 }
 
 
@@ -138,6 +475,7 @@ bool Project::AddEffectLayer(shared_ptr<MapLayer> layer)
 	assert(m_effectLayersById.find(layer->GetId()) == m_effectLayersById.end());
 	m_effectLayers[name] = layer;
 	m_effectLayersById[layer->GetId()] = layer;
+	AttachLayer(layer);
 	return true;
 }
 
@@ -160,27 +498,135 @@ void Project::DeleteEffectLayer(shared_ptr<MapLayer> layer)
 {
 	m_effectLayers.erase(layer->GetName());
 	m_effectLayersById.erase(layer->GetId());
+	DetachLayer(layer);
+}
+
+
+const map<string, shared_ptr<Map>>& Project::GetMaps()
+{
+	LoadAllMaps();
+	return m_maps;
+}
+
+
+map<string, string> Project::GetMapIdsByName() const
+{
+	map<string, string> result;
+	for (auto& i : m_maps)
+		result[i.first] = i.second->GetId();
+	for (auto& i : m_unloadedMaps)
+		result[i.second.name] = i.first;
+	return result;
+}
+
+
+shared_ptr<Map> Project::LoadMap(const string& id)
+{
+	auto i = m_unloadedMaps.find(id);
+	if (i == m_unloadedMaps.end())
+		return shared_ptr<Map>();
+
+	Json::Value data;
+	QByteArray hash;
+	if (!ReadProjectFile(m_assetPath, i->second.fileName, data, &hash))
+	{
+		i->second.error = QString("Unable to read map '") + i->second.fileName + QString("'.");
+		return shared_ptr<Map>();
+	}
+
+	// A tile set that cannot be loaded would leave the map's tiles from it empty, and saving would lose them
+	for (auto& j : i->second.dependencies)
+	{
+		if ((m_unloadedTileSets.count(j) != 0) && !LoadTileSet(j))
+		{
+			i->second.error = QString("Map '") + QString::fromStdString(i->second.name) +
+				QString("' uses a tile set that could not be loaded. ") + m_unloadedTileSets[j].error;
+			return shared_ptr<Map>();
+		}
+	}
+
+	shared_ptr<Map> map = Map::Deserialize(shared_from_this(), data);
+	if (!map)
+	{
+		i->second.error = QString("Map '") + QString::fromStdString(i->second.name) +
+			QString("' could not be read from project file.");
+		return shared_ptr<Map>();
+	}
+
+	m_savedFiles[QDir(m_assetPath).absoluteFilePath(i->second.fileName)] = hash;
+	m_unloadedMaps.erase(i);
+	m_maps[map->GetName()] = map;
+	m_mapsById[map->GetId()] = map;
+	AttachMap(map);
+	return map;
+}
+
+
+void Project::LoadAllMaps()
+{
+	vector<string> ids;
+	for (auto& i : m_unloadedMaps)
+		ids.push_back(i.first);
+	for (auto& i : ids)
+		LoadMap(i);
+}
+
+
+void Project::LoadMapsDependingOn(const set<string>& ids)
+{
+	vector<string> mapIds;
+	for (auto& i : m_unloadedMaps)
+	{
+		for (auto& j : i.second.dependencies)
+		{
+			if (ids.count(j) != 0)
+			{
+				mapIds.push_back(i.first);
+				break;
+			}
+		}
+	}
+	for (auto& i : mapIds)
+		LoadMap(i);
+}
+
+
+bool Project::IsMapNameUsed(const string& name) const
+{
+	if (m_maps.find(name) != m_maps.end())
+		return true;
+	for (auto& i : m_unloadedMaps)
+	{
+		if (i.second.name == name)
+			return true;
+	}
+	return false;
 }
 
 
 shared_ptr<Map> Project::GetMapByName(const string& name)
 {
 	auto i = m_maps.find(name);
-	if (i == m_maps.end())
-		return shared_ptr<Map>();
-	return i->second;
+	if (i != m_maps.end())
+		return i->second;
+	for (auto& j : m_unloadedMaps)
+	{
+		if (j.second.name == name)
+			return LoadMap(j.first);
+	}
+	return shared_ptr<Map>();
 }
 
 
 bool Project::AddMap(shared_ptr<Map> map)
 {
 	string name = map->GetName();
-	auto i = m_maps.find(name);
-	if (i != m_maps.end())
+	if (IsMapNameUsed(name))
 		return false;
 	assert(m_mapsById.find(map->GetId()) == m_mapsById.end());
 	m_maps[name] = map;
 	m_mapsById[map->GetId()] = map;
+	AttachMap(map);
 	return true;
 }
 
@@ -189,8 +635,7 @@ bool Project::RenameMap(shared_ptr<Map> map, const string& name)
 {
 	if (name == map->GetName())
 		return true;
-	auto i = m_maps.find(name);
-	if (i != m_maps.end())
+	if (IsMapNameUsed(name))
 		return false;
 	m_maps.erase(map->GetName());
 	map->SetName(name);
@@ -203,6 +648,7 @@ void Project::DeleteMap(shared_ptr<Map> map)
 {
 	m_maps.erase(map->GetName());
 	m_mapsById.erase(map->GetId());
+	DetachMap(map);
 }
 
 
@@ -281,6 +727,9 @@ bool Project::RenameActorType(shared_ptr<ActorType> actorType, const string& nam
 	m_actorTypes.erase(actorType->GetName());
 	actorType->SetName(name);
 	m_actorTypes[name] = actorType;
+
+	// Maps store the name of the actor types they use
+	LoadMapsDependingOn(set<string>{actorType->GetId()});
 	return true;
 }
 
@@ -294,13 +743,17 @@ void Project::DeleteActorType(shared_ptr<ActorType> actorType)
 
 vector<shared_ptr<TileSet>> Project::GetTileSetsUsingPalette(shared_ptr<Palette> palette)
 {
-	vector<shared_ptr<TileSet>> result;
-	for (auto& i : m_tileSets)
-	{
-		if (i.second->UsesPalette(palette))
-			result.push_back(i.second);
-	}
-	return result;
+	LoadTileSetsDependingOn(set<string>{palette->GetId()});
+	return GetLoadedTileSetsUsingPalette(palette);
+}
+
+
+vector<shared_ptr<TileSet>> Project::GetLoadedTileSetsUsingPalette(shared_ptr<Palette> palette) const
+{
+	auto i = m_tileSetsByPalette.find(palette);
+	if (i == m_tileSetsByPalette.end())
+		return vector<shared_ptr<TileSet>>();
+	return SortByName(i->second);
 }
 
 
@@ -318,40 +771,216 @@ vector<shared_ptr<Sprite>> Project::GetSpritesUsingPalette(shared_ptr<Palette> p
 
 vector<shared_ptr<MapLayer>> Project::GetEffectLayersUsingTileSet(shared_ptr<TileSet> tileSet)
 {
-	vector<shared_ptr<MapLayer>> result;
-	for (auto& i : m_effectLayers)
+	set<shared_ptr<MapLayer>> layers;
+	auto i = m_layersByTileSet.find(tileSet);
+	if (i != m_layersByTileSet.end())
 	{
-		if (i.second->UsesTileSet(tileSet))
-			result.push_back(i.second);
+		for (auto& j : i->second)
+		{
+			if (j->IsEffectLayer())
+				layers.insert(j);
+		}
 	}
-	return result;
+	return SortByName(layers);
 }
 
 
 vector<shared_ptr<Map>> Project::GetMapsUsingTileSet(shared_ptr<TileSet> tileSet)
 {
-	vector<shared_ptr<Map>> result;
-	for (auto& i : m_maps)
+	set<string> ids{tileSet->GetId()};
+	for (auto& i : GetEffectLayersUsingTileSet(tileSet))
+		ids.insert(i->GetId());
+	LoadMapsDependingOn(ids);
+
+	// Maps use a tile set through their own layers or through effect layers
+	set<shared_ptr<Map>> maps;
+	auto i = m_layersByTileSet.find(tileSet);
+	if (i != m_layersByTileSet.end())
 	{
-		if (i.second->UsesTileSet(tileSet))
-			result.push_back(i.second);
+		for (auto& j : i->second)
+		{
+			auto k = m_mapsByLayer.find(j);
+			if (k != m_mapsByLayer.end())
+				maps.insert(k->second.begin(), k->second.end());
+		}
 	}
-	return result;
+	return SortByName(maps);
 }
 
 
 vector<shared_ptr<Map>> Project::GetMapsUsingEffectLayer(shared_ptr<MapLayer> layer)
 {
-	vector<shared_ptr<Map>> result;
-	for (auto& i : m_maps)
+	LoadMapsDependingOn(set<string>{layer->GetId()});
+
+	auto i = m_mapsByLayer.find(layer);
+	if (i == m_mapsByLayer.end())
+		return vector<shared_ptr<Map>>();
+	return SortByName(i->second);
+}
+
+
+QString Project::GetLoadError(const string& id) const
+{
+	auto i = m_unloadedTileSets.find(id);
+	if (i != m_unloadedTileSets.end())
+		return i->second.error;
+	i = m_unloadedMaps.find(id);
+	if (i != m_unloadedMaps.end())
+		return i->second.error;
+	return QString();
+}
+
+
+QStringList Project::GetLoadErrors() const
+{
+	QStringList result;
+	for (auto* assets : {&m_unloadedTileSets, &m_unloadedMaps})
 	{
-		if (i.second->UsesEffectLayer(layer))
-			result.push_back(i.second);
+		for (auto& i : *assets)
+		{
+			if (i.second.error.size() != 0)
+				result.append(i.second.error);
+		}
 	}
 	return result;
 }
 
 
+bool Project::IsUsedByUnloadedAsset(const string& id) const
+{
+	for (auto* assets : {&m_unloadedTileSets, &m_unloadedMaps})
+	{
+		for (auto& i : *assets)
+		{
+			if (find(i.second.dependencies.begin(), i.second.dependencies.end(), id) != i.second.dependencies.end())
+				return true;
+		}
+	}
+	return false;
+}
+
+
+QString Project::GetAssetDescription(const string& id) const
+{
+	string type, name;
+	if (m_palettesById.count(id) != 0)
+	{
+		type = "Palette";
+		name = m_palettesById.at(id)->GetName();
+	}
+	else if (m_tileSetsById.count(id) != 0)
+	{
+		type = "Tile set";
+		name = m_tileSetsById.at(id)->GetName();
+	}
+	else if (m_unloadedTileSets.count(id) != 0)
+	{
+		type = "Tile set";
+		name = m_unloadedTileSets.at(id).name;
+	}
+	else if (m_effectLayersById.count(id) != 0)
+	{
+		type = "Effect layer";
+		name = m_effectLayersById.at(id)->GetName();
+	}
+	else if (m_mapsById.count(id) != 0)
+	{
+		type = "Map";
+		name = m_mapsById.at(id)->GetName();
+	}
+	else if (m_unloadedMaps.count(id) != 0)
+	{
+		type = "Map";
+		name = m_unloadedMaps.at(id).name;
+	}
+	else if (m_spritesById.count(id) != 0)
+	{
+		type = "Sprite";
+		name = m_spritesById.at(id)->GetName();
+	}
+	else if (m_actorTypesById.count(id) != 0)
+	{
+		type = "Actor type";
+		name = m_actorTypesById.at(id)->GetName();
+	}
+	else
+	{
+		return QString();
+	}
+	return QString::fromStdString(type) + " '" + QString::fromStdString(name) + "'";
+}
+
+
+bool Project::LoadAllAssets()
+{
+	LoadAllTileSets();
+	LoadAllMaps();
+	return (m_unloadedTileSets.size() == 0) && (m_unloadedMaps.size() == 0);
+}
+
+
+bool Project::SetMapTileFormat(uint32_t format)
+{
+	if (format != m_mapTileFormat)
+	{
+		m_mapTileFormat = format;
+		LoadAllMaps();
+	}
+	return m_unloadedMaps.size() == 0;
+}
+
+
+bool Project::CheckUsageCounts() const
+{
+	for (auto& i : m_tileSets)
+	{
+		if (!i.second->CheckPaletteUsage())
+			return false;
+	}
+	for (auto& i : m_effectLayers)
+	{
+		if (!i.second->CheckTileSetUsage())
+			return false;
+	}
+	for (auto& i : m_maps)
+	{
+		for (auto& j : i.second->GetLayers())
+		{
+			if (!j->CheckTileSetUsage())
+				return false;
+		}
+	}
+
+	// Rebuild the reverse index from the loaded assets and compare it with the one kept up to date
+	map<shared_ptr<Palette>, set<shared_ptr<TileSet>>> tileSetsByPalette;
+	map<shared_ptr<TileSet>, set<shared_ptr<MapLayer>>> layersByTileSet;
+	map<shared_ptr<MapLayer>, set<shared_ptr<Map>>> mapsByLayer;
+	for (auto& i : m_tileSets)
+	{
+		for (auto& j : i.second->GetUsedPalettes())
+			AddToIndex(tileSetsByPalette, j, i.second);
+	}
+	for (auto& i : m_effectLayers)
+	{
+		for (auto& j : i.second->GetUsedTileSets())
+			AddToIndex(layersByTileSet, j, i.second);
+	}
+	for (auto& i : m_maps)
+	{
+		for (auto& j : i.second->GetLayers())
+		{
+			AddToIndex(mapsByLayer, j, i.second);
+			if (j->IsEffectLayer())
+				continue;
+			for (auto& k : j->GetUsedTileSets())
+				AddToIndex(layersByTileSet, k, j);
+		}
+	}
+	return (tileSetsByPalette == m_tileSetsByPalette) && (layersByTileSet == m_layersByTileSet) &&
+		(mapsByLayer == m_mapsByLayer);
+}
+
+
 QString Project::GetFileName(const string& name, const string& id, const QString& ext)
 {
 	QString result;
@@ -380,22 +1009,91 @@ QString Project::GetFileName(const string& name, const string& id, const QString
 }
 
 
+map<string, Project::UnloadedAsset> Project::ReadAssetIndex(const Json::Value& files, const Json::Value& index,
+	set<string>& indexedFiles)
+{
+	// Entries for files that are not in the manifest's file list are stale and ignored
+	set<string> fileNames;
+	for (auto& i : files)
+		fileNames.insert(i.asString());
+
+	map<string, UnloadedAsset> result;
+	for (auto& i : index)
+	{
+		string fileName = i["file"].asString();
+		string id = i["id"].asString();
+		if ((fileNames.count(fileName) == 0) || (indexedFiles.count(fileName) != 0) || (id.size() == 0) ||
+			(result.count(id) != 0))
+			continue;
+		UnloadedAsset entry;
+		entry.name = i["name"].asString();
+		entry.fileName = QString::fromStdString(fileName);
+		for (auto& j : i["dependencies"])
+			entry.dependencies.push_back(j.asString());
+		result[id] = entry;
+		indexedFiles.insert(fileName);
+	}
+	return result;
+}
+
+
+Json::Value Project::GetAssetIndexEntry(const string& id, const UnloadedAsset& asset)
+{
+	Json::Value entry(Json::objectValue);
+	entry["file"] = asset.fileName.toStdString();
+	entry["id"] = id;
+	entry["name"] = asset.name;
+	Json::Value dependencies(Json::arrayValue);
+	for (auto& i : asset.dependencies)
+		dependencies.append(i);
+	entry["dependencies"] = dependencies;
+	return entry;
+}
+
+
 bool Project::SaveProjectFile(const QString& path, const QString& name, const Json::Value& value)
 {
 	Json::StyledWriter writer;
 	string valueStr = writer.write(value);
 
+	// Skip writing files that have not changed since they were last written or read
 	QString fullPath = QDir(path).absoluteFilePath(name);
-	FILE* fp = fopen(fullPath.toStdString().c_str(), "w");
-	if (!fp)
-		return false;
+	QByteArray hash = QCryptographicHash::hash(QByteArray(valueStr.c_str(), (int)valueStr.size()),
+		QCryptographicHash::Sha1);
+	auto i = m_savedFiles.find(fullPath);
+	if ((i != m_savedFiles.end()) && (i->second == hash) && QFile::exists(fullPath))
+		return true;
 
-	if (fwrite(valueStr.c_str(), valueStr.size(), 1, fp) != 1)
+	// Write to a temporary file that replaces the original only once it is complete
+	QSaveFile file(fullPath);
+	if (!file.open(QIODevice::WriteOnly))
+		return false;
+	if (file.write(valueStr.c_str(), (qint64)valueStr.size()) != (qint64)valueStr.size())
 	{
-		fclose(fp);
+		file.cancelWriting();
 		return false;
 	}
-	fclose(fp);
+	if (!file.commit())
+		return false;
+
+	m_savedFiles[fullPath] = hash;
+	return true;
+}
+
+
+bool Project::CopyProjectFile(const QString& path, const QString& name)
+{
+	// Files copied before are still current, as unloaded assets cannot have been modified since
+	QString fullPath = QDir(path).absoluteFilePath(name);
+	if ((m_savedFiles.count(fullPath) != 0) && QFile::exists(fullPath))
+		return true;
+
+	QFile::remove(fullPath);
+	if (!QFile::copy(QDir(m_assetPath).absoluteFilePath(name), fullPath))
+		return false;
+
+	// Copies have no hash, so the file is written again if the asset is loaded and saved
+	m_savedFiles[fullPath] = QByteArray();
 	return true;
 }
 
@@ -409,6 +1107,10 @@ bool Project::Save(const QString& path)
 			return false;
 	}
 
+	// Unloaded assets are only kept as files in the directory they were opened from, copy them as they are
+	// when saving elsewhere. This does not load anything, so snapshots can be saved from another thread.
+	bool copyUnloaded = projectDir.absolutePath() != QDir(m_assetPath).absolutePath();
+
 	set<QString> files;
 	Json::Value project(Json::objectValue);
 
@@ -425,16 +1127,31 @@ bool Project::Save(const QString& path)
 	project["palettes"] = palettes;
 
 	Json::Value tileSets(Json::arrayValue);
+	Json::Value tileSetIndex(Json::arrayValue);
 	for (auto& i : m_tileSetsById)
 	{
-		QString name = GetFileName(i.second->GetName(), i.second->GetId(), ".s16tile");
-		tileSets.append(name.toStdString());
-		files.insert(name);
-
-		if (!SaveProjectFile(path, name, i.second->Serialize()))
+		UnloadedAsset entry;
+		entry.name = i.second->GetName();
+		entry.fileName = GetFileName(entry.name, i.first, ".s16tile");
+		for (auto& j : i.second->GetDependencies())
+			entry.dependencies.push_back(j);
+		tileSets.append(entry.fileName.toStdString());
+		tileSetIndex.append(GetAssetIndexEntry(i.first, entry));
+		files.insert(entry.fileName);
+
+		if (!SaveProjectFile(path, entry.fileName, i.second->Serialize()))
 			return false;
 	}
+	for (auto& i : m_unloadedTileSets)
+	{
+		if (copyUnloaded && !CopyProjectFile(path, i.second.fileName))
+			return false;
+		tileSets.append(i.second.fileName.toStdString());
+		tileSetIndex.append(GetAssetIndexEntry(i.first, i.second));
+		files.insert(i.second.fileName);
+	}
 	project["tilesets"] = tileSets;
+	project["tileset_index"] = tileSetIndex;
 
 	Json::Value effectLayers(Json::arrayValue);
 	for (auto& i : m_effectLayersById)
@@ -443,22 +1160,38 @@ bool Project::Save(const QString& path)
 		effectLayers.append(name.toStdString());
 		files.insert(name);
 
-		if (!SaveProjectFile(path, name, i.second->Serialize()))
+		if (!SaveProjectFile(path, name, i.second->Serialize(m_mapTileFormat)))
 			return false;
 	}
 	project["effect_layers"] = effectLayers;
 
 	Json::Value maps(Json::arrayValue);
+	Json::Value mapIndex(Json::arrayValue);
 	for (auto& i : m_mapsById)
 	{
-		QString name = GetFileName(i.second->GetName(), i.second->GetId(), ".s16map");
-		maps.append(name.toStdString());
-		files.insert(name);
-
-		if (!SaveProjectFile(path, name, i.second->Serialize()))
+		UnloadedAsset entry;
+		entry.name = i.second->GetName();
+		entry.fileName = GetFileName(entry.name, i.first, ".s16map");
+		for (auto& j : i.second->GetDependencies())
+			entry.dependencies.push_back(j);
+		maps.append(entry.fileName.toStdString());
+		mapIndex.append(GetAssetIndexEntry(i.first, entry));
+		files.insert(entry.fileName);
+
+		if (!SaveProjectFile(path, entry.fileName, i.second->Serialize(m_mapTileFormat)))
 			return false;
 	}
+	for (auto& i : m_unloadedMaps)
+	{
+		if (copyUnloaded && !CopyProjectFile(path, i.second.fileName))
+			return false;
+		maps.append(i.second.fileName.toStdString());
+		mapIndex.append(GetAssetIndexEntry(i.first, i.second));
+		files.insert(i.second.fileName);
+	}
 	project["maps"] = maps;
+	project["map_index"] = mapIndex;
+	project["map_tile_format"] = m_mapTileFormat;
 
 	Json::Value sprites(Json::arrayValue);
 	for (auto& i : m_spritesById)
@@ -492,38 +1225,121 @@ bool Project::Save(const QString& path)
 	for (auto& i : allFiles)
 	{
 		if ((files.count(i) == 0) && (i.contains(".s16")))
+		{
 			projectDir.remove(i);
+			m_savedFiles.erase(projectDir.absoluteFilePath(i));
+		}
 	}
+
+	m_assetPath = path;
 	return true;
 }
 
 
-bool Project::ReadProjectFile(const QString& path, const QString& name, Json::Value& result)
+shared_ptr<Project> Project::CreateSnapshot()
 {
-	QString fullPath = QDir(path).absoluteFilePath(name);
-	FILE* fp = fopen(fullPath.toStdString().c_str(), "r");
-	if (!fp)
-		return false;
+	shared_ptr<Project> result = make_shared<Project>();
+	result->m_palettes.clear();
+	result->m_palettesById.clear();
 
-	fseek(fp, 0, SEEK_END);
-	long size = ftell(fp);
-	fseek(fp, 0, SEEK_SET);
+	for (auto& i : m_palettesById)
+	{
+		shared_ptr<Palette> palette = i.second->CreateSnapshot();
+		result->m_palettes[palette->GetName()] = palette;
+		result->m_palettesById[i.first] = palette;
+	}
 
-	char* data = new char[size + 1];
-	data[size] = 0;
-	if (fread(data, size, 1, fp) != 1)
+	for (auto& i : m_tileSetsById)
 	{
-		delete[] data;
-		fclose(fp);
+		shared_ptr<TileSet> tileSet = i.second->CreateSnapshot();
+		result->m_tileSets[tileSet->GetName()] = tileSet;
+		result->m_tileSetsById[i.first] = tileSet;
+		result->AttachTileSet(tileSet);
+	}
+
+	for (auto& i : m_effectLayersById)
+	{
+		shared_ptr<MapLayer> layer = i.second->CreateSnapshot();
+		result->m_effectLayers[layer->GetName()] = layer;
+		result->m_effectLayersById[i.first] = layer;
+		result->AttachLayer(layer);
+	}
+
+	for (auto& i : m_spritesById)
+	{
+		shared_ptr<Sprite> sprite = i.second->CreateSnapshot();
+		result->m_sprites[sprite->GetName()] = sprite;
+		result->m_spritesById[i.first] = sprite;
+	}
+
+	// Actors save the name of their type, so they must refer to the snapshot of the type and not the original
+	std::map<shared_ptr<ActorType>, shared_ptr<ActorType>> actorTypes;
+	for (auto& i : m_actorTypesById)
+	{
+		shared_ptr<ActorType> actorType = i.second->CreateSnapshot();
+		result->m_actorTypes[actorType->GetName()] = actorType;
+		result->m_actorTypesById[i.first] = actorType;
+		actorTypes[i.second] = actorType;
+	}
+
+	for (auto& i : m_mapsById)
+	{
+		shared_ptr<Map> map = i.second->CreateSnapshot(actorTypes);
+		result->m_maps[map->GetName()] = map;
+		result->m_mapsById[i.first] = map;
+		result->AttachMap(map);
+	}
+
+	result->m_unloadedTileSets = m_unloadedTileSets;
+	result->m_unloadedMaps = m_unloadedMaps;
+	result->m_assetPath = m_assetPath;
+	result->m_mapTileFormat = m_mapTileFormat;
+
+	// The snapshot writes only files that changed since the last autosave
+	result->m_savedFiles = m_autosavedFiles;
+	return result;
+}
+
+
+void Project::FinishAutosave(const shared_ptr<Project>& snapshot, bool result)
+{
+	// After a failure everything is written again, as it is not known which files are complete
+	if (result)
+		m_autosavedFiles = snapshot->m_savedFiles;
+	else
+		m_autosavedFiles.clear();
+}
+
+
+bool Project::ReadProjectFile(const QString& path, const QString& name, Json::Value& result, QByteArray* hash)
+{
+	QFile file(QDir(path).absoluteFilePath(name));
+	if (!file.open(QIODevice::ReadOnly))
 		return false;
+
+	// Parse directly from a mapping of the file to avoid copying it. Fall back to reading the file if it
+	// cannot be mapped.
+	qint64 size = file.size();
+	QByteArray contents;
+	const char* data = (size > 0) ? (const char*)file.map(0, size) : nullptr;
+	if (!data)
+	{
+		contents = file.readAll();
+		if (contents.size() != size)
+			return false;
+		data = contents.constData();
 	}
-	fclose(fp);
 
-	string dataStr = data;
-	delete[] data;
+	if (hash)
+	{
+		QCryptographicHash sha(QCryptographicHash::Sha1);
+		sha.addData(data, (int)size);
+		*hash = sha.result();
+	}
 
+	// The file is unmapped when it is closed
 	Json::Reader reader;
-	return reader.parse(dataStr, result, false);
+	return reader.parse(data, data + size, result, false);
 }
 
 
@@ -536,6 +1352,29 @@ shared_ptr<Project> Project::Open(const QString& path)
 		return nullptr;
 	}
 
+	// Tile sets and maps in the indexes are loaded on first access, any others in the manifest are loaded now
+	set<string> indexedFiles;
+	map<string, UnloadedAsset> unloadedTileSets = ReadAssetIndex(manifest["tilesets"], manifest["tileset_index"],
+		indexedFiles);
+	map<string, UnloadedAsset> unloadedMaps = ReadAssetIndex(manifest["maps"], manifest["map_index"], indexedFiles);
+
+	Json::Value loadManifest = manifest;
+	for (auto& type : {"tilesets", "maps"})
+	{
+		loadManifest[type] = Json::Value(Json::arrayValue);
+		for (auto& i : manifest[type])
+		{
+			if (indexedFiles.count(i.asString()) == 0)
+				loadManifest[type].append(i);
+		}
+	}
+
+	// Asset types in dependency order
+	ProjectFileLoader loader(loadManifest, vector<string>{"palettes", "tilesets", "effect_layers", "sprites",
+		"actor_types", "maps"}, [=](const QString& name, Json::Value& data, QByteArray* hash) {
+			return ReadProjectFile(path, name, data, hash);
+		});
+
 	shared_ptr<Project> project = make_shared<Project>();
 	project->m_palettes.clear();
 	project->m_palettesById.clear();
@@ -548,23 +1387,28 @@ shared_ptr<Project> Project::Open(const QString& path)
 	project->m_actorTypes.clear();
 	project->m_actorTypesById.clear();
 
-	for (auto& i : manifest["palettes"])
+	// Manifests without a tile format were written before the packed format, keep them readable by older versions
+	project->m_mapTileFormat = MAP_LAYER_TILE_FORMAT_ROWS;
+	if (manifest.isMember("map_tile_format") &&
+		(manifest["map_tile_format"].asUInt() == MAP_LAYER_TILE_FORMAT_PACKED))
+		project->m_mapTileFormat = MAP_LAYER_TILE_FORMAT_PACKED;
+
+	for (auto& i : loader.WaitForFiles("palettes"))
 	{
-		Json::Value data;
-		if (!ReadProjectFile(path, QString::fromStdString(i.asString()), data))
+		if (!i->valid)
 		{
 			QMessageBox::critical(nullptr, "Error", QString("Unable to read palette '") +
-				QString::fromStdString(i.asString()) + QString("'."));
+				i->name + QString("'."));
 			return nullptr;
 		}
 
-		shared_ptr<Palette> palette = Palette::Deserialize(data);
+		shared_ptr<Palette> palette = Palette::Deserialize(i->data);
 		if (!palette)
 		{
-			if (i.isMember("name"))
+			if (i->data.isMember("name"))
 			{
 				QMessageBox::critical(nullptr, "Error", QString("Palette '") +
-					QString::fromStdString(i["name"].asString()) +
+					QString::fromStdString(i->data["name"].asString()) +
 					QString("' could not be read from project file."));
 			}
 			else
@@ -577,25 +1421,26 @@ shared_ptr<Project> Project::Open(const QString& path)
 
 		project->m_palettes[palette->GetName()] = palette;
 		project->m_palettesById[palette->GetId()] = palette;
+		project->m_savedFiles[QDir(path).absoluteFilePath(i->name)] = i->hash;
 	}
+	loader.EndStage("Palettes");
 
-	for (auto& i : manifest["tilesets"])
+	for (auto& i : loader.WaitForFiles("tilesets"))
 	{
-		Json::Value data;
-		if (!ReadProjectFile(path, QString::fromStdString(i.asString()), data))
+		if (!i->valid)
 		{
 			QMessageBox::critical(nullptr, "Error", QString("Unable to read tile set '") +
-				QString::fromStdString(i.asString()) + QString("'."));
+				i->name + QString("'."));
 			return nullptr;
 		}
 
-		shared_ptr<TileSet> tileSet = TileSet::Deserialize(project, data);
+		shared_ptr<TileSet> tileSet = TileSet::Deserialize(project, i->data);
 		if (!tileSet)
 		{
-			if (i.isMember("name"))
+			if (i->data.isMember("name"))
 			{
 				QMessageBox::critical(nullptr, "Error", QString("Tile set '") +
-					QString::fromStdString(i["name"].asString()) +
+					QString::fromStdString(i->data["name"].asString()) +
 					QString("' could not be read from project file."));
 			}
 			else
@@ -608,28 +1453,42 @@ shared_ptr<Project> Project::Open(const QString& path)
 
 		project->m_tileSets[tileSet->GetName()] = tileSet;
 		project->m_tileSetsById[tileSet->GetId()] = tileSet;
+		project->AttachTileSet(tileSet);
+		project->m_savedFiles[QDir(path).absoluteFilePath(i->name)] = i->hash;
+	}
+
+	// Assets loaded from here on can load indexed tile sets they refer to
+	project->m_assetPath = path;
+	for (auto& i : unloadedTileSets)
+	{
+		// A tile set that was loaded without the index takes precedence
+		if ((project->m_tileSetsById.count(i.first) == 0) && (project->m_tileSets.count(i.second.name) == 0))
+			project->m_unloadedTileSets[i.first] = i.second;
 	}
 
+	vector<shared_ptr<TileSet>> loadedTileSets;
 	for (auto& i : project->m_tileSets)
-		i.second->ResolveInitialAssociatedTileSets(project);
+		loadedTileSets.push_back(i.second);
+	for (auto& i : loadedTileSets)
+		i->ResolveInitialAssociatedTileSets(project);
+	loader.EndStage("Tile sets");
 
-	for (auto& i : manifest["effect_layers"])
+	for (auto& i : loader.WaitForFiles("effect_layers"))
 	{
-		Json::Value data;
-		if (!ReadProjectFile(path, QString::fromStdString(i.asString()), data))
+		if (!i->valid)
 		{
 			QMessageBox::critical(nullptr, "Error", QString("Unable to read effect layer '") +
-				QString::fromStdString(i.asString()) + QString("'."));
+				i->name + QString("'."));
 			return nullptr;
 		}
 
-		shared_ptr<MapLayer> layer = MapLayer::Deserialize(project, data);
+		shared_ptr<MapLayer> layer = MapLayer::Deserialize(project, i->data);
 		if (!layer)
 		{
-			if (i.isMember("name"))
+			if (i->data.isMember("name"))
 			{
 				QMessageBox::critical(nullptr, "Error", QString("Effect layer '") +
-					QString::fromStdString(i["name"].asString()) +
+					QString::fromStdString(i->data["name"].asString()) +
 					QString("' could not be read from project file."));
 			}
 			else
@@ -642,25 +1501,27 @@ shared_ptr<Project> Project::Open(const QString& path)
 
 		project->m_effectLayers[layer->GetName()] = layer;
 		project->m_effectLayersById[layer->GetId()] = layer;
+		project->AttachLayer(layer);
+		project->m_savedFiles[QDir(path).absoluteFilePath(i->name)] = i->hash;
 	}
+	loader.EndStage("Effect layers");
 
-	for (auto& i : manifest["sprites"])
+	for (auto& i : loader.WaitForFiles("sprites"))
 	{
-		Json::Value data;
-		if (!ReadProjectFile(path, QString::fromStdString(i.asString()), data))
+		if (!i->valid)
 		{
 			QMessageBox::critical(nullptr, "Error", QString("Unable to read sprite '") +
-				QString::fromStdString(i.asString()) + QString("'."));
+				i->name + QString("'."));
 			return nullptr;
 		}
 
-		shared_ptr<Sprite> sprite = Sprite::Deserialize(project, data);
+		shared_ptr<Sprite> sprite = Sprite::Deserialize(project, i->data);
 		if (!sprite)
 		{
-			if (i.isMember("name"))
+			if (i->data.isMember("name"))
 			{
 				QMessageBox::critical(nullptr, "Error", QString("Sprite '") +
-					QString::fromStdString(i["name"].asString()) +
+					QString::fromStdString(i->data["name"].asString()) +
 					QString("' could not be read from project file."));
 			}
 			else
@@ -673,25 +1534,26 @@ shared_ptr<Project> Project::Open(const QString& path)
 
 		project->m_sprites[sprite->GetName()] = sprite;
 		project->m_spritesById[sprite->GetId()] = sprite;
+		project->m_savedFiles[QDir(path).absoluteFilePath(i->name)] = i->hash;
 	}
+	loader.EndStage("Sprites");
 
-	for (auto& i : manifest["actor_types"])
+	for (auto& i : loader.WaitForFiles("actor_types"))
 	{
-		Json::Value data;
-		if (!ReadProjectFile(path, QString::fromStdString(i.asString()), data))
+		if (!i->valid)
 		{
 			QMessageBox::critical(nullptr, "Error", QString("Unable to read actor type '") +
-				QString::fromStdString(i.asString()) + QString("'."));
+				i->name + QString("'."));
 			return nullptr;
 		}
 
-		shared_ptr<ActorType> actorType = ActorType::Deserialize(project, data);
+		shared_ptr<ActorType> actorType = ActorType::Deserialize(project, i->data);
 		if (!actorType)
 		{
-			if (i.isMember("name"))
+			if (i->data.isMember("name"))
 			{
 				QMessageBox::critical(nullptr, "Error", QString("Actor type '") +
-					QString::fromStdString(i["name"].asString()) +
+					QString::fromStdString(i->data["name"].asString()) +
 					QString("' could not be read from project file."));
 			}
 			else
@@ -704,25 +1566,26 @@ shared_ptr<Project> Project::Open(const QString& path)
 
 		project->m_actorTypes[actorType->GetName()] = actorType;
 		project->m_actorTypesById[actorType->GetId()] = actorType;
+		project->m_savedFiles[QDir(path).absoluteFilePath(i->name)] = i->hash;
 	}
+	loader.EndStage("Actor types");
 
-	for (auto& i : manifest["maps"])
+	for (auto& i : loader.WaitForFiles("maps"))
 	{
-		Json::Value data;
-		if (!ReadProjectFile(path, QString::fromStdString(i.asString()), data))
+		if (!i->valid)
 		{
 			QMessageBox::critical(nullptr, "Error", QString("Unable to read map '") +
-				QString::fromStdString(i.asString()) + QString("'."));
+				i->name + QString("'."));
 			return nullptr;
 		}
 
-		shared_ptr<Map> map = Map::Deserialize(project, data);
+		shared_ptr<Map> map = Map::Deserialize(project, i->data);
 		if (!map)
 		{
-			if (i.isMember("name"))
+			if (i->data.isMember("name"))
 			{
 				QMessageBox::critical(nullptr, "Error", QString("Map '") +
-					QString::fromStdString(i["name"].asString()) +
+					QString::fromStdString(i->data["name"].asString()) +
 					QString("' could not be read from project file."));
 			}
 			else
@@ -735,8 +1598,27 @@ shared_ptr<Project> Project::Open(const QString& path)
 
 		project->m_maps[map->GetName()] = map;
 		project->m_mapsById[map->GetId()] = map;
+		project->AttachMap(map);
+		project->m_savedFiles[QDir(path).absoluteFilePath(i->name)] = i->hash;
 	}
+	loader.EndStage("Maps");
 
+	// Assets loaded above would have lost their tiles from an indexed tile set that could not be loaded
+	QStringList errors = project->GetLoadErrors();
+	if (errors.size() != 0)
+	{
+		QMessageBox::critical(nullptr, "Error", errors.join("\n"));
+		return nullptr;
+	}
+
+	for (auto& i : unloadedMaps)
+	{
+		// A map that was loaded without the index takes precedence
+		if ((project->m_mapsById.count(i.first) == 0) && (project->m_maps.count(i.second.name) == 0))
+			project->m_unloadedMaps[i.first] = i.second;
+	}
+
+	project->m_openTimings = loader.GetTimings();
 	return project;
 }
 
@@ -754,7 +1636,7 @@ shared_ptr<TileSet> Project::GetTileSetById(const string& id)
 {
 	auto i = m_tileSetsById.find(id);
 	if (i == m_tileSetsById.end())
-		return shared_ptr<TileSet>();
+		return LoadTileSet(id);
 	return i->second;
 }
 
@@ -772,7 +1654,7 @@ shared_ptr<Map> Project::GetMapById(const string& id)
 {
 	auto i = m_mapsById.find(id);
 	if (i == m_mapsById.end())
-		return shared_ptr<Map>();
+		return LoadMap(id);
 	return i->second;
 }
 
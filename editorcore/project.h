@@ -1,8 +1,10 @@
 #pragma once
 
 #include <QString>
+#include <QStringList>
 #include <memory>
 #include <map>
+#include <set>
 #include <string>
 #include "palette.h"
 #include "tileset.h"
@@ -11,7 +13,7 @@
 #include "actortype.h"
 #include "json/json.h"
 
-class Project
+class Project: public std::enable_shared_from_this<Project>
 {
 	std::map<std::string, std::shared_ptr<Palette>> m_palettes;
 	std::map<std::string, std::shared_ptr<TileSet>> m_tileSets;
@@ -27,12 +29,70 @@ class Project
 	std::map<std::string, std::shared_ptr<Sprite>> m_spritesById;
 	std::map<std::string, std::shared_ptr<ActorType>> m_actorTypesById;
 
+	// Hashes of the files as last written or read, by full path. Every loaded asset is serialized when saving,
+	// but files whose contents have not changed are not written again.
+	std::map<QString, QByteArray> m_savedFiles;
+
+	// The same state for the autosave directory, which is written from snapshots of the project
+	std::map<QString, QByteArray> m_autosavedFiles;
+
+	// Time in milliseconds taken by each stage of opening the project
+	std::vector<std::pair<std::string, double>> m_openTimings;
+
+	// Tile sets and maps listed in the manifest's indexes are not deserialized until they are first accessed,
+	// so opening a project does not depend on their number. Unloaded assets are kept by id. Assets that fail
+	// to load stay unloaded, so that saving keeps their files, and keep the reason for the UI to report.
+	struct UnloadedAsset
+	{
+		std::string name;
+		QString fileName;
+		std::vector<std::string> dependencies;
+		QString error;
+	};
+	std::map<std::string, UnloadedAsset> m_unloadedTileSets;
+	std::map<std::string, UnloadedAsset> m_unloadedMaps;
+	QString m_assetPath;
+
+	// Tile format written for map and effect layers, one of the MAP_LAYER_TILE_FORMAT values
+	uint32_t m_mapTileFormat;
+
+	// Reverse index of the dependencies between loaded assets. Tile sets, layers and maps report when they
+	// start or stop using an asset, so finding the users of an asset only visits those users. Layers are
+	// indexed by the tile sets they use whether they belong to a map or are effect layers.
+	std::map<std::shared_ptr<Palette>, std::set<std::shared_ptr<TileSet>>> m_tileSetsByPalette;
+	std::map<std::shared_ptr<TileSet>, std::set<std::shared_ptr<MapLayer>>> m_layersByTileSet;
+	std::map<std::shared_ptr<MapLayer>, std::set<std::shared_ptr<Map>>> m_mapsByLayer;
+
+	void AttachTileSet(const std::shared_ptr<TileSet>& tileSet);
+	void DetachTileSet(const std::shared_ptr<TileSet>& tileSet);
+	void AttachLayer(const std::shared_ptr<MapLayer>& layer);
+	void DetachLayer(const std::shared_ptr<MapLayer>& layer);
+	void AttachMap(const std::shared_ptr<Map>& map);
+	void DetachMap(const std::shared_ptr<Map>& map);
+	void AddLayerToMap(const std::shared_ptr<Map>& map, const std::shared_ptr<MapLayer>& layer);
+	void RemoveLayerFromMap(const std::shared_ptr<Map>& map, const std::shared_ptr<MapLayer>& layer);
+
+	std::shared_ptr<TileSet> LoadTileSet(const std::string& id);
+	void LoadAllTileSets();
+	void LoadTileSetsDependingOn(const std::set<std::string>& ids);
+	bool IsTileSetNameUsed(const std::string& name) const;
+	std::shared_ptr<Map> LoadMap(const std::string& id);
+	void LoadAllMaps();
+	void LoadMapsDependingOn(const std::set<std::string>& ids);
+	bool IsMapNameUsed(const std::string& name) const;
+	static std::map<std::string, UnloadedAsset> ReadAssetIndex(const Json::Value& files, const Json::Value& index,
+		std::set<std::string>& indexedFiles);
+	static Json::Value GetAssetIndexEntry(const std::string& id, const UnloadedAsset& asset);
+
 	QString GetFileName(const std::string& name, const std::string& id, const QString& ext);
 	bool SaveProjectFile(const QString& path, const QString& name, const Json::Value& value);
-	static bool ReadProjectFile(const QString& path, const QString& name, Json::Value& result);
+	bool CopyProjectFile(const QString& path, const QString& name);
+	static bool ReadProjectFile(const QString& path, const QString& name, Json::Value& result,
+		QByteArray* hash = nullptr);
 
 public:
 	Project();
+	~Project();
 
 	const std::map<std::string, std::shared_ptr<Palette>>& GetPalettes() const { return m_palettes; }
 	std::shared_ptr<Palette> GetPaletteByName(const std::string& name);
@@ -40,7 +100,10 @@ public:
 	bool RenamePalette(std::shared_ptr<Palette> palette, const std::string& name);
 	void DeletePalette(std::shared_ptr<Palette> palette);
 
-	const std::map<std::string, std::shared_ptr<TileSet>>& GetTileSets() const { return m_tileSets; }
+	// Loads every tile set that has not been accessed yet, use GetTileSetIdsByName to list tile sets without
+	// loading them
+	const std::map<std::string, std::shared_ptr<TileSet>>& GetTileSets();
+	std::map<std::string, std::string> GetTileSetIdsByName() const;
 	std::shared_ptr<TileSet> GetTileSetByName(const std::string& name);
 	bool AddTileSet(std::shared_ptr<TileSet> tileSet);
 	bool RenameTileSet(std::shared_ptr<TileSet> tileSet, const std::string& name);
@@ -52,7 +115,9 @@ public:
 	bool RenameEffectLayer(std::shared_ptr<MapLayer> layer, const std::string& name);
 	void DeleteEffectLayer(std::shared_ptr<MapLayer> layer);
 
-	const std::map<std::string, std::shared_ptr<Map>>& GetMaps() const { return m_maps; }
+	// Loads every map that has not been accessed yet, use GetMapIdsByName to list maps without loading them
+	const std::map<std::string, std::shared_ptr<Map>>& GetMaps();
+	std::map<std::string, std::string> GetMapIdsByName() const;
 	std::shared_ptr<Map> GetMapByName(const std::string& name);
 	bool AddMap(std::shared_ptr<Map> map);
 	bool RenameMap(std::shared_ptr<Map> map, const std::string& name);
@@ -71,13 +136,46 @@ public:
 	void DeleteActorType(std::shared_ptr<ActorType> actorType);
 
 	std::vector<std::shared_ptr<TileSet>> GetTileSetsUsingPalette(std::shared_ptr<Palette> palette);
+	// Only the tile sets that are already loaded, which are the only ones open views can depend on
+	std::vector<std::shared_ptr<TileSet>> GetLoadedTileSetsUsingPalette(std::shared_ptr<Palette> palette) const;
 	std::vector<std::shared_ptr<Sprite>> GetSpritesUsingPalette(std::shared_ptr<Palette> palette);
 	std::vector<std::shared_ptr<MapLayer>> GetEffectLayersUsingTileSet(std::shared_ptr<TileSet> tileSet);
 	std::vector<std::shared_ptr<Map>> GetMapsUsingTileSet(std::shared_ptr<TileSet> tileSet);
 	std::vector<std::shared_ptr<Map>> GetMapsUsingEffectLayer(std::shared_ptr<MapLayer> layer);
 
+	// Verifies the usage counts kept by tile sets and layers against their contents, and the reverse index
+	// against the loaded assets, for debugging. Assets that have not been loaded are not checked.
+	bool CheckUsageCounts() const;
+
+	// Assets that are loaded on first access return null from the getters if they cannot be read. These
+	// describe why, for the caller to report.
+	QString GetLoadError(const std::string& id) const;
+	QStringList GetLoadErrors() const;
+	// Whether an asset that could not be loaded depends on the given asset. Such an asset is kept in the
+	// project and must not lose its dependencies.
+	bool IsUsedByUnloadedAsset(const std::string& id) const;
+	// Type and current name of any asset in the project, without loading it. Empty if there is no such asset.
+	QString GetAssetDescription(const std::string& id) const;
+	// Loads every asset that has not been accessed yet, returns false if any of them could not be loaded
+	bool LoadAllAssets();
+
 	bool Save(const QString& path);
+
+	// Copies the project for saving on another thread while editing continues. The snapshot shares tile data
+	// with the project until it is modified, so this is fast enough to run between frames. Save the snapshot
+	// to the autosave directory, then call FinishAutosave from the UI thread.
+	std::shared_ptr<Project> CreateSnapshot();
+	void FinishAutosave(const std::shared_ptr<Project>& snapshot, bool result);
+
 	static std::shared_ptr<Project> Open(const QString& path);
+	const std::vector<std::pair<std::string, double>>& GetOpenTimings() const { return m_openTimings; }
+
+	// New projects save map tiles in the packed format. Projects saved before it existed have no format in
+	// their manifest and keep the rows format, which older editors and runtimes can read, until changed.
+	// Changing the format loads every map so that all of them are written again, returns false if a map
+	// could not be loaded and will keep its file as it is.
+	uint32_t GetMapTileFormat() const { return m_mapTileFormat; }
+	bool SetMapTileFormat(uint32_t format);
 
 	std::shared_ptr<Palette> GetPaletteById(const std::string& id);
 	std::shared_ptr<TileSet> GetTileSetById(const std::string& id);
@@ -153,7 +153,7 @@ void ProjectViewWidget::RenamePalette(shared_ptr<Palette> palette)
 			return;
 		}
 		m_mainWindow->UpdatePaletteName(palette);
-		m_mainWindow->AddUndoAction(
+		m_mainWindow->AddUndoAction(palette->GetId(), DEFAULT_UNDO_ACTION_SIZE,
 			[=]() { // Undo
 				m_project->RenamePalette(palette, oldName);
 				m_mainWindow->UpdatePaletteName(palette);
@@ -185,7 +185,7 @@ void ProjectViewWidget::DuplicatePalette(shared_ptr<Palette> palette)
 		}
 		m_mainWindow->OpenPalette(newCopy);
 		m_mainWindow->UpdatePaletteContents(newCopy);
-		m_mainWindow->AddUndoAction(
+		m_mainWindow->AddUndoAction(newCopy->GetId(), newCopy->GetMemoryUsage(),
 			[=]() { // Undo
 				m_mainWindow->ClosePalette(newCopy);
 				m_project->DeletePalette(newCopy);
@@ -217,6 +217,12 @@ void ProjectViewWidget::RemovePalette(shared_ptr<Palette> palette)
 			"dependency list, clear the dependencies, and try again.");
 		return;
 	}
+	if (m_project->IsUsedByUnloadedAsset(palette->GetId()))
+	{
+		QMessageBox::critical(this, "Error", "This palette is used by assets that could not be loaded:\n" +
+			m_project->GetLoadErrors().join("\n"));
+		return;
+	}
 
 	if (QMessageBox::question(this, "Delete Palette", QString("Are you sure you want to remove the palette '") +
 		QString::fromStdString(palette->GetName()) + QString("'?"), QMessageBox::Yes,
@@ -227,7 +233,7 @@ void ProjectViewWidget::RemovePalette(shared_ptr<Palette> palette)
 	m_mainWindow->ClosePalette(palette);
 	m_project->DeletePalette(palette);
 	m_mainWindow->UpdatePaletteContents(palette);
-	m_mainWindow->AddUndoAction(
+	m_mainWindow->AddUndoAction(palette->GetId(), palette->GetMemoryUsage(),
 		[=]() { // Undo
 			m_project->AddPalette(palette);
 			m_mainWindow->UpdatePaletteContents(palette);
@@ -256,7 +262,7 @@ void ProjectViewWidget::RenameTileSet(shared_ptr<TileSet> tileSet)
 			return;
 		}
 		m_mainWindow->UpdateTileSetName(tileSet);
-		m_mainWindow->AddUndoAction(
+		m_mainWindow->AddUndoAction(tileSet->GetId(), DEFAULT_UNDO_ACTION_SIZE,
 			[=]() { // Undo
 				m_project->RenameTileSet(tileSet, oldName);
 				m_mainWindow->UpdateTileSetName(tileSet);
@@ -288,7 +294,7 @@ void ProjectViewWidget::DuplicateTileSet(shared_ptr<TileSet> tileSet)
 		}
 		m_mainWindow->OpenTileSet(newCopy);
 		m_mainWindow->UpdateTileSetContents(newCopy);
-		m_mainWindow->AddUndoAction(
+		m_mainWindow->AddUndoAction(newCopy->GetId(), newCopy->GetMemoryUsage(),
 			[=]() { // Undo
 				m_mainWindow->CloseTileSet(newCopy);
 				m_project->DeleteTileSet(newCopy);
@@ -306,6 +312,15 @@ void ProjectViewWidget::DuplicateTileSet(shared_ptr<TileSet> tileSet)
 }
 
 
+shared_ptr<TileSet> ProjectViewWidget::LoadTileSet(const string& id)
+{
+	shared_ptr<TileSet> tileSet = m_project->GetTileSetById(id);
+	if (!tileSet)
+		QMessageBox::critical(this, "Error", m_project->GetLoadError(id));
+	return tileSet;
+}
+
+
 void ProjectViewWidget::RemoveTileSet(shared_ptr<TileSet> tileSet)
 {
 	if (m_project->GetMapsUsingTileSet(tileSet).size() != 0)
@@ -320,6 +335,12 @@ void ProjectViewWidget::RemoveTileSet(shared_ptr<TileSet> tileSet)
 			"dependency list, clear the dependencies, and try again.");
 		return;
 	}
+	if (m_project->IsUsedByUnloadedAsset(tileSet->GetId()))
+	{
+		QMessageBox::critical(this, "Error", "This tile set is used by assets that could not be loaded:\n" +
+			m_project->GetLoadErrors().join("\n"));
+		return;
+	}
 
 	if (QMessageBox::question(this, "Delete Tile Set", QString("Are you sure you want to remove the tile set '") +
 		QString::fromStdString(tileSet->GetName()) + QString("'?"), QMessageBox::Yes,
@@ -330,7 +351,7 @@ void ProjectViewWidget::RemoveTileSet(shared_ptr<TileSet> tileSet)
 	m_mainWindow->CloseTileSet(tileSet);
 	m_project->DeleteTileSet(tileSet);
 	m_mainWindow->UpdateTileSetContents(tileSet);
-	m_mainWindow->AddUndoAction(
+	m_mainWindow->AddUndoAction(tileSet->GetId(), tileSet->GetMemoryUsage(),
 		[=]() { // Undo
 			m_project->AddTileSet(tileSet);
 			m_mainWindow->UpdateTileSetContents(tileSet);
@@ -359,7 +380,7 @@ void ProjectViewWidget::RenameEffectLayer(shared_ptr<MapLayer> layer)
 			return;
 		}
 		m_mainWindow->UpdateEffectLayerName(layer);
-		m_mainWindow->AddUndoAction(
+		m_mainWindow->AddUndoAction(layer->GetId(), DEFAULT_UNDO_ACTION_SIZE,
 			[=]() { // Undo
 				m_project->RenameEffectLayer(layer, oldName);
 				m_mainWindow->UpdateEffectLayerName(layer);
@@ -391,7 +412,7 @@ void ProjectViewWidget::DuplicateEffectLayer(shared_ptr<MapLayer> layer)
 		}
 		m_mainWindow->OpenEffectLayer(newCopy);
 		m_mainWindow->UpdateEffectLayerContents(newCopy);
-		m_mainWindow->AddUndoAction(
+		m_mainWindow->AddUndoAction(newCopy->GetId(), newCopy->GetMemoryUsage(),
 			[=]() { // Undo
 				m_mainWindow->CloseEffectLayer(newCopy);
 				m_project->DeleteEffectLayer(newCopy);
@@ -417,6 +438,12 @@ void ProjectViewWidget::RemoveEffectLayer(shared_ptr<MapLayer> layer)
 			"dependency list, clear the dependencies, and try again.");
 		return;
 	}
+	if (m_project->IsUsedByUnloadedAsset(layer->GetId()))
+	{
+		QMessageBox::critical(this, "Error", "This effect layer is used by assets that could not be loaded:\n" +
+			m_project->GetLoadErrors().join("\n"));
+		return;
+	}
 
 	if (QMessageBox::question(this, "Delete Effect Layer", QString("Are you sure you want to remove the effect layer '") +
 		QString::fromStdString(layer->GetName()) + QString("'?"), QMessageBox::Yes,
@@ -427,7 +454,7 @@ void ProjectViewWidget::RemoveEffectLayer(shared_ptr<MapLayer> layer)
 	m_mainWindow->CloseEffectLayer(layer);
 	m_project->DeleteEffectLayer(layer);
 	m_mainWindow->UpdateEffectLayerContents(layer);
-	m_mainWindow->AddUndoAction(
+	m_mainWindow->AddUndoAction(layer->GetId(), layer->GetMemoryUsage(),
 		[=]() { // Undo
 			m_project->AddEffectLayer(layer);
 			m_mainWindow->UpdateEffectLayerContents(layer);
@@ -456,7 +483,7 @@ void ProjectViewWidget::RenameMap(shared_ptr<Map> map)
 			return;
 		}
 		m_mainWindow->UpdateMapName(map);
-		m_mainWindow->AddUndoAction(
+		m_mainWindow->AddUndoAction(map->GetId(), DEFAULT_UNDO_ACTION_SIZE,
 			[=]() { // Undo
 				m_project->RenameMap(map, oldName);
 				m_mainWindow->UpdateMapName(map);
@@ -488,7 +515,7 @@ void ProjectViewWidget::DuplicateMap(shared_ptr<Map> map)
 		}
 		m_mainWindow->OpenMap(newCopy);
 		m_mainWindow->UpdateMapContents(newCopy);
-		m_mainWindow->AddUndoAction(
+		m_mainWindow->AddUndoAction(newCopy->GetId(), newCopy->GetMemoryUsage(),
 			[=]() { // Undo
 				m_mainWindow->CloseMap(newCopy);
 				m_project->DeleteMap(newCopy);
@@ -506,6 +533,15 @@ void ProjectViewWidget::DuplicateMap(shared_ptr<Map> map)
 }
 
 
+shared_ptr<Map> ProjectViewWidget::LoadMap(const string& id)
+{
+	shared_ptr<Map> map = m_project->GetMapById(id);
+	if (!map)
+		QMessageBox::critical(this, "Error", m_project->GetLoadError(id));
+	return map;
+}
+
+
 void ProjectViewWidget::RemoveMap(shared_ptr<Map> map)
 {
 	if (QMessageBox::question(this, "Delete Map", QString("Are you sure you want to remove the map '") +
@@ -517,7 +553,7 @@ void ProjectViewWidget::RemoveMap(shared_ptr<Map> map)
 	m_mainWindow->CloseMap(map);
 	m_project->DeleteMap(map);
 	m_mainWindow->UpdateMapContents(map);
-	m_mainWindow->AddUndoAction(
+	m_mainWindow->AddUndoAction(map->GetId(), map->GetMemoryUsage(),
 		[=]() { // Undo
 			m_project->AddMap(map);
 			m_mainWindow->UpdateMapContents(map);
@@ -546,7 +582,7 @@ void ProjectViewWidget::RenameSprite(shared_ptr<Sprite> sprite)
 			return;
 		}
 		m_mainWindow->UpdateSpriteName(sprite);
-		m_mainWindow->AddUndoAction(
+		m_mainWindow->AddUndoAction(sprite->GetId(), DEFAULT_UNDO_ACTION_SIZE,
 			[=]() { // Undo
 				m_project->RenameSprite(sprite, oldName);
 				m_mainWindow->UpdateSpriteName(sprite);
@@ -578,7 +614,7 @@ void ProjectViewWidget::DuplicateSprite(shared_ptr<Sprite> sprite)
 		}
 		m_mainWindow->OpenSprite(newCopy);
 		m_mainWindow->UpdateSpriteContents(newCopy);
-		m_mainWindow->AddUndoAction(
+		m_mainWindow->AddUndoAction(newCopy->GetId(), newCopy->GetMemoryUsage(),
 			[=]() { // Undo
 				m_mainWindow->CloseSprite(newCopy);
 				m_project->DeleteSprite(newCopy);
@@ -607,7 +643,7 @@ void ProjectViewWidget::RemoveSprite(shared_ptr<Sprite> sprite)
 	m_mainWindow->CloseSprite(sprite);
 	m_project->DeleteSprite(sprite);
 	m_mainWindow->UpdateSpriteContents(sprite);
-	m_mainWindow->AddUndoAction(
+	m_mainWindow->AddUndoAction(sprite->GetId(), sprite->GetMemoryUsage(),
 		[=]() { // Undo
 			m_project->AddSprite(sprite);
 			m_mainWindow->UpdateSpriteContents(sprite);
@@ -636,7 +672,7 @@ void ProjectViewWidget::RenameActorType(shared_ptr<ActorType> actorType)
 			return;
 		}
 		m_mainWindow->UpdateActorTypeName(actorType);
-		m_mainWindow->AddUndoAction(
+		m_mainWindow->AddUndoAction(actorType->GetId(), DEFAULT_UNDO_ACTION_SIZE,
 			[=]() { // Undo
 				m_project->RenameActorType(actorType, oldName);
 				m_mainWindow->UpdateActorTypeName(actorType);
@@ -668,7 +704,7 @@ void ProjectViewWidget::DuplicateActorType(shared_ptr<ActorType> actorType)
 		}
 		m_mainWindow->OpenActorType(newCopy);
 		m_mainWindow->UpdateActorTypeContents(newCopy);
-		m_mainWindow->AddUndoAction(
+		m_mainWindow->AddUndoAction(newCopy->GetId(), DEFAULT_UNDO_ACTION_SIZE,
 			[=]() { // Undo
 				m_mainWindow->CloseActorType(newCopy);
 				m_project->DeleteActorType(newCopy);
@@ -697,7 +733,7 @@ void ProjectViewWidget::RemoveActorType(shared_ptr<ActorType> actorType)
 	m_mainWindow->CloseActorType(actorType);
 	m_project->DeleteActorType(actorType);
 	m_mainWindow->UpdateActorTypeContents(actorType);
-	m_mainWindow->AddUndoAction(
+	m_mainWindow->AddUndoAction(actorType->GetId(), DEFAULT_UNDO_ACTION_SIZE,
 		[=]() { // Undo
 			m_project->AddActorType(actorType);
 			m_mainWindow->UpdateActorTypeContents(actorType);
@@ -767,14 +803,31 @@ void ProjectViewWidget::UpdateList()
 		m_paletteItems.push_back(item);
 	}
 
-	for (auto& i : m_project->GetTileSets())
+	// Tile sets and maps are loaded when they are first used from the list
+	for (auto& i : m_project->GetTileSetIdsByName())
 	{
-		shared_ptr<TileSet> tileSet = i.second;
+		string id = i.second;
 		ProjectItemWidget* item = new ProjectItemWidget(this, i.first,
-			[=]() { m_mainWindow->OpenTileSet(tileSet); },
-			[=]() { RenameTileSet(tileSet); },
-			[=]() { DuplicateTileSet(tileSet); },
-			[=]() { RemoveTileSet(tileSet); }
+			[=]() {
+				shared_ptr<TileSet> tileSet = LoadTileSet(id);
+				if (tileSet)
+					m_mainWindow->OpenTileSet(tileSet);
+			},
+			[=]() {
+				shared_ptr<TileSet> tileSet = LoadTileSet(id);
+				if (tileSet)
+					RenameTileSet(tileSet);
+			},
+			[=]() {
+				shared_ptr<TileSet> tileSet = LoadTileSet(id);
+				if (tileSet)
+					DuplicateTileSet(tileSet);
+			},
+			[=]() {
+				shared_ptr<TileSet> tileSet = LoadTileSet(id);
+				if (tileSet)
+					RemoveTileSet(tileSet);
+			}
 		);
 		m_tileSetLayout->addWidget(item);
 		m_tileSetItems.push_back(item);
@@ -793,14 +846,30 @@ void ProjectViewWidget::UpdateList()
 		m_effectLayerItems.push_back(item);
 	}
 
-	for (auto& i : m_project->GetMaps())
+	for (auto& i : m_project->GetMapIdsByName())
 	{
-		shared_ptr<Map> map = i.second;
+		string id = i.second;
 		ProjectItemWidget* item = new ProjectItemWidget(this, i.first,
-			[=]() { m_mainWindow->OpenMap(map); },
-			[=]() { RenameMap(map); },
-			[=]() { DuplicateMap(map); },
-			[=]() { RemoveMap(map); }
+			[=]() {
+				shared_ptr<Map> map = LoadMap(id);
+				if (map)
+					m_mainWindow->OpenMap(map);
+			},
+			[=]() {
+				shared_ptr<Map> map = LoadMap(id);
+				if (map)
+					RenameMap(map);
+			},
+			[=]() {
+				shared_ptr<Map> map = LoadMap(id);
+				if (map)
+					DuplicateMap(map);
+			},
+			[=]() {
+				shared_ptr<Map> map = LoadMap(id);
+				if (map)
+					RemoveMap(map);
+			}
 		);
 		m_mapLayout->addWidget(item);
 		m_mapItems.push_back(item);
@@ -848,7 +917,7 @@ void ProjectViewWidget::AddPalette()
 		shared_ptr<Palette> palette = dialog.GetResult();
 		m_mainWindow->UpdatePaletteContents(palette);
 		m_mainWindow->OpenPalette(palette);
-		m_mainWindow->AddUndoAction(
+		m_mainWindow->AddUndoAction(palette->GetId(), palette->GetMemoryUsage(),
 			[=]() { // Undo
 				m_mainWindow->ClosePalette(palette);
 				m_project->DeletePalette(palette);
@@ -874,7 +943,7 @@ void ProjectViewWidget::AddTileset()
 		shared_ptr<TileSet> tileSet = dialog.GetResult();
 		m_mainWindow->UpdateTileSetContents(tileSet);
 		m_mainWindow->OpenTileSet(tileSet);
-		m_mainWindow->AddUndoAction(
+		m_mainWindow->AddUndoAction(tileSet->GetId(), tileSet->GetMemoryUsage(),
 			[=]() { // Undo
 				m_mainWindow->UpdateTileSetContents(tileSet);
 				m_mainWindow->CloseTileSet(tileSet);
@@ -900,7 +969,7 @@ void ProjectViewWidget::AddEffectLayer()
 		shared_ptr<MapLayer> layer = dialog.GetResult();
 		m_mainWindow->UpdateEffectLayerContents(layer);
 		m_mainWindow->OpenEffectLayer(layer);
-		m_mainWindow->AddUndoAction(
+		m_mainWindow->AddUndoAction(layer->GetId(), layer->GetMemoryUsage(),
 			[=]() { // Undo
 				m_mainWindow->UpdateEffectLayerContents(layer);
 				m_mainWindow->CloseEffectLayer(layer);
@@ -926,7 +995,7 @@ void ProjectViewWidget::AddMap()
 		shared_ptr<Map> map = dialog.GetResult();
 		m_mainWindow->UpdateMapContents(map);
 		m_mainWindow->OpenMap(map);
-		m_mainWindow->AddUndoAction(
+		m_mainWindow->AddUndoAction(map->GetId(), map->GetMemoryUsage(),
 			[=]() { // Undo
 				m_mainWindow->UpdateMapContents(map);
 				m_mainWindow->CloseMap(map);
@@ -952,7 +1021,7 @@ void ProjectViewWidget::AddSprite()
 		shared_ptr<Sprite> sprite = dialog.GetResult();
 		m_mainWindow->UpdateSpriteContents(sprite);
 		m_mainWindow->OpenSprite(sprite);
-		m_mainWindow->AddUndoAction(
+		m_mainWindow->AddUndoAction(sprite->GetId(), sprite->GetMemoryUsage(),
 			[=]() { // Undo
 				m_mainWindow->UpdateSpriteContents(sprite);
 				m_mainWindow->CloseSprite(sprite);
@@ -992,7 +1061,7 @@ void ProjectViewWidget::AddActorType()
 
 		m_mainWindow->UpdateActorTypeContents(actorType);
 		m_mainWindow->OpenActorType(actorType);
-		m_mainWindow->AddUndoAction(
+		m_mainWindow->AddUndoAction(actorType->GetId(), DEFAULT_UNDO_ACTION_SIZE,
 			[=]() { // Undo
 				m_mainWindow->UpdateActorTypeContents(actorType);
 				m_mainWindow->CloseActorType(actorType);
@@ -30,6 +30,7 @@ class ProjectViewWidget: public QWidget
 	void DuplicatePalette(std::shared_ptr<Palette> palette);
 	void RemovePalette(std::shared_ptr<Palette> palette);
 
+	std::shared_ptr<TileSet> LoadTileSet(const std::string& id);
 	void RenameTileSet(std::shared_ptr<TileSet> tileSet);
 	void DuplicateTileSet(std::shared_ptr<TileSet> tileSet);
 	void RemoveTileSet(std::shared_ptr<TileSet> tileSet);
@@ -38,6 +39,7 @@ class ProjectViewWidget: public QWidget
 	void DuplicateEffectLayer(std::shared_ptr<MapLayer> layer);
 	void RemoveEffectLayer(std::shared_ptr<MapLayer> layer);
 
+	std::shared_ptr<Map> LoadMap(const std::string& id);
 	void RenameMap(std::shared_ptr<Map> map);
 	void DuplicateMap(std::shared_ptr<Map> map);
 	void RemoveMap(std::shared_ptr<Map> map);
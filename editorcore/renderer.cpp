@@ -1,9 +1,35 @@
+#include <QThreadPool>
+#include <QRunnable>
+#include <QSemaphore>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
 #include "renderer.h"
+#include "tilecache.h"
 #include "actor.h"
 
 using namespace std;
 
 
+#define MAX_CACHED_LAYER_PIXELS (2048 * 2048)
+
+
+class RenderBandTask: public QRunnable
+{
+	function<void()> m_func;
+	QSemaphore* m_done;
+
+public:
+	RenderBandTask(const function<void()>& func, QSemaphore* done): m_func(func), m_done(done) {}
+
+	virtual void run() override
+	{
+		m_func();
+		m_done->release();
+	}
+};
+
+
 Renderer::Renderer(shared_ptr<Map> map, uint16_t width, uint16_t height):
 	m_map(map), m_width(width), m_height(height)
 {
@@ -14,52 +40,250 @@ Renderer::Renderer(shared_ptr<Map> map, uint16_t width, uint16_t height):
 	m_scrollY = 0;
 	m_animFrame = 0;
 	m_parallaxEnabled = true;
+
+	m_layerCacheEnabled = false;
+	m_animating = false;
+	m_bandCount = 1;
+
+	m_fullRenderRequired = true;
+	m_singleLayerFullRenderRequired = true;
+	m_renderedScrollX = 0;
+	m_renderedScrollY = 0;
+	m_renderedAnimFrame = 0;
+	m_renderedFloatingLayerRect.x = 0;
+	m_renderedFloatingLayerRect.y = 0;
+	m_renderedFloatingLayerRect.width = 0;
+	m_renderedFloatingLayerRect.height = 0;
+}
+
+
+Renderer::~Renderer()
+{
+	delete[] m_pixels;
+	delete[] m_singleLayerPixels;
+}
+
+
+void Renderer::SetActiveLayer(shared_ptr<MapLayer> layer)
+{
+	if (layer != m_activeLayer)
+		InvalidatePixels();
+	m_activeLayer = layer;
+}
+
+
+void Renderer::SetLayerVisibility(const std::map<shared_ptr<MapLayer>, bool>& vis)
+{
+	if (vis != m_visibility)
+		InvalidatePixels();
+	m_visibility = vis;
+}
+
+
+void Renderer::SetBackgroundColor(uint16_t color)
+{
+	if (color != m_backgroundColor)
+		InvalidatePixels();
+	m_backgroundColor = color;
+}
+
+
+void Renderer::SetParallaxEnabled(bool enable)
+{
+	if (enable != m_parallaxEnabled)
+		InvalidatePixels();
+	m_parallaxEnabled = enable;
+}
+
+
+void Renderer::InvalidatePixels()
+{
+	m_fullRenderRequired = true;
+	m_singleLayerFullRenderRequired = true;
+	m_dirtyRegions.clear();
+	m_singleLayerDirtyRegions.clear();
+}
+
+
+void Renderer::Invalidate()
+{
+	InvalidatePixels();
+	m_layerCaches.clear();
+}
+
+
+void Renderer::InvalidateTileSet(const shared_ptr<TileSet>& tileSet)
+{
+	InvalidatePixels();
+	for (auto& i : m_layerCaches)
+	{
+		if (i.second.tileSetFrames.count(tileSet) != 0)
+			i.second.valid = false;
+	}
+}
+
+
+void Renderer::InvalidatePalette(const shared_ptr<Palette>& palette)
+{
+	InvalidatePixels();
+	for (auto& i : m_layerCaches)
+	{
+		if (i.second.palettes.count(palette) != 0)
+			i.second.valid = false;
+	}
 }
 
 
-void Renderer::RenderPixel(uint16_t* pixels, int16_t x, int16_t y, uint16_t color,
-	BlendMode mode, uint8_t alpha)
+void Renderer::SetLayerCacheEnabled(bool enable)
+{
+	if (enable != m_layerCacheEnabled)
+		InvalidatePixels();
+	m_layerCacheEnabled = enable;
+	if (!enable)
+		m_layerCaches.clear();
+}
+
+
+#define TILE_ROW_CHUNK_SIZE 64
+
+
+// Tiles are rendered from the tile cache in the 16-bit format, transparent pixels have bit 15 set
+static inline bool DecodeTilePixel(const uint8_t* tileDataRow, uint16_t pixelX, uint16_t& color)
 {
-	uint16_t* curPixel = &pixels[((size_t)y * (size_t)m_width) + (size_t)x];
-	uint16_t existingColor = *curPixel;
+	color = *(const uint16_t*)&tileDataRow[pixelX * 2];
+	return (color & 0x8000) == 0;
+}
+
+
+template <BlendMode mode, bool translucent>
+static void RenderTileRow(uint16_t* dest, const uint8_t* tileDataRow, uint16_t leftPixel, uint16_t count,
+	uint8_t alpha)
+{
+	if ((mode == BlendMode_Normal) && !translucent)
+	{
+		for (uint16_t i = 0; i < count; i++)
+		{
+			uint16_t color;
+			if (DecodeTilePixel(tileDataRow, leftPixel + i, color))
+				dest[i] = color;
+		}
+		return;
+	}
+
+	// Decode the row in chunks, then apply the blending mode and alpha blending to the whole chunk
+	// at once before storing the opaque pixels
+	uint16_t color[TILE_ROW_CHUNK_SIZE];
+	bool opaque[TILE_ROW_CHUNK_SIZE];
+	for (uint16_t chunkStart = 0; chunkStart < count; chunkStart += TILE_ROW_CHUNK_SIZE)
+	{
+		uint16_t chunkSize = count - chunkStart;
+		if (chunkSize > TILE_ROW_CHUNK_SIZE)
+			chunkSize = TILE_ROW_CHUNK_SIZE;
+
+		bool anyOpaque = false;
+		for (uint16_t i = 0; i < chunkSize; i++)
+		{
+			color[i] = 0;
+			opaque[i] = DecodeTilePixel(tileDataRow, leftPixel + chunkStart + i, color[i]);
+			anyOpaque |= opaque[i];
+		}
+		if (!anyOpaque)
+			continue;
+
+		uint16_t* chunkDest = &dest[chunkStart];
+		switch (mode)
+		{
+		case BlendMode_Add:
+			Palette::AddColors(color, chunkDest, color, chunkSize);
+			break;
+		case BlendMode_Subtract:
+			Palette::SubColors(color, chunkDest, color, chunkSize);
+			break;
+		case BlendMode_Multiply:
+			Palette::MultiplyColors(color, chunkDest, color, chunkSize);
+			break;
+		default:
+			break;
+		}
+		if (translucent)
+			Palette::BlendColors(color, chunkDest, color, alpha, chunkSize);
 
-	// Apply the current blending mode
+		for (uint16_t i = 0; i < chunkSize; i++)
+		{
+			if (opaque[i])
+				chunkDest[i] = color[i];
+		}
+	}
+}
+
+
+Renderer::TileRowKernel Renderer::GetTileRowKernel(BlendMode mode, uint8_t alpha)
+{
+	bool translucent = alpha != 0;
 	switch (mode)
 	{
 	case BlendMode_Add:
-		color = Palette::AddColor(existingColor, color);
-		break;
+		return translucent ? RenderTileRow<BlendMode_Add, true> : RenderTileRow<BlendMode_Add, false>;
 	case BlendMode_Subtract:
-		color = Palette::SubColor(existingColor, color);
-		break;
+		return translucent ? RenderTileRow<BlendMode_Subtract, true> : RenderTileRow<BlendMode_Subtract, false>;
 	case BlendMode_Multiply:
-		color = Palette::MultiplyColor(existingColor, color);
-		break;
+		return translucent ? RenderTileRow<BlendMode_Multiply, true> : RenderTileRow<BlendMode_Multiply, false>;
 	default:
-		break;
+		return translucent ? RenderTileRow<BlendMode_Normal, true> : RenderTileRow<BlendMode_Normal, false>;
 	}
+}
 
-	// Compute and store final pixel value using the alpha blending mode
-	if (alpha == 0)
-		*curPixel = color;
-	else
-		*curPixel = Palette::BlendColor(existingColor, color, alpha);
+
+shared_ptr<const vector<uint16_t>> Renderer::GetTilePixels(const shared_ptr<Tile>& tile, uint16_t frame,
+	const uint8_t*& data, size_t& pitch)
+{
+	if (tile->GetDepth() == 16)
+	{
+		// Read through the const overload, which does not copy pixel data shared with a snapshot
+		data = static_cast<const Tile&>(*tile).GetData(frame);
+		pitch = tile->GetPitch();
+		return shared_ptr<const vector<uint16_t>>();
+	}
+
+	// Palette based tiles are resolved once through the shared tile cache
+	shared_ptr<const vector<uint16_t>> pixels = TileCache::GetPixels(tile, frame);
+	data = (const uint8_t*)&(*pixels)[0];
+	pitch = (size_t)tile->GetWidth() * sizeof(uint16_t);
+	return pixels;
 }
 
 
-void Renderer::RenderMapLayer(uint16_t* pixels, shared_ptr<MapLayer> layer, bool forceNormalBlend)
+void Renderer::GetLayerScroll(const shared_ptr<MapLayer>& layer, uint16_t viewScrollX, uint16_t viewScrollY,
+	uint32_t animFrame, int16_t& scrollX, int16_t& scrollY)
 {
-	int16_t scrollX = m_scrollX;
-	int16_t scrollY = m_scrollY;
+	scrollX = viewScrollX;
+	scrollY = viewScrollY;
 	if (m_parallaxEnabled)
 	{
-		int animX = ((int)layer->GetAutoScrollX() * m_animFrame) / 0x100;
-		int animY = ((int)layer->GetAutoScrollY() * m_animFrame) / 0x100;
+		int animX = ((int)layer->GetAutoScrollX() * animFrame) / 0x100;
+		int animY = ((int)layer->GetAutoScrollY() * animFrame) / 0x100;
 		scrollX = (int16_t)((scrollX * layer->GetParallaxFactorX()) / 0x100 + animX);
 		scrollY = (int16_t)((scrollY * layer->GetParallaxFactorY()) / 0x100 + animY);
 	}
+}
+
+
+void Renderer::GetLayerScroll(const shared_ptr<MapLayer>& layer, int16_t& scrollX, int16_t& scrollY)
+{
+	GetLayerScroll(layer, m_scrollX, m_scrollY, m_animFrame, scrollX, scrollY);
+}
+
+
+void Renderer::RenderMapLayer(uint16_t* pixels, shared_ptr<MapLayer> layer, const RenderRect& rect,
+	bool forceNormalBlend)
+{
+	int16_t scrollX, scrollY;
+	GetLayerScroll(layer, scrollX, scrollY);
+	scrollX = (int16_t)(scrollX + rect.x);
+	scrollY = (int16_t)(scrollY + rect.y);
 
 	// Capture layer settings
+	bool floatingLayerActive = m_floatingLayer && (m_floatingLayer->GetMapLayer() == layer);
 	uint16_t tileWidth = layer->GetTileWidth();
 	uint16_t tileHeight = layer->GetTileHeight();
 	size_t tileDepth = layer->GetTileDepth();
@@ -72,17 +296,20 @@ void Renderer::RenderMapLayer(uint16_t* pixels, shared_ptr<MapLayer> layer, bool
 		alpha = 0;
 	}
 
+	// Tiles are always rendered from 16-bit pixels, so the row kernel is chosen once per layer
+	TileRowKernel kernel = GetTileRowKernel(blendMode, alpha);
+
 	uint16_t leftTile = scrollX / tileWidth;
 	uint16_t leftPixel = scrollX % tileWidth;
-	uint16_t rightTile = (scrollX + m_width - 1) / tileWidth;
-	uint16_t rightPixel = (scrollX + m_width - 1) % tileWidth;
+	uint16_t rightTile = (scrollX + rect.width - 1) / tileWidth;
+	uint16_t rightPixel = (scrollX + rect.width - 1) % tileWidth;
 	uint16_t topTile = scrollY / tileHeight;
 	uint16_t topPixel = scrollY % tileHeight;
-	uint16_t bottomTile = (scrollY + m_height - 1) / tileHeight;
-	uint16_t bottomPixel = (scrollY + m_height - 1) % tileHeight;
+	uint16_t bottomTile = (scrollY + rect.height - 1) / tileHeight;
+	uint16_t bottomPixel = (scrollY + rect.height - 1) % tileHeight;
 
 	// Render layer
-	uint16_t targetY = 0;
+	uint16_t targetY = rect.y;
 	for (uint16_t tileY = topTile; tileY <= bottomTile; tileY++)
 	{
 		// Compute rendering extents for current row of tiles
@@ -96,55 +323,69 @@ void Renderer::RenderMapLayer(uint16_t* pixels, shared_ptr<MapLayer> layer, bool
 		else
 			curBottomPixel = tileHeight - 1;
 
-		uint16_t targetX = 0;
+		size_t chunkY = tileY >> MAP_LAYER_CHUNK_SHIFT;
+		size_t chunkRowOffset = (tileY & (MAP_LAYER_CHUNK_SIZE - 1)) << MAP_LAYER_CHUNK_SHIFT;
+
+		uint16_t targetX = rect.x;
 		for (uint16_t tileX = leftTile; tileX <= rightTile; tileX++)
 		{
-			// Look up tile in map layer
-			TileReference ref = layer->GetTileAt(tileX, tileY);
-			if (m_floatingLayer && (m_floatingLayer->GetMapLayer() == layer) &&
+			uint16_t tileTargetX = targetX;
+			if (tileX == leftTile)
+				targetX += tileWidth - leftPixel;
+			else
+				targetX += tileWidth;
+
+			// Skip to the end of chunks that have no tiles
+			const MapLayerCell* chunk = layer->GetTileChunk(tileX >> MAP_LAYER_CHUNK_SHIFT, chunkY);
+			if ((!chunk) && (!floatingLayerActive))
+			{
+				uint16_t lastTile = (uint16_t)min((size_t)rightTile,
+					((((size_t)tileX >> MAP_LAYER_CHUNK_SHIFT) + 1) << MAP_LAYER_CHUNK_SHIFT) - 1);
+				targetX += (lastTile - tileX) * tileWidth;
+				tileX = lastTile;
+				continue;
+			}
+
+			// Look up tile in map layer, the table entries are borrowed to avoid reference counting per tile
+			TileSet* tileSet = nullptr;
+			uint16_t index = 0;
+			if (chunk)
+			{
+				const MapLayerCell& cell = chunk[chunkRowOffset + (tileX & (MAP_LAYER_CHUNK_SIZE - 1))];
+				tileSet = layer->GetTileSetForCell(cell).get();
+				index = cell.index;
+			}
+			MapFloatingLayerTile floatingTile;
+			if (floatingLayerActive &&
 				((int)tileX >= m_floatingLayer->GetX()) && ((int)tileY >= m_floatingLayer->GetY()) &&
 				((int)tileX < (m_floatingLayer->GetX() + m_floatingLayer->GetWidth())) &&
 				((int)tileY < (m_floatingLayer->GetY() + m_floatingLayer->GetHeight())))
 			{
-				MapFloatingLayerTile floatingTile = m_floatingLayer->GetTile(tileX - m_floatingLayer->GetX(),
+				floatingTile = m_floatingLayer->GetTile(tileX - m_floatingLayer->GetX(),
 					tileY - m_floatingLayer->GetY());
 				if (floatingTile.valid)
 				{
-					ref.tileSet = floatingTile.tileSet;
-					ref.index = floatingTile.index;
+					tileSet = floatingTile.tileSet.get();
+					index = floatingTile.index;
 				}
 			}
 
-			if (!ref.tileSet)
-			{
-				if (tileX == leftTile)
-					targetX += tileWidth - leftPixel;
-				else
-					targetX += tileWidth;
+			if (!tileSet)
 				continue;
-			}
 
-			shared_ptr<Tile> tile = ref.tileSet->GetTile(ref.index);
+			const vector<shared_ptr<Tile>>& tiles = tileSet->GetTiles();
+			if (index >= tiles.size())
+				continue;
+			const shared_ptr<Tile>& tile = tiles[index];
 			if (!tile)
-			{
-				if (tileX == leftTile)
-					targetX += tileWidth - leftPixel;
-				else
-					targetX += tileWidth;
 				continue;
-			}
-			shared_ptr<Palette> palette = tile->GetPalette();
-			if ((!palette) && (tileDepth != 16))
-			{
-				if (tileX == leftTile)
-					targetX += tileWidth - leftPixel;
-				else
-					targetX += tileWidth;
+			if ((!tile->GetPalette()) && ((tileDepth != 16) || (tile->GetDepth() != 16)))
 				continue;
-			}
 
-			uint16_t frame = ref.tileSet->GetFrameForTime(m_animFrame);
-			const uint8_t* tileData = tile->GetData(frame);
+			uint16_t frame = tileSet->GetFrameForTime(m_animFrame);
+			const uint8_t* tileData;
+			size_t tilePitch;
+			shared_ptr<const vector<uint16_t>> tilePixels = GetTilePixels(tile, frame, tileData, tilePitch);
 
 			// Compute rendering extents for current tile
 			uint16_t curLeftPixel, curRightPixel;
@@ -156,42 +397,14 @@ void Renderer::RenderMapLayer(uint16_t* pixels, shared_ptr<MapLayer> layer, bool
 				curRightPixel = rightPixel;
 			else
 				curRightPixel = tileWidth - 1;
+			uint16_t count = (curRightPixel - curLeftPixel) + 1;
 
+			uint16_t* dest = &pixels[((size_t)targetY * (size_t)m_width) + (size_t)tileTargetX];
 			for (uint16_t pixelY = curTopPixel; pixelY <= curBottomPixel; pixelY++)
 			{
-				const uint8_t* tileDataRow = &tileData[pixelY * tile->GetPitch()];
-				for (uint16_t pixelX = curLeftPixel; pixelX <= curRightPixel; pixelX++)
-				{
-					uint16_t color = 0;
-					if (tile->GetDepth() == 4)
-					{
-						uint8_t colorIndex = (tileDataRow[pixelX / 2] >> (((pixelX) & 1) << 2)) & 0xf;
-						if (colorIndex == 0)
-							continue;
-						color = palette->GetEntry(tile->GetPaletteOffset() + colorIndex);
-					}
-					else if (tile->GetDepth() == 8)
-					{
-						uint8_t colorIndex = tileDataRow[pixelX];
-						if (colorIndex == 0)
-							continue;
-						color = palette->GetEntry(tile->GetPaletteOffset() + colorIndex);
-					}
-					else if (tile->GetDepth() == 16)
-					{
-						color = *(const uint16_t*)&tileDataRow[pixelX * 2];
-						if (color & 0x8000)
-							continue;
-					}
-
-					RenderPixel(pixels, targetX + pixelX - curLeftPixel, targetY + pixelY - curTopPixel, color, blendMode, alpha);
-				}
+				kernel(dest, &tileData[pixelY * tilePitch], curLeftPixel, count, alpha);
+				dest += m_width;
 			}
-
-			if (tileX == leftTile)
-				targetX += tileWidth - leftPixel;
-			else
-				targetX += tileWidth;
 		}
 
 		if (tileY == topTile)
@@ -202,82 +415,216 @@ void Renderer::RenderMapLayer(uint16_t* pixels, shared_ptr<MapLayer> layer, bool
 }
 
 
-void Renderer::RenderSprite(uint16_t* pixels, int16_t x, int16_t y, shared_ptr<Sprite> sprite)
+void Renderer::RasterizeLayerTile(LayerCache& cache, const shared_ptr<MapLayer>& layer, size_t x, size_t y)
 {
-	shared_ptr<SpriteAnimation> animation = sprite->GetAnimation(0);
-	if (!animation)
+	size_t tileWidth = layer->GetTileWidth();
+	size_t tileHeight = layer->GetTileHeight();
+	uint16_t* dest = &cache.pixels[(y * tileHeight * cache.width) + (x * tileWidth)];
+	for (size_t pixelY = 0; pixelY < tileHeight; pixelY++)
+		for (size_t pixelX = 0; pixelX < tileWidth; pixelX++)
+			dest[(pixelY * cache.width) + pixelX] = 0x8000;
+
+	const MapLayerCell* chunk = layer->GetTileChunk(x >> MAP_LAYER_CHUNK_SHIFT, y >> MAP_LAYER_CHUNK_SHIFT);
+	if (!chunk)
 		return;
-	shared_ptr<Tile> tile = animation->GetTile();
+	const MapLayerCell& cell = chunk[((y & (MAP_LAYER_CHUNK_SIZE - 1)) << MAP_LAYER_CHUNK_SHIFT) +
+		(x & (MAP_LAYER_CHUNK_SIZE - 1))];
+	const shared_ptr<TileSet>& tileSet = layer->GetTileSetForCell(cell);
+	if (!tileSet)
+		return;
+	const vector<shared_ptr<Tile>>& tiles = tileSet->GetTiles();
+	if (cell.index >= tiles.size())
+		return;
+	const shared_ptr<Tile>& tile = tiles[cell.index];
 	if (!tile)
 		return;
-	shared_ptr<Palette> palette = tile->GetPalette();
-	const uint8_t* tileData = tile->GetData(0);
+	if ((!tile->GetPalette()) && ((layer->GetTileDepth() != 16) || (tile->GetDepth() != 16)))
+		return;
 
-	for (int16_t pixelY = 0; pixelY < (int16_t)tile->GetHeight(); pixelY++)
+	// Remember what the cached pixels were built from so that they can be invalidated
+	uint16_t frame = tileSet->GetFrameForTime(m_animFrame);
+	cache.tileSetFrames[tileSet] = frame;
+	if (tile->GetPalette())
+		cache.palettes.insert(tile->GetPalette());
+
+	const uint8_t* tileData;
+	size_t tilePitch;
+	shared_ptr<const vector<uint16_t>> tilePixels = GetTilePixels(tile, frame, tileData, tilePitch);
+	TileRowKernel kernel = GetTileRowKernel(BlendMode_Normal, 0);
+	for (size_t pixelY = 0; pixelY < tileHeight; pixelY++)
 	{
-		if (((y - m_scrollY) + pixelY) < 0)
-			continue;
-		if ((uint16_t)((y - m_scrollY) + pixelY) >= m_height)
-			break;
+		kernel(dest, &tileData[pixelY * tilePitch], 0, (uint16_t)tileWidth, 0);
+		dest += cache.width;
+	}
+}
 
-		const uint8_t* tileDataRow = &tileData[pixelY * tile->GetPitch()];
 
-		for (int16_t pixelX = 0; pixelX < (int16_t)tile->GetWidth(); pixelX++)
-		{
-			if (((x - m_scrollX) + pixelX) < 0)
-				continue;
-			if ((uint16_t)((x - m_scrollX) + pixelX) >= m_width)
-				break;
+Renderer::LayerCache* Renderer::GetLayerCache(const shared_ptr<MapLayer>& layer)
+{
+	// A layer with animated tiles would be rebuilt on every frame of the preview, which is slower than
+	// rendering it from the tiles. Its cache is dropped until the preview stops.
+	if (m_animating && IsLayerAnimated(layer))
+	{
+		m_layerCaches.erase(layer);
+		return nullptr;
+	}
 
-			uint16_t color = 0;
-			if (tile->GetDepth() == 4)
-			{
-				uint8_t colorIndex = (tileDataRow[pixelX / 2] >> (((pixelX) & 1) << 2)) & 0xf;
-				if (colorIndex == 0)
-					continue;
-				color = palette->GetEntry(tile->GetPaletteOffset() + colorIndex);
-			}
-			else if (tile->GetDepth() == 8)
+	LayerCache& cache = m_layerCaches[layer];
+	size_t width = layer->GetWidth() * layer->GetTileWidth();
+	size_t height = layer->GetHeight() * layer->GetTileHeight();
+	if ((cache.width != width) || (cache.height != height))
+		cache.valid = false;
+
+	// Animated tile sets that have moved on to another frame require the layer to be rebuilt
+	if (cache.valid)
+	{
+		for (auto& i : cache.tileSetFrames)
+		{
+			if (i.first->GetFrameForTime(m_animFrame) != i.second)
 			{
-				uint8_t colorIndex = tileDataRow[pixelX];
-				if (colorIndex == 0)
-					continue;
-				color = palette->GetEntry(tile->GetPaletteOffset() + colorIndex);
+				cache.valid = false;
+				break;
 			}
-			else if (tile->GetDepth() == 16)
+		}
+	}
+
+	if (cache.valid && (cache.changeCount != layer->GetChangeCount()))
+	{
+		vector<pair<size_t, size_t>> changedTiles;
+		if (layer->GetChangedTilesSince(cache.changeCount, changedTiles))
+		{
+			for (auto& i : changedTiles)
+				RasterizeLayerTile(cache, layer, i.first, i.second);
+			cache.changeCount = layer->GetChangeCount();
+		}
+		else
+		{
+			cache.valid = false;
+		}
+	}
+
+	if (!cache.valid)
+	{
+		cache.width = width;
+		cache.height = height;
+		cache.pixels.assign(width * height, 0x8000);
+		cache.tileSetFrames.clear();
+		cache.palettes.clear();
+		for (size_t chunkY = 0; chunkY < layer->GetHeightInChunks(); chunkY++)
+		{
+			for (size_t chunkX = 0; chunkX < layer->GetWidthInChunks(); chunkX++)
 			{
-				color = *(const uint16_t*)&tileDataRow[pixelX * 2];
-				if (color & 0x8000)
+				if (!layer->GetTileChunk(chunkX, chunkY))
 					continue;
+				size_t left = chunkX << MAP_LAYER_CHUNK_SHIFT;
+				size_t top = chunkY << MAP_LAYER_CHUNK_SHIFT;
+				size_t right = min(left + MAP_LAYER_CHUNK_SIZE, layer->GetWidth());
+				size_t bottom = min(top + MAP_LAYER_CHUNK_SIZE, layer->GetHeight());
+				for (size_t y = top; y < bottom; y++)
+					for (size_t x = left; x < right; x++)
+						RasterizeLayerTile(cache, layer, x, y);
 			}
-
-			RenderPixel(pixels, (x - m_scrollX) + pixelX, (y - m_scrollY) + pixelY, color, BlendMode_Normal, 0);
 		}
+		cache.changeCount = layer->GetChangeCount();
+		cache.valid = true;
 	}
+
+	return &cache;
 }
 
 
-bool Renderer::IsLayerVisible(shared_ptr<MapLayer> layer)
+void Renderer::RenderCachedMapLayer(uint16_t* pixels, shared_ptr<MapLayer> layer, const LayerCache& cache,
+	const RenderRect& rect, bool forceNormalBlend)
 {
-	auto i = m_visibility.find(layer);
-	if (i == m_visibility.end())
-		return true;
-	return i->second;
+	int16_t scrollX, scrollY;
+	GetLayerScroll(layer, scrollX, scrollY);
+
+	BlendMode blendMode = layer->GetBlendMode();
+	uint8_t alpha = layer->GetAlpha();
+	if (forceNormalBlend)
+	{
+		blendMode = BlendMode_Normal;
+		alpha = 0;
+	}
+
+	// The cached surface uses the same format as 16-bit tiles, so it is composited with the same kernels
+	TileRowKernel kernel = GetTileRowKernel(blendMode, alpha);
+	if (!kernel)
+		return;
+
+	int layerX = (int)scrollX + rect.x;
+	int left = max(-layerX, 0);
+	int right = min(rect.width, (int)cache.width - layerX);
+	if (left >= right)
+		return;
+
+	for (int y = 0; y < rect.height; y++)
+	{
+		int layerY = (int)scrollY + rect.y + y;
+		if ((layerY < 0) || (layerY >= (int)cache.height))
+			continue;
+
+		uint16_t* dest = &pixels[((size_t)(rect.y + y) * (size_t)m_width) + (size_t)(rect.x + left)];
+		const uint16_t* src = &cache.pixels[((size_t)layerY * cache.width) + (size_t)(layerX + left)];
+		kernel(dest, (const uint8_t*)src, 0, (uint16_t)(right - left), alpha);
+	}
 }
 
 
-void Renderer::Render()
+void Renderer::RenderSprite(uint16_t* pixels, int16_t x, int16_t y, shared_ptr<Sprite> sprite,
+	const RenderRect& rect)
 {
-	for (size_t i = 0; i < ((size_t)m_width * (size_t)m_height); i++)
-		m_pixels[i] = m_backgroundColor;
+	shared_ptr<SpriteAnimation> animation = sprite->GetAnimation(0);
+	if (!animation)
+		return;
+	shared_ptr<Tile> tile = animation->GetTile();
+	if (!tile)
+		return;
+	if ((tile->GetDepth() != 16) && (!tile->GetPalette()))
+		return;
+	TileRowKernel kernel = GetTileRowKernel(BlendMode_Normal, 0);
+	const uint8_t* tileData;
+	size_t tilePitch;
+	shared_ptr<const vector<uint16_t>> tilePixels = GetTilePixels(tile, 0, tileData, tilePitch);
 
-	for (auto& i : m_map->GetLayers())
+	// Clip sprite against the region being rendered
+	int targetX = x - m_scrollX;
+	int targetY = y - m_scrollY;
+	int leftPixel = 0;
+	int rightPixel = (int)tile->GetWidth();
+	if (targetX < rect.x)
+		leftPixel = rect.x - targetX;
+	if ((targetX + rightPixel) > (rect.x + rect.width))
+		rightPixel = (rect.x + rect.width) - targetX;
+	if (leftPixel >= rightPixel)
+		return;
+
+	for (int pixelY = 0; pixelY < (int)tile->GetHeight(); pixelY++)
 	{
-		if ((i != m_activeLayer) && !IsLayerVisible(i))
+		if ((targetY + pixelY) < rect.y)
 			continue;
-		RenderMapLayer(m_pixels, i);
+		if ((targetY + pixelY) >= (rect.y + rect.height))
+			break;
+
+		uint16_t* dest = &pixels[((size_t)(targetY + pixelY) * (size_t)m_width) + (size_t)(targetX + leftPixel)];
+		kernel(dest, &tileData[pixelY * tilePitch], (uint16_t)leftPixel,
+			(uint16_t)(rightPixel - leftPixel), 0);
 	}
+}
+
 
+bool Renderer::IsLayerVisible(shared_ptr<MapLayer> layer)
+{
+	auto i = m_visibility.find(layer);
+	if (i == m_visibility.end())
+		return true;
+	return i->second;
+}
+
+
+vector<Renderer::RenderedActor> Renderer::GetActorsToRender()
+{
+	vector<RenderedActor> result;
 	size_t tileWidth = m_map->GetMainLayer()->GetTileWidth();
 	size_t tileHeight = m_map->GetMainLayer()->GetTileHeight();
 
@@ -290,20 +637,453 @@ void Renderer::Render()
 		if (!sprite)
 			continue;
 
-		int16_t x = (int16_t)((i->GetX() * tileWidth) + ((i->GetWidth() * tileWidth) / 2) - (sprite->GetWidth() / 2));
-		int16_t y = (int16_t)((i->GetY() * tileHeight) + ((i->GetHeight() * tileHeight) / 2) - (sprite->GetHeight() / 2));
-		RenderSprite(m_pixels, x, y, sprite);
+		RenderedActor actor;
+		actor.sprite = sprite;
+		actor.x = (int16_t)((i->GetX() * tileWidth) + ((i->GetWidth() * tileWidth) / 2) - (sprite->GetWidth() / 2));
+		actor.y = (int16_t)((i->GetY() * tileHeight) + ((i->GetHeight() * tileHeight) / 2) - (sprite->GetHeight() / 2));
+		result.push_back(actor);
+	}
+
+	return result;
+}
+
+
+RenderRect Renderer::GetTileRect(const shared_ptr<MapLayer>& layer, int x, int y, int width, int height)
+{
+	int16_t scrollX, scrollY;
+	GetLayerScroll(layer, scrollX, scrollY);
+
+	RenderRect result;
+	result.x = (x * (int)layer->GetTileWidth()) - scrollX;
+	result.y = (y * (int)layer->GetTileHeight()) - scrollY;
+	result.width = width * (int)layer->GetTileWidth();
+	result.height = height * (int)layer->GetTileHeight();
+	return result;
+}
+
+
+void Renderer::AddDirtyRegion(const RenderRect& rect)
+{
+	// Clip region to the render target
+	int left = (rect.x < 0) ? 0 : rect.x;
+	int top = (rect.y < 0) ? 0 : rect.y;
+	int right = rect.x + rect.width;
+	int bottom = rect.y + rect.height;
+	if (right > (int)m_width)
+		right = m_width;
+	if (bottom > (int)m_height)
+		bottom = m_height;
+	if ((left >= right) || (top >= bottom))
+		return;
+
+	RenderRect clipped;
+	clipped.x = left;
+	clipped.y = top;
+	clipped.width = right - left;
+	clipped.height = bottom - top;
+
+	for (vector<RenderRect>* regions : {&m_dirtyRegions, &m_singleLayerDirtyRegions})
+	{
+		bool covered = false;
+		for (auto& i : *regions)
+		{
+			if ((clipped.x >= i.x) && (clipped.y >= i.y) && ((clipped.x + clipped.width) <= (i.x + i.width)) &&
+				((clipped.y + clipped.height) <= (i.y + i.height)))
+			{
+				covered = true;
+				break;
+			}
+		}
+		if (covered)
+			continue;
+
+		if (regions->size() < 64)
+		{
+			regions->push_back(clipped);
+			continue;
+		}
+
+		// Too many separate regions, fall back to recomposing their bounding box
+		RenderRect bounds = clipped;
+		for (auto& i : *regions)
+		{
+			int boundsRight = max(bounds.x + bounds.width, i.x + i.width);
+			int boundsBottom = max(bounds.y + bounds.height, i.y + i.height);
+			bounds.x = min(bounds.x, i.x);
+			bounds.y = min(bounds.y, i.y);
+			bounds.width = boundsRight - bounds.x;
+			bounds.height = boundsBottom - bounds.y;
+		}
+		regions->clear();
+		regions->push_back(bounds);
+	}
+}
+
+
+void Renderer::ShiftRegions(vector<RenderRect>& regions, int deltaX, int deltaY)
+{
+	vector<RenderRect> shifted;
+	for (auto& i : regions)
+	{
+		int left = max(i.x - deltaX, 0);
+		int top = max(i.y - deltaY, 0);
+		int right = min(i.x + i.width - deltaX, (int)m_width);
+		int bottom = min(i.y + i.height - deltaY, (int)m_height);
+		if ((left >= right) || (top >= bottom))
+			continue;
+
+		RenderRect rect;
+		rect.x = left;
+		rect.y = top;
+		rect.width = right - left;
+		rect.height = bottom - top;
+		shifted.push_back(rect);
+	}
+	regions = shifted;
+}
+
+
+void Renderer::ScrollPixels(uint16_t* pixels, int deltaX, int deltaY)
+{
+	int width = (int)m_width - abs(deltaX);
+	int srcX = max(deltaX, 0);
+	int destX = max(-deltaX, 0);
+	int height = (int)m_height - abs(deltaY);
+
+	// Walk rows in the direction that does not overwrite rows that have not been moved yet
+	for (int i = 0; i < height; i++)
+	{
+		int destY = (deltaY >= 0) ? i : (int)m_height - 1 - i;
+		int srcY = destY + deltaY;
+		memmove(&pixels[((size_t)destY * (size_t)m_width) + (size_t)destX],
+			&pixels[((size_t)srcY * (size_t)m_width) + (size_t)srcX], (size_t)width * sizeof(uint16_t));
+	}
+}
+
+
+void Renderer::ScrollRenderedPixels()
+{
+	int deltaX = (int)m_scrollX - (int)m_renderedScrollX;
+	int deltaY = (int)m_scrollY - (int)m_renderedScrollY;
+	if ((abs(deltaX) >= (int)m_width) || (abs(deltaY) >= (int)m_height))
+	{
+		InvalidatePixels();
+		return;
+	}
+
+	// Rendered pixels can only be moved if every layer scrolls by the same amount as the view, which
+	// is not the case for layers with parallax
+	for (auto& i : m_map->GetLayers())
+	{
+		int16_t oldX, oldY, newX, newY;
+		GetLayerScroll(i, m_renderedScrollX, m_renderedScrollY, m_animFrame, oldX, oldY);
+		GetLayerScroll(i, m_scrollX, m_scrollY, m_animFrame, newX, newY);
+		if ((((int)newX - (int)oldX) != deltaX) || (((int)newY - (int)oldY) != deltaY))
+		{
+			InvalidatePixels();
+			return;
+		}
+	}
+
+	if (!m_fullRenderRequired)
+		ScrollPixels(m_pixels, deltaX, deltaY);
+	if (!m_singleLayerFullRenderRequired)
+		ScrollPixels(m_singleLayerPixels, deltaX, deltaY);
+	ShiftRegions(m_dirtyRegions, deltaX, deltaY);
+	ShiftRegions(m_singleLayerDirtyRegions, deltaX, deltaY);
+	m_renderedFloatingLayerRect.x -= deltaX;
+	m_renderedFloatingLayerRect.y -= deltaY;
+
+	// Render the newly exposed strips
+	RenderRect rect;
+	if (deltaX != 0)
+	{
+		rect.x = (deltaX > 0) ? ((int)m_width - deltaX) : 0;
+		rect.y = 0;
+		rect.width = abs(deltaX);
+		rect.height = m_height;
+		AddDirtyRegion(rect);
+	}
+	if (deltaY != 0)
+	{
+		rect.x = 0;
+		rect.y = (deltaY > 0) ? ((int)m_height - deltaY) : 0;
+		rect.width = m_width;
+		rect.height = abs(deltaY);
+		AddDirtyRegion(rect);
 	}
 }
 
 
+void Renderer::UpdateDirtyRegions()
+{
+	// Animation moves and changes everything on screen, scrolling can reuse what is already rendered
+	if (m_animFrame != m_renderedAnimFrame)
+		InvalidatePixels();
+	else if ((m_scrollX != m_renderedScrollX) || (m_scrollY != m_renderedScrollY))
+		ScrollRenderedPixels();
+	m_renderedScrollX = m_scrollX;
+	m_renderedScrollY = m_scrollY;
+	m_renderedAnimFrame = m_animFrame;
+
+	// Find tiles changed since the last render
+	std::map<shared_ptr<MapLayer>, uint64_t> layerChangeCounts;
+	for (auto& i : m_map->GetLayers())
+	{
+		layerChangeCounts[i] = i->GetChangeCount();
+		if (m_fullRenderRequired && m_singleLayerFullRenderRequired)
+			continue;
+
+		auto j = m_renderedLayerChangeCounts.find(i);
+		if (j == m_renderedLayerChangeCounts.end())
+		{
+			InvalidatePixels();
+			continue;
+		}
+		if (j->second == i->GetChangeCount())
+			continue;
+
+		vector<pair<size_t, size_t>> changedTiles;
+		if (!i->GetChangedTilesSince(j->second, changedTiles))
+		{
+			InvalidatePixels();
+			continue;
+		}
+		for (auto& k : changedTiles)
+			AddDirtyRegion(GetTileRect(i, (int)k.first, (int)k.second, 1, 1));
+	}
+	m_renderedLayerChangeCounts = layerChangeCounts;
+
+	// Floating layers are replaced or moved while using the editing tools
+	RenderRect floatingLayerRect;
+	if (m_floatingLayer)
+	{
+		floatingLayerRect = GetTileRect(m_floatingLayer->GetMapLayer(), m_floatingLayer->GetX(),
+			m_floatingLayer->GetY(), m_floatingLayer->GetWidth(), m_floatingLayer->GetHeight());
+	}
+	else
+	{
+		floatingLayerRect.x = floatingLayerRect.y = floatingLayerRect.width = floatingLayerRect.height = 0;
+	}
+	if ((m_floatingLayer != m_renderedFloatingLayer) || (floatingLayerRect.x != m_renderedFloatingLayerRect.x) ||
+		(floatingLayerRect.y != m_renderedFloatingLayerRect.y) ||
+		(floatingLayerRect.width != m_renderedFloatingLayerRect.width) ||
+		(floatingLayerRect.height != m_renderedFloatingLayerRect.height))
+	{
+		AddDirtyRegion(m_renderedFloatingLayerRect);
+		AddDirtyRegion(floatingLayerRect);
+		m_renderedFloatingLayer = m_floatingLayer;
+		m_renderedFloatingLayerRect = floatingLayerRect;
+	}
+
+	// Find actors that have moved, appeared or disappeared
+	vector<RenderedActor> actors = GetActorsToRender();
+	size_t actorCount = max(actors.size(), m_renderedActors.size());
+	for (size_t i = 0; i < actorCount; i++)
+	{
+		if ((i < actors.size()) && (i < m_renderedActors.size()) && (actors[i].sprite == m_renderedActors[i].sprite) &&
+			(actors[i].x == m_renderedActors[i].x) && (actors[i].y == m_renderedActors[i].y))
+			continue;
+
+		for (vector<RenderedActor>* list : {&actors, &m_renderedActors})
+		{
+			if (i >= list->size())
+				continue;
+			RenderRect rect;
+			rect.x = (*list)[i].x - m_scrollX;
+			rect.y = (*list)[i].y - m_scrollY;
+			rect.width = (int)(*list)[i].sprite->GetWidth();
+			rect.height = (int)(*list)[i].sprite->GetHeight();
+			AddDirtyRegion(rect);
+		}
+	}
+	m_renderedActors = actors;
+}
+
+
+bool Renderer::IsLayerAnimated(const shared_ptr<MapLayer>& layer)
+{
+	for (auto& i : layer->GetReferencedTileSets())
+	{
+		if (i && (i->GetFrameCount() > 1))
+			return true;
+	}
+	return false;
+}
+
+
+bool Renderer::IsLayerCached(const shared_ptr<MapLayer>& layer)
+{
+	if (!m_layerCacheEnabled)
+		return false;
+
+	// Very large layers would take too much memory to keep rasterized
+	if ((layer->GetWidth() * layer->GetTileWidth() * layer->GetHeight() * layer->GetTileHeight()) >
+		MAX_CACHED_LAYER_PIXELS)
+		return false;
+
+	// The layer under the floating layer changes on every mouse move, so it is always rendered from the tiles
+	return !(m_floatingLayer && (m_floatingLayer->GetMapLayer() == layer));
+}
+
+
+void Renderer::PrepareLayerCaches(bool singleLayer)
+{
+	// Layer caches are brought up to date before rendering, as the bands only read from them
+	if (singleLayer)
+	{
+		if (m_activeLayer && IsLayerCached(m_activeLayer))
+			GetLayerCache(m_activeLayer);
+		return;
+	}
+
+	for (auto& i : m_map->GetLayers())
+	{
+		if ((i != m_activeLayer) && !IsLayerVisible(i))
+			continue;
+		if (IsLayerCached(i))
+			GetLayerCache(i);
+	}
+}
+
+
+void Renderer::RenderLayer(uint16_t* pixels, shared_ptr<MapLayer> layer, const RenderRect& rect,
+	bool forceNormalBlend)
+{
+	auto cache = m_layerCaches.find(layer);
+	if ((!IsLayerCached(layer)) || (cache == m_layerCaches.end()) || (!cache->second.valid))
+	{
+		RenderMapLayer(pixels, layer, rect, forceNormalBlend);
+		return;
+	}
+
+	RenderCachedMapLayer(pixels, layer, cache->second, rect, forceNormalBlend);
+}
+
+
+void Renderer::RenderRegion(uint16_t* pixels, const RenderRect& rect, bool singleLayer)
+{
+	for (int y = rect.y; y < (rect.y + rect.height); y++)
+	{
+		uint16_t* row = &pixels[((size_t)y * (size_t)m_width) + (size_t)rect.x];
+		for (int x = 0; x < rect.width; x++)
+			row[x] = m_backgroundColor;
+	}
+
+	if (singleLayer)
+	{
+		if (m_activeLayer)
+			RenderLayer(pixels, m_activeLayer, rect, true);
+		return;
+	}
+
+	for (auto& i : m_map->GetLayers())
+	{
+		if ((i != m_activeLayer) && !IsLayerVisible(i))
+			continue;
+		RenderLayer(pixels, i, rect);
+	}
+
+	for (auto& i : m_renderedActors)
+		RenderSprite(pixels, i.x, i.y, i.sprite, rect);
+}
+
+
+void Renderer::RenderBand(uint16_t* pixels, const vector<RenderRect>& regions, int top, int bottom,
+	bool singleLayer)
+{
+	for (auto& i : regions)
+	{
+		RenderRect rect = i;
+		if (rect.y < top)
+		{
+			rect.height -= top - rect.y;
+			rect.y = top;
+		}
+		if ((rect.y + rect.height) > bottom)
+			rect.height = bottom - rect.y;
+		if (rect.height <= 0)
+			continue;
+		RenderRegion(pixels, rect, singleLayer);
+	}
+}
+
+
+void Renderer::RenderRegions(uint16_t* pixels, const vector<RenderRect>& regions, bool singleLayer)
+{
+	size_t area = 0;
+	for (auto& i : regions)
+		area += (size_t)i.width * (size_t)i.height;
+
+	// Each band renders the full layer stack for its rows, so the result is the same for any band count
+	size_t bands = m_bandCount;
+	if (area < MIN_PARALLEL_RENDER_AREA)
+		bands = 1;
+	if (bands > m_height)
+		bands = m_height;
+	if (bands <= 1)
+	{
+		RenderBand(pixels, regions, 0, m_height, singleLayer);
+		return;
+	}
+
+	QSemaphore done;
+	for (size_t i = 1; i < bands; i++)
+	{
+		int top = (int)(((size_t)m_height * i) / bands);
+		int bottom = (int)(((size_t)m_height * (i + 1)) / bands);
+		QThreadPool::globalInstance()->start(new RenderBandTask([=, &regions]() {
+			RenderBand(pixels, regions, top, bottom, singleLayer);
+		}, &done));
+	}
+	RenderBand(pixels, regions, 0, (int)((size_t)m_height / bands), singleLayer);
+	done.acquire((int)bands - 1);
+}
+
+
+void Renderer::Render()
+{
+	UpdateDirtyRegions();
+	PrepareLayerCaches(false);
+
+	if (m_fullRenderRequired)
+	{
+		RenderRect rect;
+		rect.x = 0;
+		rect.y = 0;
+		rect.width = m_width;
+		rect.height = m_height;
+		RenderRegions(m_pixels, vector<RenderRect>{rect}, false);
+		m_fullRenderRequired = false;
+	}
+	else
+	{
+		RenderRegions(m_pixels, m_dirtyRegions, false);
+	}
+	m_dirtyRegions.clear();
+}
+
+
 void Renderer::RenderSingleLayer()
 {
-	for (size_t i = 0; i < ((size_t)m_width * (size_t)m_height); i++)
-		m_singleLayerPixels[i] = m_backgroundColor;
+	UpdateDirtyRegions();
+	PrepareLayerCaches(true);
 
-	if (m_activeLayer)
-		RenderMapLayer(m_singleLayerPixels, m_activeLayer, true);
+	if (m_singleLayerFullRenderRequired)
+	{
+		RenderRect rect;
+		rect.x = 0;
+		rect.y = 0;
+		rect.width = m_width;
+		rect.height = m_height;
+		RenderRegions(m_singleLayerPixels, vector<RenderRect>{rect}, true);
+		m_singleLayerFullRenderRequired = false;
+	}
+	else
+	{
+		RenderRegions(m_singleLayerPixels, m_singleLayerDirtyRegions, true);
+	}
+	m_singleLayerDirtyRegions.clear();
 }
 
 
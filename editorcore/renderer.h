@@ -1,11 +1,43 @@
 #pragma once
 
+#include <set>
 #include "map.h"
 #include "mapfloatinglayer.h"
 #include "sprite.h"
 
+// Smallest update in pixels that is split into bands when rendering in parallel
+#define MIN_PARALLEL_RENDER_AREA (128 * 128)
+
+struct RenderRect
+{
+	int x, y;
+	int width, height;
+};
+
 class Renderer
 {
+public:
+	typedef void (*TileRowKernel)(uint16_t* dest, const uint8_t* tileDataRow, uint16_t leftPixel, uint16_t count,
+		uint8_t alpha);
+
+private:
+	struct RenderedActor
+	{
+		std::shared_ptr<Sprite> sprite;
+		int16_t x, y;
+	};
+
+	// Whole map layer rasterized in the 16-bit tile format, transparent pixels have bit 15 set
+	struct LayerCache
+	{
+		std::vector<uint16_t> pixels;
+		size_t width = 0, height = 0;
+		uint64_t changeCount = 0;
+		bool valid = false;
+		std::map<std::shared_ptr<TileSet>, uint16_t> tileSetFrames;
+		std::set<std::shared_ptr<Palette>> palettes;
+	};
+
 	std::shared_ptr<Map> m_map;
 	std::shared_ptr<MapLayer> m_activeLayer;
 	std::shared_ptr<MapFloatingLayer> m_floatingLayer;
@@ -20,20 +52,82 @@ class Renderer
 	uint16_t m_scrollX, m_scrollY;
 	bool m_parallaxEnabled;
 
-	void RenderPixel(uint16_t* pixels, int16_t x, int16_t y, uint16_t color,
-		BlendMode mode, uint8_t alpha);
-	void RenderMapLayer(uint16_t* pixels, std::shared_ptr<MapLayer> layer, bool forceNormalBlend = false);
-	void RenderSprite(uint16_t* pixels, int16_t x, int16_t y, std::shared_ptr<Sprite> sprite);
+	bool m_layerCacheEnabled, m_animating;
+	size_t m_bandCount;
+	std::map<std::shared_ptr<MapLayer>, LayerCache> m_layerCaches;
+
+	// State of the last render, used to find the regions that need to be recomposed
+	bool m_fullRenderRequired, m_singleLayerFullRenderRequired;
+	std::vector<RenderRect> m_dirtyRegions, m_singleLayerDirtyRegions;
+	uint16_t m_renderedScrollX, m_renderedScrollY;
+	uint32_t m_renderedAnimFrame;
+	std::map<std::shared_ptr<MapLayer>, uint64_t> m_renderedLayerChangeCounts;
+	std::shared_ptr<MapFloatingLayer> m_renderedFloatingLayer;
+	RenderRect m_renderedFloatingLayerRect;
+	std::vector<RenderedActor> m_renderedActors;
+
+	static TileRowKernel GetTileRowKernel(BlendMode mode, uint8_t alpha);
+	static std::shared_ptr<const std::vector<uint16_t>> GetTilePixels(const std::shared_ptr<Tile>& tile,
+		uint16_t frame, const uint8_t*& data, size_t& pitch);
+	void GetLayerScroll(const std::shared_ptr<MapLayer>& layer, uint16_t viewScrollX, uint16_t viewScrollY,
+		uint32_t animFrame, int16_t& scrollX, int16_t& scrollY);
+	void GetLayerScroll(const std::shared_ptr<MapLayer>& layer, int16_t& scrollX, int16_t& scrollY);
+	void RenderMapLayer(uint16_t* pixels, std::shared_ptr<MapLayer> layer, const RenderRect& rect,
+		bool forceNormalBlend = false);
+	void RenderSprite(uint16_t* pixels, int16_t x, int16_t y, std::shared_ptr<Sprite> sprite, const RenderRect& rect);
+	void RasterizeLayerTile(LayerCache& cache, const std::shared_ptr<MapLayer>& layer, size_t x, size_t y);
+	LayerCache* GetLayerCache(const std::shared_ptr<MapLayer>& layer);
+	void RenderCachedMapLayer(uint16_t* pixels, std::shared_ptr<MapLayer> layer, const LayerCache& cache,
+		const RenderRect& rect, bool forceNormalBlend);
+	static bool IsLayerAnimated(const std::shared_ptr<MapLayer>& layer);
+	bool IsLayerCached(const std::shared_ptr<MapLayer>& layer);
+	void PrepareLayerCaches(bool singleLayer);
+	void RenderLayer(uint16_t* pixels, std::shared_ptr<MapLayer> layer, const RenderRect& rect,
+		bool forceNormalBlend = false);
+	void RenderRegion(uint16_t* pixels, const RenderRect& rect, bool singleLayer);
+	void RenderBand(uint16_t* pixels, const std::vector<RenderRect>& regions, int top, int bottom,
+		bool singleLayer);
+	void RenderRegions(uint16_t* pixels, const std::vector<RenderRect>& regions, bool singleLayer);
 	bool IsLayerVisible(std::shared_ptr<MapLayer> layer);
 
+	std::vector<RenderedActor> GetActorsToRender();
+	RenderRect GetTileRect(const std::shared_ptr<MapLayer>& layer, int x, int y, int width, int height);
+	void AddDirtyRegion(const RenderRect& rect);
+	void ShiftRegions(std::vector<RenderRect>& regions, int deltaX, int deltaY);
+	void ScrollPixels(uint16_t* pixels, int deltaX, int deltaY);
+	void ScrollRenderedPixels();
+	void UpdateDirtyRegions();
+	void InvalidatePixels();
+
 public:
 	Renderer(std::shared_ptr<Map> map, uint16_t width, uint16_t height);
+	~Renderer();
 
-	void SetActiveLayer(std::shared_ptr<MapLayer> layer) { m_activeLayer = layer; }
+	void SetActiveLayer(std::shared_ptr<MapLayer> layer);
 	void SetFloatingLayer(std::shared_ptr<MapFloatingLayer> layer) { m_floatingLayer = layer; }
-	void SetLayerVisibility(const std::map<std::shared_ptr<MapLayer>, bool>& vis) { m_visibility = vis; }
-	void SetBackgroundColor(uint16_t color) { m_backgroundColor = color; }
-	void SetParallaxEnabled(bool enable) { m_parallaxEnabled = enable; }
+	void SetLayerVisibility(const std::map<std::shared_ptr<MapLayer>, bool>& vis);
+	void SetBackgroundColor(uint16_t color);
+	void SetParallaxEnabled(bool enable);
+
+	// Keeps a rasterized copy of each map layer so that rendering only needs to blend the layers together.
+	// Uses two bytes per pixel of every layer in the map. Off by default.
+	void SetLayerCacheEnabled(bool enable);
+	// Set while animations are being previewed, layers with animated tiles are then not cached
+	void SetAnimating(bool animating) { m_animating = animating; }
+
+	// Number of horizontal bands rendered in parallel on the global thread pool, defaults to one. Updates
+	// smaller than MIN_PARALLEL_RENDER_AREA pixels are always rendered in one band.
+	size_t GetBandCount() const { return m_bandCount; }
+	void SetBandCount(size_t count) { m_bandCount = (count < 1) ? 1 : count; }
+
+	// Forces the next render to recompose everything, for changes that are not tracked by the renderer
+	// such as tile set and palette contents
+	void Invalidate();
+	void InvalidateTileSet(const std::shared_ptr<TileSet>& tileSet);
+	void InvalidatePalette(const std::shared_ptr<Palette>& palette);
+
+	uint16_t GetWidth() const { return m_width; }
+	uint16_t GetHeight() const { return m_height; }
 
 	void Render();
 	void RenderSingleLayer();
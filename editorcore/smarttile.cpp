@@ -0,0 +1,207 @@
+#include "smarttile.h"
+
+using namespace std;
+
+
+struct SmartTileRule
+{
+	uint32_t filled, empty;
+	uint16_t tile;
+};
+
+
+// Rules are checked in order, the first one with all of its filled neighbours present and none of its
+// empty neighbours present decides the tile
+static constexpr bool MatchesRule(const SmartTileRule& rule, uint32_t neighbours)
+{
+	return ((neighbours & rule.filled) == rule.filled) && ((neighbours & rule.empty) == 0);
+}
+
+
+static constexpr uint16_t ResolveRules(const SmartTileRule* rules, size_t count, uint16_t defaultTile,
+	uint32_t neighbours)
+{
+	return (count == 0) ? defaultTile : (MatchesRule(rules[0], neighbours) ? rules[0].tile :
+		ResolveRules(rules + 1, count - 1, defaultTile, neighbours));
+}
+
+
+#define N(x, y) SmartTileNeighbour(x, y)
+
+#define T(x, y) (((y) * 5) + (x))
+static constexpr SmartTileRule g_singleWidthRules[] =
+{
+	{N(-1, 0) | N(1, 0) | N(0, -1), N(0, 1), T(1, 2)},
+	{N(-1, 0) | N(1, 0) | N(0, 1), N(0, -1), T(1, 0)},
+	{N(-1, 0) | N(0, -1) | N(0, 1), N(1, 0), T(2, 1)},
+	{N(1, 0) | N(0, -1) | N(0, 1), N(-1, 0), T(0, 1)},
+	{N(-1, 0) | N(0, -1), N(1, 0) | N(0, 1), T(2, 2)},
+	{N(-1, 0) | N(0, 1), N(1, 0) | N(0, -1), T(2, 0)},
+	{N(1, 0) | N(0, -1), N(-1, 0) | N(0, 1), T(0, 2)},
+	{N(1, 0) | N(0, 1), N(-1, 0) | N(0, -1), T(0, 0)},
+	{0, N(-1, -1), T(3, 0)},
+	{0, N(1, -1), T(4, 0)},
+	{0, N(-1, 1), T(3, 1)},
+	{0, N(1, 1), T(4, 1)}
+};
+static constexpr uint16_t g_singleWidthDefault = T(1, 1);
+#undef T
+
+#define T(x, y) (((y) * 9) + (x))
+static constexpr SmartTileRule g_doubleWidthRules[] =
+{
+	// Outer upper left corner
+	{N(1, 0) | N(1, 1) | N(1, 2) | N(2, 1), N(2, 2), T(0, 0)},
+	{N(0, 1) | N(0, 2) | N(1, 0) | N(1, 1), N(1, 2), T(1, 0)},
+	{N(1, 0) | N(1, 1) | N(2, 0), N(2, 1), T(0, 1)},
+	{N(0, 1) | N(1, 0), N(1, 1), T(1, 1)},
+	// Top
+	{N(0, 1) | N(-2, 0) | N(-1, 0) | N(1, 0) | N(2, 0), N(0, 2), T(2, 0)},
+	{N(-2, 0) | N(-1, 0) | N(1, 0) | N(2, 0), N(0, 1), T(2, 1)},
+	// Outer upper right corner
+	{N(0, 1) | N(0, 2) | N(-1, 0) | N(-1, 1), N(-1, 2), T(3, 0)},
+	{N(-1, 0) | N(-1, 1) | N(-1, 2) | N(-2, 1), N(-2, 2), T(4, 0)},
+	{N(0, 1) | N(-1, 0), N(-1, 1), T(3, 1)},
+	{N(-1, 0) | N(-1, 1) | N(-2, 0), N(-2, 1), T(4, 1)},
+	// Left
+	{N(1, 0) | N(0, -2) | N(0, -1) | N(0, 1) | N(0, 2), N(2, 0), T(0, 2)},
+	{N(0, -2) | N(0, -1) | N(0, 1) | N(0, 2), N(1, 0), T(1, 2)},
+	// Right
+	{N(0, -2) | N(0, -1) | N(0, 1) | N(0, 2), N(-1, 0), T(3, 2)},
+	{N(-1, 0) | N(0, -2) | N(0, -1) | N(0, 1) | N(0, 2), N(-2, 0), T(4, 2)},
+	// Outer bottom left corner
+	{N(1, 0) | N(1, -1) | N(2, 0), N(2, -1), T(0, 3)},
+	{N(0, -1) | N(1, 0), N(1, -1), T(1, 3)},
+	{N(1, 0) | N(1, -1) | N(1, -2) | N(2, -1), N(2, -2), T(0, 4)},
+	{N(0, -1) | N(0, -2) | N(1, 0) | N(1, -1), N(1, -2), T(1, 4)},
+	// Bottom
+	{N(-2, 0) | N(-1, 0) | N(1, 0) | N(2, 0), N(0, -1), T(2, 3)},
+	{N(0, -1) | N(-2, 0) | N(-1, 0) | N(1, 0) | N(2, 0), N(0, -2), T(2, 4)},
+	// Outer bottom right corner
+	{N(0, -1) | N(-1, 0), N(-1, -1), T(3, 3)},
+	{N(-1, 0) | N(-1, -1) | N(-2, 0), N(-2, -1), T(4, 3)},
+	{N(0, -1) | N(0, -2) | N(-1, 0) | N(-1, -1), N(-1, -2), T(3, 4)},
+	{N(-1, 0) | N(-1, -1) | N(-1, -2) | N(-2, -1), N(-2, -2), T(4, 4)},
+	// Inner upper left corner
+	{N(1, 0) | N(1, 1) | N(0, 1), N(2, 0) | N(0, 2), T(5, 0)},
+	{N(-1, 0) | N(-1, 1) | N(0, 1), N(1, 0) | N(0, 2), T(6, 0)},
+	{N(0, -1) | N(1, -1) | N(1, 0), N(2, 0) | N(0, 1), T(5, 1)},
+	{N(-1, -1) | N(-1, 0) | N(0, -1), N(1, 0) | N(0, 1), T(6, 1)},
+	// Inner upper right corner
+	{N(1, 0) | N(1, 1) | N(0, 1), N(-1, 0) | N(0, 2), T(7, 0)},
+	{N(-1, 0) | N(-1, 1) | N(0, 1), N(-2, 0) | N(0, 2), T(8, 0)},
+	{N(1, -1) | N(1, 0) | N(0, -1), N(-1, 0) | N(0, 1), T(7, 1)},
+	{N(0, -1) | N(-1, -1) | N(-1, 0), N(-2, 0) | N(0, 1), T(8, 1)},
+	// Inner bottom left corner
+	{N(0, 1) | N(1, 1) | N(1, 0), N(2, 0) | N(0, -1), T(5, 2)},
+	{N(-1, 1) | N(-1, 0) | N(0, 1), N(1, 0) | N(0, -1), T(6, 2)},
+	{N(1, 0) | N(1, -1) | N(0, -1), N(2, 0) | N(0, -2), T(5, 3)},
+	{N(-1, 0) | N(-1, -1) | N(0, -1), N(1, 0) | N(0, -2), T(6, 3)},
+	// Inner bottom right corner
+	{N(1, 1) | N(1, 0) | N(0, 1), N(-1, 0) | N(0, -1), T(7, 2)},
+	{N(0, 1) | N(-1, 1) | N(-1, 0), N(-2, 0) | N(0, -1), T(8, 2)},
+	{N(1, 0) | N(1, -1) | N(0, -1), N(-1, 0) | N(0, -2), T(7, 3)},
+	{N(-1, 0) | N(-1, -1) | N(0, -1), N(-2, 0) | N(0, -2), T(8, 3)}
+};
+static constexpr uint16_t g_doubleWidthDefault = T(2, 2);
+#undef T
+
+// Tile sets that only look at the 8 closest neighbours are resolved with a table indexed by a compact
+// mask of those neighbours, with bits clockwise starting from the tile above
+#define NEIGHBOUR_UP (1 << 0)
+#define NEIGHBOUR_UP_RIGHT (1 << 1)
+#define NEIGHBOUR_RIGHT (1 << 2)
+#define NEIGHBOUR_DOWN_RIGHT (1 << 3)
+#define NEIGHBOUR_DOWN (1 << 4)
+#define NEIGHBOUR_DOWN_LEFT (1 << 5)
+#define NEIGHBOUR_LEFT (1 << 6)
+#define NEIGHBOUR_UP_LEFT (1 << 7)
+
+static constexpr uint32_t ExpandNeighbours(uint32_t compact)
+{
+	return ((compact & NEIGHBOUR_UP) ? N(0, -1) : 0) | ((compact & NEIGHBOUR_UP_RIGHT) ? N(1, -1) : 0) |
+		((compact & NEIGHBOUR_RIGHT) ? N(1, 0) : 0) | ((compact & NEIGHBOUR_DOWN_RIGHT) ? N(1, 1) : 0) |
+		((compact & NEIGHBOUR_DOWN) ? N(0, 1) : 0) | ((compact & NEIGHBOUR_DOWN_LEFT) ? N(-1, 1) : 0) |
+		((compact & NEIGHBOUR_LEFT) ? N(-1, 0) : 0) | ((compact & NEIGHBOUR_UP_LEFT) ? N(-1, -1) : 0);
+}
+
+
+static uint32_t CompactNeighbours(uint32_t neighbours)
+{
+	return ((neighbours & N(0, -1)) ? NEIGHBOUR_UP : 0) | ((neighbours & N(1, -1)) ? NEIGHBOUR_UP_RIGHT : 0) |
+		((neighbours & N(1, 0)) ? NEIGHBOUR_RIGHT : 0) | ((neighbours & N(1, 1)) ? NEIGHBOUR_DOWN_RIGHT : 0) |
+		((neighbours & N(0, 1)) ? NEIGHBOUR_DOWN : 0) | ((neighbours & N(-1, 1)) ? NEIGHBOUR_DOWN_LEFT : 0) |
+		((neighbours & N(-1, 0)) ? NEIGHBOUR_LEFT : 0) | ((neighbours & N(-1, -1)) ? NEIGHBOUR_UP_LEFT : 0);
+}
+
+#undef N
+
+
+// The 47 tile blob set has a tile for every arrangement of neighbours, except that a corner only matters
+// when both of the edges next to it connect. Tiles are ordered by their compact mask.
+static constexpr uint32_t ReduceBlobNeighbours(uint32_t compact)
+{
+	return compact & (NEIGHBOUR_UP | NEIGHBOUR_RIGHT | NEIGHBOUR_DOWN | NEIGHBOUR_LEFT |
+		(((compact & (NEIGHBOUR_UP | NEIGHBOUR_RIGHT)) == (NEIGHBOUR_UP | NEIGHBOUR_RIGHT)) ? NEIGHBOUR_UP_RIGHT : 0) |
+		(((compact & (NEIGHBOUR_DOWN | NEIGHBOUR_RIGHT)) == (NEIGHBOUR_DOWN | NEIGHBOUR_RIGHT)) ? NEIGHBOUR_DOWN_RIGHT : 0) |
+		(((compact & (NEIGHBOUR_DOWN | NEIGHBOUR_LEFT)) == (NEIGHBOUR_DOWN | NEIGHBOUR_LEFT)) ? NEIGHBOUR_DOWN_LEFT : 0) |
+		(((compact & (NEIGHBOUR_UP | NEIGHBOUR_LEFT)) == (NEIGHBOUR_UP | NEIGHBOUR_LEFT)) ? NEIGHBOUR_UP_LEFT : 0));
+}
+
+
+static constexpr uint16_t GetBlobTile(uint32_t reduced, uint32_t compact = 0)
+{
+	return (compact >= reduced) ? 0 : (((ReduceBlobNeighbours(compact) == compact) ? 1 : 0) +
+		GetBlobTile(reduced, compact + 1));
+}
+
+
+#define SMART_TILE_TABLE_4(f, n) f(n), f((n) + 1), f((n) + 2), f((n) + 3)
+#define SMART_TILE_TABLE_16(f, n) SMART_TILE_TABLE_4(f, n), SMART_TILE_TABLE_4(f, (n) + 4), \
+	SMART_TILE_TABLE_4(f, (n) + 8), SMART_TILE_TABLE_4(f, (n) + 12)
+#define SMART_TILE_TABLE_64(f, n) SMART_TILE_TABLE_16(f, n), SMART_TILE_TABLE_16(f, (n) + 16), \
+	SMART_TILE_TABLE_16(f, (n) + 32), SMART_TILE_TABLE_16(f, (n) + 48)
+#define SMART_TILE_TABLE_256(f) SMART_TILE_TABLE_64(f, 0), SMART_TILE_TABLE_64(f, 64), \
+	SMART_TILE_TABLE_64(f, 128), SMART_TILE_TABLE_64(f, 192)
+
+#define SINGLE_WIDTH_TILE(n) ResolveRules(g_singleWidthRules, \
+	sizeof(g_singleWidthRules) / sizeof(SmartTileRule), g_singleWidthDefault, ExpandNeighbours(n))
+#define BLOB_TILE(n) GetBlobTile(ReduceBlobNeighbours(n))
+
+static constexpr uint16_t g_singleWidthTable[256] = { SMART_TILE_TABLE_256(SINGLE_WIDTH_TILE) };
+static constexpr uint16_t g_blobTable[256] = { SMART_TILE_TABLE_256(BLOB_TILE) };
+
+static_assert(BLOB_TILE(0xff) == 46, "Blob tile set must have 47 tiles");
+
+
+int SmartTile::GetNeighbourRadius(SmartTileSetType type)
+{
+	switch (type)
+	{
+	case SimplifiedDoubleWidthSmartTileSet:
+		return 2;
+	default:
+		return 1;
+	}
+}
+
+
+uint16_t SmartTile::ResolveTile(SmartTileSetType type, uint32_t neighbours)
+{
+	switch (type)
+	{
+	case SimplifiedSingleWidthSmartTileSet:
+		return g_singleWidthTable[CompactNeighbours(neighbours)];
+	case SimplifiedDoubleWidthSmartTileSet:
+		for (auto& i : g_doubleWidthRules)
+		{
+			if (MatchesRule(i, neighbours))
+				return i.tile;
+		}
+		return g_doubleWidthDefault;
+	case BlobSmartTileSet:
+		return g_blobTable[CompactNeighbours(neighbours)];
+	default:
+		return 0;
+	}
+}
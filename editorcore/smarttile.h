@@ -0,0 +1,21 @@
+#pragma once
+
+#include <inttypes.h>
+#include "tileset.h"
+
+// Bit in a neighbour mask for the tile at the given offset from the center tile. Offsets range from -2 to 2,
+// the mask has a bit for each of the 24 surrounding tiles in row order.
+constexpr uint32_t SmartTileNeighbour(int x, int y)
+{
+	return 1u << ((((y + 2) * 5) + (x + 2)) - (((((y + 2) * 5) + (x + 2)) > 12) ? 1 : 0));
+}
+
+// Resolves smart tiles from a mask of which neighbouring tiles connect to the tile being placed. Each
+// smart tile set type is described by constant tables, so resolving a tile never searches the map.
+class SmartTile
+{
+public:
+	// Distance from the center tile that affects the choice of tile, either 1 or 2
+	static int GetNeighbourRadius(SmartTileSetType type);
+	static uint16_t ResolveTile(SmartTileSetType type, uint32_t neighbours);
+};
@@ -28,6 +28,18 @@ Sprite::Sprite(const Sprite& other)
 }
 
 
+shared_ptr<Sprite> Sprite::CreateSnapshot() const
+{
+	shared_ptr<Sprite> result = make_shared<Sprite>(m_width, m_height, m_depth);
+	result->m_id = m_id;
+	result->m_name = m_name;
+	result->m_animations.clear();
+	for (auto& i : m_animations)
+		result->m_animations.push_back(i->CreateSnapshot());
+	return result;
+}
+
+
 shared_ptr<SpriteAnimation> Sprite::GetAnimation(size_t i)
 {
 	if (i >= m_animations.size())
@@ -83,6 +95,15 @@ bool Sprite::UsesPalette(shared_ptr<Palette> palette)
 }
 
 
+size_t Sprite::GetMemoryUsage() const
+{
+	size_t result = sizeof(Sprite);
+	for (auto& i : m_animations)
+		result += i->GetMemoryUsage();
+	return result;
+}
+
+
 Json::Value Sprite::Serialize()
 {
 	Json::Value sprite(Json::objectValue);
@@ -16,6 +16,9 @@ public:
 	Sprite(size_t width, size_t height, size_t depth);
 	Sprite(const Sprite& other);
 
+	// Copy with the same id for saving in the background, tiles share pixel data with the original
+	std::shared_ptr<Sprite> CreateSnapshot() const;
+
 	const std::string& GetName() const { return m_name; }
 	void SetName(const std::string& name) { m_name = name; }
 
@@ -34,6 +37,7 @@ public:
 	std::shared_ptr<SpriteAnimation> CreateAnimation(const std::string& name);
 
 	bool UsesPalette(std::shared_ptr<Palette> palette);
+	size_t GetMemoryUsage() const;
 
 	const std::string& GetId() const { return m_id; }
 	Json::Value Serialize();
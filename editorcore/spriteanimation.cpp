@@ -22,6 +22,14 @@ SpriteAnimation::SpriteAnimation(const SpriteAnimation& other)
 }
 
 
+shared_ptr<SpriteAnimation> SpriteAnimation::CreateSnapshot() const
+{
+	shared_ptr<SpriteAnimation> result = make_shared<SpriteAnimation>(*this);
+	result->m_tile = m_tile->CreateSnapshot();
+	return result;
+}
+
+
 size_t SpriteAnimation::GetFrameCount() const
 {
 	return m_animation->GetFrameCount();
@@ -100,6 +108,12 @@ bool SpriteAnimation::UsesPalette(shared_ptr<Palette> palette)
 }
 
 
+size_t SpriteAnimation::GetMemoryUsage() const
+{
+	return sizeof(SpriteAnimation) + m_tile->GetMemoryUsage();
+}
+
+
 Json::Value SpriteAnimation::Serialize()
 {
 	Json::Value anim(Json::objectValue);
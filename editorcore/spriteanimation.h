@@ -15,6 +15,9 @@ public:
 	SpriteAnimation(const std::string& name, size_t width, size_t height, size_t depth);
 	SpriteAnimation(const SpriteAnimation& other);
 
+	// Copy for saving in the background, the tile shares pixel data with the original
+	std::shared_ptr<SpriteAnimation> CreateSnapshot() const;
+
 	const std::string& GetName() const { return m_name; }
 	void SetName(const std::string& name) { m_name = name; }
 
@@ -36,6 +39,7 @@ public:
 	void InsertFrameFromTile(uint16_t frame, const std::shared_ptr<Tile>& tile, uint16_t length);
 
 	bool UsesPalette(std::shared_ptr<Palette> palette);
+	size_t GetMemoryUsage() const;
 
 	Json::Value Serialize();
 	static std::shared_ptr<SpriteAnimation> Deserialize(std::shared_ptr<Project> project, const Json::Value& data,
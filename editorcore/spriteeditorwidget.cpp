@@ -1,5 +1,7 @@
 #include <QVBoxLayout>
 #include <QPainter>
+#include <QImage>
+#include <QVector>
 #include <QMouseEvent>
 #include <QPaintEvent>
 #include <QGuiApplication>
@@ -15,6 +17,7 @@
 #include "spriteview.h"
 #include "theme.h"
 #include "mainwindow.h"
+#include "undodelta.h"
 #include "json/json.h"
 
 using namespace std;
@@ -158,12 +161,14 @@ void SpriteEditorWidget::SetFrame(const shared_ptr<SpriteAnimation>& anim, uint1
 }
 
 
-void SpriteEditorWidget::paintEvent(QPaintEvent* event)
+void SpriteEditorWidget::paintEvent(QPaintEvent*)
 {
 	QPainter p(this);
 
-	int tileWidth = (int)m_sprite->GetWidth() * m_zoom;
-	int tileHeight = (int)m_sprite->GetHeight() * m_zoom;
+	int width = (int)m_sprite->GetWidth();
+	int height = (int)m_sprite->GetHeight();
+	int tileWidth = width * m_zoom;
+	int tileHeight = height * m_zoom;
 
 	bool hoverValid = false;
 
@@ -182,9 +187,9 @@ void SpriteEditorWidget::paintEvent(QPaintEvent* event)
 	if (m_showHover)
 	{
 		if ((m_hoverX >= 0) &&
-			(m_hoverX < (int)m_sprite->GetWidth()) &&
+			(m_hoverX < width) &&
 			(m_hoverY >= 0) &&
-			(m_hoverY < (int)m_sprite->GetHeight()))
+			(m_hoverY < height))
 		{
 			hoverValid = true;
 			paletteOverride = m_palette;
@@ -195,30 +200,21 @@ void SpriteEditorWidget::paintEvent(QPaintEvent* event)
 		}
 	}
 
-	p.setBrush(QBrush(Theme::backgroundHighlight, Qt::BDiagPattern));
-	p.setPen(Qt::NoPen);
-	p.drawRect(0, 0, tileWidth, tileHeight);
-
-	for (int y = 0; y < (int)m_sprite->GetHeight(); y++)
+	// The frame is decoded at its original size into an image, which is scaled up with a single draw
+	QImage image(width, height, QImage::Format_ARGB32);
+	image.fill(0);
+	const uint8_t* data = static_cast<const Tile&>(*tile).GetData(m_frame);
+	for (int y = 0; y < height; y++)
 	{
-		if (((y + 1) * m_zoom) < event->rect().top())
-			continue;
-		if ((y * m_zoom) > event->rect().bottom())
-			break;
-
-		for (int x = 0; x < (int)m_sprite->GetWidth(); x++)
+		uint32_t* line = (uint32_t*)image.scanLine(y);
+		for (int x = 0; x < width; x++)
 		{
-			if (((x + 1) * m_zoom) < event->rect().left())
-				continue;
-			if ((x * m_zoom) > event->rect().right())
-				break;
-
 			shared_ptr<Palette> palette = tile->GetPalette();
 			uint8_t colorIndex;
 			if (tile->GetDepth() == 4)
-				colorIndex = (tile->GetData(m_frame)[(y * tile->GetPitch()) + (x / 2)] >> ((x & 1) << 2)) & 0xf;
+				colorIndex = (data[(y * tile->GetPitch()) + (x / 2)] >> ((x & 1) << 2)) & 0xf;
 			else
-				colorIndex = tile->GetData(m_frame)[(y * tile->GetPitch()) + x];
+				colorIndex = data[(y * tile->GetPitch()) + x];
 			if (paletteOverride)
 				colorIndex += paletteOverrideOffset;
 			else
@@ -250,56 +246,39 @@ void SpriteEditorWidget::paintEvent(QPaintEvent* event)
 				paletteEntry = paletteOverride->GetEntry(colorIndex);
 			else
 				paletteEntry = palette->GetEntry(colorIndex);
-
-			p.setBrush(QColor::fromRgba(Palette::ToRGB32(paletteEntry) | 0xff000000));
-			p.drawRect(x * m_zoom, y * m_zoom, m_zoom, m_zoom);
+			line[x] = Palette::ToRGB32(paletteEntry) | 0xff000000;
 		}
 	}
 
+	// Transparent pixels show a hatched background
+	p.setBrush(QBrush(Theme::backgroundHighlight, Qt::BDiagPattern));
+	p.setPen(Qt::NoPen);
+	p.drawRect(0, 0, tileWidth, tileHeight);
+	p.drawImage(QRect(0, 0, tileWidth, tileHeight), image);
+
+	// Grid lines are drawn with one call for each style
+	p.setBrush(Qt::NoBrush);
 	if (m_zoom >= 8)
 	{
-		for (int y = 0; y < (int)m_sprite->GetHeight(); y++)
-		{
-			if (((y + 1) * m_zoom) < event->rect().top())
-				continue;
-			if ((y * m_zoom) > event->rect().bottom())
-				break;
-
-			for (int x = 0; x < (int)m_sprite->GetWidth(); x++)
-			{
-				if (((x + 1) * m_zoom) < event->rect().left())
-					continue;
-				if ((x * m_zoom) > event->rect().right())
-					break;
-
-				p.setPen(QPen(QBrush(Theme::backgroundHighlight), 1));
-				p.setBrush(Qt::NoBrush);
-				p.drawRect(x * m_zoom, y * m_zoom, m_zoom, m_zoom);
-			}
-		}
+		QVector<QLine> lines;
+		for (int x = 0; x <= width; x++)
+			lines.push_back(QLine(x * m_zoom, 0, x * m_zoom, tileHeight));
+		for (int y = 0; y <= height; y++)
+			lines.push_back(QLine(0, y * m_zoom, tileWidth, y * m_zoom));
+		p.setPen(QPen(QBrush(Theme::backgroundHighlight), 1));
+		p.drawLines(lines);
 	}
 
 	if (m_zoom >= 4)
 	{
-		for (int y = 0; y < (int)m_sprite->GetHeight(); y += 8)
+		QVector<QRect> blocks;
+		for (int y = 0; y < height; y += 8)
 		{
-			if (((y + 8) * m_zoom) < event->rect().top())
-				continue;
-			if ((y * m_zoom) > event->rect().bottom())
-				break;
-
-			for (int x = 0; x < (int)m_sprite->GetWidth(); x += 8)
-			{
-				if (((x + 8) * m_zoom) < event->rect().left())
-					continue;
-				if ((x * m_zoom) > event->rect().right())
-					break;
-
-				p.setPen(QPen(QBrush(Theme::backgroundHighlight), 2));
-				p.setBrush(Qt::NoBrush);
-				p.drawRect(x * m_zoom, y * m_zoom, m_zoom * 8, m_zoom * 8);
-			}
+			for (int x = 0; x < width; x += 8)
+				blocks.push_back(QRect(x * m_zoom, y * m_zoom, m_zoom * 8, m_zoom * 8));
 		}
+		p.setPen(QPen(QBrush(Theme::backgroundHighlight), 2));
+		p.drawRects(blocks);
 	}
 
 	if (m_zoom >= 2)
@@ -308,7 +287,6 @@ void SpriteEditorWidget::paintEvent(QPaintEvent* event)
 			p.setPen(QPen(QBrush(Theme::disabled), 2));
 		else
 			p.setPen(QPen(QBrush(Theme::disabled), 1));
-		p.setBrush(Qt::NoBrush);
 		p.drawRect(0, 0, tileWidth, tileHeight);
 	}
 
@@ -365,12 +343,12 @@ TileSetFloatingLayerPixel SpriteEditorWidget::GetPixel(int x, int y)
 	if (tile->GetDepth() == 4)
 	{
 		size_t offset = (y * tile->GetPitch()) + (x / 2);
-		colorIndex = (tile->GetData(m_frame)[offset] >> ((x & 1) << 2)) & 0xf;
+		colorIndex = (static_cast<const Tile&>(*tile).GetData(m_frame)[offset] >> ((x & 1) << 2)) & 0xf;
 	}
 	else
 	{
 		size_t offset = (y * tile->GetPitch()) + x;
-		colorIndex = tile->GetData(m_frame)[offset];
+		colorIndex = static_cast<const Tile&>(*tile).GetData(m_frame)[offset];
 	}
 
 	if ((colorIndex == 0) || (!tile->GetPalette()))
@@ -405,7 +383,7 @@ void SpriteEditorWidget::SetPixel(int x, int y, shared_ptr<Palette> palette, uin
 	if (entry == 0)
 		palette = tile->GetPalette();
 
-	uint8_t* data;
+	const uint8_t* data;
 	uint8_t newData, colorIndex, paletteOffset;
 	size_t offset;
 	if (tile->GetDepth() == 4)
@@ -413,7 +391,7 @@ void SpriteEditorWidget::SetPixel(int x, int y, shared_ptr<Palette> palette, uin
 		colorIndex = (uint8_t)(entry & 0xf);
 		paletteOffset = (uint8_t)(entry & 0xf0);
 		offset = (y * tile->GetPitch()) + (x / 2);
-		data = &tile->GetData(m_frame)[offset];
+		data = &static_cast<const Tile&>(*tile).GetData(m_frame)[offset];
 		newData = ((*data) & (0xf0 >> ((x & 1) << 2))) | (colorIndex << ((x & 1) << 2));
 	}
 	else
@@ -421,7 +399,7 @@ void SpriteEditorWidget::SetPixel(int x, int y, shared_ptr<Palette> palette, uin
 		colorIndex = entry;
 		paletteOffset = 0;
 		offset = (y * tile->GetPitch()) + x;
-		data = &tile->GetData(m_frame)[offset];
+		data = &static_cast<const Tile&>(*tile).GetData(m_frame)[offset];
 		newData = colorIndex;
 	}
 
@@ -453,7 +431,7 @@ void SpriteEditorWidget::SetPixel(int x, int y, shared_ptr<Palette> palette, uin
 
 		m_pendingActions.push_back(action);
 
-		*data = newData;
+		tile->GetData(m_frame)[offset] = newData;
 		if ((colorIndex != 0) && ((palette != tile->GetPalette()) ||
 			(paletteOffset != tile->GetPaletteOffset())))
 		{
@@ -519,12 +497,12 @@ void SpriteEditorWidget::CaptureLayer(shared_ptr<TileSetFloatingLayer> layer)
 			uint8_t colorIndex;
 			if (tile->GetDepth() == 4)
 			{
-				colorIndex = (tile->GetData(m_frame)[(tilePixelY * tile->GetPitch()) +
+				colorIndex = (static_cast<const Tile&>(*tile).GetData(m_frame)[(tilePixelY * tile->GetPitch()) +
 					(tilePixelX / 2)] >> ((tilePixelX & 1) << 2)) & 0xf;
 			}
 			else
 			{
-				colorIndex = tile->GetData(m_frame)[(tilePixelY * tile->GetPitch()) + tilePixelX];
+				colorIndex = static_cast<const Tile&>(*tile).GetData(m_frame)[(tilePixelY * tile->GetPitch()) + tilePixelX];
 			}
 			colorIndex += tile->GetPaletteOffset();
 
@@ -1024,26 +1002,36 @@ void SpriteEditorWidget::CommitPendingActions()
 			selectActions.erase(selectActions.begin() + 1, selectActions.end());
 		}
 
+		// Store the pixel changes as a compact delta for the undo history
+		shared_ptr<TilePixelDelta> delta = make_shared<TilePixelDelta>(m_frame);
+		for (auto& i : editActions)
+		{
+			shared_ptr<Tile> tile = i.anim->GetTile();
+			if (!tile)
+				continue;
+			delta->AddChange(tile, i.offset, i.oldData, i.newData, i.oldPalette, i.oldPaletteOffset,
+				i.newPalette, i.newPaletteOffset);
+		}
+		delta->Finish();
+
+		size_t memoryUsage = delta->GetMemoryUsage();
+		for (auto& i : selectActions)
+		{
+			for (auto& j : {i.oldSelectionContents, i.oldUnderSelection, i.newSelectionContents, i.newUnderSelection})
+			{
+				if (j)
+					memoryUsage += j->GetWidth() * j->GetHeight() * sizeof(TileSetFloatingLayerPixel);
+			}
+		}
+
 		shared_ptr<Sprite> sprite = m_sprite;
 		MainWindow* mainWindow = m_mainWindow;
 		shared_ptr<SpriteAnimation> anim = m_animation;
 		uint16_t frame = m_frame;
-		m_mainWindow->AddUndoAction(
+		m_mainWindow->AddUndoAction(sprite->GetId(), memoryUsage,
 			[=]() { // Undo
-				set<shared_ptr<Palette>> palettes;
-				for (size_t i = 0; i < editActions.size(); i++)
-				{
-					EditAction action = editActions[editActions.size() - (i + 1)];
-					shared_ptr<Tile> tile = action.anim->GetTile();
-					if (!tile)
-						continue;
-					tile->GetData(frame)[action.offset] = action.oldData;
-					tile->SetPalette(action.oldPalette, action.oldPaletteOffset);
-					if (action.oldPalette)
-						palettes.insert(action.oldPalette);
-					if (action.newPalette)
-						palettes.insert(action.newPalette);
-				}
+				delta->Undo();
+				set<shared_ptr<Palette>> palettes = delta->GetPalettes();
 				for (auto& i : selectActions)
 				{
 					SpriteView* view = mainWindow->GetSpriteView(sprite);
@@ -1069,20 +1057,8 @@ void SpriteEditorWidget::CommitPendingActions()
 				mainWindow->UpdateSpriteContents(sprite);
 			},
 			[=]() { // Redo
-				set<shared_ptr<Palette>> palettes;
-				for (size_t i = 0; i < editActions.size(); i++)
-				{
-					EditAction action = editActions[i];
-					shared_ptr<Tile> tile = action.anim->GetTile();
-					if (!tile)
-						continue;
-					tile->GetData(frame)[action.offset] = action.newData;
-					tile->SetPalette(action.newPalette, action.newPaletteOffset);
-					if (action.oldPalette)
-						palettes.insert(action.oldPalette);
-					if (action.newPalette)
-						palettes.insert(action.newPalette);
-				}
+				delta->Redo();
+				set<shared_ptr<Palette>> palettes = delta->GetPalettes();
 				for (auto& i : selectActions)
 				{
 					SpriteView* view = mainWindow->GetSpriteView(sprite);
@@ -55,6 +55,7 @@ void SpritePreviewWidget::UpdateImageData()
 	if ((tile->GetDepth() != m_sprite->GetDepth()))
 		return;
 
+	const uint8_t* data = static_cast<const Tile&>(*tile).GetData(frame);
 	for (int y = 0; y < (int)m_sprite->GetHeight(); y++)
 	{
 		uint32_t* line = (uint32_t*)m_image->scanLine(y);
@@ -62,9 +63,9 @@ void SpritePreviewWidget::UpdateImageData()
 		{
 			uint8_t colorIndex;
 			if (tile->GetDepth() == 4)
-				colorIndex = (tile->GetData(frame)[(y * tile->GetPitch()) + (x / 2)] >> ((x & 1) << 2)) & 0xf;
+				colorIndex = (data[(y * tile->GetPitch()) + (x / 2)] >> ((x & 1) << 2)) & 0xf;
 			else
-				colorIndex = tile->GetData(frame)[(y * tile->GetPitch()) + x];
+				colorIndex = data[(y * tile->GetPitch()) + x];
 			if (colorIndex == 0)
 				continue;
 			if (!tile->GetPalette())
@@ -46,6 +46,7 @@ void SpriteSelectWidget::UpdateImageData()
 	if ((tile->GetDepth() != m_sprite->GetDepth()))
 		return;
 
+	const uint8_t* data = static_cast<const Tile&>(*tile).GetData(0);
 	for (int y = 0; y < (int)m_sprite->GetHeight(); y++)
 	{
 		uint32_t* line = (uint32_t*)m_image->scanLine(y);
@@ -53,9 +54,9 @@ void SpriteSelectWidget::UpdateImageData()
 		{
 			uint8_t colorIndex;
 			if (tile->GetDepth() == 4)
-				colorIndex = (tile->GetData(0)[(y * tile->GetPitch()) + (x / 2)] >> ((x & 1) << 2)) & 0xf;
+				colorIndex = (data[(y * tile->GetPitch()) + (x / 2)] >> ((x & 1) << 2)) & 0xf;
 			else
-				colorIndex = tile->GetData(0)[(y * tile->GetPitch()) + x];
+				colorIndex = data[(y * tile->GetPitch()) + x];
 			if (colorIndex == 0)
 				continue;
 			if (!tile->GetPalette())
@@ -147,6 +147,13 @@ void SpriteView::UpdateToolState()
 }
 
 
+void SpriteView::UpdatePaletteList()
+{
+	m_palettes->UpdateView();
+	m_activePalette->UpdateView();
+}
+
+
 void SpriteView::UpdateView()
 {
 	m_editor->UpdateView();
@@ -52,6 +52,7 @@ public:
 		std::shared_ptr<Sprite> sprite);
 
 	void UpdateView();
+	void UpdatePaletteList();
 	void UpdateToolState();
 
 	std::shared_ptr<Sprite> GetSprite() const { return m_sprite; }
@@ -0,0 +1,55 @@
+#include <QCoreApplication>
+#include <QStringList>
+#include <QTest>
+#include <string.h>
+#include "palettetest.h"
+#include "tiletest.h"
+#include "projecttest.h"
+#include "maplayertest.h"
+#include "undohistorytest.h"
+#include "maptilesmimedatatest.h"
+#include "renderbenchmark.h"
+#include "tilebenchmark.h"
+
+
+int main(int argc, char* argv[])
+{
+	QCoreApplication app(argc, argv);
+
+	// Benchmarks take much longer than the tests, so they only run with --bench. Other options such as -v2
+	// or -o are passed on to QTest for every test object.
+	bool bench = false;
+	QStringList args;
+	for (int i = 0; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--bench") == 0)
+			bench = true;
+		else
+			args << QString::fromLocal8Bit(argv[i]);
+	}
+
+	if (bench)
+	{
+		int result = 0;
+		RenderBenchmark renderBenchmark;
+		result |= QTest::qExec(&renderBenchmark, args);
+		TileBenchmark tileBenchmark;
+		result |= QTest::qExec(&tileBenchmark, args);
+		return result;
+	}
+
+	int result = 0;
+	PaletteTest paletteTest;
+	result |= QTest::qExec(&paletteTest, args);
+	TileTest tileTest;
+	result |= QTest::qExec(&tileTest, args);
+	ProjectTest projectTest;
+	result |= QTest::qExec(&projectTest, args);
+	MapLayerTest mapLayerTest;
+	result |= QTest::qExec(&mapLayerTest, args);
+	UndoHistoryTest undoHistoryTest;
+	result |= QTest::qExec(&undoHistoryTest, args);
+	MapTilesMimeDataTest mapTilesMimeDataTest;
+	result |= QTest::qExec(&mapTilesMimeDataTest, args);
+	return result;
+}
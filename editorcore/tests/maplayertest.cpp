@@ -0,0 +1,139 @@
+#include <QTest>
+#include <QByteArray>
+#include "maplayertest.h"
+#include "project.h"
+
+using namespace std;
+
+
+bool MapLayerTest::LayersEqual(const shared_ptr<MapLayer>& a, const shared_ptr<MapLayer>& b)
+{
+	if ((a->GetWidth() != b->GetWidth()) || (a->GetHeight() != b->GetHeight()))
+		return false;
+	for (size_t y = 0; y < a->GetHeight(); y++)
+	{
+		for (size_t x = 0; x < a->GetWidth(); x++)
+		{
+			TileReference i = a->GetTileAt(x, y);
+			TileReference j = b->GetTileAt(x, y);
+			if ((i.tileSet != j.tileSet) || (i.index != j.index))
+				return false;
+		}
+	}
+	return true;
+}
+
+
+Json::Value MapLayerTest::PackRuns(const Json::Value& layer, const vector<uint16_t>& runs)
+{
+	string packed;
+	for (auto i : runs)
+	{
+		packed += (char)(i & 0xff);
+		packed += (char)(i >> 8);
+	}
+	Json::Value result = layer;
+	result["tile_format"] = MAP_LAYER_TILE_FORMAT_PACKED;
+	result["tiles"] = QByteArray(packed.c_str(), (int)packed.size()).toBase64().toStdString();
+	return result;
+}
+
+
+void MapLayerTest::TileFormatsRoundTrip()
+{
+	shared_ptr<Project> project = make_shared<Project>();
+	shared_ptr<TileSet> first = make_shared<TileSet>(8, 8, 4);
+	first->SetName("First");
+	first->SetTileCount(4);
+	QVERIFY(project->AddTileSet(first));
+	shared_ptr<TileSet> second = make_shared<TileSet>(8, 8, 4);
+	second->SetName("Second");
+	second->SetTileCount(4);
+	QVERIFY(project->AddTileSet(second));
+
+	// Rows wider than the largest run, a full row, an empty row and changes at the row boundaries
+	shared_ptr<MapLayer> layer = make_shared<MapLayer>(70000, 4, 8, 8, 4);
+	for (size_t x = 0; x < layer->GetWidth(); x++)
+		layer->SetTileAt(x, 0, TileReference(first, 1));
+	layer->SetTileAt(0, 2, TileReference(second, 3));
+	layer->SetTileAt(69999, 2, TileReference(second, 3));
+	for (size_t x = 65530; x < 65540; x++)
+		layer->SetTileAt(x, 3, TileReference((x & 1) ? first : second, (uint16_t)(x & 3)));
+	layer->SetTileAt(69999, 3, TileReference(first, 1));
+
+	for (uint32_t format : {MAP_LAYER_TILE_FORMAT_ROWS, MAP_LAYER_TILE_FORMAT_PACKED})
+	{
+		Json::Value data = layer->Serialize(format);
+		QCOMPARE(data.isMember("tile_format"), format == MAP_LAYER_TILE_FORMAT_PACKED);
+		shared_ptr<MapLayer> loaded = MapLayer::Deserialize(project, data);
+		QVERIFY(loaded);
+		QVERIFY(LayersEqual(layer, loaded));
+		QVERIFY(loaded->CheckTileSetUsage());
+	}
+}
+
+
+void MapLayerTest::PackedRunsStayWithinRows()
+{
+	shared_ptr<Project> project = make_shared<Project>();
+	shared_ptr<TileSet> tileSet = make_shared<TileSet>(8, 8, 4);
+	tileSet->SetName("Tiles");
+	tileSet->SetTileCount(1);
+	QVERIFY(project->AddTileSet(tileSet));
+
+	// Every cell holds the same tile, so only the row ends and the run limit split the runs
+	shared_ptr<MapLayer> layer = make_shared<MapLayer>(65536 + 100, 3, 8, 8, 4);
+	for (size_t y = 0; y < layer->GetHeight(); y++)
+		for (size_t x = 0; x < layer->GetWidth(); x++)
+			layer->SetTileAt(x, y, TileReference(tileSet, 0));
+
+	string tiles = layer->Serialize(MAP_LAYER_TILE_FORMAT_PACKED)["tiles"].asString();
+	QByteArray packed = QByteArray::fromBase64(QByteArray(tiles.c_str(), (int)tiles.size()));
+	QCOMPARE(packed.size() % 6, 0);
+	const uint8_t* runs = (const uint8_t*)packed.constData();
+	vector<size_t> counts;
+	for (int i = 0; i < packed.size(); i += 6)
+		counts.push_back((size_t)(runs[i] | (runs[i + 1] << 8)));
+	QCOMPARE(counts.size(), (size_t)6);
+	for (size_t y = 0; y < layer->GetHeight(); y++)
+	{
+		QCOMPARE(counts[y * 2], (size_t)0xffff);
+		QCOMPARE(counts[(y * 2) + 1], layer->GetWidth() - 0xffff);
+	}
+}
+
+
+void MapLayerTest::MalformedPackedTilesAreRejected()
+{
+	shared_ptr<Project> project = make_shared<Project>();
+	shared_ptr<TileSet> tileSet = make_shared<TileSet>(8, 8, 4);
+	tileSet->SetName("Tiles");
+	tileSet->SetTileCount(1);
+	QVERIFY(project->AddTileSet(tileSet));
+
+	shared_ptr<MapLayer> layer = make_shared<MapLayer>(4, 2, 8, 8, 4);
+	layer->SetTileAt(1, 1, TileReference(tileSet, 0));
+	Json::Value data = layer->Serialize(MAP_LAYER_TILE_FORMAT_PACKED);
+	QVERIFY(MapLayer::Deserialize(project, data));
+	QVERIFY(MapLayer::Deserialize(project, PackRuns(data, {4, 0, 0, 1, 0, 0, 1, 1, 0, 2, 0, 0})));
+
+	// Decoded lengths that are not whole runs
+	Json::Value truncated = data;
+	truncated["tiles"] = "AAAA";
+	QVERIFY(!MapLayer::Deserialize(project, truncated));
+	Json::Value garbage = data;
+	garbage["tiles"] = "not base64!";
+	QVERIFY(!MapLayer::Deserialize(project, garbage));
+
+	// Empty runs, runs crossing a row, too few or too many tiles and unknown tile sets
+	QVERIFY(!MapLayer::Deserialize(project, PackRuns(data, {0, 0, 0, 4, 0, 0, 4, 0, 0})));
+	QVERIFY(!MapLayer::Deserialize(project, PackRuns(data, {2, 0, 0, 4, 0, 0, 2, 0, 0})));
+	QVERIFY(!MapLayer::Deserialize(project, PackRuns(data, {4, 0, 0})));
+	QVERIFY(!MapLayer::Deserialize(project, PackRuns(data, {4, 0, 0, 4, 0, 0, 1, 0, 0})));
+	QVERIFY(!MapLayer::Deserialize(project, PackRuns(data, {4, 2, 0, 4, 0, 0})));
+	QVERIFY(!MapLayer::Deserialize(project, PackRuns(data, {})));
+
+	Json::Value unknown = data;
+	unknown["tile_format"] = 3;
+	QVERIFY(!MapLayer::Deserialize(project, unknown));
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <QObject>
+#include <memory>
+#include "json/json.h"
+
+class MapLayer;
+
+class MapLayerTest: public QObject
+{
+	Q_OBJECT
+
+	static bool LayersEqual(const std::shared_ptr<MapLayer>& a, const std::shared_ptr<MapLayer>& b);
+	static Json::Value PackRuns(const Json::Value& layer, const std::vector<uint16_t>& runs);
+
+private slots:
+	void TileFormatsRoundTrip();
+	void PackedRunsStayWithinRows();
+	void MalformedPackedTilesAreRejected();
+};
@@ -0,0 +1,166 @@
+#include <QTest>
+#include "maptilesmimedatatest.h"
+#include "maptilesmimedata.h"
+
+using namespace std;
+
+
+void MapTilesMimeDataTest::EncodeDecodeRoundTrip()
+{
+	shared_ptr<Project> project = make_shared<Project>();
+	shared_ptr<TileSet> first = make_shared<TileSet>(8, 8, 4);
+	first->SetName("First Tiles");
+	first->SetTileCount(4);
+	QVERIFY(project->AddTileSet(first));
+	shared_ptr<TileSet> second = make_shared<TileSet>(8, 8, 4);
+	second->SetName("Second Tiles");
+	second->SetTileCount(300);
+	QVERIFY(project->AddTileSet(second));
+	shared_ptr<MapLayer> layer = make_shared<MapLayer>(16, 16, 8, 8, 4);
+
+	shared_ptr<MapFloatingLayer> contents = make_shared<MapFloatingLayer>(layer, 5, 6, 3, 2);
+	contents->SetTile(0, 0, first, 3);
+	contents->SetTile(1, 0, second, 299);
+	contents->SetTile(2, 0, first, 0);
+	contents->SetTile(1, 1, second, 1);
+	contents->SetTile(2, 1, shared_ptr<TileSet>(), 0);
+
+	QByteArray data = MapTilesMimeData::Encode(contents);
+	shared_ptr<MapFloatingLayer> decoded = MapTilesMimeData::Decode(data, project, layer);
+	QVERIFY(decoded);
+	QCOMPARE(decoded->GetX(), 0);
+	QCOMPARE(decoded->GetY(), 0);
+	QCOMPARE(decoded->GetWidth(), 3);
+	QCOMPARE(decoded->GetHeight(), 2);
+	for (int y = 0; y < 2; y++)
+	{
+		for (int x = 0; x < 3; x++)
+		{
+			MapFloatingLayerTile expected = contents->GetTile(x, y);
+			MapFloatingLayerTile tile = decoded->GetTile(x, y);
+			QVERIFY(tile.valid);
+			if (expected.valid && expected.tileSet)
+			{
+				QCOMPARE(tile.tileSet, expected.tileSet);
+				QCOMPARE(tile.index, expected.index);
+			}
+			else
+			{
+				QVERIFY(!tile.tileSet);
+			}
+		}
+	}
+
+	// Tiles from sets that are no longer in the project, or past the end of their set, are left empty
+	project->DeleteTileSet(second);
+	first->SetTileCount(2);
+	decoded = MapTilesMimeData::Decode(data, project, layer);
+	QVERIFY(decoded);
+	QVERIFY(!decoded->GetTile(0, 0).tileSet);
+	QVERIFY(!decoded->GetTile(1, 0).tileSet);
+	QCOMPARE(decoded->GetTile(2, 0).tileSet, first);
+	QVERIFY(!decoded->GetTile(1, 1).tileSet);
+}
+
+
+void MapTilesMimeDataTest::MalformedDataIsRejected()
+{
+	shared_ptr<Project> project = make_shared<Project>();
+	shared_ptr<TileSet> tileSet = make_shared<TileSet>(8, 8, 4);
+	tileSet->SetName("Test Tiles");
+	tileSet->SetTileCount(2);
+	QVERIFY(project->AddTileSet(tileSet));
+	shared_ptr<MapLayer> layer = make_shared<MapLayer>(16, 16, 8, 8, 4);
+
+	shared_ptr<MapFloatingLayer> contents = make_shared<MapFloatingLayer>(layer, 0, 0, 2, 2);
+	contents->SetTile(0, 0, tileSet, 1);
+	contents->SetTile(1, 1, tileSet, 0);
+	QByteArray data = MapTilesMimeData::Encode(contents);
+
+	// Every truncation and any trailing data must be rejected
+	for (int i = 0; i < data.size(); i++)
+		QVERIFY(!MapTilesMimeData::Decode(QByteArray(data.constData(), i), project, layer));
+	QByteArray extended = data;
+	extended.append((char)0);
+	QVERIFY(!MapTilesMimeData::Decode(extended, project, layer));
+
+	// Empty and oversized selections
+	QByteArray header = data;
+	header.data()[0] = 0;
+	header.data()[1] = 0;
+	QVERIFY(!MapTilesMimeData::Decode(header, project, layer));
+	header = data;
+	header.data()[3] = (char)0x80;
+	QVERIFY(!MapTilesMimeData::Decode(header, project, layer));
+
+	// A tile set id longer than the data
+	header = data;
+	header.data()[6] = (char)0xff;
+	header.data()[7] = (char)0xff;
+	QVERIFY(!MapTilesMimeData::Decode(header, project, layer));
+
+	// Tile set numbers past the table are treated as empty cells
+	QByteArray cells = data;
+	cells.data()[cells.size() - 4] = 7;
+	shared_ptr<MapFloatingLayer> decoded = MapTilesMimeData::Decode(cells, project, layer);
+	QVERIFY(decoded);
+	QVERIFY(!decoded->GetTile(1, 1).tileSet);
+	QCOMPARE(decoded->GetTile(0, 0).tileSet, tileSet);
+
+	// Arbitrary bytes never decode to anything larger than they describe
+	uint32_t seed = 1;
+	for (int i = 0; i < 1000; i++)
+	{
+		QByteArray garbage;
+		int size = (int)(i % 64);
+		for (int j = 0; j < size; j++)
+		{
+			seed = (seed * 1103515245) + 12345;
+			garbage.append((char)(seed >> 16));
+		}
+		shared_ptr<MapFloatingLayer> result = MapTilesMimeData::Decode(garbage, project, layer);
+		if (result)
+			QVERIFY(((size_t)result->GetWidth() * (size_t)result->GetHeight() * 4) < (size_t)size);
+	}
+}
+
+
+void MapTilesMimeDataTest::TextIsCapturedWhenCopied()
+{
+	shared_ptr<Project> project = make_shared<Project>();
+	shared_ptr<Palette> first = make_shared<Palette>();
+	first->SetName("First Palette");
+	first->SetEntryCount(16);
+	QVERIFY(project->AddPalette(first));
+	shared_ptr<Palette> second = make_shared<Palette>();
+	second->SetName("Second Palette");
+	second->SetEntryCount(16);
+	QVERIFY(project->AddPalette(second));
+
+	shared_ptr<TileSet> tileSet = make_shared<TileSet>(8, 8, 4);
+	tileSet->SetName("Test Tiles");
+	tileSet->SetTileCount(1);
+	QVERIFY(project->AddTileSet(tileSet));
+	shared_ptr<Tile> tile = tileSet->GetTile(0);
+	tile->SetPalette(first, 0);
+	tile->GetData()[0] = 0x01;
+	shared_ptr<MapLayer> layer = make_shared<MapLayer>(16, 16, 8, 8, 4);
+
+	shared_ptr<MapFloatingLayer> contents = make_shared<MapFloatingLayer>(layer, 0, 0, 1, 1);
+	contents->SetTile(0, 0, tileSet, 0);
+	MapTilesMimeData mimeData(contents);
+
+	// Edits made after copying are not seen by the text, which is generated when it is first requested
+	tile->GetData()[0] = 0x02;
+	tile->SetPalette(second, 4);
+
+	QByteArray text = mimeData.data("text/plain");
+	Json::Value data;
+	Json::Reader reader;
+	QVERIFY(reader.parse(text.constData(), text.constData() + text.size(), data, false));
+	QCOMPARE(data["image"]["palettes"].size(), 1u);
+	QCOMPARE(data["image"]["palettes"][0].asString(), first->GetId());
+	QCOMPARE(data["image"]["pixel_data"].asString().substr(0, 2), string("01"));
+	QCOMPARE(data["image"]["palette_data"].asString().substr(0, 2), string("01"));
+	QCOMPARE(data["tiles"]["tile_sets"][0].asString(), tileSet->GetId());
+}
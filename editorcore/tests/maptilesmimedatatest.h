@@ -0,0 +1,13 @@
+#pragma once
+
+#include <QObject>
+
+class MapTilesMimeDataTest: public QObject
+{
+	Q_OBJECT
+
+private slots:
+	void EncodeDecodeRoundTrip();
+	void MalformedDataIsRejected();
+	void TextIsCapturedWhenCopied();
+};
@@ -0,0 +1,106 @@
+#include <QTest>
+#include <functional>
+#include <random>
+#include <vector>
+#include "palettetest.h"
+#include "palette.h"
+
+using namespace std;
+
+
+#define SENTINEL 0xdead
+
+
+typedef function<void(uint16_t* result, const uint16_t* a, const uint16_t* b, size_t count)> BatchColorFunction;
+typedef function<uint16_t(uint16_t a, uint16_t b)> ScalarColorFunction;
+
+
+static void CompareWithScalar(const BatchColorFunction& batch, const ScalarColorFunction& scalar)
+{
+	mt19937 random(1);
+
+	// Every value of a against random values of b. Bit 15 of b is random, it must be ignored as in the scalar version.
+	vector<uint16_t> a(0x8000), b(0x8000), result(0x8000);
+	for (size_t i = 0; i < a.size(); i++)
+		a[i] = (uint16_t)i;
+	for (int pass = 0; pass < 64; pass++)
+	{
+		for (auto& i : b)
+			i = (uint16_t)random();
+		batch(result.data(), a.data(), b.data(), a.size());
+		for (size_t i = 0; i < a.size(); i++)
+		{
+			if (result[i] != scalar(a[i], b[i]))
+				QFAIL(qPrintable(QString::asprintf("%.4x, %.4x gives %.4x, expected %.4x", a[i], b[i], result[i],
+					scalar(a[i], b[i]))));
+		}
+	}
+
+	// Rows of every length up to several vectors, at every alignment and in place, so that each split between
+	// the AVX2, SSE2 and scalar parts is covered. Nothing past the end of the row may be written.
+	for (size_t count = 0; count <= 72; count++)
+	{
+		for (size_t offset = 0; offset < 16; offset++)
+		{
+			vector<uint16_t> rowA(offset + count + 16), rowB(offset + count + 16);
+			for (auto& i : rowA)
+				i = (uint16_t)random();
+			for (auto& i : rowB)
+				i = (uint16_t)random();
+			vector<uint16_t> expected(count);
+			for (size_t i = 0; i < count; i++)
+				expected[i] = scalar(rowA[offset + i], rowB[offset + i]);
+
+			vector<uint16_t> row(offset + count + 16, SENTINEL);
+			batch(&row[offset], &rowA[offset], &rowB[offset], count);
+			for (size_t i = 0; i < count; i++)
+				QCOMPARE(row[offset + i], expected[i]);
+			for (size_t i = offset + count; i < row.size(); i++)
+				QCOMPARE(row[i], (uint16_t)SENTINEL);
+
+			vector<uint16_t> inPlace = rowA;
+			batch(&inPlace[offset], &inPlace[offset], &rowB[offset], count);
+			for (size_t i = 0; i < count; i++)
+				QCOMPARE(inPlace[offset + i], expected[i]);
+
+			inPlace = rowB;
+			batch(&inPlace[offset], &rowA[offset], &inPlace[offset], count);
+			for (size_t i = 0; i < count; i++)
+				QCOMPARE(inPlace[offset + i], expected[i]);
+		}
+	}
+}
+
+
+void PaletteTest::AddColors()
+{
+	CompareWithScalar(Palette::AddColors, Palette::AddColor);
+}
+
+
+void PaletteTest::SubColors()
+{
+	CompareWithScalar(Palette::SubColors, Palette::SubColor);
+}
+
+
+void PaletteTest::MultiplyColors()
+{
+	CompareWithScalar(Palette::MultiplyColors, Palette::MultiplyColor);
+}
+
+
+void PaletteTest::BlendColors()
+{
+	// Only the low four bits of alpha are used, values above 15 are included to check that they wrap the same way
+	for (int alpha = 0; alpha < 20; alpha++)
+	{
+		CompareWithScalar([=](uint16_t* result, const uint16_t* a, const uint16_t* b, size_t count) {
+			Palette::BlendColors(result, a, b, (uint8_t)alpha, count);
+		}, [=](uint16_t a, uint16_t b) {
+			return Palette::BlendColor(a, b, (uint8_t)alpha);
+		});
+		if (QTest::currentTestFailed())
+			return;
+	}
+}
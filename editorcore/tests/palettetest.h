@@ -0,0 +1,15 @@
+#pragma once
+
+#include <QObject>
+
+// Compares the batch color operations with the scalar versions they replace, which must match exactly
+class PaletteTest: public QObject
+{
+	Q_OBJECT
+
+private slots:
+	void AddColors();
+	void SubColors();
+	void MultiplyColors();
+	void BlendColors();
+};
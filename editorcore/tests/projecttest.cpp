@@ -0,0 +1,495 @@
+#include <QTest>
+#include <QTemporaryDir>
+#include <QFile>
+#include <QDir>
+#include "projecttest.h"
+#include "project.h"
+#include "undodelta.h"
+
+using namespace std;
+
+
+Json::Value ProjectTest::ReadFile(const QString& path)
+{
+	Json::Value result;
+	QFile file(path);
+	if (!file.open(QIODevice::ReadOnly))
+		return result;
+	QByteArray data = file.readAll();
+	Json::Reader reader;
+	reader.parse(data.constData(), data.constData() + data.size(), result, false);
+	return result;
+}
+
+
+bool ProjectTest::WriteFile(const QString& path, const Json::Value& data)
+{
+	QFile file(path);
+	if (!file.open(QIODevice::WriteOnly))
+		return false;
+	string contents = Json::StyledWriter().write(data);
+	return file.write(contents.c_str(), (qint64)contents.size()) == (qint64)contents.size();
+}
+
+
+void ProjectTest::SaveWritesUnnotifiedEdits()
+{
+	QTemporaryDir dir;
+	QVERIFY(dir.isValid());
+
+	shared_ptr<Project> project = make_shared<Project>();
+	shared_ptr<Palette> palette = make_shared<Palette>();
+	palette->SetName("Test Palette");
+	palette->SetEntryCount(16);
+	QVERIFY(project->AddPalette(palette));
+
+	shared_ptr<TileSet> tileSet = make_shared<TileSet>(8, 8, 4);
+	tileSet->SetName("Test Tiles");
+	tileSet->SetTileCount(4);
+	for (auto& i : tileSet->GetTiles())
+		i->SetPalette(palette, 0);
+	QVERIFY(project->AddTileSet(tileSet));
+
+	shared_ptr<Map> map = make_shared<Map>(16, 16, 8, 8, 4);
+	map->SetName("Test Map");
+	QVERIFY(project->AddMap(map));
+	QVERIFY(project->Save(dir.path()));
+
+	// Edit the model directly, as the editors do, without sending any update notification
+	map->GetMainLayer()->SetTileAt(3, 4, TileReference(tileSet, 2));
+	tileSet->GetTile(1)->GetData()[5] = 7;
+	palette->SetEntry(3, 0x1234);
+	QVERIFY(project->Save(dir.path()));
+
+	shared_ptr<Project> loaded = Project::Open(dir.path());
+	QVERIFY(loaded);
+	shared_ptr<Map> loadedMap = loaded->GetMapById(map->GetId());
+	QVERIFY(loadedMap);
+	TileReference tile = loadedMap->GetMainLayer()->GetTileAt(3, 4);
+	QVERIFY(tile.tileSet);
+	QCOMPARE(tile.tileSet->GetId(), tileSet->GetId());
+	QCOMPARE(tile.index, (uint16_t)2);
+	shared_ptr<TileSet> loadedTileSet = loaded->GetTileSetById(tileSet->GetId());
+	QVERIFY(loadedTileSet);
+	QCOMPARE(static_cast<const Tile&>(*loadedTileSet->GetTile(1)).GetData()[5], (uint8_t)7);
+	shared_ptr<Palette> loadedPalette = loaded->GetPaletteById(palette->GetId());
+	QVERIFY(loadedPalette);
+	QCOMPARE(loadedPalette->GetEntry(3), (uint16_t)0x1234);
+
+	// Maps loaded on first access are saved in place with their edits
+	loadedMap->GetMainLayer()->SetTileAt(5, 6, TileReference(loadedTileSet, 3));
+	QVERIFY(loaded->Save(dir.path()));
+	loaded = Project::Open(dir.path());
+	QVERIFY(loaded);
+	loadedMap = loaded->GetMapById(map->GetId());
+	QVERIFY(loadedMap);
+	QCOMPARE(loadedMap->GetMainLayer()->GetTileAt(5, 6).index, (uint16_t)3);
+	QCOMPARE(loadedMap->GetMainLayer()->GetTileAt(3, 4).index, (uint16_t)2);
+}
+
+
+void ProjectTest::MapLoadErrorsAreReturned()
+{
+	QTemporaryDir dir;
+	QVERIFY(dir.isValid());
+
+	shared_ptr<Project> project = make_shared<Project>();
+	shared_ptr<TileSet> tileSet = make_shared<TileSet>(8, 8, 4);
+	tileSet->SetName("Test Tiles");
+	tileSet->SetTileCount(1);
+	QVERIFY(project->AddTileSet(tileSet));
+	shared_ptr<Map> map = make_shared<Map>(16, 16, 8, 8, 4);
+	map->SetName("Test Map");
+	map->GetMainLayer()->SetTileAt(0, 0, TileReference(tileSet, 0));
+	QVERIFY(project->AddMap(map));
+	QVERIFY(project->Save(dir.path()));
+
+	// Replace the map file with one that cannot be parsed
+	QString mapFile;
+	for (auto& i : QDir(dir.path()).entryList(QDir::Files | QDir::NoDotAndDotDot))
+	{
+		if (i.endsWith(".s16map"))
+			mapFile = QDir(dir.path()).absoluteFilePath(i);
+	}
+	QVERIFY(mapFile.size() != 0);
+	QFile file(mapFile);
+	QVERIFY(file.open(QIODevice::WriteOnly));
+	file.write("{", 1);
+	file.close();
+
+	shared_ptr<Project> loaded = Project::Open(dir.path());
+	QVERIFY(loaded);
+	QVERIFY(!loaded->GetMapById(map->GetId()));
+	QVERIFY(loaded->GetLoadError(map->GetId()).size() != 0);
+	QCOMPARE(loaded->GetLoadErrors().size(), 1);
+	QVERIFY(loaded->IsUsedByUnloadedAsset(tileSet->GetId()));
+	QVERIFY(!loaded->LoadAllAssets());
+	QCOMPARE(loaded->GetMapIdsByName().count("Test Map"), (size_t)1);
+
+	// The map that failed to load keeps its file when saving
+	QVERIFY(loaded->Save(dir.path()));
+	QVERIFY(QFile::exists(mapFile));
+}
+
+
+void ProjectTest::TileSetsLoadOnFirstAccess()
+{
+	QTemporaryDir dir, copyDir;
+	QVERIFY(dir.isValid());
+	QVERIFY(copyDir.isValid());
+
+	shared_ptr<Project> project = make_shared<Project>();
+	shared_ptr<Palette> palette = make_shared<Palette>();
+	palette->SetName("Test Palette");
+	QVERIFY(project->AddPalette(palette));
+	shared_ptr<TileSet> used = make_shared<TileSet>(8, 8, 4);
+	used->SetName("Used Tiles");
+	used->SetTileCount(1);
+	QVERIFY(project->AddTileSet(used));
+	shared_ptr<TileSet> broken = make_shared<TileSet>(8, 8, 4);
+	broken->SetName("Broken Tiles");
+	broken->SetTileCount(1);
+	broken->GetTile(0)->SetPalette(palette, 0);
+	QVERIFY(project->AddTileSet(broken));
+	shared_ptr<Map> map = make_shared<Map>(16, 16, 8, 8, 4);
+	map->SetName("Test Map");
+	map->GetMainLayer()->SetTileAt(0, 0, TileReference(broken, 0));
+	QVERIFY(project->AddMap(map));
+	QVERIFY(project->Save(dir.path()));
+
+	QString brokenFile;
+	for (auto& i : QDir(dir.path()).entryList(QDir::Files | QDir::NoDotAndDotDot))
+	{
+		if (i.startsWith("Broken_Tiles"))
+			brokenFile = i;
+	}
+	QVERIFY(brokenFile.size() != 0);
+	QFile file(QDir(dir.path()).absoluteFilePath(brokenFile));
+	QVERIFY(file.open(QIODevice::WriteOnly));
+	file.write("{", 1);
+	file.close();
+
+	// Opening does not read tile sets, so the broken one is only reported when it is used
+	shared_ptr<Project> loaded = Project::Open(dir.path());
+	QVERIFY(loaded);
+	QCOMPARE(loaded->GetTileSetIdsByName().size(), (size_t)2);
+	QCOMPARE(loaded->GetLoadErrors().size(), 0);
+	QVERIFY(loaded->GetTileSetById(used->GetId()));
+
+	// Change notifications only look at loaded tile sets and do not read the others
+	QCOMPARE(loaded->GetLoadedTileSetsUsingPalette(loaded->GetPaletteById(palette->GetId())).size(), (size_t)0);
+	QCOMPARE(loaded->GetLoadError(broken->GetId()).size(), 0);
+
+	// Dependency queries load the tile sets that use the palette, the broken one cannot be and blocks removal
+	QCOMPARE(loaded->GetTileSetsUsingPalette(loaded->GetPaletteById(palette->GetId())).size(), (size_t)0);
+	QVERIFY(loaded->GetLoadError(broken->GetId()).size() != 0);
+	QVERIFY(loaded->IsUsedByUnloadedAsset(palette->GetId()));
+
+	// A map using the broken tile set is not loaded without its tiles
+	QVERIFY(!loaded->GetMapById(map->GetId()));
+	QVERIFY(loaded->GetLoadError(map->GetId()).size() != 0);
+	QCOMPARE(loaded->GetLoadErrors().size(), 2);
+
+	// Saving elsewhere copies the files of assets that are not loaded
+	QVERIFY(loaded->Save(copyDir.path()));
+	QVERIFY(QFile::exists(QDir(copyDir.path()).absoluteFilePath(brokenFile)));
+	shared_ptr<Project> copy = Project::Open(copyDir.path());
+	QVERIFY(copy);
+	QCOMPARE(copy->GetTileSetIdsByName().size(), (size_t)2);
+	QCOMPARE(copy->GetMapIdsByName().size(), (size_t)1);
+	QVERIFY(!copy->LoadAllAssets());
+}
+
+
+void ProjectTest::SnapshotIsUnchangedByLaterEdits()
+{
+	QTemporaryDir dir;
+	QVERIFY(dir.isValid());
+
+	shared_ptr<Project> project = make_shared<Project>();
+	shared_ptr<TileSet> tileSet = make_shared<TileSet>(8, 8, 4);
+	tileSet->SetName("Test Tiles");
+	tileSet->SetTileCount(2);
+	tileSet->GetTile(0)->GetData()[0] = 3;
+	QVERIFY(project->AddTileSet(tileSet));
+	shared_ptr<Map> map = make_shared<Map>(64, 64, 8, 8, 4);
+	map->SetName("Test Map");
+	map->GetMainLayer()->SetTileAt(40, 40, TileReference(tileSet, 1));
+	QVERIFY(project->AddMap(map));
+
+	// Edits made while the snapshot is being saved on another thread must not reach it
+	shared_ptr<Project> snapshot = project->CreateSnapshot();
+	tileSet->GetTile(0)->GetData()[0] = 5;
+	tileSet->SetTileCount(1);
+	map->GetMainLayer()->SetTileAt(40, 40, TileReference());
+	map->GetMainLayer()->SetTileAt(1, 1, TileReference(tileSet, 0));
+	QVERIFY(snapshot->Save(dir.path()));
+	project->FinishAutosave(snapshot, true);
+
+	shared_ptr<Project> loaded = Project::Open(dir.path());
+	QVERIFY(loaded);
+	shared_ptr<TileSet> loadedTileSet = loaded->GetTileSetById(tileSet->GetId());
+	QVERIFY(loadedTileSet);
+	QCOMPARE(loadedTileSet->GetTileCount(), (size_t)2);
+	QCOMPARE(static_cast<const Tile&>(*loadedTileSet->GetTile(0)).GetData()[0], (uint8_t)3);
+	shared_ptr<Map> loadedMap = loaded->GetMapById(map->GetId());
+	QVERIFY(loadedMap);
+	QCOMPARE(loadedMap->GetMainLayer()->GetTileAt(40, 40).index, (uint16_t)1);
+	QVERIFY(!loadedMap->GetMainLayer()->GetTileAt(1, 1).tileSet);
+}
+
+
+void ProjectTest::UsageCountsStayConsistent()
+{
+	QTemporaryDir dir;
+	QVERIFY(dir.isValid());
+
+	shared_ptr<Project> project = make_shared<Project>();
+	shared_ptr<Palette> first = make_shared<Palette>();
+	first->SetName("First Palette");
+	QVERIFY(project->AddPalette(first));
+	shared_ptr<Palette> second = make_shared<Palette>();
+	second->SetName("Second Palette");
+	QVERIFY(project->AddPalette(second));
+
+	shared_ptr<TileSet> tileSet = make_shared<TileSet>(8, 8, 4);
+	tileSet->SetName("Test Tiles");
+	tileSet->SetTileCount(4);
+	QVERIFY(project->AddTileSet(tileSet));
+	QVERIFY(tileSet->CheckPaletteUsage());
+
+	tileSet->GetTile(0)->SetPalette(first, 0);
+	tileSet->GetTile(1)->SetPalette(first, 0);
+	tileSet->GetTile(3)->SetPalette(second, 0);
+	QVERIFY(tileSet->CheckPaletteUsage());
+	QCOMPARE(project->GetTileSetsUsingPalette(first).size(), (size_t)1);
+
+	shared_ptr<Tile> replacement = make_shared<Tile>(8, 8, 4);
+	replacement->SetPalette(second, 0);
+	shared_ptr<Tile> replaced = tileSet->GetTile(1);
+	tileSet->SetTile(1, replacement);
+	QVERIFY(tileSet->CheckPaletteUsage());
+	replaced->SetPalette(second, 0);
+	QVERIFY(tileSet->CheckPaletteUsage());
+
+	shared_ptr<Map> map = make_shared<Map>(64, 64, 8, 8, 4);
+	map->SetName("Test Map");
+	shared_ptr<MapLayer> layer = map->GetMainLayer();
+	layer->SetTileAt(0, 0, TileReference(tileSet, 0));
+	layer->SetTileAt(40, 40, TileReference(tileSet, 3));
+	QVERIFY(project->AddMap(map));
+	QVERIFY(layer->CheckTileSetUsage());
+	QVERIFY(project->CheckUsageCounts());
+
+	// Remove the last tiles the way the tile set view does, then undo and redo it
+	vector<shared_ptr<Tile>> deleted(tileSet->GetTiles().begin() + 2, tileSet->GetTiles().end());
+	MapLayerDelta cleared(layer);
+	cleared.AddChange(40, 40, layer->GetTileAt(40, 40), TileReference());
+	cleared.Finish();
+	cleared.Redo();
+	tileSet->SetTileCount(2);
+	QVERIFY(tileSet->CheckPaletteUsage());
+	QVERIFY(layer->CheckTileSetUsage());
+	QVERIFY(project->CheckUsageCounts());
+	QCOMPARE(project->GetTileSetsUsingPalette(first).size(), (size_t)1);
+
+	// Edits to removed tiles held by the undo history must not count towards the set
+	deleted[1]->SetPalette(first, 0);
+	QVERIFY(tileSet->CheckPaletteUsage());
+
+	tileSet->SetTileCount(4);
+	for (size_t i = 0; i < deleted.size(); i++)
+		tileSet->SetTile(2 + i, deleted[i]);
+	cleared.Undo();
+	QVERIFY(tileSet->CheckPaletteUsage());
+	QVERIFY(layer->CheckTileSetUsage());
+	QVERIFY(project->CheckUsageCounts());
+	QCOMPARE(layer->GetTileAt(40, 40).index, (uint16_t)3);
+
+	tileSet->SetTileCount(2);
+	cleared.Redo();
+	QVERIFY(project->CheckUsageCounts());
+	tileSet->SetTileCount(4);
+	for (size_t i = 0; i < deleted.size(); i++)
+		tileSet->SetTile(2 + i, deleted[i]);
+	cleared.Undo();
+	QVERIFY(project->CheckUsageCounts());
+
+	// Palette assignments made by pixel edits are counted in both directions
+	TilePixelDelta pixels(0);
+	shared_ptr<Tile> tile = tileSet->GetTile(0);
+	pixels.AddChange(tile, 0, tile->GetData()[0], 1, tile->GetPalette(), tile->GetPaletteOffset(), second, 0);
+	pixels.Finish();
+	pixels.Redo();
+	QVERIFY(tileSet->CheckPaletteUsage());
+	pixels.Undo();
+	QVERIFY(tileSet->CheckPaletteUsage());
+	QCOMPARE(tile->GetPalette(), first);
+
+	// Snapshots share chunks and tiles with the project, edits on either side keep both consistent
+	shared_ptr<Project> snapshot = project->CreateSnapshot();
+	QVERIFY(snapshot->CheckUsageCounts());
+	layer->SetTileAt(1, 1, TileReference(tileSet, 1));
+	tileSet->GetTile(2)->SetPalette(second, 0);
+	QVERIFY(project->CheckUsageCounts());
+	QVERIFY(snapshot->CheckUsageCounts());
+
+	QVERIFY(project->Save(dir.path()));
+	shared_ptr<Project> loaded = Project::Open(dir.path());
+	QVERIFY(loaded);
+	QVERIFY(loaded->LoadAllAssets());
+	QVERIFY(loaded->CheckUsageCounts());
+	shared_ptr<Map> loadedMap = loaded->GetMapById(map->GetId());
+	QVERIFY(loadedMap);
+	QVERIFY(loadedMap->GetMainLayer()->CheckTileSetUsage());
+	shared_ptr<TileSet> loadedTileSet = loaded->GetTileSetById(tileSet->GetId());
+	QVERIFY(loadedTileSet);
+	QVERIFY(loadedTileSet->CheckPaletteUsage());
+	QCOMPARE(loaded->GetTileSetsUsingPalette(loaded->GetPaletteById(first->GetId())).size(), (size_t)1);
+}
+
+
+void ProjectTest::DependencyIndexFollowsEdits()
+{
+	shared_ptr<Project> project = make_shared<Project>();
+	shared_ptr<Palette> palette = make_shared<Palette>();
+	palette->SetName("Test Palette");
+	QVERIFY(project->AddPalette(palette));
+
+	shared_ptr<TileSet> tileSet = make_shared<TileSet>(8, 8, 4);
+	tileSet->SetName("Test Tiles");
+	tileSet->SetTileCount(2);
+	QVERIFY(project->AddTileSet(tileSet));
+	QCOMPARE(project->GetTileSetsUsingPalette(palette).size(), (size_t)0);
+	tileSet->GetTile(1)->SetPalette(palette, 0);
+	QCOMPARE(project->GetTileSetsUsingPalette(palette), vector<shared_ptr<TileSet>>{tileSet});
+	QVERIFY(project->CheckUsageCounts());
+
+	shared_ptr<MapLayer> effectLayer = make_shared<MapLayer>(4, 4, 8, 8, 4, true);
+	effectLayer->SetName("Test Effect");
+	QVERIFY(project->AddEffectLayer(effectLayer));
+	effectLayer->SetTileAt(1, 1, TileReference(tileSet, 0));
+	QCOMPARE(project->GetEffectLayersUsingTileSet(tileSet), vector<shared_ptr<MapLayer>>{effectLayer});
+
+	// Maps are found through their own layers and through effect layers, in name order
+	shared_ptr<Map> first = make_shared<Map>(16, 16, 8, 8, 4);
+	first->SetName("B Map");
+	QVERIFY(project->AddMap(first));
+	shared_ptr<Map> second = make_shared<Map>(16, 16, 8, 8, 4);
+	second->SetName("A Map");
+	QVERIFY(project->AddMap(second));
+	QCOMPARE(project->GetMapsUsingTileSet(tileSet).size(), (size_t)0);
+
+	shared_ptr<MapLayer> layer = make_shared<MapLayer>(16, 16, 8, 8, 4);
+	layer->SetTileAt(3, 3, TileReference(tileSet, 1));
+	first->InsertLayer(1, layer);
+	second->InsertLayer(1, effectLayer);
+	second->InsertLayer(2, effectLayer);
+	QCOMPARE(project->GetMapsUsingTileSet(tileSet), (vector<shared_ptr<Map>>{second, first}));
+	QCOMPARE(project->GetMapsUsingEffectLayer(effectLayer), vector<shared_ptr<Map>>{second});
+	QVERIFY(project->CheckUsageCounts());
+
+	// An effect layer stays in the map until its last instance is removed
+	second->DeleteLayer(2);
+	QCOMPARE(project->GetMapsUsingEffectLayer(effectLayer), vector<shared_ptr<Map>>{second});
+	second->DeleteLayer(1);
+	QCOMPARE(project->GetMapsUsingEffectLayer(effectLayer).size(), (size_t)0);
+	QCOMPARE(project->GetMapsUsingTileSet(tileSet), vector<shared_ptr<Map>>{first});
+
+	// Removed layers no longer count, even when edited while held by the undo history
+	first->DeleteLayer(1);
+	QCOMPARE(project->GetMapsUsingTileSet(tileSet).size(), (size_t)0);
+	layer->SetTileAt(3, 3, TileReference());
+	layer->SetTileAt(4, 4, TileReference(tileSet, 0));
+	QVERIFY(project->CheckUsageCounts());
+	first->InsertLayer(1, layer);
+	QCOMPARE(project->GetMapsUsingTileSet(tileSet), vector<shared_ptr<Map>>{first});
+
+	// Clearing the last tile and replacing tiles within the same set are tracked
+	first->GetMainLayer()->SetTileAt(0, 0, TileReference(tileSet, 0));
+	first->GetMainLayer()->SetTileAt(0, 0, TileReference(tileSet, 1));
+	layer->SetTileAt(4, 4, TileReference());
+	QCOMPARE(project->GetMapsUsingTileSet(tileSet), vector<shared_ptr<Map>>{first});
+	first->GetMainLayer()->SetTileAt(0, 0, TileReference());
+	QCOMPARE(project->GetMapsUsingTileSet(tileSet).size(), (size_t)0);
+	QVERIFY(project->CheckUsageCounts());
+
+	// Deleted assets leave the index and return to it when added back, as undo does
+	layer->SetTileAt(4, 4, TileReference(tileSet, 0));
+	project->DeleteMap(first);
+	QCOMPARE(project->GetMapsUsingTileSet(tileSet).size(), (size_t)0);
+	QVERIFY(project->CheckUsageCounts());
+	QVERIFY(project->AddMap(first));
+	QCOMPARE(project->GetMapsUsingTileSet(tileSet), vector<shared_ptr<Map>>{first});
+
+	project->DeleteEffectLayer(effectLayer);
+	QCOMPARE(project->GetEffectLayersUsingTileSet(tileSet).size(), (size_t)0);
+	QVERIFY(project->CheckUsageCounts());
+
+	first->DeleteLayer(1);
+	project->DeleteTileSet(tileSet);
+	QCOMPARE(project->GetTileSetsUsingPalette(palette).size(), (size_t)0);
+	tileSet->GetTile(0)->SetPalette(palette, 0);
+	QVERIFY(project->CheckUsageCounts());
+	QVERIFY(project->AddTileSet(tileSet));
+	QCOMPARE(project->GetTileSetsUsingPalette(palette), vector<shared_ptr<TileSet>>{tileSet});
+	QVERIFY(project->CheckUsageCounts());
+}
+
+
+void ProjectTest::MapTileFormatIsKeptPerProject()
+{
+	QTemporaryDir dir;
+	QVERIFY(dir.isValid());
+
+	shared_ptr<Project> project = make_shared<Project>();
+	QCOMPARE(project->GetMapTileFormat(), (uint32_t)MAP_LAYER_TILE_FORMAT_PACKED);
+	shared_ptr<TileSet> tileSet = make_shared<TileSet>(8, 8, 4);
+	tileSet->SetName("Test Tiles");
+	tileSet->SetTileCount(2);
+	QVERIFY(project->AddTileSet(tileSet));
+	shared_ptr<Map> map = make_shared<Map>(16, 16, 8, 8, 4);
+	map->SetName("Test Map");
+	map->GetMainLayer()->SetTileAt(2, 3, TileReference(tileSet, 1));
+	QVERIFY(project->AddMap(map));
+	QVERIFY(project->Save(dir.path()));
+
+	QString mapFile;
+	for (auto& i : QDir(dir.path()).entryList(QDir::Files | QDir::NoDotAndDotDot))
+	{
+		if (i.endsWith(".s16map"))
+			mapFile = QDir(dir.path()).absoluteFilePath(i);
+	}
+	QVERIFY(mapFile.size() != 0);
+	QCOMPARE(ReadFile(mapFile)["layers"][0]["normal"]["tile_format"].asUInt(), (uint32_t)MAP_LAYER_TILE_FORMAT_PACKED);
+
+	// Switching to rows rewrites maps that were not loaded yet
+	shared_ptr<Project> loaded = Project::Open(dir.path());
+	QVERIFY(loaded);
+	QCOMPARE(loaded->GetMapTileFormat(), (uint32_t)MAP_LAYER_TILE_FORMAT_PACKED);
+	QVERIFY(loaded->SetMapTileFormat(MAP_LAYER_TILE_FORMAT_ROWS));
+	QVERIFY(loaded->Save(dir.path()));
+	QVERIFY(!ReadFile(mapFile)["layers"][0]["normal"].isMember("tile_format"));
+
+	loaded = Project::Open(dir.path());
+	QVERIFY(loaded);
+	QCOMPARE(loaded->GetMapTileFormat(), (uint32_t)MAP_LAYER_TILE_FORMAT_ROWS);
+	shared_ptr<Map> loadedMap = loaded->GetMapById(map->GetId());
+	QVERIFY(loadedMap);
+	QCOMPARE(loadedMap->GetMainLayer()->GetTileAt(2, 3).index, (uint16_t)1);
+
+	// Manifests written before the packed format keep the rows format
+	QString manifestFile = QDir(dir.path()).absoluteFilePath("manifest.json");
+	Json::Value manifest = ReadFile(manifestFile);
+	QVERIFY(manifest.isMember("map_tile_format"));
+	manifest["map_tile_format"] = MAP_LAYER_TILE_FORMAT_PACKED;
+	QVERIFY(WriteFile(manifestFile, manifest));
+	loaded = Project::Open(dir.path());
+	QVERIFY(loaded);
+	QCOMPARE(loaded->GetMapTileFormat(), (uint32_t)MAP_LAYER_TILE_FORMAT_PACKED);
+	manifest.removeMember("map_tile_format");
+	QVERIFY(WriteFile(manifestFile, manifest));
+	loaded = Project::Open(dir.path());
+	QVERIFY(loaded);
+	QCOMPARE(loaded->GetMapTileFormat(), (uint32_t)MAP_LAYER_TILE_FORMAT_ROWS);
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <QObject>
+#include <QString>
+#include "json/json.h"
+
+class ProjectTest: public QObject
+{
+	Q_OBJECT
+
+	static Json::Value ReadFile(const QString& path);
+	static bool WriteFile(const QString& path, const Json::Value& data);
+
+private slots:
+	void SaveWritesUnnotifiedEdits();
+	void MapLoadErrorsAreReturned();
+	void TileSetsLoadOnFirstAccess();
+	void SnapshotIsUnchangedByLaterEdits();
+	void UsageCountsStayConsistent();
+	void DependencyIndexFollowsEdits();
+	void MapTileFormatIsKeptPerProject();
+};
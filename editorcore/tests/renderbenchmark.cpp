@@ -0,0 +1,152 @@
+#include <QTest>
+#include <QThread>
+#include <random>
+#include <set>
+#include "renderbenchmark.h"
+#include "renderer.h"
+
+using namespace std;
+
+
+shared_ptr<Map> RenderBenchmark::CreateMap(size_t size, bool animated)
+{
+	mt19937 random(1);
+
+	shared_ptr<Palette> palette = make_shared<Palette>();
+	palette->SetEntryCount(256);
+	for (size_t i = 0; i < 256; i++)
+		palette->SetEntry(i, (uint16_t)(random() & 0x7fff));
+
+	shared_ptr<TileSet> tileSet = make_shared<TileSet>(8, 8, 4);
+	tileSet->SetTileCount(64);
+	if (animated)
+	{
+		shared_ptr<Animation> animation = make_shared<Animation>();
+		for (size_t i = 0; i < 4; i++)
+			animation->AddFrame(1);
+		tileSet->SetAnimation(animation);
+	}
+	for (size_t i = 0; i < 64; i++)
+	{
+		shared_ptr<Tile> tile = tileSet->GetTile(i);
+		tile->SetPalette(palette, (uint8_t)((i & 15) << 4));
+		uint8_t* data = tile->GetData();
+		for (size_t j = 0; j < tile->GetSize(); j++)
+			data[j] = (uint8_t)random();
+	}
+
+	// Main layer and three blended layers above it, all completely filled
+	shared_ptr<Map> map = make_shared<Map>(size, size, 8, 8, 4);
+	for (size_t i = 0; i < 4; i++)
+	{
+		shared_ptr<MapLayer> layer = map->GetMainLayer();
+		if (i != 0)
+		{
+			layer = make_shared<MapLayer>(size, size, 8, 8, 4);
+			layer->SetBlendMode((i == 1) ? BlendMode_Normal : BlendMode_Add);
+			layer->SetAlpha(8);
+			map->InsertLayer(i, layer);
+		}
+		for (size_t y = 0; y < size; y++)
+			for (size_t x = 0; x < size; x++)
+				layer->SetTileAt(x, y, TileReference(tileSet, (uint16_t)(random() % 64)));
+	}
+	return map;
+}
+
+
+void RenderBenchmark::initTestCase()
+{
+	m_map = CreateMap(512, false);
+
+	// Layers of 2048x2048 pixels are the largest that are cached
+	m_cachedMap = CreateMap(256, false);
+	m_animatedMap = CreateMap(256, true);
+}
+
+
+void RenderBenchmark::cleanupTestCase()
+{
+	m_map.reset();
+	m_cachedMap.reset();
+	m_animatedMap.reset();
+}
+
+
+void RenderBenchmark::Render_data()
+{
+	QTest::addColumn<int>("width");
+	QTest::addColumn<int>("height");
+	QTest::addColumn<int>("bands");
+
+	set<int> bandCounts{1, 2, 4, 8};
+	bandCounts.insert(QThread::idealThreadCount());
+
+	// The smallest size is the threshold below which updates are always rendered in one band
+	int sizes[][2] = {{128, 128}, {512, 512}, {1920, 1080}, {3840, 2160}};
+	for (auto& size : sizes)
+	{
+		for (int bands : bandCounts)
+		{
+			if (bands < 1)
+				continue;
+			QTest::newRow(qPrintable(QString::asprintf("%dx%d bands=%d", size[0], size[1], bands))) <<
+				size[0] << size[1] << bands;
+		}
+	}
+}
+
+
+void RenderBenchmark::Render()
+{
+	QFETCH(int, width);
+	QFETCH(int, height);
+	QFETCH(int, bands);
+	QVERIFY((width * height) >= MIN_PARALLEL_RENDER_AREA);
+
+	Renderer renderer(m_map, (uint16_t)width, (uint16_t)height);
+	renderer.SetBandCount((size_t)bands);
+	renderer.Render();
+
+	// Advancing the animation makes every render recompose the whole view
+	QBENCHMARK
+	{
+		renderer.TickAnimation();
+		renderer.Render();
+	}
+}
+
+
+void RenderBenchmark::CachedLayers_data()
+{
+	QTest::addColumn<bool>("cache");
+	QTest::addColumn<bool>("animated");
+	QTest::addColumn<bool>("preview");
+
+	QTest::newRow("static, uncached") << false << false << false;
+	QTest::newRow("static, cached") << true << false << false;
+	QTest::newRow("animated, uncached") << false << true << true;
+	QTest::newRow("animated, cached") << true << true << true;
+
+	// Animated layers are rebuilt on every frame if the renderer is not told that the preview is running
+	QTest::newRow("animated, cached, rebuilt every frame") << true << true << false;
+}
+
+
+void RenderBenchmark::CachedLayers()
+{
+	QFETCH(bool, cache);
+	QFETCH(bool, animated);
+	QFETCH(bool, preview);
+
+	Renderer renderer(animated ? m_animatedMap : m_cachedMap, 1920, 1080);
+	renderer.SetLayerCacheEnabled(cache);
+	renderer.SetAnimating(preview);
+	renderer.Render();
+
+	QBENCHMARK
+	{
+		renderer.TickAnimation();
+		renderer.Render();
+	}
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <QObject>
+#include <memory>
+#include "map.h"
+
+// Full renders of a large four layer map, run with --bench. Compare the rows of each render size to find the
+// band count and the smallest update that benefit from rendering in parallel on the machine. CachedLayers
+// compares rendering with and without the layer cache, on the largest map it caches with and without
+// animated tiles.
+class RenderBenchmark: public QObject
+{
+	Q_OBJECT
+
+	std::shared_ptr<Map> m_map, m_cachedMap, m_animatedMap;
+
+	static std::shared_ptr<Map> CreateMap(size_t size, bool animated);
+
+private slots:
+	void initTestCase();
+	void cleanupTestCase();
+	void Render_data();
+	void Render();
+	void CachedLayers_data();
+	void CachedLayers();
+};
@@ -0,0 +1,37 @@
+QT += core gui widgets testlib
+
+TARGET = editortests
+TEMPLATE = app
+CONFIG += console
+CONFIG += c++11
+CONFIG += testcase
+CONFIG -= app_bundle
+
+DEFINES += QT_DEPRECATED_WARNINGS
+INCLUDEPATH += $$PWD/..
+
+# Links the editor core library from the parent of this build directory. The color kernels are selected at
+# compile time, build both with QMAKE_CXXFLAGS+=-mavx2 to test the AVX2 versions instead of SSE2.
+LIBS += -L$$OUT_PWD/.. -leditorcore
+unix: PRE_TARGETDEPS += $$OUT_PWD/../libeditorcore.a
+
+SOURCES += \
+	main.cpp \
+	palettetest.cpp \
+	tiletest.cpp \
+	projecttest.cpp \
+	maplayertest.cpp \
+	undohistorytest.cpp \
+	maptilesmimedatatest.cpp \
+	renderbenchmark.cpp \
+	tilebenchmark.cpp
+
+HEADERS += \
+	palettetest.h \
+	tiletest.h \
+	projecttest.h \
+	maplayertest.h \
+	undohistorytest.h \
+	maptilesmimedatatest.h \
+	renderbenchmark.h \
+	tilebenchmark.h
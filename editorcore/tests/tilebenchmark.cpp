@@ -0,0 +1,84 @@
+#include <QTest>
+#include <random>
+#include <string.h>
+#include "tilebenchmark.h"
+
+using namespace std;
+
+
+void TileBenchmark::initTestCase()
+{
+	mt19937 random(1);
+
+	// 1024 tiles of 16x16 pixels at 8 bits per pixel with four animation frames, 1 MB of pixel data
+	m_tileSet = make_shared<TileSet>(16, 16, 8);
+	m_tileSet->SetTileCount(1024);
+	shared_ptr<Animation> animation = make_shared<Animation>();
+	for (size_t i = 0; i < 4; i++)
+		animation->AddFrame(1);
+	m_tileSet->SetAnimation(animation);
+	for (auto& i : m_tileSet->GetTiles())
+	{
+		uint8_t* data = i->GetData();
+		for (size_t j = 0; j < i->GetSize(); j++)
+			data[j] = (uint8_t)(random() & 15);
+	}
+}
+
+
+void TileBenchmark::cleanupTestCase()
+{
+	m_tileSet.reset();
+}
+
+
+void TileBenchmark::LoadTileSet_data()
+{
+	QTest::addColumn<QString>("encoding");
+
+	QTest::newRow("hex") << QString("hex");
+	QTest::newRow("base64") << QString("base64");
+	QTest::newRow("zlib") << QString("zlib");
+}
+
+
+void TileBenchmark::LoadTileSet()
+{
+	QFETCH(QString, encoding);
+
+	Json::Value data = m_tileSet->Serialize();
+	for (size_t i = 0; i < m_tileSet->GetTiles().size(); i++)
+	{
+		shared_ptr<Tile> tile = m_tileSet->GetTile(i);
+		const uint8_t* pixels = static_cast<const Tile&>(*tile).GetData();
+		QByteArray raw((const char*)pixels, (int)tile->GetSize());
+		Json::Value& tileData = data["tiles"][(Json::ArrayIndex)i];
+		if (encoding == "hex")
+		{
+			// Hex data has no encoding tag
+			tileData.removeMember("encoding");
+			tileData["data"] = raw.toHex().toStdString();
+		}
+		else if (encoding == "base64")
+		{
+			tileData["encoding"] = "base64";
+			tileData["data"] = raw.toBase64().toStdString();
+		}
+		else
+		{
+			tileData["encoding"] = "zlib";
+			tileData["data"] = qCompress(raw).toBase64().toStdString();
+		}
+	}
+
+	shared_ptr<TileSet> loaded;
+	QBENCHMARK
+	{
+		loaded = TileSet::Deserialize(shared_ptr<Project>(), data);
+	}
+	QVERIFY(loaded);
+	QCOMPARE(loaded->GetTiles().size(), m_tileSet->GetTiles().size());
+	QVERIFY(loaded->GetTile(1023));
+	QVERIFY(memcmp(static_cast<const Tile&>(*loaded->GetTile(1023)).GetData(),
+		static_cast<const Tile&>(*m_tileSet->GetTile(1023)).GetData(), m_tileSet->GetTile(1023)->GetSize()) == 0);
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <QObject>
+#include <memory>
+#include "tileset.h"
+
+// Loading a large animated tile set with each pixel data encoding, run with --bench. The hex rows are the
+// format of projects saved before base64 pixel data was added.
+class TileBenchmark: public QObject
+{
+	Q_OBJECT
+
+	std::shared_ptr<TileSet> m_tileSet;
+
+private slots:
+	void initTestCase();
+	void cleanupTestCase();
+	void LoadTileSet_data();
+	void LoadTileSet();
+};
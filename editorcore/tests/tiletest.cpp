@@ -0,0 +1,41 @@
+#include <QTest>
+#include "tiletest.h"
+#include "tile.h"
+#include "tilecache.h"
+
+using namespace std;
+
+
+void TileTest::GenerationChangesOnWrite()
+{
+	shared_ptr<Palette> palette = make_shared<Palette>();
+	palette->SetEntryCount(16);
+	palette->SetEntry(1, 0x1234);
+	palette->SetEntry(2, 0x4321);
+
+	shared_ptr<Tile> tile = make_shared<Tile>(8, 8, 8, 2);
+	tile->SetPalette(palette, 0);
+	tile->GetData(1)[0] = 1;
+	QCOMPARE((*TileCache::GetPixels(tile, 1))[0], (uint16_t)0x1234);
+
+	// Reading does not invalidate cached pixels
+	uint64_t generation = tile->GetGeneration();
+	QCOMPARE(static_cast<const Tile&>(*tile).GetData(1)[0], (uint8_t)1);
+	QCOMPARE(tile->GetGeneration(), generation);
+
+	// Writing through either non-const GetData is seen by the cache without any other call
+	tile->GetData(1)[0] = 2;
+	QVERIFY(tile->GetGeneration() != generation);
+	QCOMPARE((*TileCache::GetPixels(tile, 1))[0], (uint16_t)0x4321);
+
+	tile->GetData()[tile->GetPerFrameSize()] = 1;
+	QCOMPARE((*TileCache::GetPixels(tile, 1))[0], (uint16_t)0x1234);
+
+	// Snapshots keep the generation of the pixels they share, writing to the original moves it on
+	shared_ptr<Tile> snapshot = tile->CreateSnapshot();
+	QCOMPARE(snapshot->GetGeneration(), tile->GetGeneration());
+	tile->GetData(1)[0] = 2;
+	QVERIFY(snapshot->GetGeneration() != tile->GetGeneration());
+	QCOMPARE((*TileCache::GetPixels(snapshot, 1))[0], (uint16_t)0x1234);
+	QCOMPARE((*TileCache::GetPixels(tile, 1))[0], (uint16_t)0x4321);
+}
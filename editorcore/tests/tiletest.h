@@ -0,0 +1,11 @@
+#pragma once
+
+#include <QObject>
+
+class TileTest: public QObject
+{
+	Q_OBJECT
+
+private slots:
+	void GenerationChangesOnWrite();
+};
@@ -0,0 +1,111 @@
+#include <QTest>
+#include "undohistorytest.h"
+#include "undohistory.h"
+
+using namespace std;
+
+
+shared_ptr<UndoAction> UndoHistoryTest::CreateAction(const string& asset, size_t memoryUsage,
+	shared_ptr<vector<int>> log, int number)
+{
+	return make_shared<UndoAction>(
+		[=]() { log->push_back(number); },
+		[=]() { log->push_back(-number); },
+		asset, memoryUsage);
+}
+
+
+void UndoHistoryTest::OldestActionsAreDiscardedFirst()
+{
+	shared_ptr<vector<int>> log = make_shared<vector<int>>();
+	size_t actionSize = CreateAction("", 1000, log, 0)->GetMemoryUsage();
+
+	UndoHistory history(actionSize * 3);
+	for (int i = 1; i <= 5; i++)
+		history.Add(CreateAction("", 1000, log, i));
+	QCOMPARE(history.GetUndoCount(), (size_t)3);
+	QCOMPARE(history.GetMemoryUsage(), actionSize * 3);
+
+	while (history.Undo())
+		continue;
+	QCOMPARE(*log, (vector<int>{5, 4, 3}));
+	QCOMPARE(history.GetRedoCount(), (size_t)3);
+
+	// An action larger than the budget is still kept so that it can be undone
+	history.Clear();
+	QCOMPARE(history.GetMemoryUsage(), (size_t)0);
+	history.Add(CreateAction("", 1000, log, 6));
+	history.Add(CreateAction("", actionSize * 4, log, 7));
+	QCOMPARE(history.GetUndoCount(), (size_t)1);
+	log->clear();
+	QVERIFY(history.Undo());
+	QCOMPARE(*log, vector<int>{7});
+
+	// Lowering the budget discards old actions immediately
+	history.Clear();
+	for (int i = 1; i <= 3; i++)
+		history.Add(CreateAction("", 1000, log, i));
+	history.SetMemoryBudget(actionSize);
+	QCOMPARE(history.GetUndoCount(), (size_t)1);
+	QCOMPARE(history.GetMemoryUsage(), actionSize);
+}
+
+
+void UndoHistoryTest::RedoStackIsCounted()
+{
+	shared_ptr<vector<int>> log = make_shared<vector<int>>();
+	size_t actionSize = CreateAction("", 1000, log, 0)->GetMemoryUsage();
+
+	UndoHistory history(actionSize * 3);
+	for (int i = 1; i <= 3; i++)
+		history.Add(CreateAction("", 1000, log, i));
+	QVERIFY(history.Undo());
+	QVERIFY(history.Undo());
+	QCOMPARE(history.GetUndoCount(), (size_t)1);
+	QCOMPARE(history.GetRedoCount(), (size_t)2);
+	QCOMPARE(history.GetMemoryUsage(), actionSize * 3);
+
+	QVERIFY(history.Redo());
+	QCOMPARE(*log, (vector<int>{3, 2, -2}));
+	QCOMPARE(history.GetMemoryUsage(), actionSize * 3);
+
+	// A new action clears the redo stack and its memory
+	history.Add(CreateAction("", 1000, log, 4));
+	QCOMPARE(history.GetRedoCount(), (size_t)0);
+	QCOMPARE(history.GetUndoCount(), (size_t)3);
+	QCOMPARE(history.GetMemoryUsage(), actionSize * 3);
+	QVERIFY(!history.Redo());
+
+	// Redo actions take budget away from the undo stack
+	QVERIFY(history.Undo());
+	history.SetMemoryBudget(actionSize * 2);
+	QCOMPARE(history.GetUndoCount(), (size_t)1);
+	QCOMPARE(history.GetRedoCount(), (size_t)1);
+	QCOMPARE(history.GetMemoryUsage(), actionSize * 2);
+}
+
+
+void UndoHistoryTest::MemoryUsageIsReportedByAsset()
+{
+	shared_ptr<vector<int>> log = make_shared<vector<int>>();
+	size_t overhead = CreateAction("", 0, log, 0)->GetMemoryUsage();
+
+	UndoHistory history;
+	history.Add(CreateAction("map", 100, log, 1));
+	history.Add(CreateAction("tileset", 200, log, 2));
+	history.Add(CreateAction("map", 300, log, 3));
+	history.Add(CreateAction("", 50, log, 4));
+	QVERIFY(history.Undo());
+	QVERIFY(history.Undo());
+
+	map<string, size_t> usage = history.GetMemoryUsageByAsset();
+	QCOMPARE(usage.size(), (size_t)3);
+	QCOMPARE(usage["map"], 400 + overhead * 2);
+	QCOMPARE(usage["tileset"], 200 + overhead);
+	QCOMPARE(usage[""], 50 + overhead);
+
+	size_t total = 0;
+	for (auto& i : usage)
+		total += i.second;
+	QCOMPARE(total, history.GetMemoryUsage());
+}
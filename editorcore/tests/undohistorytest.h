@@ -0,0 +1,22 @@
+#pragma once
+
+#include <QObject>
+#include <memory>
+#include <string>
+#include <vector>
+
+class UndoAction;
+
+class UndoHistoryTest: public QObject
+{
+	Q_OBJECT
+
+	// Creates an action that appends its number to the log when undone and its negation when redone
+	static std::shared_ptr<UndoAction> CreateAction(const std::string& asset, size_t memoryUsage,
+		std::shared_ptr<std::vector<int>> log, int number);
+
+private slots:
+	void OldestActionsAreDiscardedFirst();
+	void RedoStackIsCounted();
+	void MemoryUsageIsReportedByAsset();
+};
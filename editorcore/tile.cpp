@@ -1,3 +1,4 @@
+#include <QByteArray>
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -8,6 +9,67 @@ using namespace std;
 
 
 map<uint32_t, string> Tile::m_collisionChannelNames;
+atomic<uint64_t> Tile::m_nextGeneration(1);
+
+
+// Lookup table from character to hex digit value, -1 for characters that are not hex digits
+struct HexDigitTable
+{
+	int8_t values[256];
+
+	HexDigitTable()
+	{
+		memset(values, -1, sizeof(values));
+		for (int i = 0; i < 10; i++)
+			values['0' + i] = (int8_t)i;
+		for (int i = 0; i < 6; i++)
+		{
+			values['a' + i] = (int8_t)(10 + i);
+			values['A' + i] = (int8_t)(10 + i);
+		}
+	}
+};
+
+static const HexDigitTable g_hexDigits;
+
+
+static bool DecodeHex(const string& str, uint8_t* data, size_t size)
+{
+	if (str.size() != (size * 2))
+		return false;
+
+	const uint8_t* src = (const uint8_t*)str.data();
+	for (size_t i = 0; i < size; i++)
+	{
+		int8_t high = g_hexDigits.values[src[i * 2]];
+		int8_t low = g_hexDigits.values[src[(i * 2) + 1]];
+		if ((high < 0) || (low < 0))
+			return false;
+		data[i] = (uint8_t)((high << 4) | low);
+	}
+	return true;
+}
+
+
+void TilePaletteUsage::Add(const shared_ptr<Palette>& palette)
+{
+	if ((m_counts[palette]++ == 0) && m_callback)
+		m_callback(palette, true);
+}
+
+
+void TilePaletteUsage::Remove(const shared_ptr<Palette>& palette)
+{
+	auto i = m_counts.find(palette);
+	if (i == m_counts.end())
+		return;
+	if (--i->second == 0)
+	{
+		m_counts.erase(i);
+		if (m_callback)
+			m_callback(palette, false);
+	}
+}
 
 
 Tile::Tile(uint16_t width, uint16_t height, uint16_t depth, uint16_t frames)
@@ -19,8 +81,9 @@ Tile::Tile(uint16_t width, uint16_t height, uint16_t depth, uint16_t frames)
 	m_pitch = (((size_t)m_width * (size_t)m_depth) + 7) / 8;
 	m_frameSize = m_pitch * (size_t)height;
 	m_size = m_frameSize * (size_t)m_frames;
-	m_data = new uint8_t[m_size];
+	SetBuffer(new uint8_t[m_size]);
 	memset(m_data, 0, m_size);
+	MarkModified();
 }
 
 
@@ -35,19 +98,44 @@ Tile::Tile(const Tile& other)
 	m_size = other.m_size;
 	m_palette = other.m_palette;
 	m_paletteOffset = other.m_paletteOffset;
-	m_data = new uint8_t[m_size];
-	memcpy(m_data, other.m_data, m_size);
+	m_buffer = other.m_buffer;
+	m_data = other.m_data;
+	MarkModified();
+}
+
+
+shared_ptr<Tile> Tile::CreateSnapshot() const
+{
+	shared_ptr<Tile> result = make_shared<Tile>(*this);
+	result->m_collision = m_collision;
+	result->m_collisionChannels = m_collisionChannels;
+	result->m_generation = m_generation;
+	return result;
+}
+
+
+void Tile::SetBuffer(uint8_t* data)
+{
+	m_buffer = shared_ptr<uint8_t>(data, default_delete<uint8_t[]>());
+	m_data = data;
 }
 
 
-Tile::~Tile()
+void Tile::Detach()
 {
-	delete[] m_data;
+	// Data only becomes shared on the UI thread, a snapshot releasing it concurrently at worst causes an extra copy
+	if (m_buffer.use_count() <= 1)
+		return;
+	uint8_t* data = new uint8_t[m_size];
+	memcpy(data, m_data, m_size);
+	SetBuffer(data);
 }
 
 
 uint8_t* Tile::GetData(uint16_t frame)
 {
+	Detach();
+	MarkModified();
 	if (frame >= m_frames)
 		frame = m_frames - 1;
 	return &m_data[(size_t)frame * m_frameSize];
@@ -72,10 +160,10 @@ void Tile::SetFrameCount(uint16_t frames)
 		copyFrames = m_frames;
 	memcpy(newData, m_data, (size_t)copyFrames * m_frameSize);
 
-	delete[] m_data;
-	m_data = newData;
+	SetBuffer(newData);
 	m_size = (size_t)frames * m_frameSize;
 	m_frames = frames;
+	MarkModified();
 }
 
 
@@ -88,7 +176,9 @@ void Tile::CopyFrame(uint16_t from, uint16_t to)
 	if (from == to)
 		return;
 
+	Detach();
 	memcpy(&m_data[(size_t)to * m_frameSize], &m_data[(size_t)from * m_frameSize], m_frameSize);
+	MarkModified();
 }
 
 
@@ -101,11 +191,13 @@ void Tile::SwapFrames(uint16_t from, uint16_t to)
 	if (from == to)
 		return;
 
+	Detach();
 	uint8_t* tempData = new uint8_t[m_frameSize];
 	memcpy(tempData, &m_data[(size_t)to * m_frameSize], m_frameSize);
 	memcpy(&m_data[(size_t)to * m_frameSize], &m_data[(size_t)from * m_frameSize], m_frameSize);
 	memcpy(&m_data[(size_t)from * m_frameSize], tempData, m_frameSize);
 	delete[] tempData;
+	MarkModified();
 }
 
 
@@ -118,6 +210,7 @@ void Tile::DuplicateFrame(uint16_t frame)
 	SetFrameCount(m_frames + 1);
 	memmove(&m_data[((size_t)frame + 1) * m_frameSize], &m_data[(size_t)frame * m_frameSize], m_frameSize * trailingFrames);
 	memcpy(&m_data[(size_t)frame * m_frameSize], &m_data[((size_t)frame + 1) * m_frameSize], m_frameSize);
+	MarkModified();
 }
 
 
@@ -126,6 +219,7 @@ void Tile::RemoveFrame(uint16_t frame)
 	if ((frame >= m_frames) || (m_frames == 1))
 		return;
 	size_t trailingFrames = (m_frames - frame) - 1;
+	Detach();
 	memmove(&m_data[(size_t)frame * m_frameSize], &m_data[((size_t)frame + 1) * m_frameSize], m_frameSize * trailingFrames);
 	SetFrameCount(m_frames - 1);
 }
@@ -139,6 +233,7 @@ shared_ptr<Tile> Tile::GetTileForSingleFrame(uint16_t frame)
 	result->m_palette = m_palette;
 	result->m_paletteOffset = m_paletteOffset;
 	memcpy(result->m_data, &m_data[(size_t)frame * m_frameSize], m_frameSize);
+	result->MarkModified();
 	return result;
 }
 
@@ -154,13 +249,43 @@ void Tile::InsertFrameFromTile(uint16_t frame, const shared_ptr<Tile>& tile)
 	SetFrameCount(m_frames + 1);
 	memmove(&m_data[((size_t)frame + 1) * m_frameSize], &m_data[(size_t)frame * m_frameSize], m_frameSize * trailingFrames);
 	memcpy(&m_data[(size_t)frame * m_frameSize], tile->m_data, m_frameSize);
+	MarkModified();
 }
 
 
 void Tile::SetPalette(const shared_ptr<Palette> palette, uint8_t offset)
 {
+	if ((palette == m_palette) && (offset == m_paletteOffset))
+		return;
+	if (m_paletteUsage && (palette != m_palette))
+	{
+		m_paletteUsage->Remove(m_palette);
+		m_paletteUsage->Add(palette);
+	}
 	m_palette = palette;
 	m_paletteOffset = offset;
+	MarkModified();
+}
+
+
+void Tile::SetPaletteUsage(const shared_ptr<TilePaletteUsage>& usage)
+{
+	if (usage == m_paletteUsage)
+		return;
+	if (m_paletteUsage)
+		m_paletteUsage->Remove(m_palette);
+	m_paletteUsage = usage;
+	if (m_paletteUsage)
+		m_paletteUsage->Add(m_palette);
+}
+
+
+size_t Tile::GetMemoryUsage() const
+{
+	size_t result = sizeof(Tile) + m_size + (m_collision.size() * sizeof(BoundingRect));
+	for (auto& i : m_collisionChannels)
+		result += i.second.size() * sizeof(BoundingRect);
+	return result;
 }
 
 
@@ -199,14 +324,20 @@ Json::Value Tile::Serialize()
 		tile["offset"] = m_paletteOffset;
 	}
 
-	string data;
-	for (size_t i = 0; i < m_size; i++)
+	// Pixel data is stored as base64, compressed when that makes it smaller. The encoding tag tells
+	// readers which format is used, data without a tag is the original hex format.
+	QByteArray raw((const char*)m_data, (int)m_size);
+	QByteArray compressed = qCompress(raw);
+	if ((size_t)compressed.size() < m_size)
+	{
+		tile["encoding"] = "zlib";
+		tile["data"] = compressed.toBase64().toStdString();
+	}
+	else
 	{
-		char byteStr[3];
-		sprintf(byteStr, "%.2x", m_data[i]);
-		data += byteStr;
+		tile["encoding"] = "base64";
+		tile["data"] = raw.toBase64().toStdString();
 	}
-	tile["data"] = data;
 
 	if (m_collision.size() > 0)
 	{
@@ -260,12 +391,30 @@ shared_ptr<Tile> Tile::Deserialize(shared_ptr<Project> project, const Json::Valu
 		result->m_paletteOffset = (uint8_t)data["offset"].asUInt();
 	}
 
+	string encoding = "hex";
+	if (data.isMember("encoding"))
+		encoding = data["encoding"].asString();
+
 	string dataStr = data["data"].asString();
-	if (dataStr.size() != (result->m_size * 2))
+	if (encoding == "hex")
+	{
+		if (!DecodeHex(dataStr, result->m_data, result->m_size))
+			return shared_ptr<Tile>();
+	}
+	else if ((encoding == "base64") || (encoding == "zlib"))
+	{
+		// Compressed data uses the qCompress layout, a 32-bit big endian size followed by a zlib stream
+		QByteArray decoded = QByteArray::fromBase64(QByteArray(dataStr.c_str(), (int)dataStr.size()));
+		if (encoding == "zlib")
+			decoded = qUncompress(decoded);
+		if ((size_t)decoded.size() != result->m_size)
+			return shared_ptr<Tile>();
+		memcpy(result->m_data, decoded.constData(), result->m_size);
+	}
+	else
+	{
 		return shared_ptr<Tile>();
-
-	for (size_t i = 0; i < result->m_size; i++)
-		result->m_data[i] = (uint8_t)strtoul(dataStr.substr(i * 2, 2).c_str(), nullptr, 16);
+	}
 
 	if (data.isMember("collision"))
 	{
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <memory>
+#include <atomic>
+#include <functional>
 #include <map>
 #include <inttypes.h>
 #include "palette.h"
@@ -16,34 +18,73 @@ struct BoundingRect
 	uint16_t width, height;
 };
 
+// Number of tiles using each palette, kept by the owner of a group of tiles. Tiles report palette changes
+// to the group they belong to, so finding the users of a palette does not need to visit every tile.
+class TilePaletteUsage
+{
+public:
+	typedef std::function<void(const std::shared_ptr<Palette>& palette, bool used)> Callback;
+
+private:
+	std::map<std::shared_ptr<Palette>, size_t> m_counts;
+	Callback m_callback;
+
+public:
+	void Add(const std::shared_ptr<Palette>& palette);
+	void Remove(const std::shared_ptr<Palette>& palette);
+	bool Uses(const std::shared_ptr<Palette>& palette) const { return m_counts.find(palette) != m_counts.end(); }
+	const std::map<std::shared_ptr<Palette>, size_t>& GetCounts() const { return m_counts; }
+
+	// Called when a palette gets its first tile in the group or loses its last one
+	void SetCallback(const Callback& callback) { m_callback = callback; }
+};
+
 class Tile
 {
 	uint16_t m_width, m_height, m_depth, m_frames;
+	std::shared_ptr<uint8_t> m_buffer;
 	uint8_t* m_data;
 	size_t m_size, m_frameSize, m_pitch;
 	std::shared_ptr<Palette> m_palette;
 	uint8_t m_paletteOffset;
+	std::shared_ptr<TilePaletteUsage> m_paletteUsage;
 	std::vector<BoundingRect> m_collision;
 	std::map<uint32_t, std::vector<BoundingRect>> m_collisionChannels;
 
 	static std::map<uint32_t, std::string> m_collisionChannelNames;
 
+	uint64_t m_generation;
+	static std::atomic<uint64_t> m_nextGeneration;
+
+	void SetBuffer(uint8_t* data);
+	void Detach();
+	void MarkModified() { m_generation = m_nextGeneration++; }
+
 public:
 	Tile(uint16_t width, uint16_t height, uint16_t depth = 4, uint16_t frames = 1);
 	Tile(const Tile& other);
-	~Tile();
+
+	// Copy with the same contents and generation for saving in the background. Pixel data is shared with
+	// copies until one of them is written to through the non-const GetData.
+	std::shared_ptr<Tile> CreateSnapshot() const;
 
 	uint16_t GetWidth() const { return m_width; }
 	uint16_t GetHeight() const { return m_height; }
 	uint16_t GetDepth() const { return m_depth; }
 	size_t GetPitch() const { return m_pitch; }
 	uint16_t GetFrameCount() const { return m_frames; }
-	uint8_t* GetData() { return m_data; }
+	// The non-const versions mark the tile as modified, use the const versions to read pixels
+	uint8_t* GetData() { Detach(); MarkModified(); return m_data; }
 	const uint8_t* GetData() const { return m_data; }
 	uint8_t* GetData(uint16_t frame);
 	const uint8_t* GetData(uint16_t frame) const;
 	size_t GetSize() { return m_size; }
 	size_t GetPerFrameSize() { return m_frameSize; }
+	// Approximate memory held by the tile, for the undo history
+	size_t GetMemoryUsage() const;
+
+	// Generation changes whenever the tile is modified, including every call to the non-const GetData
+	uint64_t GetGeneration() const { return m_generation; }
 
 	void SetFrameCount(uint16_t frames);
 	void CopyFrame(uint16_t from, uint16_t to);
@@ -57,6 +98,10 @@ public:
 	uint8_t GetPaletteOffset() const { return m_paletteOffset; }
 	void SetPalette(const std::shared_ptr<Palette> palette, uint8_t offset);
 
+	// Palette usage counts of the group the tile belongs to, copies of a tile do not belong to any group
+	const std::shared_ptr<TilePaletteUsage>& GetPaletteUsage() const { return m_paletteUsage; }
+	void SetPaletteUsage(const std::shared_ptr<TilePaletteUsage>& usage);
+
 	std::vector<BoundingRect> GetCollision(uint32_t channel) const;
 	void SetCollision(uint32_t channel, const std::vector<BoundingRect>& collision);
 
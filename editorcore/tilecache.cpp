@@ -0,0 +1,145 @@
+#include "tilecache.h"
+
+using namespace std;
+
+
+#define DEFAULT_TILE_CACHE_BUDGET (8 * 1024 * 1024)
+
+
+mutex TileCache::m_mutex;
+map<TileCache::Key, TileCache::Entry> TileCache::m_entries;
+list<TileCache::Key> TileCache::m_lru;
+size_t TileCache::m_memoryUsage = 0;
+size_t TileCache::m_memoryBudget = DEFAULT_TILE_CACHE_BUDGET;
+
+
+bool TileCache::Key::operator<(const Key& other) const
+{
+	if (tileGeneration != other.tileGeneration)
+		return tileGeneration < other.tileGeneration;
+	if (paletteGeneration != other.paletteGeneration)
+		return paletteGeneration < other.paletteGeneration;
+	if (frame != other.frame)
+		return frame < other.frame;
+	return paletteOffset < other.paletteOffset;
+}
+
+
+shared_ptr<const vector<uint16_t>> TileCache::DecodeTile(const shared_ptr<Tile>& tile, uint16_t frame)
+{
+	shared_ptr<vector<uint16_t>> result = make_shared<vector<uint16_t>>(
+		(size_t)tile->GetWidth() * (size_t)tile->GetHeight(), 0x8000);
+	const uint8_t* data = static_cast<const Tile&>(*tile).GetData(frame);
+	shared_ptr<Palette> palette = tile->GetPalette();
+	if ((tile->GetDepth() != 16) && !palette)
+		return result;
+
+	uint16_t* dest = &(*result)[0];
+	for (size_t y = 0; y < tile->GetHeight(); y++)
+	{
+		const uint8_t* row = &data[y * tile->GetPitch()];
+		for (size_t x = 0; x < tile->GetWidth(); x++)
+		{
+			if (tile->GetDepth() == 16)
+			{
+				*(dest++) = ((const uint16_t*)row)[x];
+				continue;
+			}
+
+			uint8_t colorIndex;
+			if (tile->GetDepth() == 4)
+				colorIndex = (row[x / 2] >> ((x & 1) << 2)) & 0xf;
+			else
+				colorIndex = row[x];
+			if (colorIndex != 0)
+				*dest = palette->GetEntry((size_t)tile->GetPaletteOffset() + colorIndex) & 0x7fff;
+			dest++;
+		}
+	}
+	return result;
+}
+
+
+void TileCache::EvictToBudget()
+{
+	while ((m_memoryUsage > m_memoryBudget) && (m_lru.size() != 0))
+	{
+		auto i = m_entries.find(m_lru.back());
+		m_memoryUsage -= i->second.pixels->size() * sizeof(uint16_t);
+		m_entries.erase(i);
+		m_lru.pop_back();
+	}
+}
+
+
+shared_ptr<const vector<uint16_t>> TileCache::GetPixels(const shared_ptr<Tile>& tile, uint16_t frame)
+{
+	if (frame >= tile->GetFrameCount())
+		frame = tile->GetFrameCount() - 1;
+
+	Key key;
+	key.tileGeneration = tile->GetGeneration();
+	key.paletteGeneration = 0;
+	key.paletteOffset = 0;
+	key.frame = frame;
+	if ((tile->GetDepth() != 16) && tile->GetPalette())
+	{
+		key.paletteGeneration = tile->GetPalette()->GetGeneration();
+		key.paletteOffset = tile->GetPaletteOffset();
+	}
+
+	{
+		lock_guard<mutex> lock(m_mutex);
+		auto i = m_entries.find(key);
+		if (i != m_entries.end())
+		{
+			m_lru.splice(m_lru.begin(), m_lru, i->second.lruEntry);
+			return i->second.pixels;
+		}
+	}
+
+	shared_ptr<const vector<uint16_t>> pixels = DecodeTile(tile, frame);
+
+	lock_guard<mutex> lock(m_mutex);
+	if (m_entries.count(key) != 0)
+		return pixels;
+	m_lru.push_front(key);
+	Entry entry;
+	entry.pixels = pixels;
+	entry.lruEntry = m_lru.begin();
+	m_entries[key] = entry;
+	m_memoryUsage += pixels->size() * sizeof(uint16_t);
+	EvictToBudget();
+	return pixels;
+}
+
+
+size_t TileCache::GetMemoryBudget()
+{
+	lock_guard<mutex> lock(m_mutex);
+	return m_memoryBudget;
+}
+
+
+void TileCache::SetMemoryBudget(size_t bytes)
+{
+	lock_guard<mutex> lock(m_mutex);
+	m_memoryBudget = bytes;
+	EvictToBudget();
+}
+
+
+size_t TileCache::GetMemoryUsage()
+{
+	lock_guard<mutex> lock(m_mutex);
+	return m_memoryUsage;
+}
+
+
+void TileCache::Clear()
+{
+	lock_guard<mutex> lock(m_mutex);
+	m_entries.clear();
+	m_lru.clear();
+	m_memoryUsage = 0;
+}
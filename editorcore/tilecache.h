@@ -0,0 +1,44 @@
+#pragma once
+
+#include <list>
+#include <map>
+#include <mutex>
+#include <vector>
+#include "tile.h"
+
+// Shared cache of tile frames resolved to 15-bit colors. Pixels are stored in the same format as
+// 16-bit tiles, with bit 15 set for transparent pixels. Entries are keyed by the generation counters
+// of the tile and its palette, so stale entries are never returned and age out of the cache.
+class TileCache
+{
+	struct Key
+	{
+		uint64_t tileGeneration, paletteGeneration;
+		uint16_t frame;
+		uint8_t paletteOffset;
+
+		bool operator<(const Key& other) const;
+	};
+
+	struct Entry
+	{
+		std::shared_ptr<const std::vector<uint16_t>> pixels;
+		std::list<Key>::iterator lruEntry;
+	};
+
+	static std::mutex m_mutex;
+	static std::map<Key, Entry> m_entries;
+	static std::list<Key> m_lru;
+	static size_t m_memoryUsage, m_memoryBudget;
+
+	static std::shared_ptr<const std::vector<uint16_t>> DecodeTile(const std::shared_ptr<Tile>& tile, uint16_t frame);
+	static void EvictToBudget();
+
+public:
+	static std::shared_ptr<const std::vector<uint16_t>> GetPixels(const std::shared_ptr<Tile>& tile, uint16_t frame);
+
+	static size_t GetMemoryBudget();
+	static void SetMemoryBudget(size_t bytes);
+	static size_t GetMemoryUsage();
+	static void Clear();
+};
@@ -6,6 +6,7 @@
 #include "tileselectwidget.h"
 #include "theme.h"
 #include "mapeditorwidget.h"
+#include "tilecache.h"
 
 using namespace std;
 
@@ -31,6 +32,51 @@ TileSelectWidget::~TileSelectWidget()
 }
 
 
+void TileSelectWidget::UpdateTileImage(int tileX, int tileY)
+{
+	int width = (int)m_tileSet->GetWidth();
+	int height = (int)m_tileSet->GetHeight();
+	for (int y = 0; y < height; y++)
+		memset(m_image->scanLine(tileY * height + y) + (tileX * width * 4), 0, width * 4);
+
+	size_t tileIndex = (size_t)((tileY * m_cols) + tileX);
+	if (tileIndex >= m_tileSet->GetTileCount())
+	{
+		for (int y = 0; y < height; y++)
+		{
+			uint32_t* line = (uint32_t*)m_image->scanLine(tileY * height + y);
+			for (int x = 0; x < width; x++)
+				line[tileX * width + x] = Theme::backgroundWindow.rgba();
+		}
+		return;
+	}
+
+	shared_ptr<Tile> tile = m_tileSet->GetTile(tileIndex);
+	if (!tile)
+		return;
+	if ((tile->GetWidth() != m_tileSet->GetWidth()))
+		return;
+	if ((tile->GetHeight() != m_tileSet->GetHeight()))
+		return;
+	if ((tile->GetDepth() != m_tileSet->GetDepth()))
+		return;
+
+	shared_ptr<const vector<uint16_t>> pixels = TileCache::GetPixels(tile, 0);
+	const uint16_t* src = &(*pixels)[0];
+	for (int y = 0; y < height; y++)
+	{
+		uint32_t* line = (uint32_t*)m_image->scanLine(tileY * height + y);
+		for (int x = 0; x < width; x++)
+		{
+			uint16_t color = *(src++);
+			if (color & 0x8000)
+				continue;
+			line[tileX * width + x] = Palette::ToRGB32(color) | 0xff000000;
+		}
+	}
+}
+
+
 void TileSelectWidget::UpdateView()
 {
 	m_cols = m_tileSet->GetDisplayColumns();
@@ -57,55 +103,10 @@ void TileSelectWidget::UpdateView()
 		m_image = new QImage(m_width, m_height, QImage::Format_ARGB32);
 	}
 
-	for (int y = 0; y < m_height; y++)
-		memset(m_image->scanLine(y), 0, m_width * 4);
-
 	for (int tileY = 0; tileY < m_rows; tileY++)
 	{
 		for (int tileX = 0; tileX < m_cols; tileX++)
-		{
-			size_t tileIndex = (size_t)((tileY * m_cols) + tileX);
-			if (tileIndex >= m_tileSet->GetTileCount())
-			{
-				for (int y = 0; y < (int)m_tileSet->GetHeight(); y++)
-				{
-					uint32_t* line = (uint32_t*)m_image->scanLine(tileY * m_tileSet->GetHeight() + y);
-					for (int x = 0; x < (int)m_tileSet->GetWidth(); x++)
-						line[tileX * m_tileSet->GetWidth() + x] = Theme::backgroundWindow.rgba();
-				}
-				continue;
-			}
-
-			shared_ptr<Tile> tile = m_tileSet->GetTile(tileIndex);
-			if (!tile)
-				continue;
-			if ((tile->GetWidth() != m_tileSet->GetWidth()))
-				continue;
-			if ((tile->GetHeight() != m_tileSet->GetHeight()))
-				continue;
-			if ((tile->GetDepth() != m_tileSet->GetDepth()))
-				continue;
-
-			for (int y = 0; y < (int)m_tileSet->GetHeight(); y++)
-			{
-				uint32_t* line = (uint32_t*)m_image->scanLine(tileY * m_tileSet->GetHeight() + y);
-				for (int x = 0; x < (int)m_tileSet->GetWidth(); x++)
-				{
-					uint8_t colorIndex;
-					if (tile->GetDepth() == 4)
-						colorIndex = (tile->GetData()[(y * tile->GetPitch()) + (x / 2)] >> ((x & 1) << 2)) & 0xf;
-					else
-						colorIndex = tile->GetData()[(y * tile->GetPitch()) + x];
-					if (colorIndex == 0)
-						continue;
-					if (!tile->GetPalette())
-						continue;
-
-					uint16_t paletteEntry = tile->GetPalette()->GetEntry(tile->GetPaletteOffset() + colorIndex);
-					line[tileX * m_tileSet->GetWidth() + x] = Palette::ToRGB32(paletteEntry) | 0xff000000;
-				}
-			}
-		}
+			UpdateTileImage(tileX, tileY);
 	}
 
 	m_renderSize = QSize(m_tileWidth * m_cols, m_tileHeight * m_rows);
@@ -115,6 +116,28 @@ void TileSelectWidget::UpdateView()
 }
 
 
+void TileSelectWidget::UpdateTiles(const set<size_t>& tiles)
+{
+	int cols = m_tileSet->GetDisplayColumns();
+	if (cols > (int)m_tileSet->GetTileCount())
+		cols = (int)m_tileSet->GetTileCount();
+	int rows = (m_tileSet->GetTileCount() + (cols - 1)) / cols;
+	if ((!m_image) || (cols != m_cols) || (rows != m_rows))
+	{
+		UpdateView();
+		return;
+	}
+
+	for (auto i : tiles)
+	{
+		if (i >= m_tileSet->GetTileCount())
+			continue;
+		UpdateTileImage((int)(i % (size_t)m_cols), (int)(i / (size_t)m_cols));
+	}
+	update();
+}
+
+
 void TileSelectWidget::paintEvent(QPaintEvent*)
 {
 	QPainter p(this);
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <QWidget>
+#include <set>
 #include "project.h"
 #include "tileset.h"
 
@@ -26,12 +27,18 @@ class TileSelectWidget: public QWidget
 	bool m_showHover;
 	int m_hoverX, m_hoverY;
 
+	void UpdateTileImage(int tileX, int tileY);
+
 public:
 	TileSelectWidget(QWidget* parent, MapEditorWidget* editor, MainWindow* mainWindow,
 		std::shared_ptr<Project> project, std::shared_ptr<TileSet> tileSet);
 	~TileSelectWidget();
 
+	std::shared_ptr<TileSet> GetTileSet() const { return m_tileSet; }
+
 	void UpdateView();
+	// Decodes only the given tiles again, unless the layout of the tile set has changed
+	void UpdateTiles(const std::set<size_t>& tiles);
 
 protected:
 	virtual void paintEvent(QPaintEvent* event) override;
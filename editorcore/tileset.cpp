@@ -12,6 +12,7 @@ TileSet::TileSet(size_t width, size_t height, size_t depth, SmartTileSetType sma
 	m_height = height;
 	m_depth = depth;
 	m_smartTileSetType = smartTileSetType;
+	m_paletteUsage = make_shared<TilePaletteUsage>();
 
 	m_displayCols = GetDisplayColumnsForSmartTileSet(smartTileSetType);
 
@@ -37,6 +38,7 @@ TileSet::TileSet(const TileSet& other)
 	m_depth = other.m_depth;
 	m_smartTileSetType = other.m_smartTileSetType;
 	m_displayCols = other.m_displayCols;
+	m_paletteUsage = make_shared<TilePaletteUsage>();
 
 	for (auto& i : other.m_tiles)
 	{
@@ -44,6 +46,7 @@ TileSet::TileSet(const TileSet& other)
 			m_tiles.push_back(make_shared<Tile>(*i));
 		else
 			m_tiles.emplace_back();
+		AttachTile(m_tiles.back());
 	}
 
 	if (other.m_animation)
@@ -51,6 +54,23 @@ TileSet::TileSet(const TileSet& other)
 }
 
 
+shared_ptr<TileSet> TileSet::CreateSnapshot() const
+{
+	shared_ptr<TileSet> result = make_shared<TileSet>(m_width, m_height, m_depth);
+	*result = *this;
+	result->m_paletteUsage = make_shared<TilePaletteUsage>();
+	for (auto& i : result->m_tiles)
+	{
+		if (i)
+			i = i->CreateSnapshot();
+		result->AttachTile(i);
+	}
+	if (m_animation)
+		result->m_animation = make_shared<Animation>(*m_animation);
+	return result;
+}
+
+
 size_t TileSet::GetFrameCount() const
 {
 	if (m_animation)
@@ -71,19 +91,38 @@ void TileSet::SetTile(size_t i, shared_ptr<Tile> tile)
 {
 	if (i >= m_tiles.size())
 		return;
+	DetachTile(m_tiles[i]);
 	m_tiles[i] = tile;
+	AttachTile(tile);
 }
 
 
 void TileSet::SetTileCount(size_t count)
 {
 	size_t oldCount = m_tiles.size();
+	for (size_t i = count; i < oldCount; i++)
+		DetachTile(m_tiles[i]);
 	m_tiles.resize(count);
 	for (size_t i = oldCount; i < count; i++)
 		SetTile(i, CreateTile());
 }
 
 
+void TileSet::AttachTile(const shared_ptr<Tile>& tile)
+{
+	if (tile)
+		tile->SetPaletteUsage(m_paletteUsage);
+}
+
+
+void TileSet::DetachTile(const shared_ptr<Tile>& tile)
+{
+	// Removed tiles may still be referenced by the undo history, they must no longer count towards this set
+	if (tile && (tile->GetPaletteUsage() == m_paletteUsage))
+		tile->SetPaletteUsage(shared_ptr<TilePaletteUsage>());
+}
+
+
 shared_ptr<Tile> TileSet::CreateTile()
 {
 	return make_shared<Tile>(m_width, m_height, m_depth);
@@ -172,12 +211,58 @@ void TileSet::InsertFrameFromTiles(uint16_t frame, const vector<shared_ptr<Tile>
 
 bool TileSet::UsesPalette(shared_ptr<Palette> palette)
 {
+	return m_paletteUsage->Uses(palette);
+}
+
+
+vector<shared_ptr<Palette>> TileSet::GetUsedPalettes() const
+{
+	vector<shared_ptr<Palette>> result;
+	for (auto& i : m_paletteUsage->GetCounts())
+	{
+		if (i.first)
+			result.push_back(i.first);
+	}
+	return result;
+}
+
+
+set<string> TileSet::GetDependencies() const
+{
+	set<string> result;
+	for (auto& i : m_paletteUsage->GetCounts())
+	{
+		if (i.first)
+			result.insert(i.first->GetId());
+	}
+	return result;
+}
+
+
+size_t TileSet::GetMemoryUsage() const
+{
+	size_t result = sizeof(TileSet);
 	for (auto& i : m_tiles)
 	{
-		if (i->GetPalette() == palette)
-			return true;
+		if (i)
+			result += i->GetMemoryUsage();
 	}
-	return false;
+	return result;
+}
+
+
+bool TileSet::CheckPaletteUsage() const
+{
+	map<shared_ptr<Palette>, size_t> counts;
+	for (auto& i : m_tiles)
+	{
+		if (!i)
+			continue;
+		if (i->GetPaletteUsage() != m_paletteUsage)
+			return false;
+		counts[i->GetPalette()]++;
+	}
+	return counts == m_paletteUsage->GetCounts();
 }
 
 
@@ -232,6 +317,9 @@ Json::Value TileSet::Serialize()
 	case SimplifiedDoubleWidthSmartTileSet:
 		tileSet["smart"] = "simplified_double_width";
 		break;
+	case BlobSmartTileSet:
+		tileSet["smart"] = "blob";
+		break;
 	default:
 		break;
 	}
@@ -268,6 +356,8 @@ shared_ptr<TileSet> TileSet::Deserialize(shared_ptr<Project> project, const Json
 			smartTileSetType = SimplifiedSingleWidthSmartTileSet;
 		if (data["smart"].asString() == "simplified_double_width")
 			smartTileSetType = SimplifiedDoubleWidthSmartTileSet;
+		if (data["smart"].asString() == "blob")
+			smartTileSetType = BlobSmartTileSet;
 	}
 
 	shared_ptr<TileSet> result = make_shared<TileSet>(width, height, depth, smartTileSetType);
@@ -286,9 +376,12 @@ shared_ptr<TileSet> TileSet::Deserialize(shared_ptr<Project> project, const Json
 		frames = result->m_animation->GetFrameCount();
 	}
 
-	result->m_tiles.clear();
+	result->SetTileCount(0);
 	for (auto& i : data["tiles"])
+	{
 		result->m_tiles.push_back(Tile::Deserialize(project, i, width, height, depth, frames));
+		result->AttachTile(result->m_tiles.back());
+	}
 
 	result->m_associatedTileSets.clear();
 	if (data.isMember("associated"))
@@ -320,6 +413,8 @@ size_t TileSet::GetTileCountForSmartTileSet(SmartTileSetType type)
 		return 13;
 	case SimplifiedDoubleWidthSmartTileSet:
 		return 41;
+	case BlobSmartTileSet:
+		return 47;
 	default:
 		return 0;
 	}
@@ -334,6 +429,8 @@ size_t TileSet::GetDisplayColumnsForSmartTileSet(SmartTileSetType type)
 		return 5;
 	case SimplifiedDoubleWidthSmartTileSet:
 		return 9;
+	case BlobSmartTileSet:
+		return 8;
 	default:
 		return 0;
 	}
@@ -348,6 +445,8 @@ size_t TileSet::GetDefaultTileForSmartTileSet(SmartTileSetType type)
 		return 6;
 	case SimplifiedDoubleWidthSmartTileSet:
 		return (2 * 9) + 2;
+	case BlobSmartTileSet:
+		return 46;
 	default:
 		return 0;
 	}
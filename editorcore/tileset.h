@@ -15,7 +15,8 @@ enum SmartTileSetType
 {
 	NormalTileSet,
 	SimplifiedSingleWidthSmartTileSet,
-	SimplifiedDoubleWidthSmartTileSet
+	SimplifiedDoubleWidthSmartTileSet,
+	BlobSmartTileSet
 };
 
 class TileSet
@@ -24,16 +25,23 @@ class TileSet
 	size_t m_width, m_height, m_depth;
 	size_t m_displayCols;
 	std::vector<std::shared_ptr<Tile>> m_tiles;
+	std::shared_ptr<TilePaletteUsage> m_paletteUsage;
 	std::shared_ptr<Animation> m_animation;
 	std::string m_id;
 	SmartTileSetType m_smartTileSetType;
 	std::set<std::shared_ptr<TileSet>> m_associatedTileSets;
 	std::set<std::string> m_initialAssociatedTileSetIds;
 
+	void AttachTile(const std::shared_ptr<Tile>& tile);
+	void DetachTile(const std::shared_ptr<Tile>& tile);
+
 public:
 	TileSet(size_t width, size_t height, size_t depth, SmartTileSetType smartTileSetType = NormalTileSet);
 	TileSet(const TileSet& other);
 
+	// Copy with the same id for saving in the background, tiles share pixel data with the original
+	std::shared_ptr<TileSet> CreateSnapshot() const;
+
 	const std::string& GetName() const { return m_name; }
 	void SetName(const std::string& name) { m_name = name; }
 
@@ -67,6 +75,14 @@ public:
 	std::shared_ptr<Tile> CreateTile();
 
 	bool UsesPalette(std::shared_ptr<Palette> palette);
+	std::vector<std::shared_ptr<Palette>> GetUsedPalettes() const;
+	// Called when the tiles start or stop using a palette, copies of the set do not keep the callback
+	void SetPaletteUsageCallback(const TilePaletteUsage::Callback& callback) { m_paletteUsage->SetCallback(callback); }
+	// Ids of the palettes used by the tiles
+	std::set<std::string> GetDependencies() const;
+	size_t GetMemoryUsage() const;
+	// Verifies the palette usage counts against the tiles, for debugging
+	bool CheckPaletteUsage() const;
 
 	const std::set<std::shared_ptr<TileSet>>& GetAssociatedTileSets() const { return m_associatedTileSets; }
 	void AddAssociatedTileSet(const std::shared_ptr<TileSet>& tileSet);
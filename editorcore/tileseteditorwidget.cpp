@@ -1,5 +1,7 @@
 #include <QVBoxLayout>
 #include <QPainter>
+#include <QImage>
+#include <QVector>
 #include <QMouseEvent>
 #include <QPaintEvent>
 #include <QGuiApplication>
@@ -9,6 +11,7 @@
 #include <QFileDialog>
 #include <set>
 #include <queue>
+#include <algorithm>
 #include <stdlib.h>
 #include <math.h>
 #include "tileseteditorwidget.h"
@@ -16,6 +19,7 @@
 #include "tilesetview.h"
 #include "theme.h"
 #include "mainwindow.h"
+#include "undodelta.h"
 #include "json/json.h"
 
 using namespace std;
@@ -168,25 +172,31 @@ void TileSetEditorWidget::paintEvent(QPaintEvent* event)
 {
 	QPainter p(this);
 
-	int tileWidth = (int)m_tileSet->GetWidth() * m_zoom;
-	int tileHeight = (int)m_tileSet->GetHeight() * m_zoom;
+	int width = (int)m_tileSet->GetWidth();
+	int height = (int)m_tileSet->GetHeight();
+	int tileWidth = width * m_zoom;
+	int tileHeight = height * m_zoom;
+
+	// Tiles touching the painted area, including those whose border overlaps it
+	int firstTileX = max((event->rect().left() - 1) / tileWidth, 0);
+	int firstTileY = max((event->rect().top() - 1) / tileHeight, 0);
+	int lastTileX = min((event->rect().right() + 1) / tileWidth, (int)m_columns - 1);
+	int lastTileY = min((event->rect().bottom() + 1) / tileHeight, (int)m_rows - 1);
+	int tilesWide = max(lastTileX - firstTileX + 1, 0);
+	int tilesHigh = max(lastTileY - firstTileY + 1, 0);
+
+	// Visible tiles are decoded at their original size into one image, which is scaled up with a single draw
+	QImage image(max(tilesWide * width, 1), max(tilesHigh * height, 1), QImage::Format_ARGB32);
+	image.fill(0);
+	QVector<QRect> tileRects;
+	vector<shared_ptr<Tile>> tiles;
 
 	bool hoverValid = false;
 
-	for (int tileY = 0; tileY < (int)m_rows; tileY++)
+	for (int tileY = firstTileY; tileY <= lastTileY; tileY++)
 	{
-		if (((tileY + 1) * tileHeight) < event->rect().top())
-			continue;
-		if ((tileY * tileHeight) > event->rect().bottom())
-			break;
-
-		for (int tileX = 0; tileX < (int)m_columns; tileX++)
+		for (int tileX = firstTileX; tileX <= lastTileX; tileX++)
 		{
-			if (((tileX + 1) * tileWidth) < event->rect().left())
-				continue;
-			if ((tileX * tileWidth) > event->rect().right())
-				break;
-
 			size_t tileIndex = (size_t)((tileY * m_columns) + tileX);
 			if (tileIndex >= m_tileSet->GetTileCount())
 				break;
@@ -205,10 +215,8 @@ void TileSetEditorWidget::paintEvent(QPaintEvent* event)
 			uint8_t paletteOverrideOffset;
 			if (m_showHover)
 			{
-				if ((m_hoverX >= (tileX * (int)m_tileSet->GetWidth())) &&
-					(m_hoverX < ((tileX + 1) * (int)m_tileSet->GetWidth())) &&
-					(m_hoverY >= (tileY * (int)m_tileSet->GetHeight())) &&
-					(m_hoverY < ((tileY + 1) * (int)m_tileSet->GetHeight())))
+				if ((m_hoverX >= (tileX * width)) && (m_hoverX < ((tileX + 1) * width)) &&
+					(m_hoverY >= (tileY * height)) && (m_hoverY < ((tileY + 1) * height)))
 				{
 					hoverValid = true;
 					paletteOverride = m_palette;
@@ -219,30 +227,22 @@ void TileSetEditorWidget::paintEvent(QPaintEvent* event)
 				}
 			}
 
-			p.setBrush(QBrush(Theme::backgroundHighlight, Qt::BDiagPattern));
-			p.setPen(Qt::NoPen);
-			p.drawRect(tileWidth * tileX, tileHeight * tileY, tileWidth, tileHeight);
+			tileRects.push_back(QRect(tileWidth * tileX, tileHeight * tileY, tileWidth, tileHeight));
+			tiles.push_back(tile);
 
-			for (int y = 0; y < (int)m_tileSet->GetHeight(); y++)
+			const uint8_t* data = static_cast<const Tile&>(*tile).GetData(m_frame);
+			for (int y = 0; y < height; y++)
 			{
-				if ((tileY * tileHeight + (y + 1) * m_zoom) < event->rect().top())
-					continue;
-				if ((tileY * tileHeight + y * m_zoom) > event->rect().bottom())
-					break;
-
-				for (int x = 0; x < (int)m_tileSet->GetWidth(); x++)
+				uint32_t* line = (uint32_t*)image.scanLine(((tileY - firstTileY) * height) + y) +
+					((tileX - firstTileX) * width);
+				for (int x = 0; x < width; x++)
 				{
-					if ((tileX * tileWidth + (x + 1) * m_zoom) < event->rect().left())
-						continue;
-					if ((tileX * tileWidth + x * m_zoom) > event->rect().right())
-						break;
-
 					shared_ptr<Palette> palette = tile->GetPalette();
 					uint8_t colorIndex;
 					if (tile->GetDepth() == 4)
-						colorIndex = (tile->GetData(m_frame)[(y * tile->GetPitch()) + (x / 2)] >> ((x & 1) << 2)) & 0xf;
+						colorIndex = (data[(y * tile->GetPitch()) + (x / 2)] >> ((x & 1) << 2)) & 0xf;
 					else
-						colorIndex = tile->GetData(m_frame)[(y * tile->GetPitch()) + x];
+						colorIndex = data[(y * tile->GetPitch()) + x];
 					if (paletteOverride)
 						colorIndex += paletteOverrideOffset;
 					else
@@ -250,8 +250,8 @@ void TileSetEditorWidget::paintEvent(QPaintEvent* event)
 
 					if (m_floatingLayer)
 					{
-						int absX = (tileX * (int)m_tileSet->GetWidth()) + x;
-						int absY = (tileY * (int)m_tileSet->GetHeight()) + y;
+						int absX = (tileX * width) + x;
+						int absY = (tileY * height) + y;
 						if ((absX >= m_floatingLayer->GetX()) && (absY >= m_floatingLayer->GetY()) &&
 							(absX < (m_floatingLayer->GetX() + m_floatingLayer->GetWidth())) &&
 							(absY < (m_floatingLayer->GetY() + m_floatingLayer->GetHeight())))
@@ -276,78 +276,76 @@ void TileSetEditorWidget::paintEvent(QPaintEvent* event)
 						paletteEntry = paletteOverride->GetEntry(colorIndex);
 					else
 						paletteEntry = palette->GetEntry(colorIndex);
-
-					p.setBrush(QColor::fromRgba(Palette::ToRGB32(paletteEntry) | 0xff000000));
-					p.drawRect(tileWidth * tileX + x * m_zoom, tileHeight * tileY + y * m_zoom, m_zoom, m_zoom);
+					line[x] = Palette::ToRGB32(paletteEntry) | 0xff000000;
 				}
 			}
+		}
+	}
 
-			if (m_zoom >= 8)
-			{
-				for (int y = 0; y < (int)m_tileSet->GetHeight(); y++)
-				{
-					if ((tileY * tileHeight + (y + 1) * m_zoom) < event->rect().top())
-						continue;
-					if ((tileY * tileHeight + y * m_zoom) > event->rect().bottom())
-						break;
+	// Transparent pixels show a hatched background
+	p.setBrush(QBrush(Theme::backgroundHighlight, Qt::BDiagPattern));
+	p.setPen(Qt::NoPen);
+	p.drawRects(tileRects);
+	if ((tilesWide > 0) && (tilesHigh > 0))
+	{
+		p.drawImage(QRect(firstTileX * tileWidth, firstTileY * tileHeight, tilesWide * tileWidth,
+			tilesHigh * tileHeight), image);
+	}
 
-					for (int x = 0; x < (int)m_tileSet->GetWidth(); x++)
-					{
-						if ((tileX * tileWidth + (x + 1) * m_zoom) < event->rect().left())
-							continue;
-						if ((tileX * tileWidth + x * m_zoom) > event->rect().right())
-							break;
-
-						p.setPen(QPen(QBrush(Theme::backgroundHighlight), 1));
-						p.setBrush(Qt::NoBrush);
-						p.drawRect(tileWidth * tileX + x * m_zoom, tileHeight * tileY + y * m_zoom, m_zoom, m_zoom);
-					}
-				}
-			}
+	// Grid lines of every visible tile are drawn with one call for each style
+	p.setBrush(Qt::NoBrush);
+	if (m_zoom >= 8)
+	{
+		QVector<QLine> lines;
+		for (auto& i : tileRects)
+		{
+			for (int x = 0; x <= width; x++)
+				lines.push_back(QLine(i.left() + x * m_zoom, i.top(), i.left() + x * m_zoom, i.top() + tileHeight));
+			for (int y = 0; y <= height; y++)
+				lines.push_back(QLine(i.left(), i.top() + y * m_zoom, i.left() + tileWidth, i.top() + y * m_zoom));
+		}
+		p.setPen(QPen(QBrush(Theme::backgroundHighlight), 1));
+		p.drawLines(lines);
+	}
 
-			if (m_zoom >= 4)
+	if (m_zoom >= 4)
+	{
+		QVector<QRect> blocks;
+		for (auto& i : tileRects)
+		{
+			for (int y = 0; y < height; y += 8)
 			{
-				for (int y = 0; y < (int)m_tileSet->GetHeight(); y += 8)
-				{
-					if ((tileY * tileHeight + (y + 8) * m_zoom) < event->rect().top())
-						continue;
-					if ((tileY * tileHeight + y * m_zoom) > event->rect().bottom())
-						break;
-
-					for (int x = 0; x < (int)m_tileSet->GetWidth(); x += 8)
-					{
-						if ((tileX * tileWidth + (x + 8) * m_zoom) < event->rect().left())
-							continue;
-						if ((tileX * tileWidth + x * m_zoom) > event->rect().right())
-							break;
-
-						p.setPen(QPen(QBrush(Theme::backgroundHighlight), 2));
-						p.setBrush(Qt::NoBrush);
-						p.drawRect(tileWidth * tileX + x * m_zoom, tileHeight * tileY + y * m_zoom, m_zoom * 8, m_zoom * 8);
-					}
-				}
+				for (int x = 0; x < width; x += 8)
+					blocks.push_back(QRect(i.left() + x * m_zoom, i.top() + y * m_zoom, m_zoom * 8, m_zoom * 8));
 			}
+		}
+		p.setPen(QPen(QBrush(Theme::backgroundHighlight), 2));
+		p.drawRects(blocks);
+	}
 
-			if (m_zoom >= 2)
-			{
-				if (m_zoom >= 8)
-					p.setPen(QPen(QBrush(Theme::disabled), 2));
-				else
-					p.setPen(QPen(QBrush(Theme::disabled), 1));
-				p.setBrush(Qt::NoBrush);
-				p.drawRect(tileWidth * tileX, tileHeight * tileY, tileWidth, tileHeight);
-			}
+	if (m_zoom >= 2)
+	{
+		if (m_zoom >= 8)
+			p.setPen(QPen(QBrush(Theme::disabled), 2));
+		else
+			p.setPen(QPen(QBrush(Theme::disabled), 1));
+		p.drawRects(tileRects);
+	}
 
-			if (m_tool == CollisionTool)
+	if (m_tool == CollisionTool)
+	{
+		QVector<QRect> collision;
+		for (size_t i = 0; i < tiles.size(); i++)
+		{
+			for (auto& j : tiles[i]->GetCollision(m_collisionChannel))
 			{
-				for (auto& i : tile->GetCollision(m_collisionChannel))
-				{
-					p.setPen(QPen(QBrush(Theme::red), 2, Qt::DashDotLine));
-					p.drawRect(tileWidth * tileX + i.x * m_zoom + (m_zoom / 4), tileHeight * tileY + i.y * m_zoom + (m_zoom / 4),
-						i.width * m_zoom - m_zoom / 2, i.height * m_zoom - m_zoom / 2);
-				}
+				collision.push_back(QRect(tileRects[(int)i].left() + j.x * m_zoom + (m_zoom / 4),
+					tileRects[(int)i].top() + j.y * m_zoom + (m_zoom / 4),
+					j.width * m_zoom - m_zoom / 2, j.height * m_zoom - m_zoom / 2));
 			}
 		}
+		p.setPen(QPen(QBrush(Theme::red), 2, Qt::DashDotLine));
+		p.drawRects(collision);
 	}
 
 	if ((m_tool == SelectTool) && m_floatingLayer)
@@ -408,12 +406,12 @@ TileSetFloatingLayerPixel TileSetEditorWidget::GetPixel(int x, int y)
 	if (tile->GetDepth() == 4)
 	{
 		size_t offset = (pixelY * tile->GetPitch()) + (pixelX / 2);
-		colorIndex = (tile->GetData(m_frame)[offset] >> ((pixelX & 1) << 2)) & 0xf;
+		colorIndex = (static_cast<const Tile&>(*tile).GetData(m_frame)[offset] >> ((pixelX & 1) << 2)) & 0xf;
 	}
 	else
 	{
 		size_t offset = (pixelY * tile->GetPitch()) + pixelX;
-		colorIndex = tile->GetData(m_frame)[offset];
+		colorIndex = static_cast<const Tile&>(*tile).GetData(m_frame)[offset];
 	}
 
 	if ((colorIndex == 0) || (!tile->GetPalette()))
@@ -453,7 +451,7 @@ void TileSetEditorWidget::SetPixel(int x, int y, shared_ptr<Palette> palette, ui
 
 	int pixelX = x % m_tileSet->GetWidth();
 	int pixelY = y % m_tileSet->GetHeight();
-	uint8_t* data;
+	const uint8_t* data;
 	uint8_t newData, colorIndex, paletteOffset;
 	size_t offset;
 	if (tile->GetDepth() == 4)
@@ -461,7 +459,7 @@ void TileSetEditorWidget::SetPixel(int x, int y, shared_ptr<Palette> palette, ui
 		colorIndex = (uint8_t)(entry & 0xf);
 		paletteOffset = (uint8_t)(entry & 0xf0);
 		offset = (pixelY * tile->GetPitch()) + (pixelX / 2);
-		data = &tile->GetData(m_frame)[offset];
+		data = &static_cast<const Tile&>(*tile).GetData(m_frame)[offset];
 		newData = ((*data) & (0xf0 >> ((pixelX & 1) << 2))) | (colorIndex << ((pixelX & 1) << 2));
 	}
 	else
@@ -469,7 +467,7 @@ void TileSetEditorWidget::SetPixel(int x, int y, shared_ptr<Palette> palette, ui
 		colorIndex = entry;
 		paletteOffset = 0;
 		offset = (pixelY * tile->GetPitch()) + pixelX;
-		data = &tile->GetData(m_frame)[offset];
+		data = &static_cast<const Tile&>(*tile).GetData(m_frame)[offset];
 		newData = colorIndex;
 	}
 
@@ -501,7 +499,8 @@ void TileSetEditorWidget::SetPixel(int x, int y, shared_ptr<Palette> palette, ui
 
 		m_pendingActions.push_back(action);
 
-		*data = newData;
+		tile->GetData(m_frame)[offset] = newData;
+		m_modifiedTiles.insert(tileIndex);
 		if ((colorIndex != 0) && ((palette != tile->GetPalette()) ||
 			(paletteOffset != tile->GetPaletteOffset())))
 		{
@@ -525,12 +524,24 @@ void TileSetEditorWidget::SetPixel(int x, int y, shared_ptr<Palette> palette, ui
 }
 
 
+void TileSetEditorWidget::NotifyModifiedTiles()
+{
+	if (m_modifiedTiles.size() == 0)
+	{
+		update();
+		return;
+	}
+	m_mainWindow->UpdateTileSetTiles(m_tileSet, m_modifiedTiles, m_frame);
+	m_modifiedTiles.clear();
+}
+
+
 void TileSetEditorWidget::SetPixelForMouseEvent(QMouseEvent* event)
 {
 	int x = event->x() / m_zoom;
 	int y = event->y() / m_zoom;
 	SetPixel(x, y, m_palette, m_mouseDownPaletteEntry);
-	m_mainWindow->UpdateTileSetContents(m_tileSet);
+	NotifyModifiedTiles();
 }
 
 
@@ -572,12 +583,12 @@ void TileSetEditorWidget::CaptureLayer(shared_ptr<TileSetFloatingLayer> layer)
 			uint8_t colorIndex;
 			if (tile->GetDepth() == 4)
 			{
-				colorIndex = (tile->GetData(m_frame)[(tilePixelY * tile->GetPitch()) +
+				colorIndex = (static_cast<const Tile&>(*tile).GetData(m_frame)[(tilePixelY * tile->GetPitch()) +
 					(tilePixelX / 2)] >> ((tilePixelX & 1) << 2)) & 0xf;
 			}
 			else
 			{
-				colorIndex = tile->GetData(m_frame)[(tilePixelY * tile->GetPitch()) + tilePixelX];
+				colorIndex = static_cast<const Tile&>(*tile).GetData(m_frame)[(tilePixelY * tile->GetPitch()) + tilePixelX];
 			}
 			colorIndex += tile->GetPaletteOffset();
 
@@ -615,7 +626,7 @@ void TileSetEditorWidget::ApplyLayer(shared_ptr<TileSetFloatingLayer> layer)
 		}
 	}
 
-	m_mainWindow->UpdateTileSetContents(m_tileSet);
+	NotifyModifiedTiles();
 }
 
 
@@ -981,7 +992,7 @@ void TileSetEditorWidget::Fill(QMouseEvent* event)
 		}
 	}
 
-	m_mainWindow->UpdateTileSetContents(m_tileSet);
+	NotifyModifiedTiles();
 }
 
 
@@ -1279,25 +1290,35 @@ void TileSetEditorWidget::CommitPendingActions()
 			setColumnsActions.erase(setColumnsActions.begin() + 1, setColumnsActions.end());
 		}
 
+		// Store the pixel changes as a compact delta for the undo history
+		shared_ptr<TilePixelDelta> delta = make_shared<TilePixelDelta>(m_frame);
+		for (auto& i : editActions)
+		{
+			shared_ptr<Tile> tile = m_tileSet->GetTile(i.tileIndex);
+			if (!tile)
+				continue;
+			delta->AddChange(tile, i.offset, i.oldData, i.newData, i.oldPalette, i.oldPaletteOffset,
+				i.newPalette, i.newPaletteOffset);
+		}
+		delta->Finish();
+
+		size_t memoryUsage = delta->GetMemoryUsage();
+		for (auto& i : selectActions)
+		{
+			for (auto& j : {i.oldSelectionContents, i.oldUnderSelection, i.newSelectionContents, i.newUnderSelection})
+			{
+				if (j)
+					memoryUsage += j->GetWidth() * j->GetHeight() * sizeof(TileSetFloatingLayerPixel);
+			}
+		}
+
 		shared_ptr<TileSet> tileSet = m_tileSet;
 		MainWindow* mainWindow = m_mainWindow;
 		uint16_t frame = m_frame;
-		m_mainWindow->AddUndoAction(
+		m_mainWindow->AddUndoAction(tileSet->GetId(), memoryUsage,
 			[=]() { // Undo
-				set<shared_ptr<Palette>> palettes;
-				for (size_t i = 0; i < editActions.size(); i++)
-				{
-					EditAction action = editActions[editActions.size() - (i + 1)];
-					shared_ptr<Tile> tile = tileSet->GetTile(action.tileIndex);
-					if (!tile)
-						continue;
-					tile->GetData(frame)[action.offset] = action.oldData;
-					tile->SetPalette(action.oldPalette, action.oldPaletteOffset);
-					if (action.oldPalette)
-						palettes.insert(action.oldPalette);
-					if (action.newPalette)
-						palettes.insert(action.newPalette);
-				}
+				delta->Undo();
+				set<shared_ptr<Palette>> palettes = delta->GetPalettes();
 				for (auto& i : selectActions)
 				{
 					TileSetView* view = mainWindow->GetTileSetView(tileSet);
@@ -1322,20 +1343,8 @@ void TileSetEditorWidget::CommitPendingActions()
 				mainWindow->UpdateTileSetContents(tileSet);
 			},
 			[=]() { // Redo
-				set<shared_ptr<Palette>> palettes;
-				for (size_t i = 0; i < editActions.size(); i++)
-				{
-					EditAction action = editActions[i];
-					shared_ptr<Tile> tile = tileSet->GetTile(action.tileIndex);
-					if (!tile)
-						continue;
-					tile->GetData(frame)[action.offset] = action.newData;
-					tile->SetPalette(action.newPalette, action.newPaletteOffset);
-					if (action.oldPalette)
-						palettes.insert(action.oldPalette);
-					if (action.newPalette)
-						palettes.insert(action.newPalette);
-				}
+				delta->Redo();
+				set<shared_ptr<Palette>> palettes = delta->GetPalettes();
 				for (auto& i : selectActions)
 				{
 					TileSetView* view = mainWindow->GetTileSetView(tileSet);
@@ -1935,6 +1944,18 @@ void TileSetEditorWidget::SelectAll()
 }
 
 
+size_t TileSetEditorWidget::GetCollisionUndoMemoryUsage(const vector<CollisionUpdateAction>& actions)
+{
+	size_t result = 0;
+	for (auto& i : actions)
+	{
+		result += sizeof(CollisionUpdateAction);
+		result += (i.oldCollision.size() + i.newCollision.size()) * sizeof(BoundingRect);
+	}
+	return result;
+}
+
+
 void TileSetEditorWidget::RemoveCollisions()
 {
 	m_tool = CollisionTool;
@@ -1958,7 +1979,7 @@ void TileSetEditorWidget::RemoveCollisions()
 
 	MainWindow* mainWindow = m_mainWindow;
 	shared_ptr<TileSet> tileSet = m_tileSet;
-	m_mainWindow->AddUndoAction(
+	m_mainWindow->AddUndoAction(tileSet->GetId(), GetCollisionUndoMemoryUsage(actions),
 		[=]() { // Undo
 			for (auto& i : actions)
 				tileSet->GetTile(i.tileIndex)->SetCollision(i.channel, i.oldCollision);
@@ -2014,7 +2035,7 @@ void TileSetEditorWidget::CollideWithAll()
 
 	MainWindow* mainWindow = m_mainWindow;
 	shared_ptr<TileSet> tileSet = m_tileSet;
-	m_mainWindow->AddUndoAction(
+	m_mainWindow->AddUndoAction(tileSet->GetId(), GetCollisionUndoMemoryUsage(actions),
 		[=]() { // Undo
 			for (auto& i : actions)
 				tileSet->GetTile(i.tileIndex)->SetCollision(i.channel, i.oldCollision);
@@ -2078,6 +2099,7 @@ void TileSetEditorWidget::ExportPNG()
 			if ((tile->GetDepth() != m_tileSet->GetDepth()))
 				continue;
 
+			const uint8_t* data = static_cast<const Tile&>(*tile).GetData(m_frame);
 			for (int y = 0; y < (int)m_tileSet->GetHeight(); y++)
 			{
 				uint32_t* line = (uint32_t*)image.scanLine(tileY * m_tileSet->GetHeight() + y);
@@ -2085,9 +2107,9 @@ void TileSetEditorWidget::ExportPNG()
 				{
 					uint8_t colorIndex;
 					if (tile->GetDepth() == 4)
-						colorIndex = (tile->GetData(m_frame)[(y * tile->GetPitch()) + (x / 2)] >> ((x & 1) << 2)) & 0xf;
+						colorIndex = (data[(y * tile->GetPitch()) + (x / 2)] >> ((x & 1) << 2)) & 0xf;
 					else
-						colorIndex = tile->GetData(m_frame)[(y * tile->GetPitch()) + x];
+						colorIndex = data[(y * tile->GetPitch()) + x];
 					if (colorIndex == 0)
 						continue;
 					if (!tile->GetPalette())
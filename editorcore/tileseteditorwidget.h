@@ -64,6 +64,7 @@ class TileSetEditorWidget: public QWidget
 	std::shared_ptr<TileSet> m_tileSet;
 	uint16_t m_frame;
 	uint32_t m_collisionChannel;
+	std::set<size_t> m_modifiedTiles;
 
 	std::shared_ptr<Palette> m_palette;
 	size_t m_leftPaletteEntry, m_rightPaletteEntry;
@@ -97,6 +98,7 @@ class TileSetEditorWidget: public QWidget
 	TileSetFloatingLayerPixel GetPixel(int x, int y);
 	void SetPixel(int x, int y, std::shared_ptr<Palette> palette, uint8_t entry);
 	void SetPixelForMouseEvent(QMouseEvent* event);
+	void NotifyModifiedTiles();
 	void CaptureLayer(std::shared_ptr<TileSetFloatingLayer> layer);
 	void ApplyLayer(std::shared_ptr<TileSetFloatingLayer> layer);
 	void UpdateSelectionLayer(QMouseEvent* event);
@@ -112,6 +114,7 @@ class TileSetEditorWidget: public QWidget
 	void AddSelectionAsCollision();
 	void SetSelectionAsCollision();
 	void RemoveSingleCollision();
+	static size_t GetCollisionUndoMemoryUsage(const std::vector<CollisionUpdateAction>& actions);
 
 	void CommitPendingActions();
 
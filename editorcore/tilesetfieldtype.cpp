@@ -12,20 +12,14 @@ TileSetFieldEditorWidget::TileSetFieldEditorWidget(const shared_ptr<Project>& pr
 	QVBoxLayout* layout = new QVBoxLayout();
 	layout->setContentsMargins(0, 0, 0, 0);
 
-	for (auto& i : project->GetTileSets())
-		m_tileSets.push_back(i.second);
-	sort(m_tileSets.begin(), m_tileSets.end(), [&](const shared_ptr<TileSet>& a, const shared_ptr<TileSet>& b) {
-		return a->GetName() < b->GetName();
-	});
-	m_tileSets.insert(m_tileSets.begin(), shared_ptr<TileSet>());
-
+	// Tile sets are listed by id so that choosing a tile set does not require loading all of them
 	QStringList choices;
-	for (auto& i : m_tileSets)
+	m_tileSetIds.push_back("");
+	choices.append("<None>");
+	for (auto& i : project->GetTileSetIdsByName())
 	{
-		if (i)
-			choices.append(QString::fromStdString(i->GetName()));
-		else
-			choices.append("<None>");
+		m_tileSetIds.push_back(i.second);
+		choices.append(QString::fromStdString(i.first));
 	}
 
 	m_combo = new QComboBox();
@@ -35,10 +29,10 @@ TileSetFieldEditorWidget::TileSetFieldEditorWidget(const shared_ptr<Project>& pr
 	{
 		if (!value->GetValue().isNull())
 		{
-			shared_ptr<TileSet> tileSet = project->GetTileSetById(value->GetValue().asString());
-			for (size_t i = 0; i < m_tileSets.size(); i++)
+			string id = value->GetValue().asString();
+			for (size_t i = 1; i < m_tileSetIds.size(); i++)
 			{
-				if (m_tileSets[i] == tileSet)
+				if (m_tileSetIds[i] == id)
 					m_combo->setCurrentIndex(i);
 			}
 		}
@@ -57,13 +51,9 @@ TileSetFieldEditorWidget::TileSetFieldEditorWidget(const shared_ptr<Project>& pr
 
 void TileSetFieldEditorWidget::OnValueChanged(int value)
 {
-	if ((value < 0) || (value >= (int)m_tileSets.size()))
+	if ((value < 0) || (value >= (int)m_tileSetIds.size()))
 		return;
-	shared_ptr<TileSet> tileSet = m_tileSets[value];
-	if (tileSet)
-		m_value->SetValue(tileSet->GetId());
-	else
-		m_value->SetValue("");
+	m_value->SetValue(m_tileSetIds[value]);
 }
 
 
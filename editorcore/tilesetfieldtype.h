@@ -8,7 +8,7 @@
 class TileSetFieldEditorWidget: public QWidget
 {
 	std::shared_ptr<ActorFieldValue> m_value;
-	std::vector<std::shared_ptr<TileSet>> m_tileSets;
+	std::vector<std::string> m_tileSetIds;
 	QComboBox* m_combo;
 
 public:
@@ -32,65 +32,77 @@ TileSetPreviewWidget::~TileSetPreviewWidget()
 }
 
 
-void TileSetPreviewWidget::UpdateImageData(int rows, int cols)
+uint16_t TileSetPreviewWidget::GetDisplayedFrame()
 {
-	uint16_t frame = m_activeFrame;
 	if (m_animate)
-		frame = m_tileSet->GetFrameForTime(m_animFrame);
+		return m_tileSet->GetFrameForTime(m_animFrame);
+	return m_activeFrame;
+}
 
-	for (int y = 0; y < m_height; y++)
-		memset(m_image->scanLine(y), 0, m_width * 4);
 
-	for (int tileY = 0; tileY < rows; tileY++)
+void TileSetPreviewWidget::UpdateTileImage(int tileX, int tileY, int cols, uint16_t frame)
+{
+	int width = (int)m_tileSet->GetWidth();
+	int height = (int)m_tileSet->GetHeight();
+	for (int y = 0; y < height; y++)
+		memset(m_image->scanLine(tileY * height + y) + (tileX * width * 4), 0, width * 4);
+
+	size_t tileIndex = (size_t)((tileY * cols) + tileX);
+	if (tileIndex >= m_tileSet->GetTileCount())
 	{
-		for (int tileX = 0; tileX < cols; tileX++)
+		for (int y = 0; y < height; y++)
 		{
-			size_t tileIndex = (size_t)((tileY * cols) + tileX);
-			if (tileIndex >= m_tileSet->GetTileCount())
-			{
-				for (int y = 0; y < (int)m_tileSet->GetHeight(); y++)
-				{
-					uint32_t* line = (uint32_t*)m_image->scanLine(tileY * m_tileSet->GetHeight() + y);
-					for (int x = 0; x < (int)m_tileSet->GetWidth(); x++)
-						line[tileX * m_tileSet->GetWidth() + x] = Theme::backgroundWindow.rgba();
-				}
-				continue;
-			}
+			uint32_t* line = (uint32_t*)m_image->scanLine(tileY * height + y);
+			for (int x = 0; x < width; x++)
+				line[tileX * width + x] = Theme::backgroundWindow.rgba();
+		}
+		return;
+	}
 
-			shared_ptr<Tile> tile = m_tileSet->GetTile(tileIndex);
-			if (!tile)
-				continue;
-			if ((tile->GetWidth() != m_tileSet->GetWidth()))
-				continue;
-			if ((tile->GetHeight() != m_tileSet->GetHeight()))
+	shared_ptr<Tile> tile = m_tileSet->GetTile(tileIndex);
+	if (!tile)
+		return;
+	if ((tile->GetWidth() != m_tileSet->GetWidth()))
+		return;
+	if ((tile->GetHeight() != m_tileSet->GetHeight()))
+		return;
+	if ((tile->GetDepth() != m_tileSet->GetDepth()))
+		return;
+
+	const uint8_t* data = static_cast<const Tile&>(*tile).GetData(frame);
+	for (int y = 0; y < height; y++)
+	{
+		uint32_t* line = (uint32_t*)m_image->scanLine(tileY * height + y);
+		for (int x = 0; x < width; x++)
+		{
+			uint8_t colorIndex;
+			if (tile->GetDepth() == 4)
+				colorIndex = (data[(y * tile->GetPitch()) + (x / 2)] >> ((x & 1) << 2)) & 0xf;
+			else
+				colorIndex = data[(y * tile->GetPitch()) + x];
+			if (colorIndex == 0)
 				continue;
-			if ((tile->GetDepth() != m_tileSet->GetDepth()))
+			if (!tile->GetPalette())
 				continue;
 
-			for (int y = 0; y < (int)m_tileSet->GetHeight(); y++)
-			{
-				uint32_t* line = (uint32_t*)m_image->scanLine(tileY * m_tileSet->GetHeight() + y);
-				for (int x = 0; x < (int)m_tileSet->GetWidth(); x++)
-				{
-					uint8_t colorIndex;
-					if (tile->GetDepth() == 4)
-						colorIndex = (tile->GetData(frame)[(y * tile->GetPitch()) + (x / 2)] >> ((x & 1) << 2)) & 0xf;
-					else
-						colorIndex = tile->GetData(frame)[(y * tile->GetPitch()) + x];
-					if (colorIndex == 0)
-						continue;
-					if (!tile->GetPalette())
-						continue;
-
-					uint16_t paletteEntry = tile->GetPalette()->GetEntry(tile->GetPaletteOffset() + colorIndex);
-					line[tileX * m_tileSet->GetWidth() + x] = Palette::ToRGB32(paletteEntry) | 0xff000000;
-				}
-			}
+			uint16_t paletteEntry = tile->GetPalette()->GetEntry(tile->GetPaletteOffset() + colorIndex);
+			line[tileX * width + x] = Palette::ToRGB32(paletteEntry) | 0xff000000;
 		}
 	}
 }
 
 
+void TileSetPreviewWidget::UpdateImageData(int rows, int cols)
+{
+	uint16_t frame = GetDisplayedFrame();
+	for (int tileY = 0; tileY < rows; tileY++)
+	{
+		for (int tileX = 0; tileX < cols; tileX++)
+			UpdateTileImage(tileX, tileY, cols, frame);
+	}
+}
+
+
 void TileSetPreviewWidget::UpdateImageData()
 {
 	int cols, rows;
@@ -144,6 +156,35 @@ void TileSetPreviewWidget::UpdateView()
 }
 
 
+void TileSetPreviewWidget::UpdateTiles(const set<size_t>& tiles, uint16_t frame)
+{
+	int cols, rows;
+	cols = m_tileSet->GetDisplayColumns();
+	if (cols > (int)m_tileSet->GetTileCount())
+		cols = (int)m_tileSet->GetTileCount();
+	rows = (m_tileSet->GetTileCount() + (cols - 1)) / cols;
+
+	int newWidth = cols * m_tileSet->GetWidth();
+	int newHeight = rows * m_tileSet->GetHeight();
+	if ((!m_image) || (newWidth != m_width) || (newHeight != m_height))
+	{
+		UpdateView();
+		return;
+	}
+
+	if (frame != GetDisplayedFrame())
+		return;
+
+	for (auto i : tiles)
+	{
+		if (i >= m_tileSet->GetTileCount())
+			continue;
+		UpdateTileImage((int)(i % (size_t)cols), (int)(i / (size_t)cols), cols, frame);
+	}
+	update();
+}
+
+
 void TileSetPreviewWidget::paintEvent(QPaintEvent*)
 {
 	QPainter p(this);
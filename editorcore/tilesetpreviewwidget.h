@@ -1,6 +1,7 @@
 #pragma once
 
 #include <QWidget>
+#include <set>
 #include "project.h"
 #include "tileset.h"
 
@@ -24,6 +25,8 @@ class TileSetPreviewWidget: public QWidget
 	QTimer* m_animTimer;
 	uint16_t m_activeFrame;
 
+	uint16_t GetDisplayedFrame();
+	void UpdateTileImage(int tileX, int tileY, int cols, uint16_t frame);
 	void UpdateImageData(int rows, int cols);
 	void UpdateImageData();
 
@@ -33,6 +36,8 @@ public:
 	~TileSetPreviewWidget();
 
 	void UpdateView();
+	// Decodes only the given tiles again if the frame is displayed, unless the layout has changed
+	void UpdateTiles(const std::set<size_t>& tiles, uint16_t frame);
 
 	void SetPreviewAnimation(bool anim);
 	void SetActiveFrame(uint16_t frame);
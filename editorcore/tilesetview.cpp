@@ -215,6 +215,20 @@ void TileSetView::UpdateToolState()
 }
 
 
+void TileSetView::UpdateTiles(const set<size_t>& tiles, uint16_t frame)
+{
+	m_editor->update();
+	m_preview->UpdateTiles(tiles, frame);
+}
+
+
+void TileSetView::UpdatePaletteList()
+{
+	m_palettes->UpdateView();
+	m_activePalette->UpdateView();
+}
+
+
 void TileSetView::UpdateView()
 {
 	m_editor->UpdateView();
@@ -337,9 +351,14 @@ void TileSetView::ResizeTileSet()
 		m_tileSet->SetTileCount(count);
 		m_mainWindow->UpdateTileSetContents(m_tileSet);
 
+		// The removed tiles are kept alive by the undo history
+		size_t memoryUsage = 0;
+		for (auto& i : deletedEntries)
+			memoryUsage += i->GetMemoryUsage();
+
 		shared_ptr<TileSet> tileSet = m_tileSet;
 		MainWindow* mainWindow = m_mainWindow;
-		m_mainWindow->AddUndoAction(
+		m_mainWindow->AddUndoAction(tileSet->GetId(), memoryUsage,
 			[=]() { // Undo
 				tileSet->SetTileCount(existingCount);
 				for (size_t i = 0; i < deletedEntries.size(); i++)
@@ -359,7 +378,7 @@ void TileSetView::ResizeTileSet()
 
 		shared_ptr<TileSet> tileSet = m_tileSet;
 		MainWindow* mainWindow = m_mainWindow;
-		m_mainWindow->AddUndoAction(
+		m_mainWindow->AddUndoAction(tileSet->GetId(), DEFAULT_UNDO_ACTION_SIZE,
 			[=]() { // Undo
 				tileSet->SetTileCount(existingCount);
 				mainWindow->UpdateTileSetContents(tileSet);
@@ -62,6 +62,8 @@ public:
 		std::shared_ptr<TileSet> tileSet);
 
 	void UpdateView();
+	void UpdateTiles(const std::set<size_t>& tiles, uint16_t frame);
+	void UpdatePaletteList();
 	void UpdateToolState();
 
 	std::shared_ptr<TileSet> GetTileSet() const { return m_tileSet; }
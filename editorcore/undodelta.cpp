@@ -0,0 +1,237 @@
+#include <algorithm>
+#include "undodelta.h"
+
+using namespace std;
+
+
+MapLayerDelta::MapLayerDelta(const shared_ptr<MapLayer>& layer): m_layer(layer)
+{
+	// Slot zero is used for cells without a tile
+	m_tileSets.push_back(shared_ptr<TileSet>());
+}
+
+
+uint16_t MapLayerDelta::GetTileSetSlot(const shared_ptr<TileSet>& tileSet)
+{
+	if (!tileSet)
+		return 0;
+	for (size_t i = 1; i < m_tileSets.size(); i++)
+	{
+		if (m_tileSets[i] == tileSet)
+			return (uint16_t)i;
+	}
+	m_tileSets.push_back(tileSet);
+	return (uint16_t)(m_tileSets.size() - 1);
+}
+
+
+TileReference MapLayerDelta::GetTile(const MapLayerCell& cell) const
+{
+	if (!cell.tileSet)
+		return TileReference();
+	return TileReference(m_tileSets[cell.tileSet], cell.index);
+}
+
+
+void MapLayerDelta::AddChange(size_t x, size_t y, const TileReference& oldTile, const TileReference& newTile)
+{
+	Change change;
+	change.x = (uint16_t)x;
+	change.y = (uint16_t)y;
+	change.oldTile.tileSet = GetTileSetSlot(oldTile.tileSet);
+	change.oldTile.index = change.oldTile.tileSet ? oldTile.index : 0;
+	change.newTile.tileSet = GetTileSetSlot(newTile.tileSet);
+	change.newTile.index = change.newTile.tileSet ? newTile.index : 0;
+	m_changes.push_back(change);
+}
+
+
+void MapLayerDelta::Finish()
+{
+	// Keep only the original and final contents of each cell, so changes can be applied in any order
+	stable_sort(m_changes.begin(), m_changes.end(), [](const Change& a, const Change& b) {
+		if (a.y != b.y)
+			return a.y < b.y;
+		return a.x < b.x;
+	});
+
+	vector<Change> changes;
+	vector<bool> used(m_tileSets.size(), false);
+	for (size_t i = 0; i < m_changes.size(); )
+	{
+		Change change = m_changes[i];
+		for (i++; (i < m_changes.size()) && (m_changes[i].x == change.x) && (m_changes[i].y == change.y); i++)
+			change.newTile = m_changes[i].newTile;
+		if ((change.oldTile.tileSet == change.newTile.tileSet) && (change.oldTile.index == change.newTile.index))
+			continue;
+		used[change.oldTile.tileSet] = true;
+		used[change.newTile.tileSet] = true;
+		changes.push_back(change);
+	}
+
+	// Drop tile sets that are no longer referenced
+	vector<shared_ptr<TileSet>> tileSets;
+	vector<uint16_t> remap(m_tileSets.size(), 0);
+	tileSets.push_back(shared_ptr<TileSet>());
+	for (size_t i = 1; i < m_tileSets.size(); i++)
+	{
+		if (!used[i])
+			continue;
+		remap[i] = (uint16_t)tileSets.size();
+		tileSets.push_back(m_tileSets[i]);
+	}
+	for (auto& i : changes)
+	{
+		i.oldTile.tileSet = remap[i.oldTile.tileSet];
+		i.newTile.tileSet = remap[i.newTile.tileSet];
+	}
+
+	changes.shrink_to_fit();
+	tileSets.shrink_to_fit();
+	m_changes = move(changes);
+	m_tileSets = move(tileSets);
+}
+
+
+void MapLayerDelta::Apply(bool undo) const
+{
+	vector<pair<size_t, size_t>> changedTiles;
+	changedTiles.reserve(m_changes.size());
+	for (auto& i : m_changes)
+	{
+		m_layer->SetTileAt(i.x, i.y, GetTile(undo ? i.oldTile : i.newTile));
+		changedTiles.push_back(pair<size_t, size_t>(i.x, i.y));
+	}
+	m_layer->UpdateSmartTilesAround(changedTiles);
+}
+
+
+void MapLayerDelta::Undo() const
+{
+	Apply(true);
+}
+
+
+void MapLayerDelta::Redo() const
+{
+	Apply(false);
+}
+
+
+size_t MapLayerDelta::GetMemoryUsage() const
+{
+	return sizeof(MapLayerDelta) + (m_changes.capacity() * sizeof(Change)) +
+		(m_tileSets.capacity() * sizeof(shared_ptr<TileSet>));
+}
+
+
+TilePixelDelta::TilePixelDelta(uint16_t frame): m_frame(frame)
+{
+}
+
+
+void TilePixelDelta::AddChange(const shared_ptr<Tile>& tile, size_t offset, uint8_t oldData, uint8_t newData,
+	const shared_ptr<Palette>& oldPalette, uint8_t oldPaletteOffset,
+	const shared_ptr<Palette>& newPalette, uint8_t newPaletteOffset)
+{
+	size_t slot;
+	for (slot = 0; slot < m_tiles.size(); slot++)
+	{
+		if (m_tiles[slot].tile == tile)
+			break;
+	}
+
+	if (slot == m_tiles.size())
+	{
+		TileEntry entry;
+		entry.tile = tile;
+		entry.oldPalette = oldPalette;
+		entry.oldPaletteOffset = oldPaletteOffset;
+		m_tiles.push_back(entry);
+	}
+
+	// Undo restores the palette from before the first change, redo the palette from after the last change
+	m_tiles[slot].newPalette = newPalette;
+	m_tiles[slot].newPaletteOffset = newPaletteOffset;
+
+	Change change;
+	change.offset = (uint32_t)offset;
+	change.tile = (uint16_t)slot;
+	change.oldData = oldData;
+	change.newData = newData;
+	m_changes.push_back(change);
+}
+
+
+void TilePixelDelta::Finish()
+{
+	stable_sort(m_changes.begin(), m_changes.end(), [](const Change& a, const Change& b) {
+		if (a.tile != b.tile)
+			return a.tile < b.tile;
+		return a.offset < b.offset;
+	});
+
+	vector<Change> changes;
+	for (size_t i = 0; i < m_changes.size(); )
+	{
+		Change change = m_changes[i];
+		for (i++; (i < m_changes.size()) && (m_changes[i].tile == change.tile) &&
+			(m_changes[i].offset == change.offset); i++)
+			change.newData = m_changes[i].newData;
+		if (change.oldData == change.newData)
+			continue;
+		changes.push_back(change);
+	}
+
+	// Tiles are kept even without pixel changes, as their palette may have changed
+	changes.shrink_to_fit();
+	m_tiles.shrink_to_fit();
+	m_changes = move(changes);
+}
+
+
+void TilePixelDelta::Apply(bool undo) const
+{
+	for (auto& i : m_changes)
+		m_tiles[i.tile].tile->GetData(m_frame)[i.offset] = undo ? i.oldData : i.newData;
+	for (auto& i : m_tiles)
+	{
+		if (undo)
+			i.tile->SetPalette(i.oldPalette, i.oldPaletteOffset);
+		else
+			i.tile->SetPalette(i.newPalette, i.newPaletteOffset);
+	}
+}
+
+
+void TilePixelDelta::Undo() const
+{
+	Apply(true);
+}
+
+
+void TilePixelDelta::Redo() const
+{
+	Apply(false);
+}
+
+
+set<shared_ptr<Palette>> TilePixelDelta::GetPalettes() const
+{
+	set<shared_ptr<Palette>> palettes;
+	for (auto& i : m_tiles)
+	{
+		if (i.oldPalette)
+			palettes.insert(i.oldPalette);
+		if (i.newPalette)
+			palettes.insert(i.newPalette);
+	}
+	return palettes;
+}
+
+
+size_t TilePixelDelta::GetMemoryUsage() const
+{
+	return sizeof(TilePixelDelta) + (m_changes.capacity() * sizeof(Change)) +
+		(m_tiles.capacity() * sizeof(TileEntry));
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <vector>
+#include <set>
+#include <memory>
+#include <inttypes.h>
+#include "maplayer.h"
+
+// Tile changes to a single map layer, stored compactly for the undo history. Tile sets are referenced
+// through a small table so that each change takes 12 bytes. Call Finish once all changes are added, it
+// merges repeated changes to the same cell and drops changes that did not modify anything.
+class MapLayerDelta
+{
+	struct Change
+	{
+		uint16_t x, y;
+		MapLayerCell oldTile, newTile;
+	};
+
+	std::shared_ptr<MapLayer> m_layer;
+	std::vector<std::shared_ptr<TileSet>> m_tileSets;
+	std::vector<Change> m_changes;
+
+	uint16_t GetTileSetSlot(const std::shared_ptr<TileSet>& tileSet);
+	TileReference GetTile(const MapLayerCell& cell) const;
+	void Apply(bool undo) const;
+
+public:
+	MapLayerDelta(const std::shared_ptr<MapLayer>& layer);
+
+	std::shared_ptr<MapLayer> GetLayer() const { return m_layer; }
+	bool IsEmpty() const { return m_changes.size() == 0; }
+
+	void AddChange(size_t x, size_t y, const TileReference& oldTile, const TileReference& newTile);
+	void Finish();
+
+	// Restores the tiles and updates the smart tiles around them
+	void Undo() const;
+	void Redo() const;
+
+	size_t GetMemoryUsage() const;
+};
+
+// Pixel changes to one frame of a set of tiles, stored compactly for the undo history. Each change takes
+// 8 bytes, palette assignments are stored once per tile. Call Finish once all changes are added.
+class TilePixelDelta
+{
+	struct TileEntry
+	{
+		std::shared_ptr<Tile> tile;
+		std::shared_ptr<Palette> oldPalette, newPalette;
+		uint8_t oldPaletteOffset, newPaletteOffset;
+	};
+
+	struct Change
+	{
+		uint32_t offset;
+		uint16_t tile;
+		uint8_t oldData, newData;
+	};
+
+	uint16_t m_frame;
+	std::vector<TileEntry> m_tiles;
+	std::vector<Change> m_changes;
+
+	void Apply(bool undo) const;
+
+public:
+	TilePixelDelta(uint16_t frame);
+
+	bool IsEmpty() const { return m_tiles.size() == 0; }
+
+	void AddChange(const std::shared_ptr<Tile>& tile, size_t offset, uint8_t oldData, uint8_t newData,
+		const std::shared_ptr<Palette>& oldPalette, uint8_t oldPaletteOffset,
+		const std::shared_ptr<Palette>& newPalette, uint8_t newPaletteOffset);
+	void Finish();
+
+	void Undo() const;
+	void Redo() const;
+
+	// Palettes assigned to the changed tiles before or after the change
+	std::set<std::shared_ptr<Palette>> GetPalettes() const;
+
+	size_t GetMemoryUsage() const;
+};
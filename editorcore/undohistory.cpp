@@ -0,0 +1,100 @@
+#include "undohistory.h"
+
+using namespace std;
+
+
+UndoAction::UndoAction(const function<void()>& undoAction, const function<void()>& redoAction,
+	const string& asset, size_t memoryUsage):
+	m_undo(undoAction), m_redo(redoAction), m_asset(asset), m_memoryUsage(memoryUsage + sizeof(UndoAction))
+{
+}
+
+
+void UndoAction::Undo()
+{
+	m_undo();
+}
+
+
+void UndoAction::Redo()
+{
+	m_redo();
+}
+
+
+UndoHistory::UndoHistory(size_t budget): m_memoryUsage(0), m_memoryBudget(budget)
+{
+}
+
+
+void UndoHistory::Add(const shared_ptr<UndoAction>& action)
+{
+	for (auto& i : m_redoStack)
+		m_memoryUsage -= i->GetMemoryUsage();
+	m_redoStack.clear();
+
+	m_undoStack.push_back(action);
+	m_memoryUsage += action->GetMemoryUsage();
+	DiscardOldActions();
+}
+
+
+bool UndoHistory::Undo()
+{
+	if (m_undoStack.empty())
+		return false;
+	shared_ptr<UndoAction> action = m_undoStack.back();
+	m_undoStack.pop_back();
+	m_redoStack.push_back(action);
+	action->Undo();
+	return true;
+}
+
+
+bool UndoHistory::Redo()
+{
+	if (m_redoStack.empty())
+		return false;
+	shared_ptr<UndoAction> action = m_redoStack.back();
+	m_redoStack.pop_back();
+	m_undoStack.push_back(action);
+	action->Redo();
+	return true;
+}
+
+
+void UndoHistory::Clear()
+{
+	m_undoStack.clear();
+	m_redoStack.clear();
+	m_memoryUsage = 0;
+}
+
+
+void UndoHistory::DiscardOldActions()
+{
+	// Always keep the most recent action so that it can be undone, even if it is larger than the budget
+	while ((m_memoryUsage > m_memoryBudget) && (m_undoStack.size() > 1))
+	{
+		m_memoryUsage -= m_undoStack.front()->GetMemoryUsage();
+		m_undoStack.pop_front();
+	}
+}
+
+
+void UndoHistory::SetMemoryBudget(size_t bytes)
+{
+	m_memoryBudget = bytes;
+	DiscardOldActions();
+}
+
+
+map<string, size_t> UndoHistory::GetMemoryUsageByAsset() const
+{
+	map<string, size_t> result;
+	for (auto& i : m_undoStack)
+		result[i->GetAsset()] += i->GetMemoryUsage();
+	for (auto& i : m_redoStack)
+		result[i->GetAsset()] += i->GetMemoryUsage();
+	return result;
+}
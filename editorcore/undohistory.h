@@ -0,0 +1,58 @@
+#pragma once
+
+#include <functional>
+#include <deque>
+#include <map>
+#include <memory>
+#include <string>
+
+// Default limit on the memory used by the undo history, the oldest actions are discarded when it is exceeded
+#define DEFAULT_UNDO_MEMORY_BUDGET (64 * 1024 * 1024)
+
+// Estimated size of an undo action that does not report its memory usage
+#define DEFAULT_UNDO_ACTION_SIZE 256
+
+class UndoAction
+{
+	std::function<void()> m_undo, m_redo;
+	std::string m_asset;
+	size_t m_memoryUsage;
+
+public:
+	UndoAction(const std::function<void()>& undoAction, const std::function<void()>& redoAction,
+		const std::string& asset, size_t memoryUsage);
+	void Undo();
+	void Redo();
+
+	// Id of the asset the action belongs to, empty for actions that are not attributed to an asset
+	const std::string& GetAsset() const { return m_asset; }
+	size_t GetMemoryUsage() const { return m_memoryUsage; }
+};
+
+// Undo and redo stacks with a memory budget. Memory usage counts the actions on both stacks, the oldest
+// undo actions are discarded when it is exceeded.
+class UndoHistory
+{
+	std::deque<std::shared_ptr<UndoAction>> m_undoStack, m_redoStack;
+	size_t m_memoryUsage;
+	size_t m_memoryBudget;
+
+	void DiscardOldActions();
+
+public:
+	UndoHistory(size_t budget = DEFAULT_UNDO_MEMORY_BUDGET);
+
+	// Adding an action clears the redo stack
+	void Add(const std::shared_ptr<UndoAction>& action);
+	bool Undo();
+	bool Redo();
+	void Clear();
+
+	size_t GetUndoCount() const { return m_undoStack.size(); }
+	size_t GetRedoCount() const { return m_redoStack.size(); }
+
+	size_t GetMemoryBudget() const { return m_memoryBudget; }
+	void SetMemoryBudget(size_t bytes);
+	size_t GetMemoryUsage() const { return m_memoryUsage; }
+	std::map<std::string, size_t> GetMemoryUsageByAsset() const;
+};
@@ -3,7 +3,7 @@ extern crate serde_json;
 use std::io;
 use std::rc::Rc;
 use std::cmp::{min, max};
-use tile::{TileSet, PaletteWithOffset};
+use tile::{TileSet, PaletteWithOffset, decode_base64};
 use asset;
 use asset::AssetNamespace;
 use actor::BoundingRect;
@@ -19,7 +19,8 @@ struct RawMapLayer {
 	pub tile_height: usize,
 	pub tile_depth: usize,
 	pub tile_sets: Vec<String>,
-	pub tiles: Vec<String>,
+	pub tile_format: Option<u32>,
+	pub tiles: serde_json::Value,
 	pub effect: bool,
 	pub blend: u32,
 	pub alpha: u8,
@@ -29,6 +30,9 @@ struct RawMapLayer {
 	pub auto_scroll_y: i16
 }
 
+const TILE_FORMAT_ROWS: u32 = 1;
+const TILE_FORMAT_PACKED: u32 = 2;
+
 #[derive(Serialize, Deserialize)]
 struct RawMapLayerRef {
 	pub normal: Option<RawMapLayer>,
@@ -189,11 +193,6 @@ impl MapLayer {
 			return Err(io::Error::new(io::ErrorKind::InvalidData, "Non-effect layers cannot have scrolling effects"));
 		}
 
-		// Check tile count for given width and height
-		if raw_map_layer.tiles.len() != map_layer.height {
-			return Err(io::Error::new(io::ErrorKind::InvalidData, "Tile row count does not match height"));
-		}
-
 		// Resolve tile sets
 		let mut tile_sets = Vec::new();
 		for tile_set_id in raw_map_layer.tile_sets {
@@ -214,9 +213,34 @@ impl MapLayer {
 		}
 
 		// Resolve individual tiles
-		for tile_row_str in raw_map_layer.tiles {
+		match raw_map_layer.tile_format.unwrap_or(TILE_FORMAT_ROWS) {
+			TILE_FORMAT_ROWS => {
+				let tile_rows: Vec<String> = serde_json::from_value(raw_map_layer.tiles)?;
+				map_layer.import_tile_rows(&tile_sets, tile_rows)?;
+			},
+			TILE_FORMAT_PACKED => {
+				let packed_str: String = serde_json::from_value(raw_map_layer.tiles)?;
+				let packed = match decode_base64(&packed_str) {
+					Some(packed) => packed,
+					None => return Err(io::Error::new(io::ErrorKind::InvalidData, "Invalid packed tile data"))
+				};
+				map_layer.import_packed_tiles(&tile_sets, &packed)?;
+			},
+			_ => return Err(io::Error::new(io::ErrorKind::InvalidData, "Unsupported tile format"))
+		}
+
+		Ok(Rc::new(map_layer))
+	}
+
+	fn import_tile_rows(&mut self, tile_sets: &Vec<Rc<TileSet>>, tile_rows: Vec<String>) -> Result<(), io::Error> {
+		// Check tile count for given width and height
+		if tile_rows.len() != self.height {
+			return Err(io::Error::new(io::ErrorKind::InvalidData, "Tile row count does not match height"));
+		}
+
+		for tile_row_str in tile_rows {
 			let raw_tile_row: Vec<Vec<usize>> = serde_json::from_str(&tile_row_str)?;
-			if raw_tile_row.len() != map_layer.width {
+			if raw_tile_row.len() != self.width {
 				return Err(io::Error::new(io::ErrorKind::InvalidData, "Tile column count does not match width"));
 			}
 			for raw_tile in raw_tile_row {
@@ -232,11 +256,53 @@ impl MapLayer {
 					},
 					_ => return Err(io::Error::new(io::ErrorKind::InvalidData, "Invalid tile format"))
 				};
-				map_layer.tiles.push(tile)
+				self.tiles.push(tile)
 			}
 		}
 
-		Ok(Rc::new(map_layer))
+		Ok(())
+	}
+
+	fn import_packed_tiles(&mut self, tile_sets: &Vec<Rc<TileSet>>, packed: &[u8]) -> Result<(), io::Error> {
+		// Each run is a 16-bit count, a 16-bit tile set number (zero for no tile) and a 16-bit tile index,
+		// all little endian. Runs never cross the end of a row.
+		if (packed.len() % 6) != 0 {
+			return Err(io::Error::new(io::ErrorKind::InvalidData, "Invalid packed tile data"));
+		}
+
+		let mut x = 0;
+		for run in packed.chunks(6) {
+			let count = (run[0] as usize) | ((run[1] as usize) << 8);
+			let tile_set_number = (run[2] as usize) | ((run[3] as usize) << 8);
+			let tile_index = (run[4] as usize) | ((run[5] as usize) << 8);
+
+			if (count == 0) || ((x + count) > self.width) ||
+				((self.tiles.len() + count) > (self.width * self.height)) {
+				return Err(io::Error::new(io::ErrorKind::InvalidData, "Invalid tile run"));
+			}
+			if tile_set_number > tile_sets.len() {
+				return Err(io::Error::new(io::ErrorKind::InvalidData, "Invalid tile set reference"));
+			}
+
+			let tile = match tile_set_number {
+				0 => None,
+				_ => Some(TileRef::new(&tile_sets[tile_set_number - 1], tile_index))
+			};
+			for _ in 0..count {
+				self.tiles.push(tile.clone());
+			}
+
+			x += count;
+			if x == self.width {
+				x = 0;
+			}
+		}
+
+		if self.tiles.len() != (self.width * self.height) {
+			return Err(io::Error::new(io::ErrorKind::InvalidData, "Tile count does not match size"));
+		}
+
+		Ok(())
 	}
 
 	fn import(assets: &AssetNamespace, data: &str, effect: bool) -> Result<Rc<MapLayer>, io::Error> {
@@ -1,18 +1,18 @@
 extern crate serde_json;
-extern crate hex;
 
 use std::io;
 use std::rc::Rc;
 use std::collections::HashMap;
 use asset;
 use asset::AssetNamespace;
-use tile::{PaletteWithOffset, Animation};
+use tile::{PaletteWithOffset, Animation, decode_tile_data};
 
 #[derive(Serialize, Deserialize)]
 struct RawSpriteTile {
 	pub palette: Option<String>,
 	pub offset: Option<usize>,
-	pub data: String
+	pub data: String,
+	pub encoding: Option<String>
 }
 
 #[derive(Serialize, Deserialize)]
@@ -152,9 +152,9 @@ impl Sprite {
 			};
 
 			// Decode tile data
-			let data = match hex::decode(raw_sprite_anim.tile.data) {
-				Ok(decoded_data) => decoded_data,
-				Err(_) => return Err(io::Error::new(io::ErrorKind::InvalidData, "Sprite data is invalid"))
+			let data = match decode_tile_data(&raw_sprite_anim.tile.data, &raw_sprite_anim.tile.encoding) {
+				Some(decoded_data) => decoded_data,
+				None => return Err(io::Error::new(io::ErrorKind::InvalidData, "Sprite data is invalid"))
 			};
 			if data.len() != (frames * sprite.single_frame_size) {
 				return Err(io::Error::new(io::ErrorKind::InvalidData, "Sprite data size is incorrect for its animation"));
@@ -1,5 +1,6 @@
 extern crate serde_json;
 extern crate hex;
+extern crate inflate;
 
 use std::io;
 use std::rc::Rc;
@@ -28,6 +29,7 @@ struct RawTile {
 	pub palette: Option<String>,
 	pub offset: Option<usize>,
 	pub data: String,
+	pub encoding: Option<String>,
 	pub collision: Option<Vec<RawBoundingRect>>,
 	pub collision_channels: Option<Vec<RawCollisionChannel>>
 }
@@ -74,6 +76,48 @@ pub struct TileSet {
 	pub animation: Option<Animation>
 }
 
+pub fn decode_base64(data: &str) -> Option<Vec<u8>> {
+	let mut result = Vec::with_capacity((data.len() / 4) * 3);
+	let mut accumulator: u32 = 0;
+	let mut bits = 0;
+	for ch in data.bytes() {
+		let value = match ch {
+			b'A' ..= b'Z' => ch - b'A',
+			b'a' ..= b'z' => (ch - b'a') + 26,
+			b'0' ..= b'9' => (ch - b'0') + 52,
+			b'+' => 62,
+			b'/' => 63,
+			b'=' => break,
+			_ => return None
+		};
+		accumulator = (accumulator << 6) | (value as u32);
+		bits += 6;
+		if bits >= 8 {
+			bits -= 8;
+			result.push((accumulator >> bits) as u8);
+		}
+	}
+	Some(result)
+}
+
+/// Decodes tile pixel data in any of the encodings written by the editor. Data without an
+/// encoding tag uses the original hex format.
+pub fn decode_tile_data(data: &str, encoding: &Option<String>) -> Option<Vec<u8>> {
+	match encoding.as_ref().map(|e| e.as_str()) {
+		None | Some("hex") => hex::decode(data).ok(),
+		Some("base64") => decode_base64(data),
+		Some("zlib") => {
+			// Compressed data starts with the 32-bit big endian uncompressed size
+			let compressed = decode_base64(data)?;
+			if compressed.len() < 4 {
+				return None;
+			}
+			inflate::inflate_bytes_zlib(&compressed[4..]).ok()
+		},
+		_ => None
+	}
+}
+
 impl Animation {
 	pub fn new(frame_lengths: Vec<usize>) -> Animation {
 		let mut total_length = 0;
@@ -178,9 +222,9 @@ impl TileSet {
 			};
 
 			// Decode tile data
-			let data = match hex::decode(raw_tile.data) {
-				Ok(decoded_data) => decoded_data,
-				Err(_) => return Err(io::Error::new(io::ErrorKind::InvalidData, "Tile data is invalid"))
+			let data = match decode_tile_data(&raw_tile.data, &raw_tile.encoding) {
+				Some(decoded_data) => decoded_data,
+				None => return Err(io::Error::new(io::ErrorKind::InvalidData, "Tile data is invalid"))
 			};
 			if data.len() != (tile_set.frames * tile_set.single_frame_size) {
 				return Err(io::Error::new(io::ErrorKind::InvalidData, "Tile data size is incorrect for its tile set"));